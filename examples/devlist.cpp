@@ -62,6 +62,12 @@ int main() {
     unsigned pos = 0;
     for(auto d = dev.begin(); d != dev.end(); d++)
         cout << ++pos << ". " << *d << endl;
+#elif VEXCL_BACKEND_JIT
+    cout << "JIT devices:" << endl << endl;
+    for(auto d = dev.begin(); d != dev.end(); d++)
+        cout << "  " << d->name() << endl
+             << "    " << left << setw(32) << "Compute units" << " = "
+             << d->compute_units() << endl;
 #else
 #error Unsupported backend
 #endif
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vexcl/devlist.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+
+//---------------------------------------------------------------------------
+// Measures host-side overhead of launching tiny kernels, where the time spent
+// in the library dominates the time spent on the device.
+//
+// The first two lines compare the per-launch device metadata lookup only:
+// the driver queries the library used to make on each launch, against the
+// cached vex::get_queue_info() lookup that replaced them. The last two lines
+// give the total host time of an assignment and a reduction as they are
+// launched now; the old launch path is not available for comparison.
+//---------------------------------------------------------------------------
+template <class F>
+double per_call(size_t m, F &&f) {
+    typedef std::chrono::high_resolution_clock clock;
+
+    auto start = clock::now();
+    for(size_t i = 0; i < m; ++i) f();
+    auto stop = clock::now();
+
+    return std::chrono::duration<double, std::micro>(stop - start).count() / m;
+}
+
+int main(int argc, char *argv[]) {
+    const size_t n = 16;
+    const size_t m = argc > 1 ? std::stoul(argv[1]) : 100000;
+
+    try {
+        vex::Context ctx(vex::Filter::Env && vex::Filter::Count(1));
+        if (!ctx) {
+            std::cerr << "No compute devices found" << std::endl;
+            return 1;
+        }
+        std::cout << ctx << std::endl;
+
+        const vex::backend::command_queue &q = ctx.queue(0);
+
+        vex::vector<double> x(ctx, n), y(ctx, n);
+        vex::Reductor<double, vex::SUM> sum(ctx);
+
+        x = 1;
+        y = 2;
+        double s = sum(x);
+
+        std::cout << std::fixed << std::setprecision(3)
+                  << "Per-call host time, us (" << m << " calls)\n";
+
+        // Metadata lookup done on each launch before and after queue_info:
+        std::cout << "  driver queries:      " << per_call(m, [&]() {
+                vex::backend::get_context_id(q);
+                vex::backend::get_device_id(q);
+                vex::backend::compute_units(q);
+                vex::backend::is_cpu(q);
+                }) << std::endl;
+
+        std::cout << "  queue_info lookup:   " << per_call(m, [&]() {
+                vex::get_queue_info(q);
+                }) << std::endl;
+
+        std::cout << "  x = y - x:           " << per_call(m, [&]() {
+                x = y - x;
+                }) << std::endl;
+        ctx.finish();
+
+        std::cout << "  sum(x * y):          " << per_call(m, [&]() {
+                s += sum(x * y);
+                }) << std::endl;
+
+        std::cout << "(" << s << ")" << std::endl;
+    } catch (const vex::error &e) {
+        std::cerr << e << std::endl;
+        return 1;
+    }
+}
+
+// vim: et
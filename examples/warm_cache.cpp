@@ -0,0 +1,22 @@
+#include <iostream>
+#include <vexcl/vexcl.hpp>
+
+// Compiles programs recorded by an application run with VEXCL_RECORD_PROGRAMS
+// set, so that the binary cache on the target machine is warm before the
+// application is first started there.
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <recorded programs>" << std::endl;
+        return 1;
+    }
+
+    vex::Context ctx( vex::Filter::Env );
+    std::cout << ctx << std::endl;
+
+    for(int i = 1; i < argc; ++i) {
+        size_t n = vex::precompile::from_file(ctx, argv[i]);
+        std::cout << argv[i] << ": " << n << " programs" << std::endl;
+    }
+
+    vex::precompile::wait();
+}
@@ -0,0 +1,43 @@
+#define BOOST_TEST_MODULE Autotune
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/autotune.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(tune_vector_kernel)
+{
+    const size_t N = 1 << 16;
+
+    vex::autotune::enable();
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, N);
+
+    // Enough launches to time every candidate configuration.
+    for(int i = 0; i < 256; ++i) {
+        Y = 3 * X - 1;
+        check_sample(Y, [&](size_t idx, double a) { BOOST_CHECK_CLOSE(a, 3 * x[idx] - 1, 1e-8); });
+    }
+
+    auto res = vex::autotune::results();
+
+    bool found = false;
+    for(auto r = res.begin(); r != res.end(); ++r)
+        if (r->second.kernel == "vexcl_vector_kernel") {
+            found = true;
+            BOOST_CHECK(r->second.ngroups > 0);
+            BOOST_CHECK(r->second.wgs > 0);
+            BOOST_CHECK(r->second.best_time <= r->second.default_time);
+        }
+    BOOST_CHECK(found);
+
+    std::ostringstream report;
+    vex::autotune::report(report);
+    BOOST_CHECK(report.str().find("vexcl_vector_kernel") != std::string::npos);
+
+    vex::autotune::enable(false);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,120 @@
+#define BOOST_TEST_MODULE BinaryCache
+#include <boost/test/unit_test.hpp>
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/binary_cache.hpp>
+
+BOOST_AUTO_TEST_CASE(cache_key)
+{
+    std::string src = "kernel void dummy() {}";
+
+    BOOST_CHECK_EQUAL(vex::binary_cache::key(src), vex::sha1(src));
+    BOOST_CHECK_EQUAL(vex::binary_cache::key(src), vex::sha1(src));
+    BOOST_CHECK(vex::binary_cache::key(src) != vex::binary_cache::key(src + " "));
+}
+
+BOOST_AUTO_TEST_CASE(save_and_load)
+{
+    std::string key  = vex::sha1("vexcl binary cache test");
+    std::string data("binary\0data", 11);
+
+    vex::binary_cache::remove(key);
+    BOOST_CHECK(!vex::binary_cache::load(key, "kernel.bin"));
+    BOOST_CHECK(!vex::binary_cache::find(key, "kernel.bin"));
+
+    BOOST_REQUIRE(vex::binary_cache::save(key, "kernel.bin", data));
+
+    boost::optional<std::string> cached = vex::binary_cache::load(key, "kernel.bin");
+    BOOST_REQUIRE(cached);
+    BOOST_CHECK(*cached == data);
+    BOOST_CHECK(vex::binary_cache::find(key, "kernel.bin"));
+
+    vex::binary_cache::remove(key);
+    BOOST_CHECK(!vex::binary_cache::load(key, "kernel.bin"));
+}
+
+BOOST_AUTO_TEST_CASE(manifest_collision)
+{
+    namespace bc = vex::binary_cache;
+
+    std::string src   = "kernel void collision() {}";
+    std::string other = vex::sha1("vexcl binary cache collision");
+
+    // Pretend another program has the same cheap hash:
+    {
+        std::lock_guard<std::mutex> guard(bc::detail::manifest_mutex());
+        bc::detail::manifest_entry e = {
+            other, bc::detail::check_hash("kernel void another() {}")
+        };
+        bc::detail::manifest()[std::make_pair(bc::detail::fnv1a(src), src.size())] = e;
+    }
+
+    BOOST_CHECK_EQUAL(bc::key(src), vex::sha1(src));
+}
+
+BOOST_AUTO_TEST_CASE(manifest_compaction)
+{
+    namespace bc = vex::binary_cache;
+
+    std::string src = "kernel void compaction() {}";
+    std::string key = bc::key(src);
+
+    std::lock_guard<std::mutex> guard(bc::detail::manifest_mutex());
+    auto r = bc::detail::manifest().find(std::make_pair(bc::detail::fnv1a(src), src.size()));
+    BOOST_REQUIRE(r != bc::detail::manifest().end());
+    BOOST_CHECK_EQUAL(r->second.key, key);
+
+    // Duplicate records (e.g. from other processes) are compacted away:
+    for(int i = 0; i < 1000; ++i) bc::detail::append_manifest(*r);
+
+    size_t lines;
+    bc::detail::manifest_type m = bc::detail::read_manifest(lines);
+
+    BOOST_CHECK(lines <= 2 * m.size() + 64);
+    BOOST_CHECK_EQUAL(m[r->first].key, key);
+}
+
+BOOST_AUTO_TEST_CASE(known_cache_size)
+{
+    namespace bc = vex::binary_cache;
+
+    std::string key = vex::sha1("vexcl binary cache size");
+
+    uintmax_t limit = bc::size_limit();
+    bc::set_size_limit(uintmax_t(1) << 40);
+
+    // The scan measures the cache size, and commits add to it:
+    bc::trim();
+    BOOST_REQUIRE(bc::detail::known_size().known);
+
+    uintmax_t before = bc::detail::known_size().bytes;
+    BOOST_REQUIRE(bc::save(key, "kernel.bin", std::string(100, 'x')));
+    BOOST_CHECK_EQUAL(bc::detail::known_size().bytes, before + 100);
+
+    bc::set_size_limit(limit);
+    bc::remove(key);
+}
+
+BOOST_AUTO_TEST_CASE(stale_temporary_files)
+{
+    namespace bc = vex::binary_cache;
+    namespace fs = boost::filesystem;
+
+    std::string key = vex::sha1("vexcl binary cache temporary files");
+
+    std::string stale = bc::temp_path(key) + ".so";
+    std::string fresh = bc::temp_path(key);
+
+    std::ofstream(stale) << "stale";
+    std::ofstream(fresh) << "fresh";
+    fs::last_write_time(stale, std::time(0) - 7200);
+
+    uintmax_t limit = bc::size_limit();
+    bc::set_size_limit(uintmax_t(1) << 40);
+    bc::trim();
+    bc::set_size_limit(limit);
+
+    BOOST_CHECK(!fs::exists(stale));
+    BOOST_CHECK( fs::exists(fresh));
+
+    bc::remove(key);
+}
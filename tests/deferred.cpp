@@ -0,0 +1,208 @@
+#define BOOST_TEST_MODULE DeferredEvaluation
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/element_index.hpp>
+#include <vexcl/function.hpp>
+#include <vexcl/graph.hpp>
+#include <vexcl/deferred.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(fused_statements)
+{
+    const size_t N = 1024;
+
+    std::vector<double> b = random_vector<double>(N);
+    std::vector<double> q = random_vector<double>(N);
+    std::vector<double> p = random_vector<double>(N);
+    std::vector<double> x = random_vector<double>(N);
+
+    vex::vector<double> B(ctx, b);
+    vex::vector<double> Q(ctx, q);
+    vex::vector<double> P(ctx, p);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> R(ctx, N);
+
+    double alpha = 0.5, beta = 2;
+
+    vex::graph g;
+    {
+        vex::capture c(g);
+        vex::deferred lazy;
+
+        R  = B - Q;
+        P  = R + beta * P;
+        X += alpha * sin(P);
+
+        BOOST_CHECK_EQUAL(lazy.size(), 3U);
+        BOOST_CHECK_EQUAL(g.size(), 0U);
+    }
+
+    // Single fused kernel per device:
+    BOOST_CHECK_EQUAL(g.size(), ctx.size());
+
+    check_sample(R, P, X, [&](size_t idx, double r, double pp, double xx) {
+            double res_r = b[idx] - q[idx];
+            double res_p = res_r + beta * p[idx];
+            double res_x = x[idx] + alpha * std::sin(res_p);
+
+            BOOST_CHECK_CLOSE(r,  res_r, 1e-8);
+            BOOST_CHECK_CLOSE(pp, res_p, 1e-8);
+            BOOST_CHECK_CLOSE(xx, res_x, 1e-8);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(aliased_statements)
+{
+    const size_t N = 1024;
+
+    std::vector<int> x = random_vector<int>(N);
+    std::vector<int> y = random_vector<int>(N);
+
+    vex::vector<int> X(ctx, x);
+    vex::vector<int> Y(ctx, y);
+
+    {
+        vex::deferred lazy;
+
+        X  = X + Y;
+        Y  = X * 2 - Y;
+        X -= Y;
+        Y  = X;
+    }
+
+    check_sample(X, Y, [&](size_t idx, int a, int b) {
+            int xx = x[idx] + y[idx];
+            int yy = xx * 2 - y[idx];
+            xx -= yy;
+
+            BOOST_CHECK_EQUAL(a, xx);
+            BOOST_CHECK_EQUAL(b, xx);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(flush_triggers)
+{
+    const size_t N = 1024;
+
+    vex::vector<double> X(ctx, N);
+    vex::vector<double> Y(ctx, N);
+    vex::vector<size_t> I(ctx, N);
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+
+    vex::deferred lazy;
+
+    // Host read:
+    X = 1;
+    Y = 2 * X;
+    BOOST_CHECK_EQUAL(lazy.size(), 2U);
+    BOOST_CHECK_EQUAL(Y[N / 2], 2);
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+    // Other kernels:
+    Y += X;
+    BOOST_CHECK_CLOSE(sum(Y), 3.0 * N, 1e-8);
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+    // Statements that can not be deferred:
+    I = 42;
+    I = vex::element_index();
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+    check_sample(I, [](size_t idx, size_t a) { BOOST_CHECK_EQUAL(a, idx); });
+
+    // Destruction of a queued vector:
+    {
+        vex::vector<double> Z(ctx, N);
+        Z = 2 * Y;
+        X = Z;
+        BOOST_CHECK_EQUAL(lazy.size(), 2U);
+    }
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+    check_sample(X, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 6); });
+}
+
+BOOST_AUTO_TEST_CASE(statement_errors)
+{
+    const size_t N = 1024;
+
+    vex::vector<double> X(ctx, N);
+    vex::vector<double> Y(ctx, N / 2);
+
+    VEX_FUNCTION(double, broken, (double, x), return vexcl_undefined_function(x););
+
+    X = 1;
+
+    {
+        vex::deferred lazy;
+
+        // Sizes are checked when the statement is queued:
+        BOOST_CHECK_THROW(X = 2 * Y, std::runtime_error);
+        BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+        // Explicit flush reports errors:
+        X = broken(X);
+        BOOST_CHECK_THROW(lazy.flush(), std::exception);
+        BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+        // Destructors do not throw. Statements that do not use the
+        // destroyed vector stay queued, and the error is rethrown by the
+        // next flush:
+        vex::vector<double> W(ctx, N);
+        {
+            vex::vector<double> Z(ctx, N);
+            Z = broken(X);
+            W = X + 1;
+        }
+        BOOST_CHECK_EQUAL(lazy.size(), 1U);
+        BOOST_CHECK_THROW(lazy.flush(), std::exception);
+        BOOST_CHECK_EQUAL(lazy.size(), 1U);
+
+        lazy.flush();
+        check_sample(W, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 2); });
+
+        X = broken(X);
+    }
+
+    check_sample(X, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 1); });
+}
+
+BOOST_AUTO_TEST_CASE(iterators_and_moves)
+{
+    const size_t N = 1024;
+
+    vex::vector<double> X(ctx, N);
+    X = 1;
+
+    vex::deferred lazy;
+
+    // Reading through iterators:
+    X = 2 * X;
+    BOOST_CHECK_EQUAL(lazy.size(), 1U);
+
+    std::vector<double> x(N);
+    std::copy(X.begin(), X.end(), x.begin());
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+    BOOST_CHECK_EQUAL(x[N / 2], 2);
+
+    // Move construction does not flush, the result goes to the new vector:
+    X = X + 1;
+    vex::vector<double> Y(std::move(X));
+    BOOST_CHECK_EQUAL(lazy.size(), 1U);
+    BOOST_CHECK_EQUAL(Y.size(), N);
+
+    BOOST_CHECK_EQUAL(Y[N / 2], 3);
+    BOOST_CHECK_EQUAL(lazy.size(), 0U);
+
+    // Statements queued after a move are executed with the moved data:
+    Y = Y * 2;
+    vex::vector<double> Z(std::move(Y));
+    Z = Z + 1;
+    BOOST_CHECK_EQUAL(lazy.size(), 1U);
+
+    check_sample(Z, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 7); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
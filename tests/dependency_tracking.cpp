@@ -0,0 +1,83 @@
+#define BOOST_TEST_MODULE DependencyTracking
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/scan.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(nonblocking_transfers)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    std::vector<double> y(N);
+
+    vex::vector<double> X(ctx, N);
+
+    vex::copy(x, X, /*blocking=*/false);
+    X = 2 * X;
+    vex::copy(X, y, /*blocking=*/false);
+    X = 0;
+    vex::copy(X, x);
+
+    check_sample(x, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 0); });
+}
+
+BOOST_AUTO_TEST_CASE(cross_queue_dependencies)
+{
+    const size_t N = 1024;
+
+    std::vector<vex::backend::command_queue> q1(1, ctx.queue(0));
+    std::vector<vex::backend::command_queue> q2(1, vex::backend::duplicate_queue(ctx.queue(0)));
+
+    vex::vector<double> x(q1, N);
+    vex::vector<double> y(q2, N);
+
+    for(int i = 0; i < 8; ++i) {
+        x = i;
+        y = x + 1;
+        x = y * 2;
+    }
+
+    check_sample(x, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 16); });
+    check_sample(y, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 8); });
+}
+
+BOOST_AUTO_TEST_CASE(element_access)
+{
+    const size_t N = 1024;
+
+    vex::vector<double> x(ctx, N);
+
+    x = 1;
+    x[N / 2] = 42;
+    x += 1;
+
+    BOOST_CHECK_EQUAL(static_cast<double>(x[N / 2]), 43);
+    BOOST_CHECK_EQUAL(static_cast<double>(x[0]), 2);
+}
+
+BOOST_AUTO_TEST_CASE(library_launches)
+{
+    const size_t N = 1024;
+
+    std::vector<vex::backend::command_queue> q1(1, ctx.queue(0));
+    std::vector<vex::backend::command_queue> q2(1, vex::backend::duplicate_queue(ctx.queue(0)));
+
+    vex::vector<int> x(q1, N);
+    vex::vector<int> y(q2, N);
+
+    vex::Reductor<int, vex::SUM> sum(q2);
+
+    for(int i = 0; i < 8; ++i) {
+        x = i;
+        BOOST_CHECK_EQUAL(sum(x), static_cast<int>(N) * i);
+
+        vex::inclusive_scan(x, y);
+        x = y;
+    }
+
+    check_sample(x, [](size_t idx, int a) { BOOST_CHECK_EQUAL(a, 7 * static_cast<int>(idx + 1)); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
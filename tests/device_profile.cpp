@@ -0,0 +1,101 @@
+#define BOOST_TEST_MODULE DeviceProfile
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/device_profile.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(stored_profile)
+{
+    for(unsigned d = 0; d < ctx.size(); ++d) {
+        vex::device_profile::record r = vex::device_profile::get(ctx.queue(d));
+
+        BOOST_CHECK(r.weight    > 0);
+        BOOST_CHECK(r.bandwidth > 0);
+        BOOST_CHECK(r.latency   > 0);
+        BOOST_CHECK(r.compute   > 0);
+
+        // Weight is in elements per second, same as the measured throughput
+        // used by vex::adapt_partitioning():
+        BOOST_CHECK_CLOSE(r.weight, r.bandwidth * 1e9 / (3 * sizeof(float)), 1e-3);
+
+        // Second request returns the known profile:
+        vex::device_profile::record s = vex::device_profile::get(ctx.queue(d));
+
+        BOOST_CHECK_EQUAL(r.weight,    s.weight);
+        BOOST_CHECK_EQUAL(r.bandwidth, s.bandwidth);
+        BOOST_CHECK_EQUAL(r.latency,   s.latency);
+        BOOST_CHECK_EQUAL(r.compute,   s.compute);
+
+        BOOST_CHECK_EQUAL(vex::device_vector_perf(ctx.queue(d)), r.weight);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(persisted_profile)
+{
+    vex::device_profile::record r = vex::device_profile::measure(ctx.queue(0));
+
+    // The stored file should contain the measured profile:
+    auto s = vex::device_profile::detail::store().stored();
+    auto p = s.find(vex::device_profile::detail::key(ctx.queue(0)));
+
+    BOOST_REQUIRE(p != s.end());
+    BOOST_CHECK_CLOSE(p->second.weight,  r.weight,  1e-3);
+    BOOST_CHECK_CLOSE(p->second.latency, r.latency, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(compacted_store)
+{
+    struct format {
+        static bool read(std::istream &is, int &r) {
+            return static_cast<bool>(is >> r);
+        }
+
+        static void write(std::ostream &os, int r) {
+            os << r;
+        }
+    };
+
+    const size_t max_records = 32;
+
+    std::string name = boost::filesystem::unique_path(
+            "test_records_%%%%-%%%%").string();
+
+    {
+        vex::detail::record_store<int, format> s(name, max_records);
+
+        // Overridden records are compacted away:
+        for(int i = 0; i < 100; ++i) s.insert("key", i);
+
+        BOOST_CHECK(s.size_on_disk() <= 2 + 16);
+        BOOST_CHECK_EQUAL(s.stored().size(), 1U);
+        BOOST_CHECK_EQUAL(s.stored()["key"], 99);
+
+        // Only the most recently stored keys are kept:
+        for(int i = 0; i < 200; ++i) s.insert("key" + std::to_string(i), i);
+
+        BOOST_CHECK(s.size_on_disk() <= 2 * max_records + 16);
+
+        auto m = s.stored();
+        BOOST_CHECK(m.size() <= 2 * max_records + 16);
+        BOOST_CHECK_EQUAL(m.count("key0"), 0U);
+        BOOST_CHECK_EQUAL(m["key199"], 199);
+
+        // Records are kept in the session:
+        BOOST_CHECK_EQUAL(s.all().size(), 201U);
+    }
+
+    {
+        // Stored records are read by a new store:
+        vex::detail::record_store<int, format> s(name, max_records);
+
+        int r;
+        BOOST_CHECK(s.find("key199", r));
+        BOOST_CHECK_EQUAL(r, 199);
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::remove(vex::appdata_path() + vex::path_delim() + name, ec);
+    boost::filesystem::remove(vex::appdata_path() + vex::path_delim() + name + ".lock", ec);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+#define BOOST_TEST_MODULE DeviceScalar
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/device_scalar.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/function.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(scalar_arithmetics)
+{
+    vex::device_scalar<double> a(ctx, 2);
+    vex::device_scalar<double> b(ctx);
+
+    BOOST_CHECK_EQUAL(a.get(), 2);
+    BOOST_CHECK_EQUAL(b.get(), 0);
+
+    b = 3;
+    a = a * b + 1;
+    BOOST_CHECK_CLOSE(a.get(), 7, 1e-8);
+
+    vex::device_scalar<double> c = a;
+    c = sqrt(c / b);
+    BOOST_CHECK_CLOSE(c.get(), sqrt(7.0 / 3), 1e-8);
+    BOOST_CHECK_CLOSE(a.get(), 7, 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(vector_expressions)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, n);
+
+    vex::device_scalar<double> alpha(ctx, 0.5);
+
+    Y = alpha * X + 1;
+    Y += sin(alpha);
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, 0.5 * x[idx] + 1 + sin(0.5), 1e-8);
+            });
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+    BOOST_CHECK_CLOSE(sum(alpha * X), 0.5 * std::accumulate(x.begin(), x.end(), 0.0), 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(conjugate_gradient_step)
+{
+    const size_t n = 1024;
+
+    std::vector<double> r = random_vector<double>(n);
+    std::vector<double> p = random_vector<double>(n);
+
+    vex::vector<double> R(ctx, r);
+    vex::vector<double> P(ctx, p);
+    vex::vector<double> X(ctx, n);
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+    vex::device_scalar<double> rr(ctx), pp(ctx), alpha(ctx);
+
+    X = 0;
+
+    // Nothing is read back to the host here:
+    sum(rr, R * R);
+    sum(pp, P * P);
+    alpha = rr / pp;
+    X += alpha * P;
+    R -= alpha * P;
+
+    double RR = 0, PP = 0;
+    for(size_t i = 0; i < n; ++i) {
+        RR += r[i] * r[i];
+        PP += p[i] * p[i];
+    }
+
+    BOOST_CHECK_CLOSE(rr.get(), RR, 1e-6);
+    BOOST_CHECK_CLOSE(pp.get(), PP, 1e-6);
+    BOOST_CHECK_CLOSE(alpha.get(), RR / PP, 1e-6);
+
+    check_sample(X, R, [&](size_t idx, double a, double b) {
+            BOOST_CHECK_CLOSE(a, RR / PP * p[idx], 1e-6);
+            BOOST_CHECK_CLOSE(b, r[idx] - RR / PP * p[idx], 1e-6);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(cross_queue_dependencies)
+{
+    const size_t n = 1024;
+
+    std::vector<vex::backend::command_queue> q1(1, ctx.queue(0));
+    std::vector<vex::backend::command_queue> q2(1, vex::backend::duplicate_queue(ctx.queue(0)));
+
+    vex::vector<double> X(q1, n);
+    vex::vector<double> Y(q2, n);
+
+    vex::Reductor<double, vex::SUM> sum(q1);
+    vex::device_scalar<double> s(q2), alpha(q2);
+
+    for(int i = 1; i <= 4; ++i) {
+        X = i;
+        sum(s, X);
+        alpha = s / n;
+        Y = alpha * 2;
+        s = 0;
+    }
+
+    check_sample(Y, [](size_t, double a) { BOOST_CHECK_CLOSE(a, 8, 1e-8); });
+
+    // The scalar has to share the context with the reductor:
+    vex::backend::context other(ctx.device(0));
+    std::vector<vex::backend::command_queue> q3(1,
+            vex::backend::command_queue(other, ctx.device(0)));
+
+    vex::device_scalar<double> t(q3);
+    BOOST_CHECK_THROW(sum(t, X), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+#define BOOST_TEST_MODULE CommandGraph
+#include <numeric>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/scan.hpp>
+#include <vexcl/graph.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(replay_vector_expressions)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, N);
+    vex::vector<double> Z(ctx, N);
+
+    vex::graph g;
+    vex::graph_scalar<double> alpha(2);
+
+    {
+        vex::capture c(g);
+        Y = alpha * X + 1;
+        Z = Y - X;
+    }
+
+    BOOST_CHECK_EQUAL(g.size(), 2 * ctx.size());
+
+    check_sample(Z, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, x[idx] + 1, 1e-8);
+            });
+
+    for(int i = 0; i < 4; ++i) {
+        alpha = i;
+        Y = 0;
+        Z = 0;
+
+        g.replay();
+
+        check_sample(Y, [&](size_t idx, double a) {
+                BOOST_CHECK_CLOSE(a, i * x[idx] + 1, 1e-8);
+                });
+        check_sample(Z, [&](size_t idx, double a) {
+                BOOST_CHECK_CLOSE(a, (i - 1) * x[idx] + 1, 1e-8);
+                });
+    }
+
+    g.clear();
+    BOOST_CHECK_EQUAL(g.size(), 0U);
+
+    // Launches outside of the capture scope are not recorded.
+    Y = alpha * X;
+    BOOST_CHECK_EQUAL(g.size(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(replay_with_scratch_buffers)
+{
+    const size_t N = 1 << 14;
+
+    std::vector<int> x = random_vector<int>(N);
+    std::vector<vex::command_queue> q1(1, ctx.queue(0));
+
+    vex::vector<int> X(q1, x);
+    vex::vector<int> Y(q1, N);
+
+    vex::graph g;
+
+    {
+        vex::capture c(g);
+        vex::inclusive_scan(X, Y);
+    }
+
+    BOOST_CHECK(g.size() > 0);
+
+    std::vector<int> y(N);
+    std::partial_sum(x.begin(), x.end(), y.begin());
+
+    Y = 0;
+    g.replay();
+
+    check_sample(Y, [&](size_t idx, int a) { BOOST_CHECK_EQUAL(a, y[idx]); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+#define BOOST_TEST_MODULE MemoryPool
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/memory_pool.hpp>
+#include <vexcl/scan.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(reuse_released_buffers)
+{
+    const size_t N = 1000;
+
+    vex::memory_pool::trim();
+    auto s0 = vex::memory_pool::stats();
+
+    {
+        auto buf = vex::memory_pool::allocate<double>(ctx.queue(0), N);
+        BOOST_CHECK_EQUAL(buf.size(), N);
+        BOOST_CHECK(vex::memory_pool::stats().bytes_in_use >= N * sizeof(double));
+    }
+
+    auto s1 = vex::memory_pool::stats();
+    BOOST_CHECK_EQUAL(s1.allocations, s0.allocations + 1);
+    BOOST_CHECK(s1.bytes_cached >= N * sizeof(double));
+
+    {
+        // Same size class is served from the free list.
+        auto buf = vex::memory_pool::allocate<double>(ctx.queue(0), N + 1);
+    }
+
+    auto s2 = vex::memory_pool::stats();
+    BOOST_CHECK_EQUAL(s2.allocations, s1.allocations);
+    BOOST_CHECK_EQUAL(s2.reuses, s1.reuses + 1);
+
+    vex::memory_pool::trim();
+    BOOST_CHECK_EQUAL(vex::memory_pool::stats().bytes_cached, 0);
+}
+
+BOOST_AUTO_TEST_CASE(pooled_vector)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+
+    for(int i = 0; i < 4; ++i) {
+        vex::vector<double> Y(ctx, N, vex::memory_pool::pooled);
+        Y = 2 * X;
+
+        check_sample(Y, [&](size_t idx, double a) { BOOST_CHECK_EQUAL(a, 2 * x[idx]); });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(scan_scratch)
+{
+    const size_t N = 1024 * 64;
+
+    vex::vector<int> X(ctx, N);
+    vex::vector<int> Y(ctx, N);
+    X = 1;
+
+    vex::inclusive_scan(X, Y);
+    auto s0 = vex::memory_pool::stats();
+
+    vex::inclusive_scan(X, Y);
+    auto s1 = vex::memory_pool::stats();
+
+    BOOST_CHECK_EQUAL(s1.allocations, s0.allocations);
+    check_sample(Y, [](size_t idx, int a) { BOOST_CHECK_EQUAL(a, static_cast<int>(idx + 1)); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
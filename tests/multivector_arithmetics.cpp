@@ -5,6 +5,7 @@
 #include <vexcl/reductor.hpp>
 #include <vexcl/element_index.hpp>
 #include <vexcl/function.hpp>
+#include <vexcl/graph.hpp>
 #include "context_setup.hpp"
 
 BOOST_AUTO_TEST_CASE(arithmetics)
@@ -148,6 +149,84 @@ BOOST_AUTO_TEST_CASE(reduction)
     BOOST_CHECK_CLOSE(maxm[1], *std::max_element(y.begin(), y.end()), 1e-12);
 }
 
+BOOST_AUTO_TEST_CASE(single_pass_reduction)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+
+    vex::multivector<double, 3> m(ctx, n);
+    m = std::tie(X, Y, X * Y);
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+
+    // All components are reduced by a single kernel per device:
+    vex::graph g;
+    std::array<double, 3> s;
+    {
+        vex::capture c(g);
+        s = sum(m * m);
+    }
+    BOOST_CHECK_EQUAL(g.size(), ctx.size());
+
+    // Tuple of vector expressions:
+    std::array<double, 2> t = sum(std::make_tuple(X * X, X * Y));
+
+    double xx = 0, yy = 0, xy = 0, xyxy = 0;
+    for(size_t i = 0; i < n; ++i) {
+        xx   += x[i] * x[i];
+        yy   += y[i] * y[i];
+        xy   += x[i] * y[i];
+        xyxy += x[i] * y[i] * x[i] * y[i];
+    }
+
+    BOOST_CHECK_CLOSE(s[0], xx,   1e-6);
+    BOOST_CHECK_CLOSE(s[1], yy,   1e-6);
+    BOOST_CHECK_CLOSE(s[2], xyxy, 1e-6);
+
+    BOOST_CHECK_CLOSE(t[0], xx, 1e-6);
+    BOOST_CHECK_CLOSE(t[1], xy, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(single_pass_arg_reduction)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+
+    vex::multivector<double, 2> m(ctx, n);
+    m = std::tie(X, Y);
+
+    vex::Reductor<double, vex::ARGMAX> argmax(ctx);
+    vex::Reductor<double, vex::MINMAX> minmax(ctx);
+
+    std::array<std::pair<double, size_t>, 2> a = argmax(m);
+    std::array<std::pair<double, double>,  2> b = minmax(std::make_tuple(X, -Y));
+
+    auto xmax = std::max_element(x.begin(), x.end());
+    auto ymax = std::max_element(y.begin(), y.end());
+    auto xmin = std::min_element(x.begin(), x.end());
+    auto ymin = std::min_element(y.begin(), y.end());
+
+    BOOST_CHECK_EQUAL(a[0].first,  *xmax);
+    BOOST_CHECK_EQUAL(a[0].second, static_cast<size_t>(xmax - x.begin()));
+    BOOST_CHECK_EQUAL(a[1].first,  *ymax);
+    BOOST_CHECK_EQUAL(a[1].second, static_cast<size_t>(ymax - y.begin()));
+
+    BOOST_CHECK_EQUAL(b[0].first,  *xmin);
+    BOOST_CHECK_EQUAL(b[0].second, *xmax);
+    BOOST_CHECK_EQUAL(b[1].first,  -*ymax);
+    BOOST_CHECK_EQUAL(b[1].second, -*ymin);
+}
+
 BOOST_AUTO_TEST_CASE(element_index)
 {
     typedef std::array<double, 2> elem_t;
@@ -0,0 +1,71 @@
+#define BOOST_TEST_MODULE Precompile
+#include <cstdio>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/function.hpp>
+#include <vexcl/precompile.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(precompile_assignment)
+{
+    const size_t N = 1024;
+
+    vex::vector<double> x(ctx, N);
+    vex::vector<double> y(ctx, N);
+
+    y = 21;
+
+    vex::precompile::assignment(x, 2 * y);
+    vex::precompile::assignment<vex::assign::ADD>(x, sin(y) * y);
+
+    x = 2 * y;
+    check_sample(x, [](size_t, double v) { BOOST_CHECK_EQUAL(v, 42); });
+
+    x += sin(y) * y;
+    check_sample(x, [](size_t, double v) {
+            BOOST_CHECK_CLOSE(v, 42 + sin(21.0) * 21, 1e-8);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(record_and_replay)
+{
+    const size_t N = 1024;
+    std::string file = "precompile_test.programs";
+    std::remove(file.c_str());
+
+    vex::vector<int> x(ctx, N);
+    vex::Reductor<int, vex::SUM> sum(ctx);
+
+    vex::precompile::record(file);
+    x = 1;
+    int s = sum(x);
+    vex::precompile::record("");
+
+    BOOST_CHECK_EQUAL(s, static_cast<int>(N));
+    BOOST_CHECK_EQUAL(vex::precompile::from_file(ctx, file), 2U);
+    vex::precompile::wait();
+
+    std::remove(file.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(workers_are_stopped)
+{
+    vex::vector<float> x(ctx, 16);
+
+    vex::precompile::assignment(x, 3 * x + 1);
+    vex::precompile::wait();
+
+    // Background threads do not outlive the builds:
+    BOOST_CHECK_EQUAL(vex::precompile::detail::worker_pool::get().size(), 0U);
+
+    // The pool is restarted by the next submission:
+    vex::precompile::assignment(x, 4 * x + 1);
+    vex::precompile::wait();
+
+    x = 1;
+    x = 4 * x + 1;
+    check_sample(x, [](size_t, float v) { BOOST_CHECK_EQUAL(v, 5); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
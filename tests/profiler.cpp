@@ -0,0 +1,37 @@
+#define BOOST_TEST_MODULE Profiler
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/profiler.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(nonblocking_profiler)
+{
+    const size_t N = 1 << 16;
+
+    vex::vector<double> X(ctx, random_vector<double>(N));
+    vex::vector<double> Y(ctx, N);
+
+    vex::profiler<> prof(ctx, "Nonblocking", true);
+
+    for(int i = 0; i < 8; ++i) {
+        prof.tic_cl("outer");
+        Y = 2 * X;
+
+        prof.tic_cl("inner");
+        X = Y - X;
+        prof.toc("inner");
+
+        prof.toc("outer");
+    }
+
+    std::ostringstream s;
+    prof.print(s);
+
+    BOOST_CHECK(s.str().find("outer") != std::string::npos);
+    BOOST_CHECK(s.str().find("inner") != std::string::npos);
+    BOOST_CHECK(s.str().find("8x") != std::string::npos);
+    BOOST_CHECK(s.str().find("incomplete") == std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,47 @@
+#define BOOST_TEST_MODULE Repartition
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(adaptive_partitioning)
+{
+    const size_t N = 1 << 16;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, N);
+
+    // Nothing is measured yet:
+    BOOST_CHECK(!vex::adapt_partitioning(ctx));
+
+    vex::measure_device_throughput();
+
+    for(int i = 0; i < 8; ++i) Y = 2 * X + 1;
+
+    vex::measure_device_throughput(false);
+
+    BOOST_CHECK(vex::adapt_partitioning(ctx));
+
+    // Measurements are reset after the update:
+    BOOST_CHECK(!vex::adapt_partitioning(ctx));
+
+    std::vector<size_t> part = vex::partition(N, ctx);
+
+    bool xmoved = X.repartition();
+    bool ymoved = Y.repartition();
+
+    BOOST_CHECK_EQUAL(xmoved, ymoved);
+    BOOST_CHECK(X.partition() == part);
+    BOOST_CHECK(Y.partition() == part);
+
+    // Second call is a no-op:
+    BOOST_CHECK(!X.repartition());
+
+    check_sample(X, [&](size_t idx, double a) { BOOST_CHECK_EQUAL(a, x[idx]); });
+    check_sample(Y, [&](size_t idx, double a) { BOOST_CHECK_CLOSE(a, 2 * x[idx] + 1, 1e-8); });
+
+    Y = X - Y;
+    check_sample(Y, [&](size_t idx, double a) { BOOST_CHECK_CLOSE(a, -x[idx] - 1, 1e-8); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
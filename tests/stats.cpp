@@ -0,0 +1,85 @@
+#define BOOST_TEST_MODULE KernelStatistics
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/multivector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/stats.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(kernel_statistics)
+{
+    const size_t N = 1 << 16;
+
+    vex::vector<double> X(ctx, random_vector<double>(N));
+    vex::vector<double> Y(ctx, N);
+    vex::vector<float>  Z(ctx, N);
+
+    vex::stats::reset();
+    vex::stats::enable();
+
+    for(int i = 0; i < 4; ++i) {
+        Y  = 2 * X;       // 16 bytes per element
+        Z += X - Y;       // 8 + 8 + 2 * 4 bytes per element
+    }
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+    sum(X);               // 8 bytes per element
+
+    vex::stats::enable(false);
+
+    // Not counted:
+    Y = 2 * X;
+
+    auto res = vex::stats::results();
+
+    size_t vector_launches = 0, vector_bytes = 0, vector_elements = 0;
+    size_t reductor_bytes = 0;
+    for(auto r = res.begin(); r != res.end(); ++r) {
+        BOOST_CHECK(r->second.timed <= r->second.launches);
+
+        if (r->second.kernel == "vexcl_vector_kernel") {
+            vector_launches += r->second.launches;
+            vector_elements += r->second.elements;
+            vector_bytes    += r->second.bytes;
+        } else if (r->second.kernel == "vexcl_reductor_kernel") {
+            reductor_bytes  += r->second.bytes;
+        }
+    }
+
+    BOOST_CHECK_EQUAL(vector_launches, 8 * ctx.size());
+    BOOST_CHECK_EQUAL(vector_elements, 8 * N);
+    BOOST_CHECK_EQUAL(vector_bytes,    4 * N * (16 + 24));
+    BOOST_CHECK_EQUAL(reductor_bytes,  N * 8);
+
+    std::ostringstream report;
+    vex::stats::report(report);
+    BOOST_CHECK(report.str().find("vexcl_vector_kernel") != std::string::npos);
+    BOOST_CHECK(report.str().find("vexcl_reductor_kernel") != std::string::npos);
+    BOOST_CHECK(report.str().find("GB/s") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(multiexpression_statistics)
+{
+    const size_t N = 1 << 12;
+
+    vex::multivector<double, 2> X(ctx, N);
+    vex::multivector<double, 2> Y(ctx, N);
+    X = std::make_tuple(1, 2);
+
+    vex::stats::reset();
+    vex::stats::enable();
+
+    Y = X * 2;
+
+    vex::stats::enable(false);
+
+    auto res = vex::stats::results();
+
+    size_t bytes = 0;
+    for(auto r = res.begin(); r != res.end(); ++r) bytes += r->second.bytes;
+
+    BOOST_CHECK_EQUAL(bytes, 2 * N * 16);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
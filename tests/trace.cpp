@@ -0,0 +1,55 @@
+#define BOOST_TEST_MODULE Trace
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(trace_kernels_and_transfers)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, N);
+    vex::vector<double> Y(ctx, N);
+
+    vex::trace::clear();
+    vex::trace::enable();
+
+    vex::copy(x, X);
+    Y = 2 * X;
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+    double s = sum(Y);
+
+    vex::copy(Y, x);
+
+    vex::trace::enable(false);
+
+    // Not recorded:
+    Y = X;
+
+    BOOST_CHECK_CLOSE(s, std::accumulate(x.begin(), x.end(), 0.0), 1e-6);
+
+    std::ostringstream json;
+    vex::trace::write(json);
+
+    std::string t = json.str();
+
+    BOOST_CHECK(t.find("{\"traceEvents\":[") == 0);
+    BOOST_CHECK(t.find("\"name\":\"vexcl_vector_kernel\"") != std::string::npos);
+    BOOST_CHECK(t.find("\"name\":\"vexcl_reductor_kernel\"") != std::string::npos);
+    BOOST_CHECK(t.find("\"name\":\"write_data\"") != std::string::npos);
+    BOOST_CHECK(t.find("\"name\":\"read_data\"") != std::string::npos);
+    BOOST_CHECK(t.find("\"name\":\"process_name\"") != std::string::npos);
+
+    // One element-wise kernel and one reduction per device.
+    size_t kernels = 0;
+    for(size_t p = t.find("\"cat\":\"kernel\""); p != std::string::npos; p = t.find("\"cat\":\"kernel\"", p + 1))
+        ++kernels;
+    BOOST_CHECK_EQUAL(kernels, 2 * ctx.size());
+
+    vex::trace::clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
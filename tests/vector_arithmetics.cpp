@@ -42,6 +42,61 @@ BOOST_AUTO_TEST_CASE(compound_assignment)
     check_sample(x, [](size_t, double a) { BOOST_CHECK(a == -1); });
 }
 
+BOOST_AUTO_TEST_CASE(aliased_inputs)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+    vex::vector<double> Z(ctx, n);
+
+    // Same kernel type, with and without output aliasing an input:
+    Z = X * 2 + Y;
+    X = X * 2 + Y;
+
+    check_sample(X, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, x[idx] * 2 + y[idx], 1e-8);
+            });
+
+    check_sample(Z, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, x[idx] * 2 + y[idx], 1e-8);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(wide_vector_kernels)
+{
+    // Size is not divisible by any vector width:
+    const size_t n = 1031;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+    vex::vector<double> Z(ctx, n);
+
+    Z = 2 * X - Y / 3;
+    Z += X;
+    Z *= Y;
+    Z -= -X;
+
+    check_sample(Z, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, (2 * x[idx] - y[idx] / 3 + x[idx]) * y[idx] + x[idx], 1e-8);
+            });
+
+    vex::vector<int> I(ctx, n);
+    vex::vector<int> J(ctx, n);
+
+    I = 7;
+    J = I * 3 + 1;
+    J /= I;
+
+    check_sample(J, [](size_t, int a) { BOOST_CHECK_EQUAL(a, 3); });
+}
+
 BOOST_AUTO_TEST_CASE(reduce_expression)
 {
     const size_t N = 1024;
@@ -61,6 +116,160 @@ BOOST_AUTO_TEST_CASE(reduce_expression)
     BOOST_CHECK_SMALL(max(fabs(X - X)), 1e-12);
 }
 
+BOOST_AUTO_TEST_CASE(arg_reductions)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+
+    vex::Reductor<double, vex::ARGMAX> argmax(ctx);
+    vex::Reductor<double, vex::ARGMIN> argmin(ctx);
+    vex::Reductor<double, vex::MINMAX> minmax(ctx);
+
+    auto xmax = std::max_element(x.begin(), x.end());
+    auto xmin = std::min_element(x.begin(), x.end());
+
+    std::pair<double, size_t> a = argmax(X);
+    BOOST_CHECK_EQUAL(a.first,  *xmax);
+    BOOST_CHECK_EQUAL(a.second, static_cast<size_t>(xmax - x.begin()));
+
+    a = argmin(X);
+    BOOST_CHECK_EQUAL(a.first,  *xmin);
+    BOOST_CHECK_EQUAL(a.second, static_cast<size_t>(xmin - x.begin()));
+
+    // Indices are global, and equal values resolve to the first one:
+    a = argmin(fabs(X - x[777]));
+    BOOST_CHECK_EQUAL(a.second, 777U);
+
+    a = argmax(vex::element_index(0, N) / 100);
+    BOOST_CHECK_EQUAL(a.first,  10);
+    BOOST_CHECK_EQUAL(a.second, 1000U);
+
+    std::pair<double, double> m = minmax(X);
+    BOOST_CHECK_EQUAL(m.first,  *xmin);
+    BOOST_CHECK_EQUAL(m.second, *xmax);
+
+    // Indices of 4-byte values share local memory with the values:
+    vex::Reductor<float, vex::ARGMAX> fargmax(ctx);
+
+    std::pair<float, size_t> f = fargmax(vex::element_index(0, N) % 1000);
+    BOOST_CHECK_EQUAL(f.first,  999);
+    BOOST_CHECK_EQUAL(f.second, 999U);
+}
+
+BOOST_AUTO_TEST_CASE(compensated_summation)
+{
+    const size_t N = 1 << 20;
+
+    vex::vector<float> X(ctx, N);
+    X = 0.1f;
+
+    vex::Reductor<float, vex::SUM_Kahan> sum(ctx);
+
+    const double ref = N * static_cast<double>(0.1f);
+
+    BOOST_CHECK_CLOSE(sum(X), ref, 1e-4);
+    BOOST_CHECK_CLOSE(sum.async(X).get(), ref, 1e-4);
+
+    std::array<float, 2> s = sum(std::make_tuple(X, 3 * X));
+
+    BOOST_CHECK_CLOSE(s[0], ref,     1e-4);
+    BOOST_CHECK_CLOSE(s[1], 3 * ref, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(compensated_summation_across_workgroups)
+{
+    // Partial sums of the workgroups are large, need more bits than a float
+    // has, and cancel each other. The result is only accurate when their
+    // compensation terms are kept.
+    const size_t N = 3000017;
+
+    const float a = 1.0f + 1.0f / 4096, b = -1.0f;
+
+    vex::vector<float> X(ctx, N);
+    X = vex::tag<1>(a) * (vex::element_index() < N / 2)
+      + vex::tag<2>(b) * (vex::element_index() >= N / 2);
+
+    const double ref = N / 2 * static_cast<double>(a)
+        + (N - N / 2) * static_cast<double>(b);
+
+    vex::Reductor<float, vex::SUM>       sum(ctx);
+    vex::Reductor<float, vex::SUM_Kahan> ksum(ctx);
+
+    BOOST_CHECK_GT(std::abs(sum(X) - ref), 1e-3 * ref);
+
+    BOOST_CHECK_CLOSE(ksum(X),             ref, 1e-3);
+    BOOST_CHECK_CLOSE(ksum.async(X).get(), ref, 1e-3);
+
+    vex::device_scalar<float> s(ctx);
+    ksum(s, X);
+    BOOST_CHECK_CLOSE(s.get(), ref, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(assign_and_reduce)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, N);
+
+    vex::Reductor<double,vex::SUM> sum(ctx);
+
+    double s = sum(Y, 2 * X + 1, Y * Y);
+
+    double ref = 0;
+    for(size_t i = 0; i < N; ++i) ref += (2 * x[i] + 1) * (2 * x[i] + 1);
+
+    BOOST_CHECK_CLOSE(s, ref, 1e-6);
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, 2 * x[idx] + 1, 1e-8);
+            });
+
+    // Lhs is used in its own assignment, and together with other vectors in
+    // the reduced expression:
+    double m = vex::assign_and_reduce<vex::MAX>(Y, Y - X, fabs(Y - 3 * X));
+
+    ref = 0;
+    for(size_t i = 0; i < N; ++i) ref = std::max(ref, fabs(1 - 2 * x[i]));
+
+    BOOST_CHECK_CLOSE(m, ref, 1e-6);
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, x[idx] + 1, 1e-8);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(async_reduction)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, N);
+
+    vex::Reductor<double,vex::SUM> sum(ctx);
+    vex::Reductor<double,vex::MAX> max(ctx);
+
+    auto s = sum.async(X);
+    auto m = max.async(2 * X);
+
+    // Independent work submitted while the reductions are in progress:
+    Y = sin(X);
+
+    BOOST_CHECK_CLOSE(s.get(), std::accumulate(x.begin(), x.end(), 0.0), 1e-6);
+    BOOST_CHECK_CLOSE(m.get(), 2 * *std::max_element(x.begin(), x.end()), 1e-6);
+
+    // The result may be queried more than once:
+    BOOST_CHECK_CLOSE(s.get(), std::accumulate(x.begin(), x.end(), 0.0), 1e-6);
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, sin(x[idx]), 1e-8);
+            });
+}
+
 BOOST_AUTO_TEST_CASE(static_reductor)
 {
     const size_t N = 1024;
@@ -101,5 +101,53 @@ BOOST_AUTO_TEST_CASE(std_sort_vex_vector)
     BOOST_CHECK(std::is_sorted(x.begin(), x.end()));
 }
 
+BOOST_AUTO_TEST_CASE(wrap_host_memory)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x = random_vector<double>(N);
+    std::vector<double> y(N);
+
+    vex::vector<double> X(ctx, N, x.data(), vex::backend::MEM_USE_HOST_PTR);
+
+    X = 2 * X;
+
+    vex::copy(X, x);
+    vex::copy(X, y);
+
+    for(size_t i = 0; i < N; ++i) BOOST_CHECK_EQUAL(x[i], y[i]);
+
+    std::fill(x.begin(), x.end(), 42.0);
+    vex::copy(x, X);
+
+    check_sample(X, [](size_t, double a) { BOOST_CHECK_EQUAL(a, 42); });
+}
+
+#ifdef VEXCL_BACKEND_OPENCL
+BOOST_AUTO_TEST_CASE(wrap_host_memory_opencl)
+{
+    const size_t N = 1024;
+
+    std::vector<double> x(N, 0.0);
+    vex::vector<double> X(ctx, N, x.data(), vex::backend::MEM_USE_HOST_PTR);
+
+    for(unsigned d = 0; d < ctx.size(); ++d)
+        if (X.part_size(d))
+            BOOST_CHECK(X(d).raw_buffer().getInfo<CL_MEM_FLAGS>() & CL_MEM_USE_HOST_PTR);
+
+    // The device now holds newer data than the wrapped memory. Writing the
+    // host data back should not be overwritten by the device contents.
+    X = 1;
+
+    std::fill(x.begin(), x.end(), 42.0);
+    X.write_data(N / 4, N / 2, x.data() + N / 4, true);
+
+    for(size_t i = 0; i < N; ++i) {
+        double v = X[i];
+        BOOST_CHECK_EQUAL(v, (i >= N / 4 && i < 3 * N / 4) ? 42 : 1);
+    }
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,320 @@
+#ifndef VEXCL_AUTOTUNE_HPP
+#define VEXCL_AUTOTUNE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/autotune.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Autotuning of kernel launch configurations.
+ *
+ * Element-wise kernels use grid-stride loops, so any launch configuration
+ * gives correct results. When autotuning is enabled, first launches of such
+ * a kernel are made with candidate (number of workgroups, workgroup size)
+ * pairs, and each launch is timed. Once all candidates are timed, the
+ * fastest one is used for the rest of the kernel launches. The winner is
+ * stored in the "autotune" file in the binary cache directory, and is
+ * reused by later runs on the same device.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+#include <boost/io/ios_state.hpp>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+#include <vexcl/stats.hpp>
+#include <vexcl/detail/throughput.hpp>
+#include <vexcl/detail/record_store.hpp>
+
+namespace vex {
+
+/// Autotuning of kernel launch configurations.
+/**
+ * Autotuning is disabled by default. It is enabled by setting VEXCL_AUTOTUNE
+ * environment variable to a non-zero value, or with autotune::enable().
+ * Stored results are only used while autotuning is enabled.
+ */
+namespace autotune {
+
+/// Launch configuration selected for a kernel on a device.
+struct record {
+    std::string kernel;   ///< Kernel name.
+    size_t ngroups;       ///< Number of workgroups.
+    size_t wgs;           ///< Workgroup size.
+    double default_time;  ///< Time per work item with the default configuration.
+    double best_time;     ///< Time per work item with the selected configuration.
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+inline bool& enabled_flag() {
+    static bool on = [](){
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+        const char *s = getenv("VEXCL_AUTOTUNE");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+        return s && atoi(s) != 0;
+    }();
+    return on;
+}
+
+// Stores records of the form
+// "<key> <kernel> <ngroups> <wgs> <default_time> <best_time>".
+struct record_format {
+    static bool read(std::istream &is, record &r) {
+        return static_cast<bool>(
+                is >> r.kernel >> r.ngroups >> r.wgs >> r.default_time >> r.best_time);
+    }
+
+    static void write(std::ostream &os, const record &r) {
+        os << r.kernel << " " << r.ngroups << " " << r.wgs << " "
+           << std::scientific << std::setprecision(6)
+           << r.default_time << " " << r.best_time;
+    }
+};
+
+typedef vex::detail::record_store<record, record_format> store_type;
+
+// Tuned configurations, both stored and found in this session.
+inline store_type& store() {
+    static store_type s("autotune");
+    return s;
+}
+
+// Tuning state of a kernel on a device.
+class tuner {
+    public:
+        tuner(const backend::command_queue &q, const backend::kernel &K,
+                const std::string &key, const std::string &name)
+            : key(key), name(name), current(0), done(false)
+        {
+            record r;
+            if (store().find(key, r)) {
+                best = candidate(r.ngroups, r.wgs);
+                done = true;
+                return;
+            }
+
+            const queue_info &info = get_queue_info(q);
+
+            // The default configuration goes first.
+            cand.push_back(candidate(backend::kernel::num_workgroups(q), K.workgroup_size()));
+
+            size_t max_ws = std::min<size_t>(K.max_threads_per_block(q), 1024);
+            size_t min_ws = info.cpu ? 1 : 32;
+            size_t ws_mul = info.cpu ? 4 : 2;
+
+            for(size_t m = 1; m <= 32; m *= 2) {
+                for(size_t w = min_ws; w <= max_ws; w *= ws_mul) {
+                    candidate c(m * info.compute_units, w);
+                    if (c.ngroups != cand[0].ngroups || c.wgs != cand[0].wgs)
+                        cand.push_back(c);
+                }
+            }
+        }
+
+        void launch(backend::kernel &K, const backend::command_queue &q, size_t work) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            if (done) {
+                K.config(best.ngroups, best.wgs);
+                K(q);
+                return;
+            }
+
+            // Small launches are dominated by the launch overhead.
+            if (work < min_work) {
+                K.config(cand[0].ngroups, cand[0].wgs);
+                K(q);
+                return;
+            }
+
+            candidate &c = cand[current];
+            K.config(c.ngroups, c.wgs);
+
+            q.finish();
+            auto start = std::chrono::high_resolution_clock::now();
+            K(q);
+            q.finish();
+            std::chrono::duration<double> elapsed =
+                std::chrono::high_resolution_clock::now() - start;
+
+            c.time = std::min(c.time, elapsed.count() / work);
+
+            if (++c.runs == runs && ++current == cand.size()) select();
+        }
+    private:
+        static const size_t   min_work = 4096;
+        static const unsigned runs     = 3;
+
+        struct candidate {
+            size_t   ngroups, wgs;
+            double   time;
+            unsigned runs;
+
+            candidate(size_t ngroups = 0, size_t wgs = 0)
+                : ngroups(ngroups), wgs(wgs),
+                  time(std::numeric_limits<double>::max()), runs(0)
+            {}
+        };
+
+        std::string key, name;
+        std::vector<candidate> cand;
+        size_t    current;
+        bool      done;
+        candidate best;
+        std::mutex mx;
+
+        void select() {
+            best = *std::min_element(cand.begin(), cand.end(),
+                    [](const candidate &a, const candidate &b) { return a.time < b.time; });
+            done = true;
+
+            record r;
+            r.kernel       = name;
+            r.ngroups      = best.ngroups;
+            r.wgs          = best.wgs;
+            r.default_time = cand[0].time;
+            r.best_time    = best.time;
+
+            store().insert(key, r);
+            cand.clear();
+        }
+};
+
+// Returns the shared tuning state for the kernel source on the device.
+inline std::shared_ptr<tuner> get_tuner(const backend::command_queue &q,
+        const backend::kernel &K, const std::string &src, const std::string &name)
+{
+    static std::map<std::string, std::shared_ptr<tuner>> tuners;
+    static std::mutex mx;
+
+    std::ostringstream dev;
+    dev << q;
+
+    std::string key = sha1(dev.str() + "\n" + name + "\n" + src);
+
+    std::lock_guard<std::mutex> lock(mx);
+    auto t = tuners.find(key);
+    if (t == tuners.end())
+        t = tuners.insert(std::make_pair(key,
+                    std::make_shared<tuner>(q, K, key, name))).first;
+    return t->second;
+}
+
+} // namespace detail
+
+// Kernel with autotuned launch configuration. Should only be used for
+// kernels that give the same results with any launch configuration.
+struct tunable_kernel {
+    backend::kernel kernel;
+    std::shared_ptr<detail::tuner> tune;
+    stats::detail::counter stat;
+
+    tunable_kernel(const backend::command_queue &q,
+            const std::string &src, const std::string &name)
+        : kernel(q, src, name), stat(src, name)
+    {
+        if (detail::enabled_flag())
+            tune = detail::get_tuner(q, kernel, src, name);
+    }
+
+    // Launches the kernel processing the given number of work items. The
+    // estimated memory traffic is only used for the kernel statistics.
+    void operator()(const backend::command_queue &q, size_t work, size_t bytes = 0) {
+        stats::detail::counter::launch l(stat, q, work, bytes);
+        vex::detail::throughput_meter::sample s(q, work);
+
+        if (tune)
+            tune->launch(kernel, q, work);
+        else
+            kernel(q);
+
+        s.done();
+        l.done();
+    }
+};
+/// \endcond
+
+/// Enables or disables autotuning of kernels created afterwards.
+inline void enable(bool on = true) {
+    detail::enabled_flag() = on;
+}
+
+/// Returns true if autotuning is enabled.
+inline bool enabled() {
+    return detail::enabled_flag();
+}
+
+/// Returns the known tuning results indexed by kernel source and device hash.
+inline std::map<std::string, record> results() {
+    return detail::store().all();
+}
+
+/// Prints the known tuning results along with the gains over the default configuration.
+inline void report(std::ostream &os = std::cout) {
+    auto res = results();
+
+    boost::io::ios_all_saver stream_state(os);
+
+    os << std::left << std::setw(10) << "key"
+       << std::setw(26) << "kernel"
+       << std::right << std::setw(10) << "groups"
+       << std::setw(8)  << "wgs"
+       << std::setw(10) << "speedup" << std::endl;
+
+    for(auto r = res.begin(); r != res.end(); ++r) {
+        os << std::left  << std::setw(10) << r->first.substr(0, 8)
+           << std::setw(26) << r->second.kernel
+           << std::right << std::setw(10) << r->second.ngroups
+           << std::setw(8) << r->second.wgs
+           << std::setw(9) << std::fixed << std::setprecision(2)
+           << r->second.default_time / r->second.best_time << "x"
+           << std::endl;
+    }
+}
+
+} // namespace autotune
+} // namespace vex
+
+#endif
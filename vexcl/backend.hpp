@@ -28,16 +28,17 @@ THE SOFTWARE.
 /**
  * \file   vexcl/backend.hpp
  * \author Denis Demidov <dennis.demidov@gmail.com>
- * \brief  Compile-time selection of backend (OpenCL/CUDA).
+ * \brief  Compile-time selection of backend (OpenCL/CUDA/JIT).
  */
 
 namespace vex {
     /// Backend-specific functionality.
     /**
-     * \note Definitions from either vex::backend::opencl or vex::backend::cuda
-     * are directly brought into vex::backend namespace. Define either
-     * VEXCL_BACKEND_OPENCL or VEXCL_BACKEND_CUDA macro in order to select
-     * backend. You will also need to link to libOpenCL or libcuda accordingly.
+     * \note Definitions from one of vex::backend::opencl, vex::backend::cuda,
+     * or vex::backend::jit are directly brought into vex::backend namespace.
+     * Define either VEXCL_BACKEND_OPENCL, VEXCL_BACKEND_CUDA, or
+     * VEXCL_BACKEND_JIT macro in order to select backend. You will also need
+     * to link to libOpenCL, libcuda, or libdl accordingly.
      */
     namespace backend {
         namespace cuda {}
@@ -56,6 +57,17 @@ namespace vex {
 
 #include <vexcl/backend/cuda.hpp>
 
+#elif defined(VEXCL_BACKEND_JIT)
+
+namespace vex {
+    namespace backend {
+        namespace jit {}
+        using namespace jit;
+    }
+}
+
+#include <vexcl/backend/jit.hpp>
+
 #else // defined(VEXCL_BACKEND_OPENCL)
 
 namespace vex {
@@ -73,6 +85,10 @@ namespace vex {
 #  error Both OpenCL and CUDA backends are selected. Make your mind!
 #endif
 
+#if defined(VEXCL_BACKEND_JIT) && (defined(VEXCL_BACKEND_OPENCL) || defined(VEXCL_BACKEND_CUDA))
+#  error JIT backend can not be combined with OpenCL or CUDA backends.
+#endif
+
 namespace vex {
     using backend::device;
     using backend::command_queue;
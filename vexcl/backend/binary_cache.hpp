@@ -0,0 +1,549 @@
+#ifndef VEXCL_BACKEND_BINARY_CACHE_HPP
+#define VEXCL_BACKEND_BINARY_CACHE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/binary_cache.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Managed on-disk cache of compiled program binaries.
+ *
+ * Each cache entry is a directory under appdata_path() named after SHA1 hash
+ * of the program source. The cache is shared between concurrent processes:
+ * files are written under temporary names and atomically renamed into place,
+ * so that readers never see partially written entries. The manifest file
+ * maps cheap hashes of program sources to their SHA1 hashes, so that a warm
+ * start does not need to compute SHA1 of every program. A manifest record is
+ * only trusted when a second cheap hash of another kind matches as well.
+ * Total size of the cache may be limited, in which case the least recently
+ * used entries are evicted.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+
+/// Managed on-disk cache of compiled program binaries.
+/**
+ * All operations are best-effort: a failure to access the cache is never
+ * reported to the user, and simply results in a cache miss.
+ */
+namespace binary_cache {
+
+/// \cond INTERNAL
+namespace detail {
+
+namespace fs = boost::filesystem;
+
+// 64-bit FNV-1a hash. It is much cheaper than SHA1 and is only used to look
+// up SHA1 hashes in the manifest.
+inline uint64_t fnv1a(const std::string &s) {
+    uint64_t h = 14695981039346656037ULL;
+    for(auto c = s.begin(); c != s.end(); ++c) {
+        h ^= static_cast<unsigned char>(*c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Second 64-bit hash: a polynomial hash with a different multiplier and a
+// splitmix64 finalizer. Manifest records are validated with it, so that a
+// collision of FNV-1a hashes and sizes does not load a binary of another
+// program.
+inline uint64_t check_hash(const std::string &s) {
+    uint64_t h = 0;
+    for(auto c = s.begin(); c != s.end(); ++c)
+        h = h * 0x9E3779B97F4A7C15ULL + static_cast<unsigned char>(*c) + 1;
+
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+}
+
+inline std::string manifest_path() {
+    return appdata_path() + path_delim() + "manifest";
+}
+
+// Serializes manifest updates and eviction between processes.
+class cache_lock {
+    public:
+        cache_lock() : flock(lock_file().c_str()), lock(flock) {}
+    private:
+        boost::interprocess::file_lock flock;
+        boost::interprocess::scoped_lock<boost::interprocess::file_lock> lock;
+
+        static std::string lock_file() {
+            fs::create_directories(appdata_path());
+            std::string name = appdata_path() + path_delim() + "lock";
+            std::ofstream f(name, std::ios::app);
+            return name;
+        }
+};
+
+struct manifest_entry {
+    std::string key;   // SHA1 hash of the source.
+    uint64_t    check; // check_hash() of the source.
+};
+
+typedef std::map<std::pair<uint64_t, size_t>, manifest_entry> manifest_type;
+
+// Reads manifest records of the form "<fnv1a> <size> <sha1> <check_hash>".
+// Malformed records (e.g. a line being appended by another process) are
+// ignored, and later records override earlier ones. The number of lines
+// (including the duplicate and malformed ones) is returned in lines.
+inline manifest_type read_manifest(size_t &lines) {
+    manifest_type m;
+    lines = 0;
+
+    std::ifstream f(manifest_path());
+    std::string line;
+    while(std::getline(f, line)) {
+        std::istringstream s(line);
+        uint64_t h;
+        size_t   n;
+        manifest_entry e;
+
+        if (s >> std::hex >> h >> std::dec >> n >> e.key >> std::hex >> e.check
+                && e.key.size() == 40)
+            m[std::make_pair(h, n)] = e;
+
+        ++lines;
+    }
+
+    return m;
+}
+
+inline manifest_type read_manifest() {
+    size_t lines;
+    return read_manifest(lines);
+}
+
+// Guards the in-memory manifest against concurrent program builds.
+inline std::mutex& manifest_mutex() {
+    static std::mutex mx;
+    return mx;
+}
+
+// Number of manifest lines, as seen by this process.
+inline size_t& manifest_lines() {
+    static size_t n = 0;
+    return n;
+}
+
+inline manifest_type& manifest() {
+    static manifest_type m = read_manifest(manifest_lines());
+    return m;
+}
+
+inline std::string manifest_record(const manifest_type::value_type &r) {
+    std::ostringstream s;
+    s << std::hex << r.first.first << " " << std::dec << r.first.second
+      << " " << r.second.key << " " << std::hex << r.second.check << "\n";
+    return s.str();
+}
+
+inline std::string temp_name(const std::string &dir) {
+    return (fs::path(dir) / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp")).string();
+}
+
+// Atomically replaces the manifest with a single line per record. Should be
+// called under cache_lock.
+inline void write_manifest(const manifest_type &m) {
+    std::string tmp = temp_name(appdata_path());
+    {
+        std::ofstream f(tmp);
+        for(auto r = m.begin(); r != m.end(); ++r)
+            f << manifest_record(*r);
+    }
+    fs::rename(tmp, manifest_path());
+    manifest_lines() = m.size();
+}
+
+// Appends the record to the manifest. Once the manifest collects too many
+// duplicate records (e.g. from concurrent processes seeing the same new
+// programs), it is rewritten with a single line per record. Should be
+// called under manifest_mutex().
+inline void append_manifest(const manifest_type::value_type &r) {
+    // Compaction is postponed by a few lines, so that small manifests are
+    // not rewritten on every update.
+    const size_t slack = 64;
+
+    cache_lock lock;
+
+    {
+        std::ofstream f(manifest_path(), std::ios::app);
+        f << manifest_record(r);
+    }
+
+    if (++manifest_lines() > 2 * manifest().size() + slack) {
+        size_t lines;
+        manifest_type m = read_manifest(lines);
+
+        if (lines > 2 * m.size() + slack)
+            write_manifest(m);
+        else
+            manifest_lines() = lines;
+    }
+}
+
+// Name of the entry file holding the program source.
+inline std::string source_file() {
+    return "source";
+}
+
+// Checks if the file was left by temp_name() (possibly with an extension
+// added by an external tool).
+inline bool is_temp(const fs::path &file) {
+    return file.filename().string().find(".tmp") != std::string::npos;
+}
+
+// Removes the temporary file if its writer has most probably crashed.
+// Returns true if the file was removed.
+inline bool remove_stale_temp(const fs::path &file) {
+    // Nothing should take an hour to compile and store.
+    const std::time_t max_age = 3600;
+
+    boost::system::error_code ec;
+    std::time_t t = fs::last_write_time(file, ec);
+    if (ec || std::time(0) - t < max_age) return false;
+
+    return fs::remove(file, ec);
+}
+
+// Marks the file as recently used.
+inline void touch(const std::string &file) {
+    boost::system::error_code ec;
+    fs::last_write_time(file, std::time(0), ec);
+}
+
+// Size and last use time of a cache entry.
+struct entry_stat {
+    std::string key;
+    std::time_t time;
+    uintmax_t   size;
+
+    bool operator<(const entry_stat &e) const {
+        return time < e.time;
+    }
+};
+
+// Total size of the cache as known to this process: measured by the last
+// scan in trim(), plus the sizes of the files committed since then. Files
+// committed by other processes are only noticed by the next scan.
+struct cache_size {
+    bool      known;
+    uintmax_t bytes;
+};
+
+inline cache_size& known_size() {
+    static cache_size s = {false, 0};
+    return s;
+}
+
+inline std::vector<entry_stat> scan_entries() {
+    std::vector<entry_stat> entries;
+    boost::system::error_code ec;
+
+    for(fs::directory_iterator d(appdata_path(), ec), e; d != e; d.increment(ec)) {
+        if (ec) break;
+        if (is_temp(d->path())) {
+            remove_stale_temp(d->path());
+            continue;
+        }
+        if (!fs::is_directory(d->status()) || d->path().filename().string().size() != 2)
+            continue;
+
+        for(fs::directory_iterator k(d->path(), ec); k != e; k.increment(ec)) {
+            if (ec) break;
+            if (!fs::is_directory(k->status())) continue;
+
+            entry_stat s = {
+                d->path().filename().string() + k->path().filename().string(),
+                0, 0
+            };
+
+            for(fs::directory_iterator f(k->path(), ec); f != e; f.increment(ec)) {
+                if (ec) break;
+                if (is_temp(f->path()) && remove_stale_temp(f->path())) continue;
+                s.size += fs::file_size(f->path(), ec);
+                s.time  = std::max(s.time, fs::last_write_time(f->path(), ec));
+            }
+
+            entries.push_back(s);
+        }
+    }
+
+    return entries;
+}
+
+} // namespace detail
+/// \endcond
+
+/// Cache size limit in bytes. Zero means there is no limit.
+/**
+ * The default value is taken from VEXCL_CACHE_SIZE environment variable
+ * (in megabytes).
+ */
+inline uintmax_t& size_limit() {
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+    static const char *env = getenv("VEXCL_CACHE_SIZE");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+    static uintmax_t limit = env ? std::strtoull(env, 0, 10) * 1024 * 1024 : 0;
+    return limit;
+}
+
+/// Sets cache size limit in bytes. Zero means there is no limit.
+inline void set_size_limit(uintmax_t bytes) {
+    size_limit() = bytes;
+}
+
+/// Returns cache key (SHA1 hash) for the program source.
+/**
+ * The manifest is consulted first, so that SHA1 is only computed for
+ * previously unseen sources. The manifest is only a lookup hint: its record
+ * is used when a second cheap hash of the source matches as well, so that a
+ * collision of FNV-1a hashes can not load a binary of another program.
+ */
+inline std::string key(const std::string &src) {
+    auto     id    = std::make_pair(detail::fnv1a(src), src.size());
+    uint64_t check = detail::check_hash(src);
+
+    try {
+        std::lock_guard<std::mutex> guard(detail::manifest_mutex());
+        detail::manifest_type &m = detail::manifest();
+
+        auto r = m.find(id);
+        if (r != m.end()) {
+            if (r->second.check == check) return r->second.key;
+
+            // The record belongs to another source with the same cheap hash.
+            return sha1(src);
+        }
+
+        detail::manifest_entry e = {sha1(src), check};
+        r = m.insert(std::make_pair(id, e)).first;
+
+        detail::append_manifest(*r);
+
+        return r->second.key;
+    } catch(...) {
+        return sha1(src);
+    }
+}
+
+/// Returns path to the cached file, if it exists.
+/**
+ * Marks the entry as recently used.
+ */
+inline boost::optional<std::string> find(const std::string &key, const std::string &name) {
+    try {
+        std::string file = program_binaries_path(key) + name;
+        if (boost::filesystem::exists(file)) {
+            detail::touch(file);
+            return file;
+        }
+    } catch(...) { }
+
+    return boost::optional<std::string>();
+}
+
+/// Reads contents of the cached file, if it exists.
+/**
+ * Marks the entry as recently used.
+ */
+inline boost::optional<std::string> load(const std::string &key, const std::string &name) {
+    try {
+        std::string file = program_binaries_path(key) + name;
+        std::ifstream f(file, std::ios::binary);
+        if (f) {
+            std::ostringstream s;
+            s << f.rdbuf();
+            detail::touch(file);
+            return s.str();
+        }
+    } catch(...) { }
+
+    return boost::optional<std::string>();
+}
+
+/// Evicts the least recently used entries until the cache fits the size limit.
+/**
+ * The entry with the given key (usually the one that was just stored) is
+ * never evicted. Stale temporary files left by crashed writers are removed.
+ * The whole cache directory is scanned, so commit() only calls this when the
+ * cache size known to the process exceeds the limit.
+ */
+inline void trim(const std::string &keep = "") {
+    if (!size_limit()) return;
+
+    try {
+        std::lock_guard<std::mutex> guard(detail::manifest_mutex());
+        detail::cache_lock lock;
+
+        std::vector<detail::entry_stat> entries = detail::scan_entries();
+        std::sort(entries.begin(), entries.end());
+
+        uintmax_t total = 0;
+        for(auto e = entries.begin(); e != entries.end(); ++e)
+            total += e->size;
+
+        std::set<std::string> removed;
+        for(auto e = entries.begin(); e != entries.end() && total > size_limit(); ++e) {
+            if (e->key == keep) continue;
+
+            boost::system::error_code ec;
+            boost::filesystem::remove_all(program_binaries_path(e->key), ec);
+            total -= e->size;
+            removed.insert(e->key);
+        }
+
+        detail::cache_size &known = detail::known_size();
+        known.known = true;
+        known.bytes = total;
+
+        if (removed.empty()) return;
+
+        // Drop manifest records of the removed entries.
+        detail::manifest_type m = detail::read_manifest();
+        for(auto r = m.begin(); r != m.end(); )
+            if (removed.count(r->second.key)) m.erase(r++); else ++r;
+        detail::write_manifest(m);
+
+        detail::manifest_type &mine = detail::manifest();
+        for(auto r = mine.begin(); r != mine.end(); )
+            if (removed.count(r->second.key)) mine.erase(r++); else ++r;
+    } catch(...) { }
+}
+
+/// Returns a unique temporary file name inside the cache entry directory.
+/**
+ * The file may be filled by an external tool (e.g. a compiler) and then
+ * moved into the cache with commit().
+ */
+inline std::string temp_path(const std::string &key) {
+    return detail::temp_name(program_binaries_path(key, true));
+}
+
+/// Atomically moves the file into the cache entry.
+/**
+ * Evicts old entries with trim() if the cache size known to the process
+ * exceeds the size limit. The first commit with a limit set measures the
+ * cache size.
+ */
+inline bool commit(const std::string &key, const std::string &name, const std::string &file) {
+    uintmax_t size = 0;
+
+    try {
+        boost::system::error_code ec;
+        size = boost::filesystem::file_size(file, ec);
+        if (ec) size = 0;
+
+        boost::filesystem::rename(file, program_binaries_path(key, true) + name);
+    } catch(...) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(file, ec);
+        return false;
+    }
+
+    if (!size_limit()) return true;
+
+    bool over;
+    {
+        std::lock_guard<std::mutex> guard(detail::manifest_mutex());
+        detail::cache_size &known = detail::known_size();
+
+        known.bytes += size;
+        over = !known.known || known.bytes > size_limit();
+    }
+
+    if (over) trim(key);
+    return true;
+}
+
+/// Atomically stores the data in the cache entry.
+inline bool save(const std::string &key, const std::string &name, const std::string &data) {
+    std::string tmp;
+
+    try {
+        tmp = temp_path(key);
+
+        std::ofstream f(tmp, std::ios::binary);
+        f.write(data.data(), data.size());
+        f.close();
+
+        if (!f) throw std::runtime_error("write failed");
+    } catch(...) {
+        boost::system::error_code ec;
+        if (!tmp.empty()) boost::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    return commit(key, name, tmp);
+}
+
+/// Stores the program source in the cache entry.
+/**
+ * The source is kept along with the binaries, so that cache entries may be
+ * inspected. Should be called before the binary is saved.
+ */
+inline bool save_source(const std::string &key, const std::string &src) {
+    return save(key, detail::source_file(), src);
+}
+
+/// Removes the cache entry (e.g. when the cached binary is stale).
+inline void remove(const std::string &key) {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(program_binaries_path(key), ec);
+}
+
+} // namespace binary_cache
+} // namespace vex
+
+#endif
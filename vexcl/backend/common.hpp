@@ -38,7 +38,13 @@ THE SOFTWARE.
 #include <sstream>
 #include <iomanip>
 #include <cstdlib>
-#include <boost/uuid/sha1.hpp>
+#include <mutex>
+#include <boost/version.hpp>
+#if BOOST_VERSION >= 106600
+#  include <boost/uuid/detail/sha1.hpp>
+#else
+#  include <boost/uuid/sha1.hpp>
+#endif
 #include <boost/optional.hpp>
 #include <boost/filesystem.hpp>
 
@@ -51,31 +57,42 @@ enum device_options_kind {
 };
 
 /// Global program options holder
+/**
+ * Options are read by the background compilation threads, so the holder is
+ * guarded with a mutex and get() returns a copy.
+ */
 template <device_options_kind kind>
 struct device_options {
-    static const std::string& get(const backend::command_queue &q) {
+    static std::string get(const backend::command_queue &q) {
         auto dev = backend::get_device_id(q);
+        std::lock_guard<std::mutex> lock(mx);
         if (options[dev].empty()) options[dev].push_back("");
         return options[dev].back();
     }
 
     static void push(const backend::command_queue &q, const std::string &str) {
         auto dev = backend::get_device_id(q);
+        std::lock_guard<std::mutex> lock(mx);
         options[dev].push_back(str);
     }
 
     static void pop(const backend::command_queue &q) {
         auto dev = backend::get_device_id(q);
+        std::lock_guard<std::mutex> lock(mx);
         if (!options[dev].empty()) options[dev].pop_back();
     }
 
     private:
         static std::map<backend::device_id, std::vector<std::string> > options;
+        static std::mutex mx;
 };
 
 template <device_options_kind kind>
 std::map<backend::device_id, std::vector<std::string> > device_options<kind>::options;
 
+template <device_options_kind kind>
+std::mutex device_options<kind>::mx;
+
 inline std::string get_compile_options(const backend::command_queue &q) {
     return device_options<compile_options>::get(q);
 }
@@ -84,6 +101,79 @@ inline std::string get_program_header(const backend::command_queue &q) {
     return device_options<program_header>::get(q);
 }
 
+/// Command queue properties that are queried once and reused afterwards.
+/**
+ * Getting the context or the device properties of a queue involves driver
+ * calls, which are too expensive to make on every kernel launch.
+ */
+struct queue_info {
+    backend::context    context_handle;
+    backend::context_id context;
+    backend::device_id  device;
+    size_t              compute_units;
+    size_t              max_workgroup_size;
+    bool                cpu;
+    bool                in_order;
+
+    explicit queue_info(const backend::command_queue &q)
+        : context_handle(backend::get_context(q)),
+          context(backend::get_context_id(q)),
+          device(backend::get_device_id(q)),
+          compute_units(backend::compute_units(q)),
+          max_workgroup_size(backend::max_workgroup_size(q)),
+          cpu(backend::is_cpu(q)),
+          in_order(backend::is_in_order(q))
+    { }
+};
+
+/// Holds queue_info records for the known command queues.
+/**
+ * The store may be reached from the background compilation threads, so it is
+ * guarded with a mutex. The returned references stay valid until the record
+ * is purged.
+ */
+template <bool dummy = true>
+struct queue_info_store {
+    static_assert(dummy, "dummy parameter should be true");
+
+    typedef std::map<
+        backend::command_queue, queue_info, backend::compare_queues
+        > store_type;
+
+    static store_type store;
+    static std::mutex mx;
+
+    static const queue_info& get(const backend::command_queue &q) {
+        std::lock_guard<std::mutex> lock(mx);
+
+        auto i = store.find(q);
+        if (i == store.end())
+            i = store.insert(std::make_pair(q, queue_info(q))).first;
+        return i->second;
+    }
+
+    static void erase(const backend::command_queue &q) {
+        std::lock_guard<std::mutex> lock(mx);
+        store.erase(q);
+    }
+
+    static void clear() {
+        std::lock_guard<std::mutex> lock(mx);
+        store.clear();
+    }
+};
+
+template <bool dummy>
+typename queue_info_store<dummy>::store_type queue_info_store<dummy>::store;
+
+template <bool dummy>
+std::mutex queue_info_store<dummy>::mx;
+
+/// Returns cached properties of the given command queue.
+inline const queue_info& get_queue_info(const backend::command_queue &q) {
+    return queue_info_store<>::get(q);
+}
+
 /// \endcond
 
 /// Set global compute kernel compilation options for a given device.
@@ -39,6 +39,7 @@ THE SOFTWARE.
 
 #include <vexcl/backend/cuda/error.hpp>
 #include <vexcl/backend/cuda/context.hpp>
+#include <vexcl/backend/cuda/event.hpp>
 #include <vexcl/backend/cuda/filter.hpp>
 #include <vexcl/backend/cuda/device_vector.hpp>
 #include <vexcl/backend/cuda/source.hpp>
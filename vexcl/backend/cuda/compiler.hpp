@@ -34,7 +34,11 @@ THE SOFTWARE.
 #include <cstdlib>
 #include <cuda.h>
 
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+
 #include <vexcl/backend/common.hpp>
+#include <vexcl/backend/binary_cache.hpp>
 
 namespace vex {
 namespace backend {
@@ -67,39 +71,54 @@ inline CUmodule build_sources(
             << "// options: " << options << "\n"
             << source;
 
-    // Write source to a .cu file
-    std::string hash = sha1( fullsrc.str() );
-    std::string basename = program_binaries_path(hash, true) + "kernel";
-    std::string ptxfile  = basename + ".ptx";
+    std::string hash = binary_cache::key( fullsrc.str() );
+
+    boost::optional<std::string> ptxfile = binary_cache::find(hash, "kernel.ptx");
 
-    if ( !boost::filesystem::exists(ptxfile) ) {
-        std::string cufile = basename + ".cu";
+    if ( !ptxfile ) {
+        binary_cache::save_source(hash, fullsrc.str());
 
+        // Compile the source to ptx. Output goes to a temporary file first,
+        // so that a concurrent process never loads a partially written one.
+        std::string cufile  = binary_cache::temp_path(hash) + ".cu";
+        std::string tmpfile = binary_cache::temp_path(hash) + ".ptx";
 
         {
-            std::ofstream f(basename + ".cu");
+            std::ofstream f(cufile);
             f << fullsrc.str();
         }
 
-        // Compile the source to ptx.
         std::ostringstream cmdline;
-        auto cc = queue.device().compute_capability();
         cmdline
             << "nvcc -ptx -O3"
             << " -arch=sm_" << std::get<0>(cc) << std::get<1>(cc)
             << " " << options
-            << " -o " << ptxfile << " " << cufile;
-        if (0 != system(cmdline.str().c_str()) ) {
+            << " -o " << tmpfile << " " << cufile;
+
+        int status = system(cmdline.str().c_str());
+
+        boost::system::error_code ec;
+        boost::filesystem::remove(cufile, ec);
+
+        if (0 != status) {
 #ifndef VEXCL_SHOW_KERNELS
             std::cerr << fullsrc.str() << std::endl;
 #endif
+            boost::filesystem::remove(tmpfile, ec);
+            binary_cache::remove(hash);
             throw std::runtime_error("nvcc invocation failed");
         }
+
+        if (binary_cache::commit(hash, "kernel.ptx", tmpfile))
+            ptxfile = binary_cache::find(hash, "kernel.ptx");
+
+        if (!ptxfile)
+            throw std::runtime_error("Failed to store compiled ptx");
     }
 
     // Load the compiled ptx.
     CUmodule program;
-    cuda_check( cuModuleLoad(&program, ptxfile.c_str()) );
+    cuda_check( cuModuleLoad(&program, ptxfile->c_str()) );
 
     return program;
 }
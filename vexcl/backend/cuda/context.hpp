@@ -33,6 +33,8 @@ THE SOFTWARE.
 
 #include <vector>
 #include <tuple>
+#include <string>
+#include <sstream>
 #include <iostream>
 #include <memory>
 
@@ -78,6 +80,13 @@ struct deleter_impl<CUstream> {
     }
 };
 
+template <>
+struct deleter_impl<CUevent> {
+    static void dispose(CUevent event) {
+        cuda_check( cuEventDestroy(event) );
+    }
+};
+
 // Knows how to dispose of various CUDA handles.
 struct deleter {
     template <class Handle>
@@ -297,6 +306,46 @@ inline bool is_cpu(const command_queue&) {
     return false;
 }
 
+/// \cond INTERNAL
+/// Returns number of multiprocessors on the device associated with the queue.
+inline size_t compute_units(const command_queue &q) {
+    return q.device().multiprocessor_count();
+}
+
+/// Returns maximum number of threads per block for the device associated with the queue.
+inline size_t max_workgroup_size(const command_queue &q) {
+    return q.device().max_threads_per_block();
+}
+
+/// Checks if commands in the queue are executed in order.
+/**
+ * CUDA streams are always in-order.
+ */
+inline bool is_in_order(const command_queue&) {
+    return true;
+}
+
+/// Returns version of the software that runs the device.
+inline std::string driver_version(const command_queue&) {
+    int v;
+    cuda_check( cuDriverGetVersion(&v) );
+
+    std::ostringstream s;
+    s << "CUDA " << v / 1000 << "." << (v % 1000) / 10;
+    return s.str();
+}
+
+/// Returns preferred width of vector types with the given element type.
+/**
+ * CUDA has no vector loads and stores for arbitrary element types, so
+ * elementwise kernels are always scalar.
+ */
+template <class T>
+inline unsigned preferred_vector_width(const command_queue&) {
+    return 1;
+}
+/// \endcond
+
 /// Select devices by given criteria.
 /**
  * \param filter  Device filter functor. Functors may be combined with logical
@@ -49,6 +49,8 @@ typedef unsigned mem_flags;
 static const mem_flags MEM_READ_ONLY  = 1;
 static const mem_flags MEM_WRITE_ONLY = 2;
 static const mem_flags MEM_READ_WRITE = 4;
+static const mem_flags MEM_USE_HOST_PTR   = 8;
+static const mem_flags MEM_ALLOC_HOST_PTR = 16;
 
 /// \cond INTERNAL
 namespace detail {
@@ -112,6 +114,18 @@ class device_vector {
             }
         }
 
+        /// \cond INTERNAL
+        /// Uses memory of a byte buffer (see vex::memory_pool).
+        /**
+         * The keeper is released together with the last copy of the vector.
+         */
+        device_vector(const command_queue &q, const device_vector<char> &bytes,
+                size_t n, std::shared_ptr<void> keeper)
+            : ctx(q.context()), n(n),
+              buffer(keeper, reinterpret_cast<char*>(static_cast<size_t>(bytes.raw())))
+        { }
+        /// \endcond
+
         /// Selects correct device before automatic deleter kicks in.
         ~device_vector() {
             if (buffer) ctx.set_current();
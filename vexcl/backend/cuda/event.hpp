@@ -0,0 +1,132 @@
+#ifndef VEXCL_BACKEND_CUDA_EVENT_HPP
+#define VEXCL_BACKEND_CUDA_EVENT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/cuda/event.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Synchronization of CUDA streams with events.
+ */
+
+#include <vector>
+#include <memory>
+#include <type_traits>
+
+#include <cuda.h>
+
+#include <vexcl/backend/cuda/error.hpp>
+#include <vexcl/backend/cuda/context.hpp>
+
+namespace vex {
+namespace backend {
+namespace cuda {
+
+/// Synchronization event.
+/** With the CUDA backend, this is a wrapper around CUevent. */
+class event {
+    public:
+        /// Empty constructor.
+        event() {}
+
+        /// Records event in the given stream.
+        /**
+         * Timing is disabled for the event unless requested explicitly.
+         */
+        explicit event(const command_queue &q, bool timing = false)
+            : ctx(q.context()), e(create(q, timing), detail::deleter())
+        {}
+
+        /// Blocks until the event completes.
+        void wait() const {
+            ctx.set_current();
+            cuda_check( cuEventSynchronize(e.get()) );
+        }
+
+        /// Returns raw CUevent handle.
+        CUevent raw() const {
+            return e.get();
+        }
+    private:
+        vex::backend::context ctx;
+        std::shared_ptr<std::remove_pointer<CUevent>::type> e;
+
+        static CUevent create(const command_queue &q, bool timing) {
+            q.context().set_current();
+
+            CUevent e;
+            cuda_check( cuEventCreate(&e, timing ? CU_EVENT_DEFAULT : CU_EVENT_DISABLE_TIMING) );
+            cuda_check( cuEventRecord(e, q.raw()) );
+
+            return e;
+        }
+};
+
+/// Returns event that completes when all commands previously submitted to the queue complete.
+inline event enqueue_marker(const command_queue &q) {
+    return event(q);
+}
+
+/// Commands submitted to the queue after the call wait for the given events.
+inline void enqueue_barrier(const command_queue &q, const std::vector<event> &events) {
+    for(auto e = events.begin(); e != events.end(); ++e)
+        cuda_check( cuStreamWaitEvent(q.raw(), e->raw(), 0) );
+}
+
+/// Blocks until all given events complete.
+inline void wait_for_events(const std::vector<event> &events) {
+    for(auto e = events.begin(); e != events.end(); ++e)
+        e->wait();
+}
+
+/// Checks if the queue supports timing of the submitted commands.
+inline bool profiling_enabled(const command_queue&) {
+    return true;
+}
+
+/// Returns event that records the time when all previously submitted commands complete.
+inline event enqueue_timestamp(const command_queue &q) {
+    return event(q, true);
+}
+
+/// Time in seconds between two timestamps.
+/**
+ * Blocks until the second timestamp completes.
+ */
+inline double elapsed(const event &start, const event &stop) {
+    stop.wait();
+
+    float ms;
+    cuda_check( cuEventElapsedTime(&ms, start.raw(), stop.raw()) );
+
+    return 1e-3 * ms;
+}
+
+} // namespace cuda
+} // namespace backend
+} // namespace vex
+
+#endif
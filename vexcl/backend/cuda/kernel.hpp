@@ -31,16 +31,36 @@ THE SOFTWARE.
  * \brief  An abstraction over CUDA compute kernel.
  */
 
+#include <vector>
 #include <functional>
+#include <algorithm>
 
 #include <cuda.h>
 
+#include <vexcl/backend/cuda/event.hpp>
 #include <vexcl/backend/cuda/compiler.hpp>
+#include <vexcl/backend/precompile.hpp>
+#include <vexcl/backend/trace.hpp>
 
 namespace vex {
 namespace backend {
 namespace cuda {
 
+/// Compiled CUDA module.
+typedef std::shared_ptr< std::remove_pointer<CUmodule>::type > program;
+
+/// Builds program from source.
+/**
+ * The program may contain several kernels, which are then created with
+ * the corresponding backend::kernel constructor. Putting related kernels into
+ * a single program saves the per-program compilation overhead.
+ */
+inline program build_program(const command_queue &queue,
+        const std::string &src, const std::string &options = "")
+{
+    return program(precompile::detail::build(queue, src, options), detail::deleter());
+}
+
 /// \cond INTERNAL
 
 /// An abstraction over CUDA compute kernel.
@@ -56,8 +76,8 @@ class kernel {
                const std::string &options = ""
                )
             : ctx(queue.context()),
-              module(build_sources(queue, src, options), detail::deleter()),
-              smem(0)
+              module(precompile::detail::build(queue, src, options), detail::deleter()),
+              name(name), smem(0)
         {
             cuda_check( cuModuleGetFunction(&K, module.get(), name.c_str()) );
 
@@ -72,8 +92,33 @@ class kernel {
                const std::string &options = ""
                )
             : ctx(queue.context()),
-              module(build_sources(queue, src, options), detail::deleter()),
-              smem(0)
+              module(precompile::detail::build(queue, src, options), detail::deleter()),
+              name(name), smem(0)
+        {
+            cuda_check( cuModuleGetFunction(&K, module.get(), name.c_str()) );
+            config(queue, smem);
+        }
+
+        /// Constructor. Extracts kernel from compiled module.
+        kernel(const command_queue &queue,
+               const program &P,
+               const std::string &name,
+               size_t smem_per_thread = 0
+               )
+            : ctx(queue.context()), module(P), name(name), smem(0)
+        {
+            cuda_check( cuModuleGetFunction(&K, module.get(), name.c_str()) );
+
+            config(queue,
+                    [smem_per_thread](size_t wgs){ return wgs * smem_per_thread; });
+        }
+
+        /// Constructor. Extracts kernel from compiled module.
+        kernel(const command_queue &queue,
+               const program &P, const std::string &name,
+               std::function<size_t(size_t)> smem
+               )
+            : ctx(queue.context()), module(P), name(name), smem(0)
         {
             cuda_check( cuModuleGetFunction(&K, module.get(), name.c_str()) );
             config(queue, smem);
@@ -101,6 +146,19 @@ class kernel {
 
         /// Enqueue the kernel to the specified command queue.
         void operator()(const command_queue &q) {
+            if (observer()) (*observer())(*this, q);
+
+            trace::detail::command cmd(q);
+            launch(q);
+            cmd.done(name, "kernel", g_size.x * g_size.y * g_size.z * workgroup_size());
+
+            stack.clear();
+            prm_pos.clear();
+        }
+
+        /// \cond INTERNAL
+        // Launches the kernel keeping the arguments bound.
+        void launch(const command_queue &q) {
             prm_addr.clear();
             for(auto p = prm_pos.begin(); p != prm_pos.end(); ++p)
                 prm_addr.push_back(stack.data() + *p);
@@ -116,10 +174,34 @@ class kernel {
                         0
                         )
                     );
+        }
 
-            stack.clear();
-            prm_pos.clear();
+        // Position of the next argument.
+        unsigned next_arg() const {
+            return static_cast<unsigned>(prm_pos.size());
+        }
+
+        // Replaces value of an argument that was already added.
+        template <class Arg>
+        void set_arg(unsigned pos, const Arg &arg) {
+            const char *c = (const char*)&arg;
+            std::copy(c, c + sizeof(arg), stack.begin() + prm_pos[pos]);
+        }
+
+        // Returns a copy of the kernel with its own argument bindings.
+        kernel clone() const {
+            return *this;
+        }
+
+        // Receives copies of the launched kernels while a command graph is
+        // being captured.
+        typedef std::function<void(const kernel&, const command_queue&)> observer_type;
+
+        static observer_type*& observer() {
+            static observer_type *o = 0;
+            return o;
         }
+        /// \endcond
 
 #ifndef BOOST_NO_VARIADIC_TEMPLATES
         /// Enqueue the kernel to the specified command queue with the given arguments
@@ -138,7 +220,7 @@ class kernel {
 
         /// Standard number of workgroups to launch on a device.
         static inline size_t num_workgroups(const command_queue &q) {
-            return 8 * q.device().multiprocessor_count();
+            return 8 * get_queue_info(q).compute_units;
         }
 
         /// The maximum number of threads per block, beyond which a launch of the kernel would fail.
@@ -157,7 +239,7 @@ class kernel {
         /// Select best launch configuration for the given shared memory requirements.
         void config(const command_queue &q, std::function<size_t(size_t)> smem) {
             // Select workgroup size that would fit into the device.
-            size_t ws = q.device().max_threads_per_block() / 2;
+            size_t ws = get_queue_info(q).max_workgroup_size / 2;
 
             size_t max_ws   = max_threads_per_block(q);
             size_t max_smem = max_shared_memory_per_block(q);
@@ -185,8 +267,9 @@ class kernel {
         }
     private:
         context ctx;
-        std::shared_ptr< std::remove_pointer<CUmodule>::type > module;
+        program module;
         CUfunction K;
+        std::string name;
 
         ndrange  w_size;
         ndrange  g_size;
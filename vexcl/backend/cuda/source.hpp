@@ -47,12 +47,14 @@ namespace vex {
 template <class T> struct global_ptr {};
 template <class T> struct shared_ptr {};
 template <class T> struct regstr_ptr {};
+template <class T> struct restrict_ptr {};
 
 template <class T> struct remove_ptr;
 
 template <class T> struct remove_ptr< global_ptr<T> > { typedef T type; };
 template <class T> struct remove_ptr< shared_ptr<T> > { typedef T type; };
 template <class T> struct remove_ptr< regstr_ptr<T> > { typedef T type; };
+template <class T> struct remove_ptr< restrict_ptr<T> > { typedef T type; };
 
 template <class T>
 struct type_name_impl <global_ptr<T> > {
@@ -84,6 +86,15 @@ struct type_name_impl <regstr_ptr<T> > : type_name_impl< global_ptr<T> > { };
 template <class T>
 struct type_name_impl <regstr_ptr<const T> > : type_name_impl< global_ptr<const T> > { };
 
+template <class T>
+struct type_name_impl <restrict_ptr<T> > {
+    static std::string get() {
+        std::ostringstream s;
+        s << type_name< global_ptr<T> >() << " __restrict__";
+        return s.str();
+    }
+};
+
 template<typename T>
 struct type_name_impl<T*>
 {
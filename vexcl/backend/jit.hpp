@@ -0,0 +1,49 @@
+#ifndef VEXCL_BACKEND_JIT_HPP
+#define VEXCL_BACKEND_JIT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  JIT backend: kernels are compiled with the host C++ compiler and
+ *         executed on the host CPU.
+ */
+
+#ifndef VEXCL_BACKEND_JIT
+#  define VEXCL_BACKEND_JIT
+#endif
+
+#include <vexcl/backend/jit/error.hpp>
+#include <vexcl/backend/jit/context.hpp>
+#include <vexcl/backend/jit/event.hpp>
+#include <vexcl/backend/jit/filter.hpp>
+#include <vexcl/backend/jit/device_vector.hpp>
+#include <vexcl/backend/jit/source.hpp>
+#include <vexcl/backend/jit/compiler.hpp>
+#include <vexcl/backend/jit/kernel.hpp>
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef VEXCL_BACKEND_JIT_COMPILER_HPP
+#define VEXCL_BACKEND_JIT_COMPILER_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/compiler.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Compilation of JIT backend sources into shared libraries.
+ */
+
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <memory>
+#include <cstdlib>
+
+#include <dlfcn.h>
+
+#include <boost/optional.hpp>
+#include <boost/filesystem.hpp>
+
+#include <vexcl/backend/common.hpp>
+#include <vexcl/backend/binary_cache.hpp>
+#include <vexcl/backend/jit/error.hpp>
+
+namespace vex {
+namespace backend {
+namespace jit {
+
+/// Handle of a loaded shared library with compiled kernels.
+typedef std::shared_ptr<void> program;
+
+/// \cond INTERNAL
+namespace detail {
+
+struct dl_deleter {
+    void operator()(void *handle) const {
+        if (handle) dlclose(handle);
+    }
+};
+
+inline std::string jit_compiler() {
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+    const char *cc = getenv("VEXCL_JIT_COMPILER");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+    return cc ? cc : "c++";
+}
+
+// Instruction set extensions of the host CPU (hashed), or an empty string
+// if they are unknown. Hosts sharing a cache directory may have the same CPU
+// model name but different extensions (e.g. virtual machines), so these go
+// into the cache key of libraries compiled with -march=native.
+inline const std::string& host_cpu_features() {
+    static const std::string features = []() -> std::string {
+        std::ifstream f("/proc/cpuinfo");
+        std::string line;
+
+        // Only the first processor is looked at.
+        while (std::getline(f, line) && !line.empty()) {
+            if (line.compare(0, 5, "flags") == 0 || line.compare(0, 8, "Features") == 0) {
+                size_t pos = line.find(':');
+                if (pos != std::string::npos) return sha1(line.substr(pos + 1));
+            }
+        }
+        return "";
+    }();
+    return features;
+}
+
+// Compiler flags. Code is only tuned for the host CPU when its extensions
+// are known and are part of the cache key.
+inline std::string jit_flags() {
+    if (host_cpu_features().empty())
+        return "-shared -fPIC -O3 -std=c++11";
+    else
+        return "-shared -fPIC -O3 -march=native -std=c++11";
+}
+
+// Quotes a path for the shell command line.
+inline std::string shell_quote(const std::string &path) {
+    std::string q = "'";
+    for(auto c = path.begin(); c != path.end(); ++c) {
+        if (*c == '\'')
+            q += "'\\''";
+        else
+            q += *c;
+    }
+    return q + "'";
+}
+
+} // namespace detail
+/// \endcond
+
+/// Create and build a program from source string.
+/**
+ * The source is compiled into a shared library with the host C++ compiler.
+ * The compiler may be selected with the VEXCL_JIT_COMPILER environment
+ * variable. The libraries are cached on disk and reused between runs. The
+ * cache key includes the compiler flags and the instruction set extensions
+ * of the host CPU, since the code is tuned for the host with -march=native.
+ */
+inline program build_sources(
+        const command_queue &queue, const std::string &source,
+        const std::string &options = ""
+        )
+{
+#ifdef VEXCL_SHOW_KERNELS
+    std::cout << source << std::endl;
+#else
+#  ifdef _MSC_VER
+#    pragma warning(push)
+#    pragma warning(disable: 4996)
+#  endif
+    if (getenv("VEXCL_SHOW_KERNELS"))
+        std::cout << source << std::endl;
+#  ifdef _MSC_VER
+#    pragma warning(pop)
+#  endif
+#endif
+
+    const std::string compiler = detail::jit_compiler();
+
+    std::ostringstream fullsrc;
+    const std::string flags = detail::jit_flags();
+
+    fullsrc << "// Device:   " << queue.device().name() << "\n"
+            << "// Features: " << detail::host_cpu_features() << "\n"
+            << "// Compiler: " << compiler << " " << flags << "\n"
+            << "// options:  " << options << "\n"
+            << source;
+
+    std::string hash = binary_cache::key( fullsrc.str() );
+
+    boost::optional<std::string> sofile = binary_cache::find(hash, "kernel.so");
+
+    if ( !sofile ) {
+        binary_cache::save_source(hash, fullsrc.str());
+
+        // Compile into a temporary file first, so that a concurrent process
+        // never loads a partially written library.
+        std::string cppfile = binary_cache::temp_path(hash) + ".cpp";
+        std::string tmpfile = binary_cache::temp_path(hash) + ".so";
+
+        {
+            std::ofstream f(cppfile);
+            f << fullsrc.str();
+        }
+
+        std::ostringstream cmdline;
+        cmdline
+            << compiler << " " << flags
+            << " " << options
+            << " -o " << detail::shell_quote(tmpfile)
+            << " "    << detail::shell_quote(cppfile);
+
+        int status = system(cmdline.str().c_str());
+
+        boost::system::error_code ec;
+        boost::filesystem::remove(cppfile, ec);
+
+        if (0 != status) {
+#ifndef VEXCL_SHOW_KERNELS
+            std::cerr << fullsrc.str() << std::endl;
+#endif
+            boost::filesystem::remove(tmpfile, ec);
+            binary_cache::remove(hash);
+            throw error("JIT compiler invocation failed", __FILE__, __LINE__);
+        }
+
+        if (binary_cache::commit(hash, "kernel.so", tmpfile))
+            sofile = binary_cache::find(hash, "kernel.so");
+
+        if (!sofile)
+            throw error("Failed to store compiled library", __FILE__, __LINE__);
+    }
+
+    // Load the compiled library.
+    void *handle = dlopen(sofile->c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle) throw error(dlerror(), __FILE__, __LINE__);
+
+    return program(handle, detail::dl_deleter());
+}
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+#endif
@@ -0,0 +1,342 @@
+#ifndef VEXCL_BACKEND_JIT_CONTEXT_HPP
+#define VEXCL_BACKEND_JIT_CONTEXT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/context.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Host device enumeration and context initialization for the JIT backend.
+ */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <cstdlib>
+
+#include <vexcl/backend/jit/error.hpp>
+
+namespace vex {
+namespace backend {
+
+/// The JIT backend.
+/**
+ * Generated kernels are compiled into a shared library with the host C++
+ * compiler, loaded with dlopen(), and executed on the host CPU cores.
+ */
+namespace jit {
+
+/// Raw device handle.
+/**
+ * The only device known to the JIT backend is the host CPU.
+ */
+typedef unsigned device_id;
+
+/// The host CPU as seen by the JIT backend.
+class device {
+    public:
+        /// Constructor.
+        device(device_id d = 0) : d(d) {}
+
+        /// Returns raw device id.
+        device_id raw() const { return d; }
+
+        /// Returns name of the device.
+        std::string name() const {
+            static const std::string cpu_name = get_cpu_name();
+            return cpu_name;
+        }
+
+        /// Returns number of compute units (hardware threads) on the device.
+        size_t compute_units() const {
+            unsigned n = std::thread::hardware_concurrency();
+            return n ? n : 1;
+        }
+
+        /// Returns maximum number of work-items in a workgroup.
+        size_t max_threads_per_block() const {
+            return 1024;
+        }
+
+        /// Returns size of the local memory available to a workgroup.
+        size_t max_shared_memory_per_block() const {
+            return 64 * 1024;
+        }
+    private:
+        device_id d;
+
+        static std::string get_cpu_name() {
+            std::ifstream f("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(f, line)) {
+                if (line.compare(0, 10, "model name") == 0) {
+                    size_t pos = line.find(':');
+                    if (pos != std::string::npos && pos + 2 <= line.size())
+                        return line.substr(pos + 2);
+                }
+            }
+            return "CPU";
+        }
+};
+
+/// Context of the JIT backend.
+/**
+ * The context only serves as an identity for kernel caches: each context
+ * keeps its own set of compiled kernels.
+ */
+class context {
+    public:
+        /// Creates a new context.
+        context(device = device()) : c(std::make_shared<char>(0)) {}
+
+        /// Returns raw context handle.
+        const char* raw() const {
+            return c.get();
+        }
+
+        /// Does nothing. Provided for compatibility with the CUDA backend.
+        void set_current() const {}
+    private:
+        std::shared_ptr<char> c;
+};
+
+/// Command queue creation flags.
+/**
+ * Not used by the JIT backend and only defined for compatibility with the
+ * OpenCL backend.
+ */
+typedef unsigned command_queue_properties;
+
+/// Command queue.
+/**
+ * Kernels and memory transfers submitted to the JIT backend are executed
+ * synchronously, so the queue is in-order and finish() has nothing to wait
+ * for.
+ */
+class command_queue {
+    public:
+        /// Create command queue for the given context and device.
+        command_queue(const vex::backend::context &ctx, vex::backend::device dev, unsigned flags = 0)
+            : ctx(ctx), dev(dev), s(std::make_shared<char>(0)), f(flags)
+        { }
+
+        /// Blocks until all previously queued commands are completed.
+        void finish() const {}
+
+        /// Returns the context associated with the command queue.
+        vex::backend::context context() const {
+            return ctx;
+        }
+
+        /// Returns the device associated with the command queue.
+        vex::backend::device device() const {
+            return dev;
+        }
+
+        /// Returns command_queue_properties specified at creation.
+        unsigned flags() const {
+            return f;
+        }
+
+        /// Returns raw handle for the command queue.
+        const char* raw() const {
+            return s.get();
+        }
+    private:
+        vex::backend::context  ctx;
+        vex::backend::device   dev;
+        std::shared_ptr<char>  s;
+        unsigned f;
+};
+
+/// Binds the specified context to the calling CPU thread.
+/**
+ * With the JIT backend this is an empty stub provided for compatibility with
+ * the CUDA backend.
+ */
+inline void select_context(const command_queue&) {
+}
+
+/// Returns id of the device associated with the given queue.
+inline device_id get_device_id(const command_queue &q) {
+    return q.device().raw();
+}
+
+/// Launch grid size.
+struct ndrange {
+    size_t x, y, z;
+    ndrange(size_t x = 1, size_t y = 1, size_t z = 1)
+        : x(x), y(y), z(z) {}
+};
+
+/// \cond INTERNAL
+typedef const char* context_id;
+
+/// Returns raw context id for the given queue.
+inline context_id get_context_id(const command_queue &q) {
+    return q.context().raw();
+}
+
+/// Returns context for the given queue.
+inline context get_context(const command_queue &q) {
+    return q.context();
+}
+
+/// Compares contexts by raw ids.
+struct compare_contexts {
+    bool operator()(const context &a, const context &b) const {
+        return a.raw() < b.raw();
+    }
+};
+
+/// Compares queues by raw ids.
+struct compare_queues {
+    bool operator()(const command_queue &a, const command_queue &b) const {
+        return a.raw() < b.raw();
+    }
+};
+/// \endcond
+
+/// Create command queue on the same context and device as the given one.
+inline command_queue duplicate_queue(const command_queue &q) {
+    return command_queue(q.context(), q.device(), q.flags());
+}
+
+/// Checks if the compute device is CPU.
+/**
+ * Always returns true with the JIT backend.
+ */
+inline bool is_cpu(const command_queue&) {
+    return true;
+}
+
+/// \cond INTERNAL
+/// Returns number of hardware threads on the host.
+inline size_t compute_units(const command_queue &q) {
+    return q.device().compute_units();
+}
+
+/// Returns maximum number of work-items in a workgroup.
+inline size_t max_workgroup_size(const command_queue &q) {
+    return q.device().max_threads_per_block();
+}
+
+/// Checks if commands in the queue are executed in order.
+/**
+ * Commands are executed synchronously with the JIT backend.
+ */
+inline bool is_in_order(const command_queue&) {
+    return true;
+}
+
+/// Returns version of the software that runs the device.
+/**
+ * With the JIT backend, this is the compiler used to build the kernels.
+ */
+inline std::string driver_version(const command_queue&) {
+    const char *cc = getenv("VEXCL_JIT_COMPILER");
+    return cc ? cc : "c++";
+}
+
+/// Returns preferred width of vector types with the given element type.
+/**
+ * Vector types of the JIT backend are plain structs. Vectors of 16 bytes
+ * match SIMD registers on most hosts.
+ */
+template <class T>
+inline unsigned preferred_vector_width(const command_queue&) {
+    return sizeof(T) < 16 ? 16 / sizeof(T) : 1;
+}
+/// \endcond
+
+/// Select devices by given criteria.
+/**
+ * \param filter  Device filter functor. Functors may be combined with logical
+ *                operators.
+ * \returns list of devices satisfying the provided filter.
+ */
+template<class DevFilter>
+std::vector<device> device_list(DevFilter&& filter) {
+    std::vector<device> dev;
+
+    device d;
+    if (filter(d)) dev.push_back(d);
+
+    return dev;
+}
+
+/// Create command queues on devices by given criteria.
+/**
+ * \param filter  Device filter functor. Functors may be combined with logical
+ *                operators.
+ * \param properties Command queue properties.
+ *
+ * \returns list of queues accociated with selected devices.
+ * \see device_list
+ */
+template<class DevFilter>
+std::pair< std::vector<context>, std::vector<command_queue> >
+queue_list(DevFilter &&filter, unsigned queue_flags = 0)
+{
+    std::vector<context>       ctx;
+    std::vector<command_queue> queue;
+
+    device d;
+    if (filter(d)) {
+        context       c(d);
+        command_queue q(c, d, queue_flags);
+
+        ctx.push_back(c);
+        queue.push_back(q);
+    }
+
+    return std::make_pair(ctx, queue);
+}
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+namespace std {
+
+/// Output device name to stream.
+inline std::ostream& operator<<(std::ostream &os, const vex::backend::jit::device &d)
+{
+    return os << d.name() << " (JIT)";
+}
+
+/// Output device name to stream.
+inline std::ostream& operator<<(std::ostream &os, const vex::backend::jit::command_queue &q)
+{
+    return os << q.device();
+}
+
+} // namespace std
+
+#endif
@@ -0,0 +1,192 @@
+#ifndef VEXCL_BACKEND_JIT_DEVICE_VECTOR_HPP
+#define VEXCL_BACKEND_JIT_DEVICE_VECTOR_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/device_vector.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  JIT backend device vector (a buffer in host memory).
+ */
+
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <type_traits>
+
+#include <vexcl/backend/jit/context.hpp>
+
+namespace vex {
+namespace backend {
+namespace jit {
+
+/// Device memory creation flags.
+/**
+ * \note Except for MEM_USE_HOST_PTR, these are not used with the JIT backend
+ * and are only defined for compatibility with the OpenCL backend.
+ */
+typedef unsigned mem_flags;
+
+static const mem_flags MEM_READ_ONLY  = 1;
+static const mem_flags MEM_WRITE_ONLY = 2;
+static const mem_flags MEM_READ_WRITE = 4;
+static const mem_flags MEM_USE_HOST_PTR   = 8;
+static const mem_flags MEM_ALLOC_HOST_PTR = 16;
+
+/// \cond INTERNAL
+namespace detail {
+
+// Deleter for the wrapped host memory that is owned by the user.
+struct no_delete {
+    void operator()(char*) const {}
+};
+
+} // namespace detail
+/// \endcond
+
+/// Memory buffer for the JIT backend.
+/**
+ * The "device" memory is a plain host memory buffer, so that kernels may
+ * access it directly and mapping the buffer does not involve any copies.
+ */
+template <typename T>
+class device_vector {
+    public:
+        typedef T value_type;
+        typedef char* raw_type;
+
+        /// Empty constructor.
+        device_vector() : n(0) {}
+
+        /// Allocates memory buffer.
+        device_vector(const command_queue&, size_t n) : n(n) {
+            if (n) buffer.reset(new char[n * sizeof(T)], std::default_delete<char[]>());
+        }
+
+        /// Allocates memory buffer.
+        template <typename H>
+        device_vector(const command_queue &q, size_t n,
+                const H *host = 0, mem_flags flags = MEM_READ_WRITE)
+            : n(n)
+        {
+            if (n && host && (flags & MEM_USE_HOST_PTR) && std::is_same<T, H>::value) {
+                buffer.reset(reinterpret_cast<char*>(const_cast<H*>(host)), detail::no_delete());
+                return;
+            }
+
+            if (n) {
+                buffer.reset(new char[n * sizeof(T)], std::default_delete<char[]>());
+
+                if (host) {
+                    if (std::is_same<T, H>::value)
+                        write(q, 0, n, reinterpret_cast<const T*>(host), true);
+                    else
+                        write(q, 0, n, std::vector<T>(host, host + n).data(), true);
+                }
+            }
+        }
+
+        /// \cond INTERNAL
+        /// Uses memory of a byte buffer (see vex::memory_pool).
+        /**
+         * The keeper is released together with the last copy of the vector.
+         */
+        device_vector(const command_queue&, const device_vector<char> &bytes,
+                size_t n, std::shared_ptr<void> keeper)
+            : n(n), buffer(keeper, bytes.raw())
+        { }
+        /// \endcond
+
+        /// Copies data from host memory to the buffer.
+        /**
+         * Does nothing when the buffer wraps the host memory being copied.
+         */
+        void write(const command_queue&, size_t offset, size_t size, const T *host,
+                bool blocking = false) const
+        {
+            (void)blocking;
+
+            if (size && host != raw_ptr() + offset)
+                std::memcpy(buffer.get() + offset * sizeof(T), host, size * sizeof(T));
+        }
+
+        /// Copies data from the buffer to host memory.
+        /**
+         * Does nothing when the buffer wraps the host memory being copied.
+         */
+        void read(const command_queue&, size_t offset, size_t size, T *host,
+                bool blocking = false) const
+        {
+            (void)blocking;
+
+            if (size && host != raw_ptr() + offset)
+                std::memcpy(host, buffer.get() + offset * sizeof(T), size * sizeof(T));
+        }
+
+        /// Returns size (in elements) of the memory buffer.
+        size_t size() const {
+            return n;
+        }
+
+        /// \cond INTERNAL
+        struct buffer_unmapper {
+            void operator()(T*) const {}
+        };
+        /// \endcond
+
+        /// Pointer to a host memory region mapped to the device memory.
+        /**
+         * With the JIT backend this is the buffer memory itself.
+         */
+        typedef std::unique_ptr<T[], buffer_unmapper> mapped_array;
+
+        /// Maps device buffer to a host memory region and returns pointer to the mapped host memory.
+        mapped_array map(const command_queue&) {
+            return mapped_array(raw_ptr(), buffer_unmapper());
+        }
+
+        /// Returns raw pointer to the buffer memory.
+        char* raw() const {
+            return buffer.get();
+        }
+
+        const T* raw_ptr() const {
+            return reinterpret_cast<const T*>(buffer.get());
+        }
+
+        T* raw_ptr() {
+            return reinterpret_cast<T*>(buffer.get());
+        }
+    private:
+        size_t n;
+        std::shared_ptr<char> buffer;
+};
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef VEXCL_BACKEND_JIT_ERROR_HPP
+#define VEXCL_BACKEND_JIT_ERROR_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/error.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Errors reported by the JIT backend.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <boost/config.hpp>
+
+#ifdef BOOST_NO_NOEXCEPT
+#  define noexcept throw()
+#endif
+
+namespace vex {
+namespace backend {
+namespace jit {
+
+/// JIT backend error class to be thrown as exception.
+class error : public std::runtime_error {
+    public:
+        template <class ErrorCode>
+        error(ErrorCode code, const char *file, int line)
+            : std::runtime_error(get_msg(code, file, line))
+        { }
+    private:
+        template <class ErrorCode>
+        static std::string get_msg(ErrorCode code, const char *file, int line) {
+            std::ostringstream s;
+            s << file << ":" << line << "\n\t" << code;
+            return s.str();
+        }
+};
+
+/// \cond INTERNAL
+inline void check(bool ok, const std::string &msg, const char *file, int line) {
+    if (!ok) throw error(msg, file, line);
+}
+/// \endcond
+
+/// Throws with the given message if condition is not satisfied.
+/**
+ * Reports offending file and line number.
+ */
+#define jit_check(cond, msg) vex::backend::check(cond, msg, __FILE__, __LINE__)
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+namespace std {
+
+/// Sends description of a JIT backend error to the output stream.
+inline std::ostream& operator<<(std::ostream &os, const vex::backend::error &e) {
+    return os << e.what();
+}
+
+} // namespace std
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef VEXCL_BACKEND_JIT_EVENT_HPP
+#define VEXCL_BACKEND_JIT_EVENT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/event.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Synchronization events for the JIT backend.
+ *
+ * All commands are executed synchronously with the JIT backend, so the
+ * events are always complete.
+ */
+
+#include <vector>
+#include <chrono>
+
+#include <vexcl/backend/jit/context.hpp>
+
+namespace vex {
+namespace backend {
+namespace jit {
+
+/// Synchronization event.
+struct event {
+    /// Time of the event completion (only set for timestamps).
+    std::chrono::high_resolution_clock::time_point time;
+
+    /// Blocks until the event completes.
+    void wait() const {}
+};
+
+/// Returns event that completes when all commands previously submitted to the queue complete.
+inline event enqueue_marker(const command_queue&) {
+    return event();
+}
+
+/// Commands submitted to the queue after the call wait for the given events.
+inline void enqueue_barrier(const command_queue&, const std::vector<event>&) {}
+
+/// Blocks until all given events complete.
+inline void wait_for_events(const std::vector<event>&) {}
+
+/// Checks if the queue supports timing of the submitted commands.
+inline bool profiling_enabled(const command_queue&) {
+    return true;
+}
+
+/// Returns event that records the time when all previously submitted commands complete.
+inline event enqueue_timestamp(const command_queue&) {
+    event e;
+    e.time = std::chrono::high_resolution_clock::now();
+    return e;
+}
+
+/// Time in seconds between two timestamps.
+inline double elapsed(const event &start, const event &stop) {
+    return std::chrono::duration<double>(stop.time - start.time).count();
+}
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef VEXCL_BACKEND_JIT_KERNEL_HPP
+#define VEXCL_BACKEND_JIT_KERNEL_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/kernel.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  An abstraction over JIT compute kernel.
+ */
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+
+#include <dlfcn.h>
+
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#include <vexcl/backend/jit/event.hpp>
+#include <vexcl/backend/jit/compiler.hpp>
+#include <vexcl/backend/precompile.hpp>
+#include <vexcl/backend/trace.hpp>
+
+namespace vex {
+namespace backend {
+namespace jit {
+
+/// Builds program from source.
+/**
+ * The program may contain several kernels, which are then created with
+ * the corresponding backend::kernel constructor. Putting related kernels into
+ * a single program saves the per-program compilation overhead.
+ */
+inline program build_program(const command_queue &queue,
+        const std::string &src, const std::string &options = "")
+{
+    return precompile::detail::build(queue, src, options);
+}
+
+/// \cond INTERNAL
+
+/// An abstraction over JIT compute kernel.
+/**
+ * Workgroups of the launch grid are distributed between OpenMP threads.
+ * Work-items inside a workgroup are executed sequentially by the owning
+ * thread, so barriers are only meaningful for single work-item workgroups.
+ * This is what the library algorithms use on CPU devices; config() refuses
+ * larger workgroups for kernels that synchronize with barriers.
+ */
+class kernel {
+    public:
+        kernel() : K(0), barriers(false), smem(0) {}
+
+        /// Constructor. Builds the kernel from source.
+        kernel(const command_queue &queue,
+               const std::string &src,
+               const std::string &name,
+               size_t smem_per_thread = 0,
+               const std::string &options = ""
+               )
+            : lib(precompile::detail::build(queue, src, options)), barriers(false), smem(0)
+        {
+            load(name);
+
+            config(queue,
+                    [smem_per_thread](size_t wgs){ return wgs * smem_per_thread; });
+        }
+
+        /// Constructor. Builds the kernel from source.
+        kernel(const command_queue &queue,
+               const std::string &src, const std::string &name,
+               std::function<size_t(size_t)> smem,
+               const std::string &options = ""
+               )
+            : lib(precompile::detail::build(queue, src, options)), barriers(false), smem(0)
+        {
+            load(name);
+            config(queue, smem);
+        }
+
+        /// Constructor. Extracts the kernel from compiled program.
+        kernel(const command_queue &queue,
+               const program &P,
+               const std::string &name,
+               size_t smem_per_thread = 0
+               )
+            : lib(P), barriers(false), smem(0)
+        {
+            load(name);
+
+            config(queue,
+                    [smem_per_thread](size_t wgs){ return wgs * smem_per_thread; });
+        }
+
+        /// Constructor. Extracts the kernel from compiled program.
+        kernel(const command_queue &queue,
+               const program &P, const std::string &name,
+               std::function<size_t(size_t)> smem
+               )
+            : lib(P), barriers(false), smem(0)
+        {
+            load(name);
+            config(queue, smem);
+        }
+
+        /// Adds an argument to the kernel.
+        template <class Arg>
+        void push_arg(const Arg &arg) {
+            char *c = (char*)&arg;
+            prm_pos.push_back(stack.size());
+            stack.insert(stack.end(), c, c + sizeof(arg));
+        }
+
+        /// Adds an argument to the kernel.
+        template <typename T>
+        void push_arg(const device_vector<T> &arg) {
+            push_arg(arg.raw());
+        }
+
+        /// Adds local memory to the kernel.
+        template <class F>
+        void set_smem(F &&f) {
+            smem = f(workgroup_size());
+        }
+
+        /// Enqueue the kernel to the specified command queue.
+        /**
+         * The launch is synchronous: the kernel is complete on return.
+         */
+        void operator()(const command_queue &q) {
+            if (observer()) (*observer())(*this, q);
+
+            trace::detail::command cmd(q);
+            launch(q);
+            cmd.done(name, "kernel", g_size.x * g_size.y * g_size.z * workgroup_size());
+
+            stack.clear();
+            prm_pos.clear();
+        }
+
+        /// \cond INTERNAL
+        // Launches the kernel keeping the arguments bound.
+        void launch(const command_queue&) {
+            prm_addr.clear();
+            for(auto p = prm_pos.begin(); p != prm_pos.end(); ++p)
+                prm_addr.push_back(stack.data() + *p);
+
+            const size_t ngroups[] = {g_size.x, g_size.y, g_size.z};
+            const size_t lsize[]   = {w_size.x, w_size.y, w_size.z};
+            const size_t total     = g_size.x * g_size.y * g_size.z;
+
+#pragma omp parallel
+            {
+#ifdef _OPENMP
+                size_t nt  = omp_get_num_threads();
+                size_t tid = omp_get_thread_num();
+#else
+                size_t nt  = 1;
+                size_t tid = 0;
+#endif
+                size_t chunk = (total + nt - 1) / nt;
+                size_t beg   = std::min(total, tid * chunk);
+                size_t end   = std::min(total, beg + chunk);
+
+                if (beg < end) {
+                    std::vector<char> local_mem(smem);
+                    K(prm_addr.data(), ngroups, lsize, beg, end, local_mem.data());
+                }
+            }
+        }
+
+        // Position of the next argument.
+        unsigned next_arg() const {
+            return static_cast<unsigned>(prm_pos.size());
+        }
+
+        // Replaces value of an argument that was already added.
+        template <class Arg>
+        void set_arg(unsigned pos, const Arg &arg) {
+            const char *c = (const char*)&arg;
+            std::copy(c, c + sizeof(arg), stack.begin() + prm_pos[pos]);
+        }
+
+        // Returns a copy of the kernel with its own argument bindings.
+        kernel clone() const {
+            return *this;
+        }
+
+        // Receives copies of the launched kernels while a command graph is
+        // being captured.
+        typedef std::function<void(const kernel&, const command_queue&)> observer_type;
+
+        static observer_type*& observer() {
+            static observer_type *o = 0;
+            return o;
+        }
+        /// \endcond
+
+#ifndef BOOST_NO_VARIADIC_TEMPLATES
+        /// Enqueue the kernel to the specified command queue with the given arguments
+        template <class Arg1, class... OtherArgs>
+        void operator()(const command_queue &q, Arg1 &&arg1, OtherArgs&&... other_args) {
+            push_arg(std::forward<Arg1>(arg1));
+
+            (*this)(q, std::forward<OtherArgs>(other_args)...);
+        }
+#endif
+
+        /// Workgroup size.
+        size_t workgroup_size() const {
+            return w_size.x * w_size.y * w_size.z;
+        }
+
+        /// Standard number of workgroups to launch on a device.
+        static inline size_t num_workgroups(const command_queue &q) {
+            return 8 * get_queue_info(q).compute_units;
+        }
+
+        /// The maximum number of threads per block.
+        size_t max_threads_per_block(const command_queue &q) const {
+            return q.device().max_threads_per_block();
+        }
+
+        /// The size in bytes of shared memory per block available for this kernel.
+        size_t max_shared_memory_per_block(const command_queue &q) const {
+            return q.device().max_shared_memory_per_block();
+        }
+
+        /// Select best launch configuration for the given shared memory requirements.
+        /**
+         * Each workgroup consists of a single work-item.
+         */
+        void config(const command_queue &q, std::function<size_t(size_t)> smem) {
+            (void)smem;
+            config(num_workgroups(q), 1);
+        }
+
+        /// Set launch configuration.
+        void config(ndrange blocks, ndrange threads) {
+            if (barriers && threads.x * threads.y * threads.z > 1)
+                throw error("JIT kernels with barriers only support "
+                        "single work-item workgroups", __FILE__, __LINE__);
+
+            g_size = blocks;
+            w_size = threads;
+        }
+
+        /// Set launch configuration.
+        void config(size_t blocks, size_t threads) {
+            config(ndrange(blocks), ndrange(threads));
+        }
+
+        size_t preferred_work_group_size_multiple(const backend::command_queue&) const {
+            return 1;
+        }
+    private:
+        typedef void (*launcher)(void**, const size_t*, const size_t*,
+                size_t, size_t, char*);
+
+        program  lib;
+        launcher K;
+        std::string name;
+        bool     barriers;
+
+        ndrange  w_size;
+        ndrange  g_size;
+        size_t   smem;
+
+        std::vector<char>   stack;
+        std::vector<size_t> prm_pos;
+        std::vector<void*>  prm_addr;
+
+        void load(const std::string &kernel_name) {
+            name = kernel_name;
+
+            void *f = dlsym(lib.get(), name.c_str());
+            if (!f) throw error(dlerror(), __FILE__, __LINE__);
+            K = reinterpret_cast<launcher>(f);
+
+            barriers = dlsym(lib.get(), (name + "_barriers").c_str()) != 0;
+        }
+};
+
+/// \endcond
+
+} // namespace jit
+} // namespace backend
+} // namespace vex
+
+#endif
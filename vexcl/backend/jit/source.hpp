@@ -0,0 +1,590 @@
+#ifndef VEXCL_BACKEND_JIT_SOURCE_HPP
+#define VEXCL_BACKEND_JIT_SOURCE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/source.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Helper class for C++ source code generation in the JIT backend.
+ */
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <cassert>
+#include <cctype>
+
+#include <vexcl/backend/common.hpp>
+#include <vexcl/types.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+
+template <class T> struct global_ptr {};
+template <class T> struct shared_ptr {};
+template <class T> struct regstr_ptr {};
+template <class T> struct restrict_ptr {};
+
+template <class T> struct remove_ptr;
+
+template <class T> struct remove_ptr< global_ptr<T> > { typedef T type; };
+template <class T> struct remove_ptr< shared_ptr<T> > { typedef T type; };
+template <class T> struct remove_ptr< regstr_ptr<T> > { typedef T type; };
+template <class T> struct remove_ptr< restrict_ptr<T> > { typedef T type; };
+
+template <class T>
+struct type_name_impl <global_ptr<T> > {
+    static std::string get() {
+        std::ostringstream s;
+        s << type_name<T>() << " *";
+        return s.str();
+    }
+};
+
+template <class T>
+struct type_name_impl < global_ptr<const T> > {
+    static std::string get() {
+        std::ostringstream s;
+        s << "const " << type_name<T>() << " *";
+        return s.str();
+    }
+};
+
+template <class T>
+struct type_name_impl <shared_ptr<T> > : type_name_impl< global_ptr<T> > { };
+
+template <class T>
+struct type_name_impl <shared_ptr<const T> > : type_name_impl< global_ptr<const T> > { };
+
+template <class T>
+struct type_name_impl <regstr_ptr<T> > : type_name_impl< global_ptr<T> > { };
+
+template <class T>
+struct type_name_impl <regstr_ptr<const T> > : type_name_impl< global_ptr<const T> > { };
+
+template <class T>
+struct type_name_impl <restrict_ptr<T> > {
+    static std::string get() {
+        std::ostringstream s;
+        s << type_name< global_ptr<T> >() << " __restrict__";
+        return s.str();
+    }
+};
+
+template<typename T>
+struct type_name_impl<T*>
+{
+    static std::string get() {
+        return type_name_impl< global_ptr<T> >::get();
+    }
+};
+
+namespace backend {
+namespace jit {
+
+/// Returns standard JIT program header.
+/**
+ * Provides OpenCL-like vector types and builtin functions that are used by
+ * the generated kernels, the work-item state, and anything provided by the
+ * user with help of push_program_header().
+ */
+inline std::string standard_kernel_header(const command_queue &q) {
+    static const std::string header =
+        "#include <math.h>\n"
+        "#include <stdint.h>\n"
+        "#include <stdlib.h>\n"
+        "#include <string.h>\n"
+        "#include <type_traits>\n"
+        "\n"
+        "typedef unsigned char  uchar;\n"
+        "typedef unsigned short ushort;\n"
+        "typedef unsigned int   uint;\n"
+        "typedef unsigned long  ulong;\n"
+        "\n"
+        "template <class T> struct vexcl_jit_identity { typedef T type; };\n"
+        "\n"
+        "template <class T, int N> struct vexcl_jit_vec { T s[N]; };\n"
+        "template <class T> struct vexcl_jit_vec<T, 2> {\n"
+        "  union { T s[2]; struct { T x, y; }; };\n"
+        "};\n"
+        "template <class T> struct vexcl_jit_vec<T, 4> {\n"
+        "  union { T s[4]; struct { T x, y, z, w; }; };\n"
+        "};\n"
+        "\n"
+        "#define VEXCL_JIT_VEC_OP(op) \\\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N>& \\\n"
+        "operator op##=(vexcl_jit_vec<T, N> &a, const vexcl_jit_vec<T, N> &b) { \\\n"
+        "  for(int i = 0; i < N; ++i) a.s[i] op##= b.s[i]; return a; \\\n"
+        "} \\\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N>& \\\n"
+        "operator op##=(vexcl_jit_vec<T, N> &a, typename vexcl_jit_identity<T>::type b) { \\\n"
+        "  for(int i = 0; i < N; ++i) a.s[i] op##= b; return a; \\\n"
+        "} \\\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N> \\\n"
+        "operator op(vexcl_jit_vec<T, N> a, const vexcl_jit_vec<T, N> &b) { return a op##= b; } \\\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N> \\\n"
+        "operator op(vexcl_jit_vec<T, N> a, typename vexcl_jit_identity<T>::type b) { return a op##= b; } \\\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N> \\\n"
+        "operator op(typename vexcl_jit_identity<T>::type a, const vexcl_jit_vec<T, N> &b) { \\\n"
+        "  vexcl_jit_vec<T, N> r; for(int i = 0; i < N; ++i) r.s[i] = a op b.s[i]; return r; \\\n"
+        "}\n"
+        "VEXCL_JIT_VEC_OP(+)\n"
+        "VEXCL_JIT_VEC_OP(-)\n"
+        "VEXCL_JIT_VEC_OP(*)\n"
+        "VEXCL_JIT_VEC_OP(/)\n"
+        "#undef VEXCL_JIT_VEC_OP\n"
+        "\n"
+        "template <class T, int N> inline vexcl_jit_vec<T, N>\n"
+        "operator-(const vexcl_jit_vec<T, N> &a) {\n"
+        "  vexcl_jit_vec<T, N> r; for(int i = 0; i < N; ++i) r.s[i] = -a.s[i]; return r;\n"
+        "}\n"
+        "\n"
+        "#define VEXCL_JIT_VEC_TYPES(T) \\\n"
+        "  typedef vexcl_jit_vec<T,  2> T##2; \\\n"
+        "  typedef vexcl_jit_vec<T,  4> T##4; \\\n"
+        "  typedef vexcl_jit_vec<T,  8> T##8; \\\n"
+        "  typedef vexcl_jit_vec<T, 16> T##16;\n"
+        "VEXCL_JIT_VEC_TYPES(char)\n"
+        "VEXCL_JIT_VEC_TYPES(uchar)\n"
+        "VEXCL_JIT_VEC_TYPES(short)\n"
+        "VEXCL_JIT_VEC_TYPES(ushort)\n"
+        "VEXCL_JIT_VEC_TYPES(int)\n"
+        "VEXCL_JIT_VEC_TYPES(uint)\n"
+        "VEXCL_JIT_VEC_TYPES(long)\n"
+        "VEXCL_JIT_VEC_TYPES(ulong)\n"
+        "VEXCL_JIT_VEC_TYPES(float)\n"
+        "VEXCL_JIT_VEC_TYPES(double)\n"
+        "#undef VEXCL_JIT_VEC_TYPES\n"
+        "\n"
+        "#define VEXCL_JIT_VLOAD(N) \\\n"
+        "template <class T> inline vexcl_jit_vec<typename std::remove_const<T>::type, N> \\\n"
+        "vload##N(size_t o, T *p) { \\\n"
+        "  vexcl_jit_vec<typename std::remove_const<T>::type, N> v; \\\n"
+        "  for(int i = 0; i < N; ++i) v.s[i] = p[o * N + i]; return v; \\\n"
+        "} \\\n"
+        "template <class T> inline void \\\n"
+        "vstore##N(const vexcl_jit_vec<T, N> &v, size_t o, T *p) { \\\n"
+        "  for(int i = 0; i < N; ++i) p[o * N + i] = v.s[i]; \\\n"
+        "}\n"
+        "VEXCL_JIT_VLOAD(2)\n"
+        "VEXCL_JIT_VLOAD(4)\n"
+        "VEXCL_JIT_VLOAD(8)\n"
+        "VEXCL_JIT_VLOAD(16)\n"
+        "#undef VEXCL_JIT_VLOAD\n"
+        "\n"
+        "template <class A, class B>\n"
+        "inline typename std::common_type<A, B>::type min(A a, B b) { return b < a ? b : a; }\n"
+        "template <class A, class B>\n"
+        "inline typename std::common_type<A, B>::type max(A a, B b) { return a < b ? b : a; }\n"
+        "template <class T, class A, class B>\n"
+        "inline T clamp(T x, A lo, B hi) { return x < lo ? lo : (hi < x ? hi : x); }\n"
+        "template <class T> inline T mad(T a, T b, T c) { return a * b + c; }\n"
+        "template <class T> inline T rsqrt(T x) { return 1 / sqrt(x); }\n"
+        "template <class T> inline T sinpi(T x) { return sin(static_cast<T>(M_PI) * x); }\n"
+        "template <class T> inline T cospi(T x) { return cos(static_cast<T>(M_PI) * x); }\n"
+        "template <class T> inline T tanpi(T x) { return tan(static_cast<T>(M_PI) * x); }\n"
+        "template <class T> inline T degrees(T x) { return x * static_cast<T>(180 / M_PI); }\n"
+        "template <class T> inline T radians(T x) { return x * static_cast<T>(M_PI / 180); }\n"
+        "template <class T> inline T pown(T x, int n) { return pow(x, static_cast<T>(n)); }\n"
+        "template <class T> inline T powr(T x, T y) { return pow(x, y); }\n"
+        "template <class T> inline T rootn(T x, int n) { return pow(x, 1 / static_cast<T>(n)); }\n"
+        "template <class T> inline T sign(T x) { return x > 0 ? 1 : (x < 0 ? -1 : 0); }\n"
+        "template <class T> inline T mix(T x, T y, T a) { return x + (y - x) * a; }\n"
+        "template <class T> inline T step(T e, T x) { return x < e ? 0 : 1; }\n"
+        "template <class T, class C> inline T select(T a, T b, C c) { return c ? b : a; }\n"
+        "inline float  sincos(float  x, float  *c) { *c = cos(x); return sin(x); }\n"
+        "inline double sincos(double x, double *c) { *c = cos(x); return sin(x); }\n"
+        "template <class T> inline int popcount(T x) { return __builtin_popcountll(x); }\n"
+        "template <class A, class B>\n"
+        "inline typename std::common_type<A, B>::type mul_hi(A a, B b) {\n"
+        "  typedef typename std::common_type<A, B>::type T;\n"
+        "  typedef typename std::conditional<sizeof(T) == 8,\n"
+        "    typename std::conditional<std::is_signed<T>::value, __int128, unsigned __int128>::type,\n"
+        "    typename std::conditional<std::is_signed<T>::value, long, ulong>::type\n"
+        "    >::type W;\n"
+        "  return static_cast<T>((static_cast<W>(a) * static_cast<W>(b)) >> (8 * sizeof(T)));\n"
+        "}\n"
+        "template <class T, class B> inline T rotate(T x, B b) {\n"
+        "  const unsigned n = 8 * sizeof(T); b %= n;\n"
+        "  return b ? static_cast<T>((x << b) | (x >> (n - b))) : x;\n"
+        "}\n"
+        "\n"
+        "struct vexcl_jit_state_t {\n"
+        "  size_t group_id[3], num_groups[3], local_id[3], local_size[3];\n"
+        "  char *smem;\n"
+        "};\n"
+        "static thread_local vexcl_jit_state_t vexcl_jit_state;\n"
+        "\n"
+        "inline void vexcl_jit_barrier() {}\n"
+        "\n"
+        "template <class T> inline T vexcl_jit_arg(void *p) {\n"
+        "  typename std::remove_const<T>::type v; memcpy(&v, p, sizeof(T)); return v;\n"
+        "}\n"
+        "\n"
+        "template <class F>\n"
+        "inline void vexcl_jit_launch(const size_t *ngroups, const size_t *lsize,\n"
+        "    size_t begin, size_t end, char *smem, F &&f)\n"
+        "{\n"
+        "  vexcl_jit_state_t &s = vexcl_jit_state;\n"
+        "  for(int d = 0; d < 3; ++d) {\n"
+        "    s.num_groups[d] = ngroups[d];\n"
+        "    s.local_size[d] = lsize[d];\n"
+        "  }\n"
+        "  s.smem = smem;\n"
+        "  for(size_t g = begin; g < end; ++g) {\n"
+        "    s.group_id[0] = g % ngroups[0];\n"
+        "    s.group_id[1] = (g / ngroups[0]) % ngroups[1];\n"
+        "    s.group_id[2] = g / (ngroups[0] * ngroups[1]);\n"
+        "    for(size_t k = 0; k < lsize[2]; ++k)\n"
+        "      for(size_t j = 0; j < lsize[1]; ++j)\n"
+        "        for(size_t i = 0; i < lsize[0]; ++i) {\n"
+        "          s.local_id[0] = i;\n"
+        "          s.local_id[1] = j;\n"
+        "          s.local_id[2] = k;\n"
+        "          f();\n"
+        "        }\n"
+        "  }\n"
+        "}\n"
+        "\n";
+
+    return header + get_program_header(q);
+}
+
+/// Helper class for C++ source code generation in the JIT backend.
+/**
+ * Each kernel is generated as a static function. A C-linkage launcher that
+ * unpacks the kernel arguments and iterates over the given range of
+ * workgroups is appended to the source for each kernel, so that the
+ * compiled kernel may be located with dlsym(). Kernels that use barriers
+ * (directly or through the functions they call) are marked with an exported
+ * <kernel>_barriers symbol.
+ */
+class source_generator {
+    private:
+        // A function or a kernel, along with the offset of its declaration
+        // in the source.
+        struct unit {
+            std::string name;
+            size_t      begin;
+            bool        barriers;
+        };
+
+        unsigned           indent;
+        bool               first_prm;
+        bool               stray_barriers;
+        std::ostringstream src;
+
+        std::vector<std::string> kernels;
+        std::vector<unit>        units;
+
+    public:
+        source_generator() : indent(0), first_prm(true), stray_barriers(false) { }
+
+        source_generator(const command_queue &queue)
+            : indent(0), first_prm(true), stray_barriers(false)
+        {
+            src << standard_kernel_header(queue);
+        }
+
+        source_generator& new_line() {
+            src << "\n" << std::string(2 * indent, ' ');
+            return *this;
+        }
+
+        source_generator& open(const char *bracket) {
+            new_line() << bracket;
+            ++indent;
+            return *this;
+        }
+
+        source_generator& close(const char *bracket) {
+            assert(indent > 0);
+            --indent;
+            new_line() << bracket;
+            return *this;
+        }
+
+        template <class Return>
+        source_generator& function(const std::string &name) {
+            first_prm = true;
+            new_line();
+            start_unit(name);
+            src << "static inline " << type_name<Return>() << " " << name;
+            return *this;
+        }
+
+        source_generator& kernel(const std::string &name) {
+            first_prm = true;
+            kernels.push_back(name);
+            new_line();
+            start_unit(name + "_impl");
+            src << "static void " << name << "_impl";
+            return *this;
+        }
+
+        template <class Prm>
+        source_generator& parameter(const std::string &name) {
+            prm_separator().new_line() <<
+                type_name<typename std::decay<Prm>::type>() << " " << name;
+
+            return *this;
+        }
+
+        template <class Prm>
+        source_generator& smem_parameter(const std::string &name = "smem") {
+            (void)name;
+            return *this;
+        }
+
+        template <class Prm>
+        source_generator& smem_declaration(const std::string &name = "smem") {
+            new_line() << type_name<Prm>() << " *" << name
+                << " = reinterpret_cast<" << type_name<Prm>() << "*>(vexcl_jit_state.smem);";
+            return *this;
+        }
+
+        source_generator& smem_static_var(const std::string &type, const std::string &name) {
+            new_line() << type <<  " " << name << ";";
+            return *this;
+        }
+
+        source_generator& grid_stride_loop(
+                const std::string &idx = "idx", const std::string &bnd = "n"
+                )
+        {
+            new_line() << type_name<size_t>() << " chunk_size  = (" << bnd
+                       << " + " << global_size(0) << " - 1) / " << global_size(0) << ";";
+            new_line() << type_name<size_t>() << " chunk_start = " << global_id(0) << " * chunk_size;";
+            new_line() << type_name<size_t>() << " chunk_end   = chunk_start + chunk_size;";
+            new_line() << "if (" << bnd << " < chunk_end) chunk_end = " << bnd << ";";
+            new_line() << "for(" << type_name<size_t>() << " "<< idx << " = chunk_start; "
+                       << idx << " < chunk_end; ++" << idx << ")";
+            return *this;
+        }
+
+        source_generator& barrier(bool global = false) {
+            (void)global;
+            if (units.empty())
+                stray_barriers = true;
+            else
+                units.back().barriers = true;
+            src << "vexcl_jit_barrier();";
+            return *this;
+        }
+
+        std::string global_id(int d) const {
+            std::ostringstream s;
+            s << "(vexcl_jit_state.group_id[" << d << "] * vexcl_jit_state.local_size[" << d
+              << "] + vexcl_jit_state.local_id[" << d << "])";
+            return s.str();
+        }
+
+        std::string global_size(int d) const {
+            std::ostringstream s;
+            s << "(vexcl_jit_state.num_groups[" << d << "] * vexcl_jit_state.local_size[" << d << "])";
+            return s.str();
+        }
+
+        std::string local_id(int d) const {
+            std::ostringstream s;
+            s << "vexcl_jit_state.local_id[" << d << "]";
+            return s.str();
+        }
+
+        std::string local_size(int d) const {
+            std::ostringstream s;
+            s << "vexcl_jit_state.local_size[" << d << "]";
+            return s.str();
+        }
+
+        std::string group_id(int d) const {
+            std::ostringstream s;
+            s << "vexcl_jit_state.group_id[" << d << "]";
+            return s.str();
+        }
+
+        std::string str() const {
+            std::string body = src.str();
+
+            std::vector<bool> barriers = uses_barriers(body);
+
+            std::ostringstream s;
+            s << body << "\n";
+
+            for(auto k = kernels.begin(); k != kernels.end(); ++k) {
+                std::vector<std::string> prm = kernel_parameter_types(body, *k);
+
+                s << "\nextern \"C\" void " << *k << "(\n"
+                     "  void **vexcl_jit_prm, const size_t *vexcl_jit_ngroups,\n"
+                     "  const size_t *vexcl_jit_lsize, size_t vexcl_jit_begin,\n"
+                     "  size_t vexcl_jit_end, char *vexcl_jit_smem)\n"
+                     "{\n";
+
+                for(size_t i = 0; i < prm.size(); ++i)
+                    s << "  " << prm[i] << " p" << i << " = vexcl_jit_arg<"
+                      << prm[i] << ">(vexcl_jit_prm[" << i << "]);\n";
+
+                s << "  vexcl_jit_launch(vexcl_jit_ngroups, vexcl_jit_lsize,\n"
+                     "    vexcl_jit_begin, vexcl_jit_end, vexcl_jit_smem,\n"
+                     "    [&]() { " << *k << "_impl(";
+
+                for(size_t i = 0; i < prm.size(); ++i)
+                    s << (i ? ", " : "") << "p" << i;
+
+                s << "); });\n"
+                     "}\n";
+
+                // Work-items of a workgroup run one after another, so the
+                // launcher has to know whether the kernel relies on them
+                // meeting at a barrier.
+                if (barriers[k - kernels.begin()])
+                    s << "extern \"C\" const int " << *k << "_barriers = 1;\n";
+            }
+
+            return s.str();
+        }
+    private:
+        template <class T>
+        friend inline
+        source_generator& operator<<(source_generator &src, T &&t) {
+            src.src << t;
+            return src;
+        }
+
+        source_generator& prm_separator() {
+            if (first_prm)
+                first_prm = false;
+            else
+                src << ",";
+
+            return *this;
+        }
+
+        // Extracts parameter types from the kernel signature. Parameters are
+        // not always declared with parameter(), so the generated source is
+        // the only reliable record of the signature.
+        void start_unit(const std::string &name) {
+            unit u = {name, static_cast<size_t>(src.tellp()), false};
+            units.push_back(u);
+        }
+
+        // Checks if the body of the unit calls the named function.
+        static bool calls(const std::string &body, size_t begin, size_t end,
+                const std::string &name)
+        {
+            std::string call = name + "(";
+            for(size_t pos = body.find(call, begin); pos < end; pos = body.find(call, pos + 1)) {
+                char c = pos ? body[pos - 1] : ' ';
+                if (!isalnum(static_cast<unsigned char>(c)) && c != '_') return true;
+            }
+            return false;
+        }
+
+        // Finds out which kernels use barriers, either directly, or through
+        // the functions they call.
+        std::vector<bool> uses_barriers(const std::string &body) const {
+            std::vector<bool> b(units.size());
+            for(size_t i = 0; i < units.size(); ++i) b[i] = units[i].barriers;
+
+            for(bool changed = true; changed; ) {
+                changed = false;
+                for(size_t i = 0; i < units.size(); ++i) {
+                    if (b[i]) continue;
+
+                    size_t end = i + 1 < units.size() ? units[i + 1].begin : body.size();
+                    for(size_t j = 0; j < units.size(); ++j) {
+                        if (j != i && b[j] && calls(body, units[i].begin, end, units[j].name)) {
+                            b[i] = changed = true;
+                            break;
+                        }
+                    }
+                }
+            }
+
+            // A barrier outside of any function marks every kernel.
+            std::vector<bool> k(kernels.size(), stray_barriers);
+            for(size_t i = 0; i < kernels.size(); ++i)
+                for(size_t j = 0; j < units.size(); ++j)
+                    if (units[j].name == kernels[i] + "_impl" && b[j]) k[i] = true;
+
+            return k;
+        }
+
+        static std::vector<std::string> kernel_parameter_types(
+                const std::string &body, const std::string &name)
+        {
+            std::vector<std::string> types;
+
+            size_t pos = body.find("static void " + name + "_impl");
+            assert(pos != std::string::npos);
+
+            size_t beg = body.find('(', pos) + 1, end = beg;
+            for(int depth = 1; depth; ++end) {
+                if (body[end] == '(') ++depth;
+                if (body[end] == ')') --depth;
+            }
+
+            std::string prm;
+            int depth = 0;
+            for(size_t i = beg; i < end; ++i) {
+                char c = body[i];
+
+                if (c == '(' || c == '<') ++depth;
+                if (c == ')' || c == '>') --depth;
+
+                if ((c == ',' && depth == 0) || depth < 0) {
+                    // Strip the parameter name and surrounding whitespace.
+                    size_t last = prm.find_last_not_of(" \t\n");
+                    if (last != std::string::npos) {
+                        size_t name_beg = prm.find_last_not_of(
+                                "abcdefghijklmnopqrstuvwxyz"
+                                "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                "0123456789_", last);
+                        size_t first = prm.find_first_not_of(" \t\n");
+                        types.push_back(prm.substr(first, name_beg + 1 - first));
+                    }
+                    prm.clear();
+                } else {
+                    prm += c;
+                }
+            }
+
+            return types;
+        }
+};
+
+} // namespace jit
+} // namespace backend
+
+/// \endcond
+
+} // namespace vex
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef VEXCL_BACKEND_JIT_TYPES_HPP
+#define VEXCL_BACKEND_JIT_TYPES_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/jit/types.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Host definitions of OpenCL scalar and vector types for the JIT backend.
+ *
+ * The JIT backend does not depend on any OpenCL headers, so it provides the
+ * cl_* types itself. The layout of the types matches the one used by the
+ * generated kernels.
+ */
+
+#include <cstdint>
+
+typedef int8_t   cl_char;
+typedef uint8_t  cl_uchar;
+typedef int16_t  cl_short;
+typedef uint16_t cl_ushort;
+typedef int32_t  cl_int;
+typedef uint32_t cl_uint;
+typedef int64_t  cl_long;
+typedef uint64_t cl_ulong;
+typedef float    cl_float;
+typedef double   cl_double;
+
+#define VEXCL_JIT_VEC_TYPE(name, len)                                          \
+  typedef struct { cl_##name s[len]; } cl_##name##len;
+
+#define VEXCL_JIT_TYPES(name)                                                  \
+  VEXCL_JIT_VEC_TYPE(name, 2)                                                  \
+  VEXCL_JIT_VEC_TYPE(name, 4)                                                  \
+  typedef cl_##name##4 cl_##name##3;                                           \
+  VEXCL_JIT_VEC_TYPE(name, 8)                                                  \
+  VEXCL_JIT_VEC_TYPE(name, 16)
+
+VEXCL_JIT_TYPES(char)
+VEXCL_JIT_TYPES(uchar)
+VEXCL_JIT_TYPES(short)
+VEXCL_JIT_TYPES(ushort)
+VEXCL_JIT_TYPES(int)
+VEXCL_JIT_TYPES(uint)
+VEXCL_JIT_TYPES(long)
+VEXCL_JIT_TYPES(ulong)
+VEXCL_JIT_TYPES(float)
+VEXCL_JIT_TYPES(double)
+
+#undef VEXCL_JIT_TYPES
+#undef VEXCL_JIT_VEC_TYPE
+
+#endif
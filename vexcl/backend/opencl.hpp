@@ -42,6 +42,7 @@ THE SOFTWARE.
 
 #include <vexcl/backend/opencl/error.hpp>
 #include <vexcl/backend/opencl/context.hpp>
+#include <vexcl/backend/opencl/event.hpp>
 #include <vexcl/backend/opencl/filter.hpp>
 #include <vexcl/backend/opencl/device_vector.hpp>
 #include <vexcl/backend/opencl/source.hpp>
@@ -32,7 +32,15 @@ THE SOFTWARE.
  */
 
 #include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include <boost/optional.hpp>
+
 #include <vexcl/backend/common.hpp>
+#include <vexcl/backend/binary_cache.hpp>
 
 #ifndef __CL_ENABLE_EXCEPTIONS
 #  define __CL_ENABLE_EXCEPTIONS
@@ -44,54 +52,89 @@ namespace backend {
 namespace opencl {
 
 /// Saves program binaries for future reuse.
+/**
+ * Binaries for all devices in the context are stored together with the
+ * program source, which is used to validate the cache key.
+ */
 inline void save_program_binaries(
         const std::string &hash, const cl::Program &program, const std::string &source
         )
 {
-    std::ofstream bfile(program_binaries_path(hash, true) + "kernel", std::ios::binary);
-    if (!bfile) return;
-
     std::vector<size_t> sizes    = program.getInfo<CL_PROGRAM_BINARY_SIZES>();
     std::vector<char*>  binaries = program.getInfo<CL_PROGRAM_BINARIES>();
 
-    assert(sizes.size() == 1);
+    std::ostringstream buf;
+
+    size_t n = sizes.size();
+    buf.write((char*)&n, sizeof(size_t));
+    buf.write((char*)sizes.data(), n * sizeof(size_t));
 
-    bfile.write((char*)&sizes[0], sizeof(size_t));
-    bfile.write(binaries[0], sizes[0]);
-    delete[] binaries[0];
+    for(size_t i = 0; i < n; ++i) {
+        buf.write(binaries[i], sizes[i]);
+        delete[] binaries[i];
+    }
 
-    bfile << "\n" << source << "\n";
+    binary_cache::save_source(hash, source);
+    binary_cache::save(hash, "kernel.bin", buf.str());
 }
 
-/// Tries to read program binaries from file cache.
-inline boost::optional<cl::Program> load_program_binaries(
-        const std::string &hash, const cl::Context &context,
-        const std::vector<cl::Device> &device
+/// \cond INTERNAL
+// Splits cached data into per-device binaries. Returns false if the data is
+// truncated or was produced for a different number of devices.
+inline bool parse_program_binaries(
+        const std::string &data, size_t ndev, cl::Program::Binaries &binaries
         )
 {
-    std::ifstream bfile(program_binaries_path(hash) + "kernel", std::ios::binary);
-    if (!bfile) return boost::optional<cl::Program>();
+    const char *ptr = data.data();
+    const char *end = ptr + data.size();
 
     size_t n;
-    std::vector<char> buf;
+    if (static_cast<size_t>(end - ptr) < sizeof(size_t)) return false;
+    std::memcpy(&n, ptr, sizeof(size_t));
+    ptr += sizeof(size_t);
 
-    bfile.read((char*)&n, sizeof(size_t));
-    buf.resize(n);
-    bfile.read(buf.data(), n);
+    if (n != ndev || static_cast<size_t>(end - ptr) < n * sizeof(size_t))
+        return false;
 
-    cl::Program program(context, device, cl::Program::Binaries(
-                1, std::make_pair(static_cast<const void*>(buf.data()), n)));
+    std::vector<size_t> sizes(n);
+    std::memcpy(sizes.data(), ptr, n * sizeof(size_t));
+    ptr += n * sizeof(size_t);
 
-    try {
-        program.build(device, "");
-    } catch(const cl::Error&) {
-        std::cerr << "Loading binaries failed:" << std::endl
-            << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device[0])
-            << std::endl;
-        return boost::optional<cl::Program>();
+    for(size_t i = 0; i < n; ++i) {
+        if (static_cast<size_t>(end - ptr) < sizes[i]) return false;
+        binaries.push_back(std::make_pair(static_cast<const void*>(ptr), sizes[i]));
+        ptr += sizes[i];
+    }
+
+    return true;
+}
+/// \endcond
+
+/// Tries to read program binaries from file cache.
+/**
+ * Stale or corrupted cache entries are removed.
+ */
+inline boost::optional<cl::Program> load_program_binaries(
+        const std::string &hash, const cl::Context &context,
+        const std::vector<cl::Device> &device
+        )
+{
+    boost::optional<std::string> data = binary_cache::load(hash, "kernel.bin");
+    if (!data) return boost::optional<cl::Program>();
+
+    cl::Program::Binaries binaries;
+    if (parse_program_binaries(*data, device.size(), binaries)) {
+        try {
+            cl::Program program(context, device, binaries);
+            program.build(device, "");
+            return boost::optional<cl::Program>(program);
+        } catch(const cl::Error&) {
+            // The binaries were probably produced by an older driver.
+        }
     }
 
-    return boost::optional<cl::Program>(program);
+    binary_cache::remove(hash);
+    return boost::optional<cl::Program>();
 }
 
 /// Create and build a program from source string.
@@ -143,7 +186,7 @@ inline cl::Program build_sources(
         << "\n// options:  " << compile_options
         << "\n" << source;
 
-    std::string hash = sha1( fullsrc.str() );
+    std::string hash = binary_cache::key( fullsrc.str() );
 
     // Try to get cached program binaries:
     try {
@@ -33,6 +33,8 @@ THE SOFTWARE.
 
 #include <vector>
 #include <iostream>
+#include <cstdlib>
+#include <type_traits>
 
 #ifndef __CL_ENABLE_EXCEPTIONS
 #  define __CL_ENABLE_EXCEPTIONS
@@ -111,6 +113,118 @@ inline bool is_cpu(const command_queue &q) {
 #endif
 }
 
+/// \cond INTERNAL
+/// Returns number of compute units on the device associated with the queue.
+inline size_t compute_units(const command_queue &q) {
+    cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
+    return d.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+}
+
+/// Returns maximum workgroup size along the first dimension for the device associated with the queue.
+inline size_t max_workgroup_size(const command_queue &q) {
+    cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
+    return d.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>()[0];
+}
+
+/// Checks if commands in the queue are executed in order.
+inline bool is_in_order(const command_queue &q) {
+    return !(q.getInfo<CL_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+}
+
+/// Returns version of the software that runs the device.
+inline std::string driver_version(const command_queue &q) {
+    cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
+    return d.getInfo<CL_DRIVER_VERSION>().c_str();
+}
+
+/// Returns preferred width of vector types with the given element type.
+template <class T>
+inline unsigned preferred_vector_width(const command_queue &q) {
+    cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
+    cl_uint w = 1;
+
+    if (std::is_floating_point<T>::value) {
+        switch (sizeof(T)) {
+            case 4: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT>();  break;
+            case 8: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE>(); break;
+        }
+    } else {
+        switch (sizeof(T)) {
+            case 1: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR>();   break;
+            case 2: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT>();  break;
+            case 4: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT>();    break;
+            case 8: w = d.getInfo<CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG>();   break;
+        }
+    }
+
+    // Zero means the type is not supported (e.g. double without cl_khr_fp64).
+    return w ? w : 1;
+}
+/// \endcond
+
+/// \cond INTERNAL
+inline bool& numa_fission_flag() {
+    static bool on = []() {
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+        const char *v = getenv("VEXCL_NUMA_FISSION");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+        return v && std::atoi(v) != 0;
+    }();
+    return on;
+}
+
+// Splits a CPU device into per-NUMA-node sub-devices when fission is
+// enabled and supported. Otherwise returns the device itself.
+inline std::vector<cl::Device> numa_nodes(const cl::Device &d) {
+    std::vector<cl::Device> sub;
+
+#ifdef CL_VERSION_1_2
+    if (numa_fission_flag() && (d.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)) {
+        try {
+            if (d.getInfo<CL_DEVICE_PARTITION_AFFINITY_DOMAIN>() & CL_DEVICE_AFFINITY_DOMAIN_NUMA) {
+                const cl_device_partition_property prop[] = {
+                    CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN,
+                    CL_DEVICE_AFFINITY_DOMAIN_NUMA,
+                    0
+                };
+
+                cl::Device(d).createSubDevices(prop, &sub);
+            }
+        } catch(const cl::Error&) {
+            sub.clear();
+        }
+    }
+#endif
+
+    // A single NUMA node is not worth a sub-device.
+    if (sub.size() < 2) return std::vector<cl::Device>(1, d);
+
+    return sub;
+}
+/// \endcond
+
+/// Enables or disables splitting of CPU devices into per-NUMA-node sub-devices.
+/**
+ * When enabled, queue_list() (and hence vex::Context constructor) creates a
+ * separate context and queue for each NUMA node of a CPU device that
+ * supports partitioning by affinity domain (OpenCL 1.2). Vectors and
+ * matrices partitioned between the queues then keep each partition in the
+ * memory local to the node that processes it. The default is taken from
+ * VEXCL_NUMA_FISSION environment variable.
+ * \code
+ * vex::backend::numa_fission(true);
+ * vex::Context ctx(vex::Filter::Type(CL_DEVICE_TYPE_CPU));
+ * \endcode
+ */
+inline void numa_fission(bool on) {
+    numa_fission_flag() = on;
+}
+
 /// Select devices by given criteria.
 /**
  * \param filter  Device filter functor. Functors may be combined with logical
@@ -180,13 +294,17 @@ queue_list(DevFilter &&filter, cl_command_queue_properties properties = 0) {
 
         if (device.empty()) continue;
 
-        for(auto d = device.begin(); d != device.end(); d++)
-            try {
-                context.push_back(cl::Context(std::vector<cl::Device>(1, *d)));
-                queue.push_back(command_queue(context.back(), *d, properties));
-            } catch(const cl::Error&) {
-                // Something bad happened. Better skip this device.
-            }
+        for(auto d = device.begin(); d != device.end(); d++) {
+            std::vector<cl::Device> node = numa_nodes(*d);
+
+            for(auto n = node.begin(); n != node.end(); n++)
+                try {
+                    context.push_back(cl::Context(std::vector<cl::Device>(1, *n)));
+                    queue.push_back(command_queue(context.back(), *n, properties));
+                } catch(const cl::Error&) {
+                    // Something bad happened. Better skip this device.
+                }
+        }
     }
 
     return std::make_pair(context, queue);
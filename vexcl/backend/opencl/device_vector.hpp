@@ -31,6 +31,12 @@ THE SOFTWARE.
  * \brief  OpenCL device vector.
  */
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+
 #ifndef __CL_ENABLE_EXCEPTIONS
 #  define __CL_ENABLE_EXCEPTIONS
 #endif
@@ -46,49 +52,245 @@ static const mem_flags MEM_READ_ONLY  = CL_MEM_READ_ONLY;
 static const mem_flags MEM_WRITE_ONLY = CL_MEM_WRITE_ONLY;
 static const mem_flags MEM_READ_WRITE = CL_MEM_READ_WRITE;
 
+/// Use the provided host memory as the buffer storage (zero-copy).
+static const mem_flags MEM_USE_HOST_PTR   = CL_MEM_USE_HOST_PTR;
+/// Allocate the buffer in host-accessible (pinned) memory.
+static const mem_flags MEM_ALLOC_HOST_PTR = CL_MEM_ALLOC_HOST_PTR;
+
+/// \cond INTERNAL
+namespace detail {
+
+// Pinned host memory used to stage large transfers to discrete devices.
+// The buffer is split in two halves, so that copying a chunk to or from the
+// user memory overlaps with the transfer of the other chunk.
+struct staging_buffer {
+    cl::CommandQueue queue;
+    size_t           chunk;
+    bool             enabled;
+    cl::Buffer       buffer;
+    char            *ptr;
+    cl::Event        done[2];
+    std::mutex       mx;
+
+    staging_buffer(const cl::CommandQueue &q)
+        : queue(q), chunk(4 << 20), enabled(false), ptr(0)
+    {
+        cl::Device dev = q.getInfo<CL_QUEUE_DEVICE>();
+
+        // Devices sharing memory with the host do not benefit from staging.
+        // Out-of-order queues would need to track the staging buffer usage.
+        enabled =
+            !dev.getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>() &&
+            !(q.getInfo<CL_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+
+        if (enabled) {
+            buffer = cl::Buffer(q.getInfo<CL_QUEUE_CONTEXT>(),
+                    CL_MEM_ALLOC_HOST_PTR | CL_MEM_READ_WRITE, 2 * chunk);
+            ptr = static_cast<char*>(q.enqueueMapBuffer(buffer, CL_TRUE,
+                        CL_MAP_READ | CL_MAP_WRITE, 0, 2 * chunk));
+        }
+    }
+
+    ~staging_buffer() {
+        if (ptr) {
+            queue.enqueueUnmapMemObject(buffer, ptr);
+            queue.finish();
+        }
+    }
+
+    void wait(int i) {
+        if (done[i]()) done[i].wait();
+    }
+
+    void write(const cl::Buffer &dst, size_t offset, size_t size, const char *src, bool blocking) {
+        std::lock_guard<std::mutex> lock(mx);
+
+        for(size_t pos = 0, i = 0; pos < size; pos += chunk, i ^= 1) {
+            size_t n = std::min(chunk, size - pos);
+
+            wait(i);
+            std::memcpy(ptr + i * chunk, src + pos, n);
+            queue.enqueueWriteBuffer(dst, CL_FALSE, offset + pos, n,
+                    ptr + i * chunk, NULL, &done[i]);
+        }
+
+        if (blocking) { wait(0); wait(1); }
+    }
+
+    void read(const cl::Buffer &src, size_t offset, size_t size, char *dst) {
+        std::lock_guard<std::mutex> lock(mx);
+
+        size_t nchunks = (size + chunk - 1) / chunk;
+
+        for(size_t k = 0; k < nchunks; ++k) {
+            if (k == 0) enqueue_read(src, offset, size, 0);
+            if (k + 1 < nchunks) enqueue_read(src, offset, size, k + 1);
+
+            int i = k & 1;
+            wait(i);
+            std::memcpy(dst + k * chunk, ptr + i * chunk, std::min(chunk, size - k * chunk));
+        }
+    }
+
+    void enqueue_read(const cl::Buffer &src, size_t offset, size_t size, size_t k) {
+        int i = k & 1;
+        wait(i);
+        queue.enqueueReadBuffer(src, CL_FALSE, offset + k * chunk,
+                std::min(chunk, size - k * chunk), ptr + i * chunk, NULL, &done[i]);
+    }
+};
+
+// Staging buffers for the known command queues.
+template <bool dummy = true>
+struct staging_area {
+    static_assert(dummy, "dummy parameter should be true");
+
+    // Transfers smaller than this are not staged.
+    static const size_t threshold = 1 << 20;
+
+    typedef std::map<cl_command_queue, std::shared_ptr<staging_buffer> > store_type;
+
+    static store_type store;
+    static std::mutex mx;
+
+    static std::shared_ptr<staging_buffer> get(const cl::CommandQueue &q) {
+        std::lock_guard<std::mutex> lock(mx);
+
+        auto s = store.find(q());
+        if (s == store.end())
+            s = store.insert(std::make_pair(q(), std::make_shared<staging_buffer>(q))).first;
+        return s->second;
+    }
+
+    static void erase(const cl::CommandQueue &q) {
+        std::lock_guard<std::mutex> lock(mx);
+        store.erase(q());
+    }
+
+    static void clear() {
+        std::lock_guard<std::mutex> lock(mx);
+        store.clear();
+    }
+};
+
+template <bool dummy>
+typename staging_area<dummy>::store_type staging_area<dummy>::store;
+
+template <bool dummy>
+std::mutex staging_area<dummy>::mx;
+
+} // namespace detail
+/// \endcond
+
 template <typename T>
 class device_vector {
     public:
         typedef T value_type;
         typedef cl_mem raw_type;
 
-        device_vector() {}
+        device_vector() : n(0), host_ptr(0) {}
 
         device_vector(const cl::CommandQueue &q, size_t n,
                 const T *host = 0, mem_flags flags = MEM_READ_WRITE)
+            : n(n), host_ptr(0)
         {
-            if (host)
+            if (host && !(flags & CL_MEM_USE_HOST_PTR))
                 flags |= CL_MEM_COPY_HOST_PTR;
 
-            if (n)
+            if (n) {
                 buffer = cl::Buffer(q.getInfo<CL_QUEUE_CONTEXT>(), flags,
                         n * sizeof(T), static_cast<void*>(const_cast<T*>(host)));
+
+                if (flags & CL_MEM_USE_HOST_PTR) host_ptr = const_cast<T*>(host);
+            }
         }
 
-        device_vector(cl::Buffer buffer) : buffer( std::move(buffer) ) {}
+        device_vector(cl::Buffer buffer)
+            : buffer( std::move(buffer) ),
+              n( this->buffer() ? this->buffer.getInfo<CL_MEM_SIZE>() / sizeof(T) : 0 ),
+              host_ptr(0)
+        {}
+
+        /// \cond INTERNAL
+        // Uses memory of a byte buffer (see vex::memory_pool).
+        // The keeper is released together with the last copy of the vector.
+        device_vector(const cl::CommandQueue&, const device_vector<char> &bytes,
+                size_t n, std::shared_ptr<void> keeper)
+            : buffer(bytes.raw_buffer()), n(n), host_ptr(0), keeper(std::move(keeper))
+        {}
+        /// \endcond
 
+        /// Copies data from host memory to the buffer.
+        /**
+         * When the buffer wraps the host memory being copied, only makes sure
+         * the device sees the latest data. Large transfers to discrete
+         * devices are staged through pinned memory.
+         */
         void write(const cl::CommandQueue &q, size_t offset, size_t size, const T *host,
                 bool blocking = false) const
         {
-            if (size)
-                q.enqueueWriteBuffer(
-                        buffer, blocking ? CL_TRUE : CL_FALSE,
-                        sizeof(T) * offset, sizeof(T) * size, host
-                        );
+            if (!size) return;
+
+            if (host_ptr && host == host_ptr + offset) {
+                // Mapping with CL_MAP_WRITE would first copy the device
+                // contents back over the data being written.
+#ifdef CL_VERSION_1_2
+                sync(q, offset, size, CL_MAP_WRITE_INVALIDATE_REGION);
+#else
+                q.enqueueWriteBuffer(buffer, CL_TRUE,
+                        sizeof(T) * offset, sizeof(T) * size, host);
+#endif
+                return;
+            }
+
+            if (size * sizeof(T) >= detail::staging_area<>::threshold) {
+                auto s = detail::staging_area<>::get(q);
+                if (s->enabled) {
+                    s->write(buffer, sizeof(T) * offset, sizeof(T) * size,
+                            reinterpret_cast<const char*>(host), blocking);
+                    return;
+                }
+            }
+
+            q.enqueueWriteBuffer(
+                    buffer, blocking ? CL_TRUE : CL_FALSE,
+                    sizeof(T) * offset, sizeof(T) * size, host
+                    );
         }
 
+        /// Copies data from the buffer to host memory.
+        /**
+         * When the buffer wraps the host memory being copied, only makes sure
+         * the host sees the latest data. Large blocking transfers from
+         * discrete devices are staged through pinned memory.
+         */
         void read(const cl::CommandQueue &q, size_t offset, size_t size, T *host,
                 bool blocking = false) const
         {
-            if (size)
-                q.enqueueReadBuffer(
-                        buffer, blocking ? CL_TRUE : CL_FALSE,
-                        sizeof(T) * offset, sizeof(T) * size, host
-                        );
+            if (!size) return;
+
+            if (host_ptr && host == host_ptr + offset) {
+                sync(q, offset, size, CL_MAP_READ);
+                return;
+            }
+
+            if (blocking && size * sizeof(T) >= detail::staging_area<>::threshold) {
+                auto s = detail::staging_area<>::get(q);
+                if (s->enabled) {
+                    s->read(buffer, sizeof(T) * offset, sizeof(T) * size,
+                            reinterpret_cast<char*>(host));
+                    return;
+                }
+            }
+
+            q.enqueueReadBuffer(
+                    buffer, blocking ? CL_TRUE : CL_FALSE,
+                    sizeof(T) * offset, sizeof(T) * size, host
+                    );
         }
 
         size_t size() const {
-            return buffer.getInfo<CL_MEM_SIZE>() / sizeof(T);
+            return n;
         }
 
         struct buffer_unmapper {
@@ -127,6 +329,19 @@ class device_vector {
         }
     private:
         cl::Buffer buffer;
+        size_t     n;
+        T         *host_ptr;
+
+        // Synchronizes the buffer with the wrapped host memory. With
+        // CL_MEM_USE_HOST_PTR mapping the region returns the host pointer
+        // itself, so no data is copied on devices sharing the host memory.
+        void sync(const cl::CommandQueue &q, size_t offset, size_t size, cl_map_flags flags) const {
+            void *ptr = q.enqueueMapBuffer(buffer, CL_TRUE, flags,
+                    sizeof(T) * offset, sizeof(T) * size);
+            q.enqueueUnmapMemObject(buffer, ptr);
+        }
+
+        std::shared_ptr<void> keeper;
 };
 
 } // namespace opencl
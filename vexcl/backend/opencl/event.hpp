@@ -0,0 +1,107 @@
+#ifndef VEXCL_BACKEND_OPENCL_EVENT_HPP
+#define VEXCL_BACKEND_OPENCL_EVENT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/event.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Synchronization of OpenCL command queues with events.
+ */
+
+#include <vector>
+
+#ifndef __CL_ENABLE_EXCEPTIONS
+#  define __CL_ENABLE_EXCEPTIONS
+#endif
+#include <CL/cl.hpp>
+
+#include <vexcl/backend/opencl/context.hpp>
+
+namespace vex {
+namespace backend {
+namespace opencl {
+
+/// Synchronization event.
+typedef cl::Event event;
+
+/// Returns event that completes when all commands previously submitted to the queue complete.
+inline event enqueue_marker(const command_queue &q) {
+    event e;
+#ifdef CL_VERSION_1_2
+    q.enqueueMarkerWithWaitList(NULL, &e);
+#else
+    q.enqueueMarker(&e);
+#endif
+    return e;
+}
+
+/// Commands submitted to the queue after the call wait for the given events.
+inline void enqueue_barrier(const command_queue &q, const std::vector<event> &events) {
+    if (events.empty()) return;
+#ifdef CL_VERSION_1_2
+    q.enqueueBarrierWithWaitList(&events);
+#else
+    q.enqueueWaitForEvents(events);
+#endif
+}
+
+/// Blocks until all given events complete.
+inline void wait_for_events(const std::vector<event> &events) {
+    if (!events.empty()) cl::WaitForEvents(events);
+}
+
+/// Checks if the queue supports timing of the submitted commands.
+/**
+ * The queue should be created with CL_QUEUE_PROFILING_ENABLE property.
+ */
+inline bool profiling_enabled(const command_queue &q) {
+    return (q.getInfo<CL_QUEUE_PROPERTIES>() & CL_QUEUE_PROFILING_ENABLE) != 0;
+}
+
+/// Returns event that records the time when all previously submitted commands complete.
+inline event enqueue_timestamp(const command_queue &q) {
+    return enqueue_marker(q);
+}
+
+/// Time in seconds between two timestamps.
+/**
+ * Blocks until the second timestamp completes.
+ */
+inline double elapsed(const event &start, const event &stop) {
+    stop.wait();
+
+    cl_ulong beg = start.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+    cl_ulong end = stop .getProfilingInfo<CL_PROFILING_COMMAND_END>();
+
+    return end > beg ? 1e-9 * (end - beg) : 0.0;
+}
+
+} // namespace opencl
+} // namespace backend
+} // namespace vex
+
+#endif
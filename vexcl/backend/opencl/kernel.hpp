@@ -38,12 +38,30 @@ THE SOFTWARE.
 #endif
 #include <CL/cl.hpp>
 
+#include <vexcl/backend/opencl/event.hpp>
 #include <vexcl/backend/opencl/compiler.hpp>
+#include <vexcl/backend/precompile.hpp>
+#include <vexcl/backend/trace.hpp>
 
 namespace vex {
 namespace backend {
 namespace opencl {
 
+/// Compiled OpenCL program.
+typedef cl::Program program;
+
+/// Builds program from source.
+/**
+ * The program may contain several kernels, which are then created with
+ * the corresponding backend::kernel constructor. Putting related kernels into
+ * a single program saves the per-program compilation overhead.
+ */
+inline program build_program(const cl::CommandQueue &queue,
+        const std::string &src, const std::string &options = "")
+{
+    return precompile::detail::build(queue, src, options);
+}
+
 /// \cond INTERNAL
 
 /// An abstraction over OpenCL compute kernel.
@@ -58,7 +76,7 @@ class kernel {
                size_t smem_per_thread = 0,
                const std::string &options = ""
                )
-            : argpos(0), K(build_sources(queue, src, options), name.c_str())
+            : argpos(0), K(precompile::detail::build(queue, src, options), name.c_str())
         {
             config(queue,
                     [smem_per_thread](size_t wgs){ return wgs * smem_per_thread; });
@@ -70,7 +88,29 @@ class kernel {
                std::function<size_t(size_t)> smem,
                const std::string &options = ""
                )
-            : argpos(0), K(build_sources(queue, src, options), name.c_str())
+            : argpos(0), K(precompile::detail::build(queue, src, options), name.c_str())
+        {
+            config(queue, smem);
+        }
+
+        /// Constructor. Extracts a cl::Kernel instance from compiled program.
+        kernel(const cl::CommandQueue &queue,
+               const program &P,
+               const std::string &name,
+               size_t smem_per_thread = 0
+               )
+            : argpos(0), K(P, name.c_str())
+        {
+            config(queue,
+                    [smem_per_thread](size_t wgs){ return wgs * smem_per_thread; });
+        }
+
+        /// Constructor. Extracts a cl::Kernel instance from compiled program.
+        kernel(const cl::CommandQueue &queue,
+               const program &P, const std::string &name,
+               std::function<size_t(size_t)> smem
+               )
+            : argpos(0), K(P, name.c_str())
         {
             config(queue, smem);
         }
@@ -78,18 +118,21 @@ class kernel {
         /// Adds an argument to the kernel.
         template <class Arg>
         void push_arg(Arg &&arg) {
+            record(arg);
             K.setArg(argpos++, arg);
         }
 
         /// Adds an argument to the kernel.
         template <typename T>
         void push_arg(device_vector<T> &&arg) {
+            record(arg.raw_buffer());
             K.setArg(argpos++, arg.raw());
         }
 
         /// Adds local memory to the kernel.
         void set_smem(size_t smem_per_thread) {
             cl::LocalSpaceArg smem = { smem_per_thread * workgroup_size() };
+            record(smem);
             K.setArg(argpos++, smem);
         }
 
@@ -97,15 +140,73 @@ class kernel {
         template <class F>
         void set_smem(F &&f) {
             cl::LocalSpaceArg smem = { f(workgroup_size()) };
+            record(smem);
             K.setArg(argpos++, smem);
         }
 
         /// Enqueue the kernel to the specified command queue.
         void operator()(const cl::CommandQueue &q) {
-            q.enqueueNDRangeKernel(K, cl::NullRange, g_size, w_size);
+            if (observer()) (*observer())(*this, q);
+
+            trace::detail::command cmd(q);
+            launch(q);
+            if (cmd) {
+                size_t size = 1;
+                for(size_t i = 0; i < g_size.dimensions(); ++i)
+                    size *= static_cast<const size_t*>(g_size)[i];
+                cmd.done(K.getInfo<CL_KERNEL_FUNCTION_NAME>().c_str(), "kernel", size);
+            }
+
             argpos = 0;
+            args.clear();
         }
 
+        /// \cond INTERNAL
+        // Launches the kernel keeping the arguments bound.
+        void launch(const cl::CommandQueue &q) {
+            q.enqueueNDRangeKernel(K, cl::NullRange, g_size, w_size);
+        }
+
+        // Position of the next argument.
+        unsigned next_arg() const {
+            return argpos;
+        }
+
+        // Replaces value of an argument that was already added.
+        template <class Arg>
+        void set_arg(unsigned pos, const Arg &arg) {
+            K.setArg(pos, arg);
+            if (pos < args.size())
+                args[pos] = [arg](cl::Kernel &k, unsigned i) { k.setArg(i, arg); };
+        }
+
+        // Returns a copy of the kernel with its own argument bindings.
+        // cl::Kernel copies share the argument state, so a new kernel object
+        // is created and the arguments recorded during capture are reapplied.
+        kernel clone() const {
+            kernel k(*this);
+
+            k.K = cl::Kernel(
+                    K.getInfo<CL_KERNEL_PROGRAM>(),
+                    K.getInfo<CL_KERNEL_FUNCTION_NAME>().c_str()
+                    );
+
+            for(unsigned i = 0; i < args.size(); ++i)
+                args[i](k.K, i);
+
+            return k;
+        }
+
+        // Receives copies of the launched kernels while a command graph is
+        // being captured.
+        typedef std::function<void(const kernel&, const command_queue&)> observer_type;
+
+        static observer_type*& observer() {
+            static observer_type *o = 0;
+            return o;
+        }
+        /// \endcond
+
 #ifndef BOOST_NO_VARIADIC_TEMPLATES
         /// Enqueue the kernel to the specified command queue with the given arguments
         template <class Arg1, class... OtherArgs>
@@ -128,8 +229,7 @@ class kernel {
         static inline size_t num_workgroups(const cl::CommandQueue &q) {
             // This is a simple heuristic-based estimate. More advanced technique may
             // be employed later.
-            cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
-            return 8 * d.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
+            return 8 * get_queue_info(q).compute_units;
         }
 
         /// The maximum number of threads per block, beyond which a launch of the kernel would fail.
@@ -148,15 +248,15 @@ class kernel {
 
         /// Select best launch configuration for the given shared memory requirements.
         void config(const cl::CommandQueue &queue, std::function<size_t(size_t)> smem) {
-            cl::Device dev = queue.getInfo<CL_QUEUE_DEVICE>();
+            const queue_info &info = get_queue_info(queue);
 
             size_t ws;
 
-            if ( is_cpu(queue) ) {
+            if ( info.cpu ) {
                 ws = 1;
             } else {
                 // Select workgroup size that would fit into the device.
-                ws = dev.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>()[0] / 2;
+                ws = info.max_workgroup_size / 2;
 
                 size_t max_ws   = max_threads_per_block(queue);
                 size_t max_smem = max_shared_memory_per_block(queue);
@@ -207,6 +307,15 @@ class kernel {
 
         cl::Kernel K;
 
+        // Arguments are only recorded while a command graph is captured.
+        std::vector< std::function<void(cl::Kernel&, unsigned)> > args;
+
+        template <class Arg>
+        void record(const Arg &arg) {
+            if (observer())
+                args.push_back([arg](cl::Kernel &k, unsigned i) { k.setArg(i, arg); });
+        }
+
         backend::ndrange w_size;
         backend::ndrange g_size;
 };
@@ -47,12 +47,14 @@ namespace vex {
 template <class T> struct global_ptr {};
 template <class T> struct shared_ptr {};
 template <class T> struct regstr_ptr {};
+template <class T> struct restrict_ptr {};
 
 template <class T> struct remove_ptr;
 
 template <class T> struct remove_ptr< global_ptr<T> > { typedef T type; };
 template <class T> struct remove_ptr< shared_ptr<T> > { typedef T type; };
 template <class T> struct remove_ptr< regstr_ptr<T> > { typedef T type; };
+template <class T> struct remove_ptr< restrict_ptr<T> > { typedef T type; };
 
 template <class T>
 struct type_name_impl <global_ptr<T> > {
@@ -108,6 +110,15 @@ struct type_name_impl <regstr_ptr<const T> > {
     }
 };
 
+template <class T>
+struct type_name_impl <restrict_ptr<T> > {
+    static std::string get() {
+        std::ostringstream s;
+        s << type_name< global_ptr<T> >() << " restrict";
+        return s.str();
+    }
+};
+
 template<typename T>
 struct type_name_impl<T*>
 {
@@ -145,7 +156,7 @@ class source_generator {
         source_generator() : indent(0), first_prm(true), cpu(false) { }
 
         source_generator(const cl::CommandQueue &queue)
-            : indent(0), first_prm(true), cpu( is_cpu(queue) )
+            : indent(0), first_prm(true), cpu( get_queue_info(queue).cpu )
         {
             src << standard_kernel_header(queue);
         }
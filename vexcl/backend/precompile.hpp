@@ -0,0 +1,427 @@
+#ifndef VEXCL_BACKEND_PRECOMPILE_HPP
+#define VEXCL_BACKEND_PRECOMPILE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/precompile.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Background compilation of program sources.
+ *
+ * Programs may be submitted for compilation ahead of their first use. The
+ * builds are done by a pool of worker threads; a kernel that needs one of the
+ * submitted programs waits for the build to finish (or does the build itself
+ * if no worker has picked it up yet). Only raw sources and vector
+ * assignments may be submitted directly. Sources of all programs compiled by
+ * the application (including reductors, sparse matrices, sorting etc.) may be
+ * recorded to a file and replayed later, e.g. to warm up the binary cache at
+ * deployment time.
+ *
+ * The builds share the compile options, queue_info_store and binary cache
+ * manifest with the rest of the library; each of these is guarded with a
+ * mutex.
+ */
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <algorithm>
+#include <cstdlib>
+
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+
+/// Ahead-of-time and background compilation of programs.
+namespace precompile {
+
+/// \cond INTERNAL
+namespace detail {
+
+typedef decltype(backend::build_sources(
+            std::declval<const backend::command_queue&>(), std::string()
+            )) program_type;
+
+// Single program build. It is executed either by a worker thread, or by the
+// thread that needs the program, whichever comes first.
+struct build_job {
+    backend::command_queue queue;
+    std::string source;
+    std::string options;
+
+    std::atomic<bool> claimed;
+    std::promise<program_type> promise;
+    std::shared_future<program_type> result;
+
+    build_job(const backend::command_queue &queue,
+            const std::string &source, const std::string &options
+            )
+        : queue(queue), source(source), options(options), claimed(false),
+          result(promise.get_future())
+    {}
+
+    void run() {
+        if (claimed.exchange(true)) return;
+
+        try {
+            backend::select_context(queue);
+            promise.set_value(backend::build_sources(queue, source, options));
+        } catch(...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+// Pool of worker threads that execute the submitted builds.
+//
+// The workers use other statics (the registry, the binary cache manifest,
+// context caches), which may be destroyed before the pool at exit. So the
+// workers are stopped explicitly: by precompile::wait() once the builds are
+// done, and by purge_caches() when a context is released. The destructor
+// only stops the workers left running by the application.
+class worker_pool {
+    public:
+        static worker_pool& get() {
+            static worker_pool pool;
+            return pool;
+        }
+
+        void submit(const std::shared_ptr<build_job> &job) {
+            std::lock_guard<std::mutex> restart(shutdown_mx);
+            {
+                std::lock_guard<std::mutex> lock(mx);
+
+                if (workers.empty())
+                    for(unsigned i = 0; i < num_workers(); ++i)
+                        workers.push_back(std::thread(&worker_pool::work, this));
+
+                jobs.push_back(job);
+                ++pending;
+            }
+            cond.notify_one();
+        }
+
+        void wait() {
+            std::unique_lock<std::mutex> lock(mx);
+            done.wait(lock, [this]{ return pending == 0 || stop; });
+        }
+
+        // Stops the workers and waits for them to exit. The builds in
+        // progress are completed, and the queued ones are dropped (they are
+        // built on demand by their users). The next submit() restarts the
+        // workers.
+        void shutdown() {
+            std::lock_guard<std::mutex> restart(shutdown_mx);
+
+            std::vector<std::thread> w;
+            {
+                std::lock_guard<std::mutex> lock(mx);
+                if (workers.empty()) return;
+
+                stop = true;
+                pending -= jobs.size();
+                jobs.clear();
+                w.swap(workers);
+            }
+            cond.notify_all();
+            done.notify_all();
+
+            for(auto t = w.begin(); t != w.end(); ++t) t->join();
+
+            std::lock_guard<std::mutex> lock(mx);
+            stop = false;
+        }
+
+        // Stops the workers of the pool, unless it has been destroyed
+        // already (e.g. when a static context is released at exit).
+        static void stop_workers() {
+            if (!destroyed()) get().shutdown();
+        }
+
+        // Number of running worker threads.
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mx);
+            return workers.size();
+        }
+
+        ~worker_pool() {
+            shutdown();
+            destroyed() = true;
+        }
+    private:
+        std::mutex shutdown_mx;
+        std::mutex mx;
+        std::condition_variable cond, done;
+        std::deque< std::shared_ptr<build_job> > jobs;
+        std::vector<std::thread> workers;
+        size_t pending;
+        bool stop;
+
+        worker_pool() : pending(0), stop(false) {}
+
+        // Trivially destructible, so it outlives the pool.
+        static bool& destroyed() {
+            static bool d = false;
+            return d;
+        }
+
+        static unsigned num_workers() {
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+            const char *n = getenv("VEXCL_PRECOMPILE_THREADS");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+            if (n) return std::max(1, atoi(n));
+            return std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        void work() {
+            while(true) {
+                std::shared_ptr<build_job> job;
+                {
+                    std::unique_lock<std::mutex> lock(mx);
+                    cond.wait(lock, [this]{ return stop || !jobs.empty(); });
+                    if (stop) return;
+
+                    job = jobs.front();
+                    jobs.pop_front();
+                }
+
+                job->run();
+
+                {
+                    std::lock_guard<std::mutex> lock(mx);
+                    if (--pending == 0) done.notify_all();
+                }
+            }
+        }
+};
+
+// Programs that were submitted for compilation, but were not used yet.
+template <bool dummy = true>
+struct registry {
+    static_assert(dummy, "Dummy parameter should be true");
+
+    typedef std::pair<backend::context_id, std::string> key_type;
+    typedef std::map<key_type, std::shared_ptr<build_job> > store_type;
+
+    static std::mutex mx;
+    static store_type store;
+
+    static key_type key(const backend::command_queue &q,
+            const std::string &source, const std::string &options)
+    {
+        return key_type(backend::get_context_id(q), options + '\n' + source);
+    }
+
+    // Returns false if the program is already scheduled.
+    static bool insert(const std::shared_ptr<build_job> &job) {
+        std::lock_guard<std::mutex> lock(mx);
+        return store.insert(std::make_pair(
+                    key(job->queue, job->source, job->options), job)).second;
+    }
+
+    static std::shared_ptr<build_job> take(const backend::command_queue &q,
+            const std::string &source, const std::string &options)
+    {
+        std::lock_guard<std::mutex> lock(mx);
+
+        std::shared_ptr<build_job> job;
+        if (store.empty()) return job;
+
+        auto j = store.find(key(q, source, options));
+        if (j != store.end()) {
+            job = j->second;
+            store.erase(j);
+        }
+        return job;
+    }
+
+    static void erase(const backend::command_queue &q) {
+        std::lock_guard<std::mutex> lock(mx);
+        backend::context_id ctx = backend::get_context_id(q);
+        for(auto j = store.begin(); j != store.end(); )
+            if (j->first.first == ctx) store.erase(j++); else ++j;
+    }
+
+    static void clear() {
+        std::lock_guard<std::mutex> lock(mx);
+        store.clear();
+    }
+};
+
+template <bool dummy>
+std::mutex registry<dummy>::mx;
+
+template <bool dummy>
+typename registry<dummy>::store_type registry<dummy>::store;
+
+// Records sources of compiled programs.
+// Each record has the form
+//   vexcl-program <options size> <source size>\n<options>\n<source>\n
+template <bool dummy = true>
+struct recorder {
+    static_assert(dummy, "Dummy parameter should be true");
+
+    static std::mutex mx;
+    static std::string file;
+    static std::set<std::string> seen;
+
+    static std::string& output() {
+        static bool init = false;
+        if (!init) {
+            init = true;
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+            if (const char *f = getenv("VEXCL_RECORD_PROGRAMS")) file = f;
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+        }
+        return file;
+    }
+
+    static void record(const std::string &source, const std::string &options) {
+        std::lock_guard<std::mutex> lock(mx);
+
+        if (output().empty()) return;
+        if (!seen.insert(options + '\n' + source).second) return;
+
+        std::ofstream f(output(), std::ios::app | std::ios::binary);
+        f << "vexcl-program " << options.size() << " " << source.size() << "\n"
+          << options << "\n" << source << "\n";
+    }
+};
+
+template <bool dummy>
+std::mutex recorder<dummy>::mx;
+
+template <bool dummy>
+std::string recorder<dummy>::file;
+
+template <bool dummy>
+std::set<std::string> recorder<dummy>::seen;
+
+// Returns the compiled program. Used by backend kernels instead of calling
+// backend::build_sources() directly.
+inline program_type build(const backend::command_queue &queue,
+        const std::string &source, const std::string &options)
+{
+    recorder<>::record(source, options);
+
+    if (std::shared_ptr<build_job> job = registry<>::take(queue, source, options)) {
+        job->run();
+        return job->result.get();
+    }
+
+    return backend::build_sources(queue, source, options);
+}
+
+} // namespace detail
+/// \endcond
+
+/// Submits program source for compilation in background.
+inline void source(const backend::command_queue &queue,
+        const std::string &src, const std::string &options = "")
+{
+    std::shared_ptr<detail::build_job> job =
+        std::make_shared<detail::build_job>(queue, src, options);
+
+    if (detail::registry<>::insert(job))
+        detail::worker_pool::get().submit(job);
+}
+
+/// Blocks until all submitted programs are compiled.
+/**
+ * The background compilation threads are stopped afterwards, and are
+ * restarted by the next submission.
+ */
+inline void wait() {
+    detail::worker_pool::get().wait();
+    detail::worker_pool::get().shutdown();
+}
+
+/// Records sources of all programs compiled from now on to the given file.
+/**
+ * The records are appended to the file. An empty file name stops the
+ * recording. The same may be achieved by setting VEXCL_RECORD_PROGRAMS
+ * environment variable. The recorded programs may be submitted for
+ * compilation with vex::precompile::from_file().
+ */
+inline void record(const std::string &file) {
+    std::lock_guard<std::mutex> lock(detail::recorder<>::mx);
+    detail::recorder<>::output() = file;
+}
+
+/// Submits programs recorded with vex::precompile::record() for compilation.
+/**
+ * Every program is compiled for each of the given queues. Returns the number
+ * of programs read from the file.
+ */
+inline size_t from_file(const std::vector<backend::command_queue> &queue,
+        const std::string &file)
+{
+    std::ifstream f(file, std::ios::binary);
+
+    size_t count = 0;
+    std::string tag;
+    size_t osize, ssize;
+
+    while(f >> tag >> osize >> ssize && tag == "vexcl-program") {
+        f.ignore(1);
+
+        std::string options(osize, ' '), src(ssize, ' ');
+        if (!f.read(&options[0], osize).ignore(1)) break;
+        if (!f.read(&src[0],     ssize).ignore(1)) break;
+
+        for(auto q = queue.begin(); q != queue.end(); ++q)
+            source(*q, src, options);
+
+        ++count;
+    }
+
+    return count;
+}
+
+} // namespace precompile
+} // namespace vex
+
+#endif
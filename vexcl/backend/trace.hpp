@@ -0,0 +1,263 @@
+#ifndef VEXCL_BACKEND_TRACE_HPP
+#define VEXCL_BACKEND_TRACE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/**
+ * \file   vexcl/backend/trace.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Timeline of kernel launches and transfers.
+ *
+ * When tracing is enabled, each kernel launch and each host-device transfer
+ * made by the library is bracketed with timestamp events. The events are
+ * only resolved when the trace is written, so tracing does not add any
+ * synchronization. The trace is written in the trace event JSON format
+ * that is understood by chrome://tracing and Perfetto.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/io/ios_state.hpp>
+
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+
+/// Timeline of kernel launches and transfers.
+namespace trace {
+
+/// \cond INTERNAL
+namespace detail {
+
+class recorder {
+    public:
+        static recorder& instance() {
+            static recorder r;
+            return r;
+        }
+
+        std::atomic<bool> enabled;
+
+        // Returns start timestamp for a command submitted to the queue.
+        backend::event start(const backend::command_queue &q) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            if (origin.find(q) == origin.end()) {
+                reference ref = {
+                    backend::enqueue_timestamp(q), seconds(),
+                    static_cast<int>(origin.size())
+                };
+                origin.insert(std::make_pair(q, ref));
+                queues.push_back(q);
+            }
+
+            return backend::enqueue_timestamp(q);
+        }
+
+        void stop(const backend::command_queue &q, const backend::event &beg,
+                const std::string &name, const char *category, size_t size)
+        {
+            backend::event end = backend::enqueue_timestamp(q);
+
+            std::lock_guard<std::mutex> lock(mx);
+            records.push_back(record{name, category, size, q, beg, end});
+        }
+
+        void write(std::ostream &os) {
+            std::lock_guard<std::mutex> lock(mx);
+            boost::io::ios_all_saver stream_state(os);
+
+            // Devices are numbered as processes, and queues as threads,
+            // in order of their first appearance in the trace.
+            std::map<backend::device_id, int> pid;
+
+            os << "{\"traceEvents\":[" << std::fixed << std::setprecision(3);
+
+            bool first = true;
+            for(auto q = queues.begin(); q != queues.end(); ++q) {
+                auto d = backend::get_device_id(*q);
+                if (!pid.count(d)) {
+                    int p = static_cast<int>(pid.size());
+                    pid[d] = p;
+
+                    std::ostringstream dev;
+                    dev << *q;
+
+                    os << (first ? "\n" : ",\n")
+                       << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << p
+                       << ",\"args\":{\"name\":\"" << escape(dev.str()) << "\"}}";
+                    first = false;
+                }
+
+                int t = origin.find(*q)->second.tid;
+
+                os << (first ? "\n" : ",\n")
+                   << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid[d]
+                   << ",\"tid\":" << t << ",\"args\":{\"name\":\"queue " << t << "\"}}";
+                first = false;
+            }
+
+            for(auto r = records.begin(); r != records.end(); ++r) {
+                const reference &o = origin.find(r->queue)->second;
+
+                double ts  = o.time + backend::elapsed(o.start, r->start);
+                double dur = backend::elapsed(r->start, r->stop);
+
+                os << (first ? "\n" : ",\n")
+                   << "{\"name\":\"" << escape(r->name) << "\",\"cat\":\"" << r->category
+                   << "\",\"ph\":\"X\",\"ts\":" << 1e6 * ts << ",\"dur\":" << 1e6 * dur
+                   << ",\"pid\":" << pid[backend::get_device_id(r->queue)]
+                   << ",\"tid\":" << o.tid
+                   << ",\"args\":{\"size\":" << r->size << "}}";
+                first = false;
+            }
+
+            os << "\n]}" << std::endl;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mx);
+            records.clear();
+            origin.clear();
+            queues.clear();
+        }
+    private:
+        struct record {
+            std::string            name;
+            const char            *category;
+            size_t                 size;
+            backend::command_queue queue;
+            backend::event         start;
+            backend::event         stop;
+        };
+
+        std::mutex mx;
+        std::vector<record> records;
+
+        // Reference timestamp for each queue, along with the host time (in
+        // seconds since the recorder creation) when it was enqueued. Device
+        // clocks are not synchronized, so alignment of timelines across
+        // devices is approximate.
+        struct reference {
+            backend::event start;
+            double         time;
+            int            tid;
+        };
+
+        std::map<backend::command_queue, reference, backend::compare_queues> origin;
+        std::vector<backend::command_queue> queues;
+
+        std::chrono::high_resolution_clock::time_point t0;
+
+        recorder() : enabled(false), t0(std::chrono::high_resolution_clock::now()) {}
+
+        double seconds() const {
+            return std::chrono::duration<double>(
+                    std::chrono::high_resolution_clock::now() - t0).count();
+        }
+
+        static std::string escape(const std::string &s) {
+            std::string r;
+            for(auto c = s.begin(); c != s.end(); ++c) {
+                if (*c == '"' || *c == '\\') r.push_back('\\');
+                if (static_cast<unsigned char>(*c) >= 0x20) r.push_back(*c);
+            }
+            return r;
+        }
+};
+
+// Brackets a command submitted to the queue with timestamps when tracing
+// is enabled.
+class command {
+    public:
+        explicit command(const backend::command_queue &q)
+            : active(recorder::instance().enabled && backend::profiling_enabled(q)), q(q)
+        {
+            if (active) beg = recorder::instance().start(q);
+        }
+
+        explicit operator bool() const {
+            return active;
+        }
+
+        void done(const std::string &name, const char *category, size_t size) {
+            if (active) recorder::instance().stop(q, beg, name, category, size);
+        }
+    private:
+        bool active;
+        const backend::command_queue &q;
+        backend::event beg;
+};
+
+} // namespace detail
+/// \endcond
+
+/// Starts (or stops) recording of kernel launches and transfers.
+/**
+ * With the OpenCL backend, only commands submitted to queues created with
+ * CL_QUEUE_PROFILING_ENABLE property are recorded.
+ */
+inline void enable(bool on = true) {
+    detail::recorder::instance().enabled = on;
+}
+
+/// Checks if tracing is enabled.
+inline bool enabled() {
+    return detail::recorder::instance().enabled;
+}
+
+/// Writes recorded trace in the trace event JSON format.
+/**
+ * Waits for completion of the recorded commands.
+ */
+inline void write(std::ostream &os) {
+    detail::recorder::instance().write(os);
+}
+
+/// Saves recorded trace to the given file.
+inline void save(const std::string &fname) {
+    std::ofstream f(fname);
+    write(f);
+}
+
+/// Drops recorded trace.
+inline void clear() {
+    detail::recorder::instance().clear();
+}
+
+} // namespace trace
+} // namespace vex
+
+#endif
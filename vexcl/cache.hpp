@@ -37,6 +37,9 @@ THE SOFTWARE.
 #include <boost/utility.hpp>
 
 #include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+#include <vexcl/backend/precompile.hpp>
+#include <vexcl/memory_pool.hpp>
 
 namespace vex {
 namespace detail {
@@ -85,13 +88,17 @@ void cache_register<dummy>::erase(const backend::command_queue &q) {
         (*c)->erase(q);
 }
 
-// Indexes cache objects by context
+// Indexes cache objects by context.
+// Uses the context handle from the queue_info record, so that the lookup does
+// not involve any driver calls. The handle keeps the context alive while it is
+// used as a key, so that a new context can not reuse its address and pick up
+// stale entries.
 struct index_by_context {
     typedef backend::context          type;
     typedef backend::compare_contexts compare;
 
-    static type get(const backend::command_queue &q) {
-        return backend::get_context(q);
+    static const type& get(const backend::command_queue &q) {
+        return get_queue_info(q).context_handle;
     }
 };
 
@@ -154,18 +161,42 @@ typedef object_cache<index_by_context, backend::kernel> kernel_cache;
 
 /// Clears cached objects, allowing to cleanly release contexts.
 inline void purge_caches() {
+    // Builds in progress may use the contexts being released.
+    precompile::detail::worker_pool::stop_workers();
     detail::cache_register<true>::clear();
+    precompile::detail::registry<>::clear();
+    memory_pool::trim();
+#ifdef VEXCL_BACKEND_OPENCL
+    backend::opencl::detail::staging_area<>::clear();
+#endif
+    queue_info_store<>::clear();
 }
 
 /// Clears cached objects, allowing to cleanly release contexts.
 inline void purge_caches(const backend::command_queue &q) {
+    precompile::detail::worker_pool::stop_workers();
     detail::cache_register<true>::erase(q);
+    precompile::detail::registry<>::erase(q);
+    memory_pool::trim(q);
+#ifdef VEXCL_BACKEND_OPENCL
+    backend::opencl::detail::staging_area<>::erase(q);
+#endif
+    queue_info_store<>::erase(q);
 }
 
 /// Clears cached objects, allowing to cleanly release contexts.
 inline void purge_caches(const std::vector<backend::command_queue> &queue) {
-    for(auto q = queue.begin(); q != queue.end(); ++q)
+    precompile::detail::worker_pool::stop_workers();
+
+    for(auto q = queue.begin(); q != queue.end(); ++q) {
         detail::cache_register<true>::erase( *q );
+        precompile::detail::registry<>::erase( *q );
+        memory_pool::trim( *q );
+#ifdef VEXCL_BACKEND_OPENCL
+        backend::opencl::detail::staging_area<>::erase( *q );
+#endif
+        queue_info_store<>::erase( *q );
+    }
 }
 
 }
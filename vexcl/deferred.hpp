@@ -0,0 +1,901 @@
+#ifndef VEXCL_DEFERRED_HPP
+#define VEXCL_DEFERRED_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/deferred.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Deferred evaluation of element-wise vector assignments.
+ *
+ * While a vex::deferred object is alive, element-wise assignments to vectors
+ * are queued instead of being executed. The queued statements are fused into
+ * a single kernel, which loads each vector once, keeps the intermediate values
+ * in registers, and stores each written vector once.
+ */
+
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <exception>
+#include <utility>
+#include <algorithm>
+#include <typeinfo>
+#include <functional>
+#include <type_traits>
+
+#include <boost/proto/proto.hpp>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/operations.hpp>
+#include <vexcl/autotune.hpp>
+#include <vexcl/cache.hpp>
+#include <vexcl/util.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+
+namespace traits {
+
+// Terminals that may take part in deferred (fused) assignments. These are
+// vectors, which are read and written element-wise, and arithmetic scalars.
+template <class Term, class Enable = void>
+struct is_deferrable_terminal : std::is_arithmetic<Term> {};
+
+} // namespace traits
+
+// Grammar for expressions that may be fused with other deferred assignments.
+// Operations that could address neighbouring elements or modify their
+// operands are excluded.
+struct deferred_expr_grammar
+    : boost::proto::or_<
+          boost::proto::and_<
+              boost::proto::terminal< boost::proto::_ >,
+              boost::proto::if_< traits::is_deferrable_terminal< boost::proto::_value >() >
+          >,
+          boost::proto::and_<
+              boost::proto::not_<
+                  boost::proto::or_<
+                      boost::proto::pre_inc    < boost::proto::_ >,
+                      boost::proto::pre_dec    < boost::proto::_ >,
+                      boost::proto::post_inc   < boost::proto::_ >,
+                      boost::proto::post_dec   < boost::proto::_ >,
+                      boost::proto::address_of < boost::proto::_ >,
+                      boost::proto::dereference< boost::proto::_ >,
+                      boost::proto::subscript  < boost::proto::_, boost::proto::_ >
+                  >
+              >,
+              boost::proto::or_<
+                  VEXCL_BUILTIN_OPERATIONS(deferred_expr_grammar),
+                  VEXCL_USER_FUNCTIONS(deferred_expr_grammar)
+              >
+          >
+      >
+{};
+
+namespace detail {
+
+// Vector taking part in a deferred statement.
+struct deferred_vector {
+    const void     *term;   // Address of the vector object.
+    size_t          id;     // Buffer id on the current device.
+    std::string     type;   // Type of the vector elements.
+    size_t          bytes;  // Bytes per element.
+    access_tracker *acc;
+
+    // Declares kernel parameter for the vector.
+    std::function<void(backend::source_generator&, const backend::command_queue&,
+            const std::string&, kernel_generator_state_ptr)> declare;
+
+    // Outputs current element of the vector.
+    std::function<void(backend::source_generator&, const backend::command_queue&,
+            const std::string&, kernel_generator_state_ptr)> element;
+
+    // Sets kernel argument for the vector.
+    std::function<void(backend::kernel&)> set_arg;
+};
+
+// Collects vectors of an expression.
+struct collect_deferred_vectors {
+    std::vector<deferred_vector> &vec;
+    unsigned part;
+    size_t   part_start;
+
+    collect_deferred_vectors(std::vector<deferred_vector> &vec,
+            unsigned part, size_t part_start
+            ) : vec(vec), part(part), part_start(part_start)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        typedef typename std::decay<Term>::type::value_type T;
+
+        unsigned d     = part;
+        size_t   start = part_start;
+
+        deferred_vector v;
+
+        v.term  = std::addressof(term);
+        v.id    = traits::get_terminal_buffer_id(term, d);
+        v.type  = type_name<T>();
+        v.bytes = traits::get_terminal_bytes_per_element(term);
+        v.acc   = traits::get_access_tracker(term, d);
+
+        v.declare = [&term](backend::source_generator &src,
+                const backend::command_queue &q, const std::string &name,
+                kernel_generator_state_ptr state)
+        {
+            traits::get_kernel_param_declaration(src, term, q, name, state);
+        };
+
+        v.element = [&term](backend::source_generator &src,
+                const backend::command_queue &q, const std::string &name,
+                kernel_generator_state_ptr state)
+        {
+            traits::get_partial_vector_expr(src, term, q, name, state);
+        };
+
+        v.set_arg = [&term, d, start](backend::kernel &krn) {
+            traits::set_kernel_args(term, krn, d, start, empty_state());
+        };
+
+        vec.push_back(v);
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {}
+};
+
+// Collects addresses of the vectors in an expression.
+struct collect_deferred_terms {
+    std::set<const void*> &terms;
+
+    collect_deferred_terms(std::set<const void*> &terms) : terms(terms) {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        terms.insert(std::addressof(term));
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {}
+};
+
+#if (VEXCL_CHECK_SIZES > 0)
+// Checks that the terminals of a queued statement have the layout of the
+// queue. Fused kernels index all vectors with the same partitioning, and
+// would not notice the mismatch otherwise.
+struct check_deferred_layout {
+    const std::vector<backend::command_queue> &queue;
+    const std::vector<size_t> &part;
+
+    check_deferred_layout(const std::vector<backend::command_queue> &queue,
+            const std::vector<size_t> &part
+            ) : queue(queue), part(part)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        check(term);
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        check(boost::proto::value(term));
+    }
+
+    template <typename Term>
+    void check(const Term &term) const {
+        std::vector<backend::command_queue> q;
+        std::vector<size_t> p;
+        size_t s = 0;
+
+        traits::extract_expression_properties(term, q, p, s);
+
+        precondition(q.empty() || q.size() == queue.size(),
+                "Incompatible queue lists");
+
+        precondition(s == 0 || s == part.back(),
+                "Incompatible expression sizes");
+
+        precondition(p.empty() || p == part,
+                "Incompatible vector partitionings");
+    }
+};
+#endif
+
+// Declares kernel parameters for the scalar terminals of an expression.
+// Vectors are declared once per fused kernel, but still get their parameter
+// numbers, so that the names match the ones used by vector_expr_context.
+struct declare_deferred_parameter : declare_expression_parameter {
+    declare_deferred_parameter(backend::source_generator &src,
+            const backend::command_queue &queue, const std::string &prefix,
+            kernel_generator_state_ptr state
+            )
+        : declare_expression_parameter(src, queue, prefix, state)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {
+        ++prm_idx;
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        declare_expression_parameter::operator()(term);
+    }
+};
+
+// Sets kernel arguments for the scalar terminals of an expression.
+struct set_deferred_argument : set_expression_argument {
+    set_deferred_argument(backend::kernel &krn, unsigned part, size_t part_start,
+            kernel_generator_state_ptr state
+            )
+        : set_expression_argument(krn, part, part_start, state)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {}
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        set_expression_argument::operator()(term);
+    }
+};
+
+// Queued assignment.
+struct deferred_statement {
+    virtual ~deferred_statement() {}
+
+    // Unique name of the statement type.
+    virtual const char* type() const = 0;
+
+    // Does the statement read its left-hand side?
+    virtual bool compound() const = 0;
+
+    // Adds addresses of the vectors used in the statement.
+    virtual void terms(std::set<const void*> &t) const = 0;
+
+    // Vectors used in the statement on the given device. Left-hand side
+    // goes first.
+    virtual void vectors(unsigned d, size_t start, std::vector<deferred_vector> &v) const = 0;
+
+    virtual void preamble(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            kernel_generator_state_ptr state) const = 0;
+
+    virtual void declare(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            kernel_generator_state_ptr state) const = 0;
+
+    // Outputs the statement with the left-hand side replaced by lhs_var.
+    virtual void body(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            const std::string &lhs_var, kernel_generator_state_ptr loc_state,
+            kernel_generator_state_ptr expr_state) const = 0;
+
+    virtual void set_args(backend::kernel &krn, unsigned d, size_t start,
+            kernel_generator_state_ptr state) const = 0;
+
+    // Executes the statement on its own.
+    virtual void execute(const std::vector<backend::command_queue> &queue,
+            const std::vector<size_t> &part) const = 0;
+};
+
+template <class OP, class LHS, class RHS>
+struct deferred_assignment : deferred_statement {
+    // Vectors are held by reference, the rest of the expression is copied.
+    typedef typename std::conditional<
+        traits::hold_terminal_by_reference<RHS>::value, const RHS&, const RHS
+        >::type rhs_type;
+
+    LHS      &lhs;
+    rhs_type  rhs;
+
+    deferred_assignment(LHS &lhs, const RHS &rhs) : lhs(lhs), rhs(rhs) {}
+
+    const char* type() const {
+        return typeid(*this).name();
+    }
+
+    bool compound() const {
+        return !std::is_same<OP, assign::SET>::value;
+    }
+
+    void terms(std::set<const void*> &t) const {
+        extract_terminals()(boost::proto::as_child(lhs), collect_deferred_terms(t));
+        extract_terminals()(boost::proto::as_child(rhs), collect_deferred_terms(t));
+    }
+
+    void vectors(unsigned d, size_t start, std::vector<deferred_vector> &v) const {
+        extract_terminals()(boost::proto::as_child(lhs), collect_deferred_vectors(v, d, start));
+        extract_terminals()(boost::proto::as_child(rhs), collect_deferred_vectors(v, d, start));
+    }
+
+    void preamble(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            kernel_generator_state_ptr state) const
+    {
+        output_terminal_preamble termpream(src, q, prefix, state);
+        boost::proto::eval(boost::proto::as_child(rhs), termpream);
+    }
+
+    void declare(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            kernel_generator_state_ptr state) const
+    {
+        extract_terminals()(boost::proto::as_child(rhs),
+                declare_deferred_parameter(src, q, prefix, state));
+    }
+
+    void body(backend::source_generator &src,
+            const backend::command_queue &q, const std::string &prefix,
+            const std::string &lhs_var, kernel_generator_state_ptr loc_state,
+            kernel_generator_state_ptr expr_state) const
+    {
+        output_local_preamble loc_init(src, q, prefix, loc_state);
+        boost::proto::eval(boost::proto::as_child(rhs), loc_init);
+
+        vector_expr_context expr_ctx(src, q, prefix, expr_state);
+
+        src.new_line() << lhs_var << " " << OP::string() << " ";
+        boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
+        src << ";";
+    }
+
+    void set_args(backend::kernel &krn, unsigned d, size_t start,
+            kernel_generator_state_ptr state) const
+    {
+        extract_terminals()(boost::proto::as_child(rhs),
+                set_deferred_argument(krn, d, start, state));
+    }
+
+    void execute(const std::vector<backend::command_queue> &queue,
+            const std::vector<size_t> &part) const
+    {
+        assign_expression<OP>(lhs, rhs, queue, part);
+    }
+};
+
+// Statements queued by the active vex::deferred scope.
+class deferred_queue {
+    public:
+        static deferred_queue*& active() {
+            static deferred_queue *q = 0;
+            return q;
+        }
+
+        // Queues the assignment. Returns false if the assignment should be
+        // executed immediately.
+        template <class OP, class LHS, class RHS>
+        bool push(LHS &lhs, const RHS &rhs,
+                const std::vector<backend::command_queue> &q,
+                const std::vector<size_t> &p
+                )
+        {
+            if (p.empty() || p.back() == 0) return false;
+
+#if (VEXCL_CHECK_SIZES > 0)
+            // Fused kernels skip the checks of assign_expression().
+            extract_terminals()(boost::proto::as_child(rhs),
+                    check_deferred_layout(q, p));
+#endif
+
+            // Statements queued after a move would see the moved-from
+            // vector restored during the flush.
+            if (!stmt.empty() && (!moves.empty() || !same_layout(q, p))) flush();
+
+            if (stmt.empty()) {
+                queue = q;
+                part  = p;
+            }
+
+            stmt.push_back(std::unique_ptr<deferred_statement>(
+                        new deferred_assignment<OP, LHS, RHS>(lhs, rhs)));
+            stmt.back()->terms(terms);
+
+            return true;
+        }
+
+        // Is the vector used by any of the queued statements?
+        bool references(const void *term) const {
+            return terms.count(term) != 0;
+        }
+
+        // Number of queued statements.
+        size_t size() const {
+            return stmt.size();
+        }
+
+        // Executes the queued statements. Rethrows the error of a previous
+        // flush made by a destructor.
+        void flush() {
+            if (failure) {
+                std::exception_ptr e;
+                std::swap(e, failure);
+                std::rethrow_exception(e);
+            }
+
+            execute(stmt.size());
+        }
+
+        // Executes the statements that have to complete before the vector is
+        // destroyed, that is, the ones up to the last statement using the
+        // vector. The rest stays queued. Since a destructor can not throw,
+        // an error is kept and rethrown by the next flush().
+        bool flush_nothrow(const void *term) {
+            try {
+                size_t n = moves.empty() ? 0 : stmt.size();
+                for(size_t k = 0; k < stmt.size(); ++k) {
+                    std::set<const void*> t;
+                    stmt[k]->terms(t);
+                    if (t.count(term)) n = std::max(n, k + 1);
+                }
+
+                execute(n);
+            } catch(...) {
+                if (!failure) failure = std::current_exception();
+                return false;
+            }
+
+            return true;
+        }
+
+        // Same as flush(), but returns the error instead of throwing it.
+        std::exception_ptr flush_nothrow() {
+            try {
+                flush();
+            } catch(...) {
+                return std::current_exception();
+            }
+            return std::exception_ptr();
+        }
+
+        // Notifies the queue that the vector has been moved. Queued
+        // statements still refer to the moved-from object, which gets its
+        // contents back for the duration of the flush. Returns false if the
+        // move could not be recorded (the caller should undo it then).
+        bool moved(void *from, void *to, void (*swap)(void*, void*)) noexcept {
+            if (!references(from)) return true;
+
+            try {
+                moves.push_back(move_record{from, to, swap});
+                terms.insert(to);
+            } catch(...) {
+                if (moves.size() && moves.back().from == from) moves.pop_back();
+                return false;
+            }
+
+            return true;
+        }
+    private:
+        struct move_record {
+            void *from, *to;
+            void (*swap)(void*, void*);
+        };
+
+        // Gives the moved-from vectors their contents back, and takes them
+        // away again on destruction.
+        struct restore_moves {
+            const std::vector<move_record> &m;
+
+            restore_moves(const std::vector<move_record> &m) : m(m) {
+                for(auto r = m.rbegin(); r != m.rend(); ++r) r->swap(r->from, r->to);
+            }
+
+            ~restore_moves() {
+                for(auto r = m.begin(); r != m.end(); ++r) r->swap(r->from, r->to);
+            }
+        };
+
+        // Executes the first n queued statements.
+        void execute(size_t n) {
+            if (!n) return;
+
+            // The statements are removed from the queue before any kernel is
+            // launched, so that the launches do not recursively flush it.
+            std::vector< std::unique_ptr<deferred_statement> > s;
+            std::vector<backend::command_queue> q = queue;
+            std::vector<size_t> p = part;
+            std::vector<move_record> m;
+
+            if (n == stmt.size()) {
+                s.swap(stmt);
+                m.swap(moves);
+                queue.clear();
+                part.clear();
+                terms.clear();
+            } else {
+                for(size_t k = 0; k < n; ++k) s.push_back(std::move(stmt[k]));
+                stmt.erase(stmt.begin(), stmt.begin() + n);
+
+                terms.clear();
+                for(auto k = stmt.begin(); k != stmt.end(); ++k) (*k)->terms(terms);
+            }
+
+            restore_moves restore(m);
+
+            if (s.size() == 1) {
+                s[0]->execute(q, p);
+                return;
+            }
+
+            static std::map<
+                std::string,
+                object_cache<index_by_context, autotune::tunable_kernel>
+                > cache;
+
+            for(unsigned d = 0; d < q.size(); d++) {
+                size_t psize = p[d + 1] - p[d];
+                if (!psize) continue;
+
+                // Each buffer gets single slot in the fused kernel.
+                std::vector<deferred_vector> slot;
+                std::vector<bool> load, store;
+
+                std::vector< std::vector<deferred_vector> > vec(s.size());
+                std::vector< std::vector<unsigned> >        pos(s.size());
+
+                std::ostringstream key;
+
+                for(size_t k = 0; k < s.size(); ++k) {
+                    s[k]->vectors(d, p[d], vec[k]);
+                    pos[k].resize(vec[k].size());
+
+                    // Right-hand side is read before the left-hand side is
+                    // written.
+                    for(size_t i = 1; i <= vec[k].size(); ++i) {
+                        size_t j = i % vec[k].size();
+                        const deferred_vector &v = vec[k][j];
+
+                        unsigned n = 0;
+                        while(n < slot.size() && slot[n].id != v.id) ++n;
+
+                        if (n == slot.size()) {
+                            slot.push_back(v);
+                            load.push_back(j != 0 || s[k]->compound());
+                            store.push_back(false);
+                        }
+
+                        if (j == 0) store[n] = true;
+
+                        pos[k][j] = n;
+                    }
+
+                    key << s[k]->type() << "(";
+                    for(auto n = pos[k].begin(); n != pos[k].end(); ++n)
+                        key << " " << *n;
+                    key << ");";
+                }
+
+                for(size_t n = 0; n < slot.size(); ++n)
+                    key << (load[n] ? "r" : "-") << (store[n] ? "w" : "-");
+
+                backend::select_context(q[d]);
+
+                auto &c = cache[key.str()];
+                auto kernel = c.find(q[d]);
+
+                if (kernel == c.end()) {
+                    kernel = c.insert(q[d], autotune::tunable_kernel(q[d],
+                                source(s, vec, pos, slot, load, store, q[d]),
+                                "vexcl_deferred_kernel"));
+                }
+
+                for(size_t n = 0; n < slot.size(); ++n)
+                    if (slot[n].acc) slot[n].acc->acquire(q[d], store[n]);
+
+                kernel->second.kernel.push_arg(psize);
+
+                for(size_t n = 0; n < slot.size(); ++n)
+                    slot[n].set_arg(kernel->second.kernel);
+
+                auto state = empty_state();
+                for(size_t k = 0; k < s.size(); ++k)
+                    s[k]->set_args(kernel->second.kernel, d, p[d], state);
+
+                size_t bytes = 0;
+                if (stats::enabled()) {
+                    for(size_t n = 0; n < slot.size(); ++n)
+                        bytes += (load[n] + store[n]) * slot[n].bytes;
+                    bytes *= psize;
+                }
+
+                kernel->second(q[d], psize, bytes);
+
+                for(size_t n = 0; n < slot.size(); ++n)
+                    if (slot[n].acc) slot[n].acc->release(q[d], store[n]);
+            }
+        }
+
+        std::vector< std::unique_ptr<deferred_statement> > stmt;
+        std::vector<backend::command_queue> queue;
+        std::vector<size_t> part;
+        std::set<const void*> terms;
+        std::vector<move_record> moves;
+        std::exception_ptr failure;
+
+        bool same_layout(const std::vector<backend::command_queue> &q,
+                const std::vector<size_t> &p) const
+        {
+            if (p != part || q.size() != queue.size()) return false;
+
+            backend::compare_queues less;
+            for(size_t d = 0; d < q.size(); ++d)
+                if (less(q[d], queue[d]) || less(queue[d], q[d])) return false;
+
+            return true;
+        }
+
+        static std::string source(
+                const std::vector< std::unique_ptr<deferred_statement> > &s,
+                const std::vector< std::vector<deferred_vector> > &vec,
+                const std::vector< std::vector<unsigned> > &pos,
+                const std::vector<deferred_vector> &slot,
+                const std::vector<bool> &load,
+                const std::vector<bool> &store,
+                const backend::command_queue &q
+                )
+        {
+            backend::source_generator src(q);
+
+            std::vector<std::string> prefix(s.size());
+            for(size_t k = 0; k < s.size(); ++k) {
+                std::ostringstream name;
+                name << "s" << k + 1;
+                prefix[k] = name.str();
+            }
+
+            std::vector<std::string> prm(slot.size()), var(slot.size());
+            for(size_t n = 0; n < slot.size(); ++n) {
+                std::ostringstream p, v;
+                p << "prm_" << n + 1;
+                v << "var_" << n + 1;
+                prm[n] = p.str();
+                var[n] = v.str();
+            }
+
+            auto pre_state = empty_state();
+            for(size_t k = 0; k < s.size(); ++k)
+                s[k]->preamble(src, q, prefix[k], pre_state);
+
+            src.kernel("vexcl_deferred_kernel").open("(").parameter<size_t>("n");
+
+            // Each buffer has its own slot, so the ones that are only read
+            // can not alias the ones that are written.
+            auto decl_state = empty_state();
+            for(size_t n = 0; n < slot.size(); ++n) {
+                set_parameter_access(decl_state,
+                        store[n] ? read_write_access : no_alias_access, prm[n]);
+                slot[n].declare(src, q, prm[n], decl_state);
+            }
+
+            set_parameter_access(decl_state, read_write_access, std::string());
+            for(size_t k = 0; k < s.size(); ++k)
+                s[k]->declare(src, q, prefix[k], decl_state);
+
+            src.close(")").open("{");
+            src.grid_stride_loop().open("{");
+
+            for(size_t n = 0; n < slot.size(); ++n) {
+                src.new_line() << slot[n].type << " " << var[n];
+                if (load[n]) {
+                    src << " = ";
+                    slot[n].element(src, q, prm[n], empty_state());
+                }
+                src << ";";
+            }
+
+            terminal_variables vars;
+            for(size_t k = 0; k < s.size(); ++k)
+                for(size_t i = 0; i < vec[k].size(); ++i)
+                    vars[vec[k][i].term] = var[pos[k][i]];
+
+            auto loc_state  = empty_state();
+            auto expr_state = empty_state();
+            (*expr_state)["terminal_variables"] = vars;
+
+            for(size_t k = 0; k < s.size(); ++k)
+                s[k]->body(src, q, prefix[k], var[pos[k][0]], loc_state, expr_state);
+
+            for(size_t n = 0; n < slot.size(); ++n) {
+                if (!store[n]) continue;
+                src.new_line();
+                slot[n].element(src, q, prm[n], empty_state());
+                src << " = " << var[n] << ";";
+            }
+
+            src.close("}").close("}");
+
+            return src.str();
+        }
+};
+
+// Flushes the queued statements if they use any of the given vectors.
+inline void deferred_sync(const void *a, const void *b = 0) {
+    deferred_queue *q = deferred_queue::active();
+
+    if (q && (q->references(a) || (b && q->references(b))))
+        q->flush();
+}
+
+// Same as deferred_sync(), for use in destructors. Only the statements
+// the vector takes part in are executed.
+inline void deferred_sync_nothrow(const void *a) {
+    deferred_queue *q = deferred_queue::active();
+
+    if (q && q->references(a) && !q->flush_nothrow(a))
+        std::cerr << "Warning: deferred statements failed in a destructor" << std::endl;
+}
+
+// Tells the active deferred queue that the vector has been moved.
+inline bool deferred_move(void *from, void *to, void (*swap)(void*, void*)) noexcept {
+    deferred_queue *q = deferred_queue::active();
+    return !q || q->moved(from, to, swap);
+}
+
+// Queues vector assignment when a vex::deferred scope is active.
+// Returns false if the assignment should be executed immediately.
+template <class OP, class LHS, class RHS>
+typename std::enable_if<
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<RHS>::type,
+        deferred_expr_grammar
+    >::value,
+    bool
+>::type
+defer_assignment(LHS &lhs, const RHS &rhs,
+        const std::vector<backend::command_queue> &queue,
+        const std::vector<size_t> &part
+        )
+{
+    deferred_queue *q = deferred_queue::active();
+    return q && q->push<OP>(lhs, rhs, queue, part);
+}
+
+template <class OP, class LHS, class RHS>
+typename std::enable_if<
+    !boost::proto::matches<
+        typename boost::proto::result_of::as_expr<RHS>::type,
+        deferred_expr_grammar
+    >::value,
+    bool
+>::type
+defer_assignment(LHS&, const RHS&,
+        const std::vector<backend::command_queue>&,
+        const std::vector<size_t>&
+        )
+{
+    if (deferred_queue *q = deferred_queue::active()) q->flush();
+    return false;
+}
+
+} // namespace detail
+
+/// \endcond
+
+/// Defers element-wise vector assignments for the lifetime of the object.
+/**
+ * Assignments of expressions that consist of vectors, arithmetic scalars,
+ * operators and (builtin or user-defined) functions are queued. The queued
+ * statements are executed with a single fused kernel, which reads each
+ * vector once and writes each modified vector once:
+ * \code
+ * {
+ *     vex::deferred lazy;
+ *     r = b - q;
+ *     p = r + beta * p;
+ *     x += alpha * p;
+ * } // Single kernel is launched here.
+ * \endcode
+ * The queue is flushed when the scope ends, when flush() is called, before
+ * any other kernel is launched, before a queued vector is read or written
+ * from the host (including through iterators) or swapped, and when a
+ * statement with a different vector size or partitioning is queued.
+ * Assignments that can not be deferred are executed immediately after the
+ * flush. Destruction of a queued vector executes the statements up to the
+ * last one that uses it. A vector may be move-constructed from a queued
+ * one; the statements are then executed with the original object.
+ *
+ * Scalars are captured by value when the statement is queued. Vectors should
+ * not be accessed through their raw device buffers while the statements are
+ * pending. Deferred scopes may not be nested, and are not thread-safe.
+ */
+class deferred {
+    public:
+        deferred()
+            : prev(backend::kernel::observer()),
+              observer([this](const backend::kernel &k, const backend::command_queue &q) {
+                      queue.flush();
+                      if (prev) (*prev)(k, q);
+                      })
+        {
+            precondition(!detail::deferred_queue::active(), "Nested deferred scope");
+
+            detail::deferred_queue::active() = &queue;
+            backend::kernel::observer() = &observer;
+        }
+
+        ~deferred() {
+            // The first error may be left by a destructor of a queued
+            // vector, the rest of the statements are still executed then.
+            while (std::exception_ptr e = queue.flush_nothrow()) {
+                try {
+                    std::rethrow_exception(e);
+                } catch(const std::exception &err) {
+                    std::cerr << "Warning: deferred statements failed: " << err.what() << std::endl;
+                } catch(...) {
+                    std::cerr << "Warning: deferred statements failed" << std::endl;
+                }
+            }
+
+            detail::deferred_queue::active() = 0;
+            backend::kernel::observer() = prev;
+        }
+
+        /// Executes the queued statements.
+        /**
+         * When statements executed by the destructor of a queued vector
+         * fail, the error is rethrown here (or by the next launch in the
+         * scope). Errors left at the end of the scope are only reported to
+         * std::cerr; call flush() before that to get them as exceptions.
+         */
+        void flush() {
+            queue.flush();
+        }
+
+        /// Number of queued statements.
+        size_t size() const {
+            return queue.size();
+        }
+    private:
+        detail::deferred_queue queue;
+
+        backend::kernel::observer_type *prev;
+        backend::kernel::observer_type  observer;
+
+        deferred(const deferred&);
+        deferred& operator=(const deferred&);
+};
+
+} // namespace vex
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef VEXCL_DETAIL_ACCESS_TRACKER_HPP
+#define VEXCL_DETAIL_ACCESS_TRACKER_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/detail/access_tracker.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Event-based tracking of accesses to device buffers.
+ */
+
+#include <vector>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+namespace detail {
+
+// Tracks pending accesses to a device buffer (e.g. a vector partition) from
+// possibly different command queues. A read has to wait for the last write,
+// and a write has to wait both for the last write and for the reads issued
+// since then.
+//
+// Commands submitted to an in-order queue are implicitly ordered, so no
+// events are recorded for them. When a command on a different queue depends
+// on such an access, a marker is enqueued into the in-order queue on demand.
+// Out-of-order queues get an explicit completion event for each access.
+class access_tracker {
+    public:
+        // Makes the queue wait for the accesses conflicting with the new one.
+        void acquire(const backend::command_queue &q, bool write) {
+            std::vector<backend::event> deps;
+
+            dependencies(q, writes, deps);
+            if (write) dependencies(q, reads, deps);
+
+            backend::enqueue_barrier(q, deps);
+        }
+
+        // Records the access submitted to the queue.
+        // Only the latest read on each queue is kept: a marker completes
+        // after all the commands submitted to the queue before it, so it
+        // covers the earlier reads as well.
+        void release(const backend::command_queue &q, bool write) {
+            bool in_order = get_queue_info(q).in_order;
+
+            if (!write) {
+                for(auto a = reads.begin(); a != reads.end(); ++a) {
+                    if (!same_queue(a->queue, q)) continue;
+
+                    // A marker requested earlier does not cover this read.
+                    a->event.clear();
+                    if (!in_order) a->event.push_back(backend::enqueue_marker(q));
+                    return;
+                }
+            }
+
+            access a(q);
+            if (!in_order) a.event.push_back(backend::enqueue_marker(q));
+
+            if (write) {
+                writes.assign(1, a);
+                reads.clear();
+            } else {
+                reads.push_back(a);
+            }
+        }
+
+        // Blocks until all pending accesses complete.
+        void wait() {
+            std::vector<backend::event> ev;
+
+            for(auto a = writes.begin(); a != writes.end(); ++a) ev.push_back(a->marker());
+            for(auto a = reads.begin();  a != reads.end();  ++a) ev.push_back(a->marker());
+
+            backend::wait_for_events(ev);
+
+            writes.clear();
+            reads.clear();
+        }
+    private:
+        struct access {
+            backend::command_queue queue;
+
+            // Completion event. Empty for in-order queues until requested.
+            std::vector<backend::event> event;
+
+            access(const backend::command_queue &q) : queue(q) {}
+
+            const backend::event& marker() {
+                if (event.empty()) event.push_back(backend::enqueue_marker(queue));
+                return event.front();
+            }
+        };
+
+        std::vector<access> writes;
+        std::vector<access> reads;
+
+        static bool same_queue(const backend::command_queue &a, const backend::command_queue &b) {
+            backend::compare_queues less;
+            return !less(a, b) && !less(b, a);
+        }
+
+        static void dependencies(const backend::command_queue &q,
+                std::vector<access> &acc, std::vector<backend::event> &deps)
+        {
+            for(auto a = acc.begin(); a != acc.end(); ++a) {
+                if (same_queue(a->queue, q) && get_queue_info(q).in_order) continue;
+                deps.push_back(a->marker());
+            }
+        }
+};
+
+} // namespace detail
+} // namespace vex
+
+#endif
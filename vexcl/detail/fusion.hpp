@@ -26,6 +26,8 @@
 #  include <boost/fusion/adapted/std_tuple.hpp>
 #endif
 
+#include <vexcl/memory_pool.hpp>
+
 
 namespace vex {
 namespace detail {
@@ -145,7 +147,8 @@ struct temp_storage {
     temp_storage<K, I + 1> tail;
 
     temp_storage(const backend::command_queue &queue, size_t n)
-        : head(queue, n), tail(queue, n) {}
+        : head(memory_pool::allocate<typename boost::mpl::at_c<K, I>::type>(queue, n)),
+          tail(queue, n) {}
 
     template <size_t J>
     typename std::enable_if<
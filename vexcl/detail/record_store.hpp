@@ -0,0 +1,231 @@
+#ifndef VEXCL_DETAIL_RECORD_STORE_HPP
+#define VEXCL_DETAIL_RECORD_STORE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/detail/record_store.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Keyed records persisted in a file in the binary cache directory.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+namespace detail {
+
+// Records keyed by strings, both stored in a file and found in this session.
+// Each line of the file is "<key> <record>". New records are appended to the
+// file, malformed records (e.g. a line being appended by another process)
+// are ignored, and later records override earlier ones. Once the file grows
+// to twice the number of live records, it is rewritten with a single line
+// per key, keeping at most max_records most recently stored keys.
+//
+// Format should provide
+//   static bool read(std::istream&, Record&);
+//   static void write(std::ostream&, const Record&);
+// Failures to access the file are silently ignored.
+template <class Record, class Format>
+class record_store {
+    public:
+        typedef std::map<std::string, Record> map_type;
+
+        explicit record_store(const std::string &name, size_t max_records = 1024)
+            : path(appdata_path() + path_delim() + name),
+              max_records(max_records), lines(0)
+        {
+            try {
+                sequence s = read(lines);
+                for(auto r = s.begin(); r != s.end(); ++r)
+                    records[r->first] = r->second.second;
+            } catch(...) { }
+        }
+
+        bool find(const std::string &key, Record &r) const {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto p = records.find(key);
+            if (p == records.end()) return false;
+
+            r = p->second;
+            return true;
+        }
+
+        void insert(const std::string &key, const Record &r) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            records[key] = r;
+
+            try {
+                file_guard guard(path);
+
+                {
+                    std::ofstream f(path, std::ios::app);
+                    write(f, key, r);
+                }
+
+                if (++lines > 2 * std::min(records.size(), max_records) + slack)
+                    compact();
+            } catch(...) { }
+        }
+
+        // Records known in this session.
+        map_type all() const {
+            std::lock_guard<std::mutex> lock(mx);
+            return records;
+        }
+
+        // Records currently stored in the file.
+        map_type stored() const {
+            map_type m;
+
+            try {
+                size_t n;
+                sequence s = read(n);
+                for(auto r = s.begin(); r != s.end(); ++r)
+                    m[r->first] = r->second.second;
+            } catch(...) { }
+
+            return m;
+        }
+
+        // Number of lines in the file, as seen by this process.
+        size_t size_on_disk() const {
+            std::lock_guard<std::mutex> lock(mx);
+            return lines;
+        }
+    private:
+        // Compaction is postponed by a few lines, so that small files are
+        // not rewritten on every update.
+        static const size_t slack = 16;
+
+        // Records along with the line number of their last occurrence.
+        typedef std::map<std::string, std::pair<size_t, Record>> sequence;
+
+        // Serializes updates of the file between processes.
+        struct file_guard {
+            boost::interprocess::file_lock flock;
+            boost::interprocess::scoped_lock<boost::interprocess::file_lock> lock;
+
+            file_guard(const std::string &path)
+                : flock(lock_file(path).c_str()), lock(flock) {}
+
+            static std::string lock_file(const std::string &path) {
+                boost::filesystem::create_directories(appdata_path());
+                std::string name = path + ".lock";
+                std::ofstream f(name, std::ios::app);
+                return name;
+            }
+        };
+
+        std::string path;
+        size_t      max_records;
+        size_t      lines;
+        map_type    records;
+
+        mutable std::mutex mx;
+
+        sequence read(size_t &n) const {
+            sequence s;
+            n = 0;
+
+            std::ifstream f(path);
+            std::string line;
+            while(std::getline(f, line)) {
+                std::istringstream l(line);
+                std::string key;
+                Record r;
+
+                if (l >> key && Format::read(l, r))
+                    s[key] = std::make_pair(n, r);
+
+                ++n;
+            }
+
+            return s;
+        }
+
+        static void write(std::ostream &os, const std::string &key, const Record &r) {
+            os << key << " ";
+            Format::write(os, r);
+            os << "\n";
+        }
+
+        // Rewrites the file with the most recent record of each key. The file
+        // is reread, so that records of other processes are kept. Should be
+        // called under the file lock.
+        void compact() {
+            size_t n;
+            sequence s = read(n);
+
+            std::vector<typename sequence::const_iterator> order;
+            order.reserve(s.size());
+            for(auto r = s.begin(); r != s.end(); ++r) order.push_back(r);
+
+            std::sort(order.begin(), order.end(),
+                    [](typename sequence::const_iterator a, typename sequence::const_iterator b) {
+                        return a->second.first < b->second.first;
+                    });
+
+            if (order.size() > max_records)
+                order.erase(order.begin(), order.end() - max_records);
+
+            std::string tmp = (boost::filesystem::path(appdata_path()) /
+                    boost::filesystem::unique_path("%%%%-%%%%-%%%%-%%%%.tmp")).string();
+            {
+                std::ofstream f(tmp);
+                for(auto r = order.begin(); r != order.end(); ++r)
+                    write(f, (*r)->first, (*r)->second.second);
+
+                f.close();
+                if (!f) {
+                    boost::system::error_code ec;
+                    boost::filesystem::remove(tmp, ec);
+                    return;
+                }
+            }
+            boost::filesystem::rename(tmp, path);
+
+            lines = order.size();
+        }
+};
+
+} // namespace detail
+} // namespace vex
+
+#endif
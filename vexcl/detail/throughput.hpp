@@ -0,0 +1,148 @@
+#ifndef VEXCL_DETAIL_THROUGHPUT_HPP
+#define VEXCL_DETAIL_THROUGHPUT_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/**
+ * \file   vexcl/detail/throughput.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Measured throughput of element-wise kernels on each device.
+ */
+
+#include <vector>
+#include <map>
+#include <limits>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+namespace detail {
+
+// Accumulates number of processed elements and device time of element-wise
+// kernel launches for each device. The launches are bracketed with timestamp
+// events, which are resolved when the throughput is requested, or when too
+// many of them are pending.
+class throughput_meter {
+    public:
+        static throughput_meter& instance() {
+            static throughput_meter m;
+            return m;
+        }
+
+        std::atomic<bool> enabled;
+
+        // Measures a single launch. Should be followed by done() once the
+        // launch is enqueued.
+        class sample {
+            public:
+                sample(const backend::command_queue &q, size_t work)
+                    : active(instance().enabled && work && backend::profiling_enabled(q)),
+                      q(q), work(work)
+                {
+                    if (active) start = backend::enqueue_timestamp(q);
+                }
+
+                void done() {
+                    if (!active) return;
+
+                    backend::event stop = backend::enqueue_timestamp(q);
+
+                    throughput_meter &m = instance();
+                    std::lock_guard<std::mutex> lock(m.mx);
+
+                    device &dev = m.devices[get_queue_info(q).device];
+                    dev.pending.push_back(launch{start, stop, work});
+
+                    // Fold the older half of the launches, which most
+                    // probably have completed by now.
+                    if (dev.pending.size() >= max_pending)
+                        dev.resolve(max_pending / 2);
+                }
+            private:
+                bool active;
+                const backend::command_queue &q;
+                size_t work;
+                backend::event start;
+        };
+
+        // Returns number of elements processed per second on each of the
+        // measured devices. Waits for the measured launches to complete.
+        std::map<backend::device_id, double> rates() {
+            std::lock_guard<std::mutex> lock(mx);
+
+            std::map<backend::device_id, double> r;
+            for(auto d = devices.begin(); d != devices.end(); ++d) {
+                d->second.resolve();
+                if (d->second.time > 0)
+                    r[d->first] = d->second.elements / d->second.time;
+            }
+
+            return r;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mx);
+            devices.clear();
+        }
+    private:
+        struct launch {
+            backend::event start, stop;
+            size_t work;
+        };
+
+        struct device {
+            double elements;
+            double time;
+            std::vector<launch> pending;
+
+            device() : elements(0), time(0) {}
+
+            // Accumulates the first n pending launches (all by default).
+            void resolve(size_t n = std::numeric_limits<size_t>::max()) {
+                auto last = pending.begin() + std::min(n, pending.size());
+                for(auto l = pending.begin(); l != last; ++l) {
+                    elements += l->work;
+                    time     += backend::elapsed(l->start, l->stop);
+                }
+                pending.erase(pending.begin(), last);
+            }
+        };
+
+        static const size_t max_pending = 1024;
+
+        std::mutex mx;
+        std::map<backend::device_id, device> devices;
+
+        throughput_meter() : enabled(false) {}
+};
+
+} // namespace detail
+} // namespace vex
+
+#endif
@@ -0,0 +1,238 @@
+#ifndef VEXCL_DEVICE_PROFILE_HPP
+#define VEXCL_DEVICE_PROFILE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/**
+ * \file   vexcl/device_profile.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Measured performance characteristics of compute devices.
+ *
+ * Device profiles are measured with a few small benchmark kernels on first
+ * request, and are stored in the "devices" file in the binary cache
+ * directory. Later runs on the same host with the same device and driver
+ * read the stored profiles instead of measuring. Profiles are used to weight
+ * devices when vectors are partitioned between several queues.
+ */
+
+#include <string>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+#include <cstdlib>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <unistd.h>
+#endif
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+#include <vexcl/detail/record_store.hpp>
+
+namespace vex {
+
+/// Measured performance characteristics of compute devices.
+namespace device_profile {
+
+/// Performance characteristics of a device.
+struct record {
+    double weight;     ///< Partitioning weight (elements of a = b + c processed per second).
+    double bandwidth;  ///< Memory bandwidth of a = b + c in GB/s.
+    double latency;    ///< Kernel launch latency in seconds.
+    double compute;    ///< Single precision compute rate in GFLOPS.
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+inline std::string host_name() {
+#ifdef _WIN32
+    char name[MAX_COMPUTERNAME_LENGTH + 1];
+    DWORD size = sizeof(name);
+    if (GetComputerNameA(name, &size)) return name;
+#else
+    char name[256];
+    if (gethostname(name, sizeof(name)) == 0) {
+        name[sizeof(name) - 1] = 0;
+        return name;
+    }
+#endif
+    return "localhost";
+}
+
+// Profiles are keyed by device, its number of compute units (sub-devices
+// created by fission share the name of the whole device), driver and host.
+inline std::string key(const backend::command_queue &q) {
+    std::ostringstream dev;
+    dev << q << "\n" << get_queue_info(q).compute_units
+        << "\n" << backend::driver_version(q) << "\n" << host_name();
+    return sha1(dev.str());
+}
+
+// Stores records of the form
+// "<key> <weight> <bandwidth> <latency> <compute>".
+struct record_format {
+    static bool read(std::istream &is, record &r) {
+        return static_cast<bool>(
+                is >> r.weight >> r.bandwidth >> r.latency >> r.compute);
+    }
+
+    static void write(std::ostream &os, const record &r) {
+        os << std::scientific << std::setprecision(6)
+           << r.weight << " " << r.bandwidth << " "
+           << r.latency << " " << r.compute;
+    }
+};
+
+typedef vex::detail::record_store<record, record_format> store_type;
+
+// Known profiles, both stored and measured in this session.
+inline store_type& store() {
+    static store_type s("devices");
+    return s;
+}
+
+// Wall clock time of the kernel launch, including the launch overhead.
+inline double launch_time(backend::kernel &K, const backend::command_queue &q) {
+    q.finish();
+    auto start = std::chrono::high_resolution_clock::now();
+    K(q);
+    q.finish();
+    return std::chrono::duration<double>(
+            std::chrono::high_resolution_clock::now() - start).count();
+}
+
+inline std::string benchmark_source(const backend::command_queue &q) {
+    backend::source_generator src(q);
+
+    src.kernel("vexcl_bandwidth_kernel").open("(")
+        .template parameter< size_t >("n")
+        .template parameter< global_ptr<float> >("a")
+        .template parameter< global_ptr<float> >("b")
+        .template parameter< global_ptr<float> >("c")
+        .close(")").open("{").grid_stride_loop().open("{");
+    src.new_line() << "a[idx] = b[idx] + c[idx];";
+    src.close("}").close("}");
+
+    src.kernel("vexcl_compute_kernel").open("(")
+        .template parameter< size_t >("n")
+        .template parameter< global_ptr<float> >("a")
+        .template parameter< global_ptr<float> >("b")
+        .close(")").open("{").grid_stride_loop().open("{");
+    src.new_line() << "float x = b[idx];";
+    src.new_line() << "float y = x;";
+    src.new_line() << "for(int k = 0; k < 64; ++k) x = x * y + 0.5f;";
+    src.new_line() << "a[idx] = x;";
+    src.close("}").close("}");
+
+    return src.str();
+}
+
+inline record measure(const backend::command_queue &q) {
+    const size_t n = 1024 * 1024;
+    const int    runs = 4;
+
+    backend::select_context(q);
+
+    // Benchmark launches should not end up in a captured graph.
+    struct observer_guard {
+        backend::kernel::observer_type *observer;
+
+        observer_guard() : observer(backend::kernel::observer()) {
+            backend::kernel::observer() = 0;
+        }
+
+        ~observer_guard() {
+            backend::kernel::observer() = observer;
+        }
+    } guard;
+
+    std::string src = benchmark_source(q);
+    backend::kernel bw(q, src, "vexcl_bandwidth_kernel");
+    backend::kernel fp(q, src, "vexcl_compute_kernel");
+
+    backend::device_vector<float> a(q, n);
+    backend::device_vector<float> b(q, n, std::vector<float>(n, 1.0f).data());
+    backend::device_vector<float> c(q, n, std::vector<float>(n, 1.0f).data());
+
+    double t_bw  = std::numeric_limits<double>::max();
+    double t_fp  = std::numeric_limits<double>::max();
+    double t_lat = std::numeric_limits<double>::max();
+
+    // The first launch of each kernel is skipped.
+    for(int i = 0; i <= runs; ++i) {
+        bw.push_arg(n); bw.push_arg(a); bw.push_arg(b); bw.push_arg(c);
+        double t = launch_time(bw, q);
+        if (i) t_bw = std::min(t_bw, t);
+
+        fp.push_arg(n); fp.push_arg(a); fp.push_arg(b);
+        t = launch_time(fp, q);
+        if (i) t_fp = std::min(t_fp, t);
+
+        bw.push_arg(size_t(1)); bw.push_arg(a); bw.push_arg(b); bw.push_arg(c);
+        t = launch_time(bw, q);
+        if (i) t_lat = std::min(t_lat, t);
+    }
+
+    record r;
+    r.weight    = n / t_bw;
+    r.bandwidth = 3.0 * n * sizeof(float) / t_bw * 1e-9;
+    r.latency   = t_lat;
+    r.compute   = 2.0 * 64 * n / t_fp * 1e-9;
+
+    return r;
+}
+
+} // namespace detail
+/// \endcond
+
+/// Measures the device profile, and stores it for later runs.
+inline record measure(const backend::command_queue &q) {
+    record r = detail::measure(q);
+    std::string key = detail::key(q);
+
+    detail::store().insert(key, r);
+    return r;
+}
+
+/// Returns the stored device profile, or measures it if none is known.
+inline record get(const backend::command_queue &q) {
+    std::string key = detail::key(q);
+
+    record r;
+    if (detail::store().find(key, r)) return r;
+
+    return measure(q);
+}
+
+} // namespace device_profile
+} // namespace vex
+
+#endif
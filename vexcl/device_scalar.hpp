@@ -0,0 +1,349 @@
+#ifndef VEXCL_DEVICE_SCALAR_HPP
+#define VEXCL_DEVICE_SCALAR_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/device_scalar.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Scalar value stored in device memory.
+ */
+
+#include <vector>
+#include <string>
+#include <type_traits>
+
+#include <boost/proto/proto.hpp>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/operations.hpp>
+#include <vexcl/detail/access_tracker.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+
+struct device_scalar_terminal {};
+
+typedef vector_expression<
+    typename boost::proto::terminal< device_scalar_terminal >::type
+    > device_scalar_terminal_expression;
+
+namespace traits {
+
+// Hold device scalar terminals by reference:
+template <class T>
+struct hold_terminal_by_reference< T,
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr< T >::type,
+                boost::proto::terminal< device_scalar_terminal >
+            >::value
+        >::type
+    >
+    : std::true_type
+{ };
+
+// Terminals that may be used in device scalar expressions. These are
+// device scalars and arithmetic scalars.
+template <class Term, class Enable = void>
+struct is_device_scalar_expr_terminal : std::is_arithmetic<Term> {};
+
+template <>
+struct is_device_scalar_expr_terminal< device_scalar_terminal > : std::true_type {};
+
+} // namespace traits
+
+// Grammar for expressions that are evaluated on the device and assigned to
+// a device scalar.
+struct device_scalar_expr_grammar
+    : boost::proto::or_<
+          boost::proto::and_<
+              boost::proto::terminal< boost::proto::_ >,
+              boost::proto::if_< traits::is_device_scalar_expr_terminal< boost::proto::_value >() >
+          >,
+          VEXCL_BUILTIN_OPERATIONS(device_scalar_expr_grammar),
+          VEXCL_USER_FUNCTIONS(device_scalar_expr_grammar)
+      >
+{};
+
+/// \endcond
+
+/// Scalar value stored in device memory.
+/**
+ * Each device in the queue list holds its own copy of the value. A device
+ * scalar may be used as a terminal in vector expressions, in which case the
+ * value is read by the kernel, and may be assigned a result of a reduction
+ * (see vex::Reductor) or an expression of other device scalars. None of
+ * these operations needs host synchronization:
+ * \code
+ * vex::Reductor<double, vex::SUM> sum(ctx);
+ * vex::device_scalar<double> rr(ctx), pAp(ctx), alpha(ctx);
+ *
+ * sum(rr,  r * r);
+ * sum(pAp, p * Ap);
+ * alpha = rr / pAp;
+ *
+ * x += alpha * p;
+ * r -= alpha * Ap;
+ * \endcode
+ */
+template <typename T>
+class device_scalar : public device_scalar_terminal_expression {
+    public:
+        typedef T value_type;
+
+        /// Allocates the scalar on each device in the queue list.
+        device_scalar(const std::vector<backend::command_queue> &queue
+#ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
+                = current_context().queue()
+#endif
+                , const T &value = T()
+                ) : queue(queue), acc(queue.size())
+        {
+            allocate();
+            *this = value;
+        }
+
+        /// Copy constructor. The value is copied on the device.
+        device_scalar(const device_scalar &s) : queue(s.queue), acc(queue.size()) {
+            allocate();
+            assign(s);
+        }
+
+        ~device_scalar() {
+            try {
+                backend::wait_for_events(host_writes);
+            } catch(...) { }
+        }
+
+        /// Sets the value on each device.
+        /**
+         * The write does not block. The value is kept in the object until the
+         * write completes.
+         */
+        const device_scalar& operator=(const T &value) {
+            backend::wait_for_events(host_writes);
+            host_writes.clear();
+
+            host_value = value;
+
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                acc[d].acquire(queue[d], true);
+                buf[d].write(queue[d], 0, 1, &host_value, false);
+                host_writes.push_back(backend::enqueue_marker(queue[d]));
+                acc[d].release(queue[d], true);
+            }
+
+            return *this;
+        }
+
+        /// Copies the value on each device.
+        const device_scalar& operator=(const device_scalar &s) {
+            if (this != &s) assign(s);
+            return *this;
+        }
+
+        /// Evaluates an expression of device scalars on each device.
+        template <class Expr>
+#ifdef DOXYGEN
+        const device_scalar&
+#else
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<Expr>::type,
+                device_scalar_expr_grammar
+            >::value,
+            const device_scalar&
+        >::type
+#endif
+        operator=(const Expr &expr) {
+            assign(expr);
+            return *this;
+        }
+
+        /// Reads the value from the first device.
+        /**
+         * This waits for the commands submitted to the queue to complete.
+         */
+        T get() const {
+            T value;
+            acc[0].acquire(queue[0], false);
+            buf[0].read(queue[0], 0, 1, &value, true);
+            acc[0].release(queue[0], false);
+            return value;
+        }
+
+        /// Device buffer holding the value on the d-th device.
+        const backend::device_vector<T>& operator()(unsigned d = 0) const {
+            return buf[d];
+        }
+
+        /// Returns the queue list.
+        const std::vector<backend::command_queue>& queue_list() const {
+            return queue;
+        }
+
+        /// \cond INTERNAL
+        /// Tracks pending accesses to the value on a given device.
+        detail::access_tracker& access(unsigned d = 0) const {
+            return acc[d];
+        }
+        /// \endcond
+    private:
+        std::vector<backend::command_queue> queue;
+        std::vector< backend::device_vector<T> > buf;
+        mutable std::vector<detail::access_tracker> acc;
+
+        // Source of the pending non-blocking writes.
+        T host_value;
+        std::vector<backend::event> host_writes;
+
+        void allocate() {
+            buf.reserve(queue.size());
+            for(unsigned d = 0; d < queue.size(); ++d)
+                buf.push_back(backend::device_vector<T>(queue[d], 1));
+        }
+
+        // A single work item evaluates the expression on each device.
+        template <class Expr>
+        void assign(const Expr &expr) {
+            using namespace detail;
+
+            static kernel_cache cache;
+
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                auto kernel = cache.find(queue[d]);
+
+                backend::select_context(queue[d]);
+
+                if (kernel == cache.end()) {
+                    backend::source_generator source(queue[d]);
+
+                    output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
+                    boost::proto::eval(boost::proto::as_child(expr), termpream);
+
+                    source.kernel("vexcl_device_scalar_kernel")
+                        .open("(")
+                        .template parameter< global_ptr<T> >("result");
+
+                    declare_expression_parameter declare(source, queue[d], "prm",
+                            empty_state(), read_only_access);
+                    extract_terminals()(boost::proto::as_child(expr), declare);
+
+                    source.close(")").open("{");
+
+                    output_local_preamble loc_init(source, queue[d], "prm", empty_state());
+                    boost::proto::eval(boost::proto::as_child(expr), loc_init);
+
+                    vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
+                    source.new_line() << "result[0] = ";
+                    boost::proto::eval(boost::proto::as_child(expr), expr_ctx);
+                    source << ";";
+                    source.close("}");
+
+                    kernel = cache.insert(queue[d], backend::kernel(
+                                queue[d], source.str(), "vexcl_device_scalar_kernel"));
+                    kernel->second.config(1, 1);
+                }
+
+                access_list a;
+                a.write(*this, d).read(expr, d).acquire(queue[d]);
+
+                kernel->second.push_arg(buf[d]);
+                extract_terminals()(boost::proto::as_child(expr),
+                        set_expression_argument(kernel->second, d, 0, empty_state()));
+
+                kernel->second(queue[d]);
+
+                a.release(queue[d]);
+            }
+        }
+};
+
+/// \cond INTERNAL
+namespace traits {
+
+template <>
+struct is_vector_expr_terminal< device_scalar_terminal > : std::true_type {};
+
+template <>
+struct proto_terminal_is_value< device_scalar_terminal > : std::true_type {};
+
+template <typename T>
+struct kernel_param_declaration< device_scalar<T> > {
+    static void get(backend::source_generator &src,
+            const device_scalar<T>&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src.parameter< global_ptr<const T> >(prm_name);
+    }
+};
+
+// Every element of the expression sees the same value:
+template <typename T>
+struct partial_vector_expr< device_scalar<T> > {
+    static void get(backend::source_generator &src,
+            const device_scalar<T>&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src << prm_name << "[0]";
+    }
+};
+
+template <typename T>
+struct kernel_arg_setter< device_scalar<T> > {
+    static void set(const device_scalar<T> &term,
+            backend::kernel &kernel, unsigned device, size_t/*index_offset*/,
+            detail::kernel_generator_state_ptr)
+    {
+        kernel.push_arg(term(device));
+    }
+};
+
+// Note that expression_properties is not specialized: device scalars, like
+// host scalars, have neither size nor partitioning.
+template <class T>
+struct terminal_access_tracker< device_scalar<T> > {
+    static detail::access_tracker* get(const device_scalar<T> &term, unsigned device) {
+        return &term.access(device);
+    }
+};
+
+template <class T>
+struct terminal_buffer_id< device_scalar<T> > {
+    static size_t get(const device_scalar<T> &term, unsigned device) {
+        return (size_t)term(device).raw();
+    }
+};
+
+} // namespace traits
+/// \endcond
+
+} // namespace vex
+
+#endif
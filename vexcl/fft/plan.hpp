@@ -224,8 +224,8 @@ struct plan {
 
         size_t total_n = std::accumulate(sizes.begin(), sizes.end(),
             static_cast<size_t>(1), std::multiplies<size_t>());
-        size_t current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n));
-        size_t other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n));
+        size_t current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n, memory_pool::pooled));
+        size_t other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n, memory_pool::pooled));
 
         size_t inv_n = 1;
         for(size_t i = 0 ; i < sizes.size() ; i++)
@@ -272,11 +272,11 @@ struct plan {
         size_t conv_n = planner.best_size(2 * n);
         size_t threads = width / n;
 
-        size_t b_twiddle = bufs.size(); bufs.push_back(vex::vector<T2>(queues, n));
-        size_t b_other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n));
-        size_t b_current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n));
-        size_t a_current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n * batch * threads));
-        size_t a_other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n * batch * threads));
+        size_t b_twiddle = bufs.size(); bufs.push_back(vex::vector<T2>(queues, n, memory_pool::pooled));
+        size_t b_other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n, memory_pool::pooled));
+        size_t b_current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n, memory_pool::pooled));
+        size_t a_current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n * batch * threads, memory_pool::pooled));
+        size_t a_other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, conv_n * batch * threads, memory_pool::pooled));
 
         // calculate twiddle factors
         kernels.push_back(bluestein_twiddle<Ts>(queues[0], n, inverse,
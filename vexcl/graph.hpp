@@ -0,0 +1,244 @@
+#ifndef VEXCL_GRAPH_HPP
+#define VEXCL_GRAPH_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/**
+ * \file   vexcl/graph.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Capture and replay of kernel launch sequences.
+ *
+ * Kernel launches made while a vex::capture object is alive are recorded
+ * into a vex::graph together with their argument bindings. The graph may
+ * then be replayed without regenerating the kernel arguments. Values of
+ * vex::graph_scalar terminals may be changed between the replays.
+ *
+ * Only device kernel launches are recorded. Host-side parts of operations
+ * (e.g. final stage of reductions, host-device transfers, or halo exchange
+ * in multi-device sparse matrix-vector products) are not replayed. Vectors
+ * used by the recorded kernels should outlive the graph, and the queues
+ * these were created for should remain valid.
+ */
+
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/operations.hpp>
+#include <vexcl/memory_pool.hpp>
+#include <vexcl/util.hpp>
+
+namespace vex {
+
+/// Recorded sequence of kernel launches.
+/**
+ * \code
+ * vex::graph g;
+ * vex::graph_scalar<double> alpha;
+ * {
+ *     vex::capture c(g);
+ *     y = alpha * x + y;
+ *     z = sin(y);
+ * }
+ * for(int i = 0; i < n; ++i) {
+ *     alpha = i;
+ *     g.replay();
+ * }
+ * \endcode
+ */
+class graph {
+    public:
+        /// Launches the recorded kernels in the order of capture.
+        void replay() {
+            for(auto l = launches.begin(); l != launches.end(); ++l) {
+                for(auto b = l->bind.begin(); b != l->bind.end(); ++b)
+                    (*b)(l->krn);
+
+                l->krn.launch(l->queue);
+            }
+        }
+
+        /// Number of recorded kernel launches.
+        size_t size() const {
+            return launches.size();
+        }
+
+        /// Drops the recorded launches.
+        void clear() {
+            launches.clear();
+            scratch.clear();
+        }
+
+        /// \cond INTERNAL
+        typedef std::function<void(backend::kernel&)> binding;
+
+        // The graph that is being captured.
+        static graph*& active() {
+            static graph *g = 0;
+            return g;
+        }
+
+        // Binds an argument of the kernel that is being set up to a value
+        // that is reread on each replay.
+        void bind(binding b) {
+            pending.push_back(std::move(b));
+        }
+        /// \endcond
+    private:
+        struct launch {
+            backend::kernel         krn;
+            backend::command_queue  queue;
+            std::vector<binding>    bind;
+
+            launch(const backend::kernel &krn, const backend::command_queue &queue)
+                : krn(krn.clone()), queue(queue)
+            {}
+        };
+
+        std::vector<launch> launches;
+
+        // Bindings of the arguments for the launch that is being set up.
+        std::vector<binding> pending;
+
+        // Pooled buffers used by the recorded kernels.
+        std::vector< std::shared_ptr<void> > scratch;
+
+        friend class capture;
+
+        void record(const backend::kernel &krn, const backend::command_queue &q) {
+            launches.push_back(launch(krn, q));
+            launches.back().bind.swap(pending);
+        }
+};
+
+/// Records kernel launches into a graph for the lifetime of the object.
+/**
+ * Recorded operations are executed as usual during the capture. Capturing
+ * is not thread-safe, and captures may not be nested.
+ */
+class capture {
+    public:
+        capture(graph &g)
+            : prev(backend::kernel::observer()),
+              observer([&g, this](const backend::kernel &k, const backend::command_queue &q) {
+                    if (prev) {
+                        // The chained observer may launch kernels of its own
+                        // (e.g. flush vex::deferred statements).
+                        std::vector<graph::binding> bind;
+                        bind.swap(g.pending);
+                        (*prev)(k, q);
+                        g.pending.swap(bind);
+                    }
+                    g.record(k, q);
+                    })
+        {
+            precondition(!graph::active(), "Nested graph capture");
+
+            graph::active() = &g;
+            backend::kernel::observer() = &observer;
+            memory_pool::detail::capture_sink() = &g.scratch;
+        }
+
+        ~capture() {
+            graph::active()->pending.clear();
+
+            graph::active() = 0;
+            backend::kernel::observer() = prev;
+            memory_pool::detail::capture_sink() = 0;
+        }
+    private:
+        backend::kernel::observer_type *prev;
+        backend::kernel::observer_type  observer;
+
+        capture(const capture&);
+        capture& operator=(const capture&);
+};
+
+/// Scalar kernel parameter that may be changed between graph replays.
+template <typename T>
+struct graph_scalar {
+    typedef T value_type;
+
+    std::shared_ptr<T> value;
+
+    graph_scalar(const T &v = T()) : value(std::make_shared<T>(v)) {}
+
+    /// Sets new value for the next launches and graph replays.
+    graph_scalar& operator=(const T &v) {
+        *value = v;
+        return *this;
+    }
+
+    /// Current value.
+    T get() const {
+        return *value;
+    }
+};
+
+/// \cond INTERNAL
+namespace traits {
+
+template <typename T>
+struct is_vector_expr_terminal< graph_scalar<T> > : std::true_type {};
+
+template <typename T>
+struct kernel_param_declaration< graph_scalar<T> >
+{
+    static void get(backend::source_generator &src,
+            const graph_scalar<T>&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src.parameter<T>(prm_name);
+    }
+};
+
+template <typename T>
+struct kernel_arg_setter< graph_scalar<T> >
+{
+    static void set(const graph_scalar<T> &term,
+            backend::kernel &kernel, unsigned/*part*/, size_t/*index_offset*/,
+            detail::kernel_generator_state_ptr)
+    {
+        if (graph *g = graph::active()) {
+            unsigned pos = kernel.next_arg();
+            std::shared_ptr<T> value = term.value;
+
+            g->bind([pos, value](backend::kernel &k) {
+                    k.set_arg(pos, *value);
+                    });
+        }
+
+        kernel.push_arg(*term.value);
+    }
+};
+
+} // namespace traits
+/// \endcond
+
+} // namespace vex
+
+#endif
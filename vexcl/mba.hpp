@@ -39,6 +39,7 @@ THE SOFTWARE.
 #include <numeric>
 #include <type_traits>
 #include <cassert>
+#include <cmath>
 
 #include <boost/tuple/tuple.hpp>
 #include <boost/fusion/adapted/boost_tuple.hpp>
@@ -0,0 +1,318 @@
+#ifndef VEXCL_MEMORY_POOL_HPP
+#define VEXCL_MEMORY_POOL_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/memory_pool.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Per-queue caching allocator for temporary device buffers.
+ *
+ * Buffers released to the pool are kept in per-queue free lists indexed by
+ * size class, and are handed out again to later requests of the same size
+ * class on the same queue. Since the commands submitted to an in-order queue
+ * are executed in order, a released buffer may be reused right away, even if
+ * the kernels that used it are still running.
+ */
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <exception>
+#include <cstdlib>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/common.hpp>
+
+namespace vex {
+
+/// Per-queue caching allocator for temporary device buffers.
+/**
+ * Total size of the cached (unused) buffers is limited by size_limit(). The
+ * default limit is 256 MB and may be changed with VEXCL_POOL_SIZE
+ * environment variable (in megabytes). Zero limit disables caching.
+ */
+namespace memory_pool {
+
+/// Memory pool usage statistics.
+struct statistics {
+    size_t allocations;  ///< Buffers allocated on a device.
+    size_t reuses;       ///< Requests served from the free lists.
+    size_t releases;     ///< Buffers returned to a device.
+    size_t bytes_in_use; ///< Memory held by live buffers.
+    size_t bytes_cached; ///< Memory held by the free lists.
+
+    statistics()
+        : allocations(0), reuses(0), releases(0),
+          bytes_in_use(0), bytes_cached(0)
+    {}
+};
+
+/// Tag selecting pool allocation in vex::vector constructor.
+struct pooled_t {};
+static const pooled_t pooled = {};
+
+/// \cond INTERNAL
+namespace detail {
+
+// Rounds allocation size up to a size class. Small sizes are rounded to a
+// power of two, larger ones to a multiple of p/8, where p is the next power
+// of two. That gives four classes within each (p/2, p] range, so that at most
+// 25% of the allocated memory is wasted.
+inline size_t size_class(size_t bytes) {
+    size_t p = 256;
+    while(p < bytes) p <<= 1;
+
+    if (p <= 4096) return p;
+
+    size_t step = p / 8;
+    return (bytes + step - 1) / step * step;
+}
+
+inline size_t default_size_limit() {
+#ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4996)
+#endif
+    const char *s = getenv("VEXCL_POOL_SIZE");
+#ifdef _MSC_VER
+#  pragma warning(pop)
+#endif
+    return (s ? static_cast<size_t>(atol(s)) : 256) << 20;
+}
+
+class pool {
+    public:
+        typedef backend::device_vector<char> buffer;
+
+        static std::shared_ptr<pool> instance() {
+            static std::shared_ptr<pool> p(new pool());
+            return p;
+        }
+
+        // Returns a buffer of at least the given size. The keeper puts the
+        // buffer back to the free list when the last reference is gone.
+        buffer acquire(const backend::command_queue &q, size_t bytes,
+                std::shared_ptr<void> &keeper)
+        {
+            size_t size = size_class(bytes);
+
+            buffer buf;
+            std::vector<backend::event> ready;
+            bool found = false;
+
+            {
+                std::lock_guard<std::mutex> lock(mx);
+
+                auto l = store.find(q);
+                if (l != store.end()) {
+                    auto b = l->second.find(size);
+                    if (b != l->second.end() && !b->second.empty()) {
+                        buf   = b->second.back().buf;
+                        ready = b->second.back().ready;
+                        b->second.pop_back();
+
+                        found = true;
+                        ++stat.reuses;
+                        stat.bytes_cached -= size;
+                    }
+                }
+
+                if (!found) ++stat.allocations;
+                stat.bytes_in_use += size;
+            }
+
+            if (found) {
+                backend::enqueue_barrier(q, ready);
+            } else {
+                try {
+                    buf = buffer(q, size);
+                } catch(const std::exception&) {
+                    // Out of memory? Release cached buffers and retry.
+                    trim();
+                    buf = buffer(q, size);
+                }
+            }
+
+            keeper = std::make_shared<handle>(instance(), q, buf, size);
+            return buf;
+        }
+
+        void trim() {
+            std::lock_guard<std::mutex> lock(mx);
+            for(auto l = store.begin(); l != store.end(); ++l)
+                drop(l->second);
+            store.clear();
+        }
+
+        void trim(const backend::command_queue &q) {
+            std::lock_guard<std::mutex> lock(mx);
+            auto l = store.find(q);
+            if (l != store.end()) {
+                drop(l->second);
+                store.erase(l);
+            }
+        }
+
+        size_t size_limit() const {
+            return limit;
+        }
+
+        void set_size_limit(size_t bytes) {
+            bool over;
+            {
+                std::lock_guard<std::mutex> lock(mx);
+                limit = bytes;
+                over  = stat.bytes_cached > limit;
+            }
+            if (over) trim();
+        }
+
+        statistics stats() {
+            std::lock_guard<std::mutex> lock(mx);
+            return stat;
+        }
+    private:
+        struct block {
+            buffer buf;
+            // Completion markers for out-of-order queues.
+            std::vector<backend::event> ready;
+        };
+
+        typedef std::map<size_t, std::vector<block>> free_list;
+
+        // Returns the buffer to the pool when the last user is gone.
+        struct handle {
+            std::weak_ptr<pool>    owner;
+            backend::command_queue queue;
+            buffer                 buf;
+            size_t                 size;
+            bool                   in_order;
+
+            handle(std::shared_ptr<pool> owner, const backend::command_queue &q,
+                    const buffer &buf, size_t size)
+                : owner(owner), queue(q), buf(buf), size(size),
+                  in_order(get_queue_info(q).in_order)
+            {}
+
+            ~handle() {
+                if (auto p = owner.lock()) p->release(queue, buf, size, in_order);
+            }
+        };
+
+        std::mutex mx;
+        std::map<backend::command_queue, free_list, backend::compare_queues> store;
+        statistics stat;
+        size_t limit;
+
+        pool() : limit(default_size_limit()) {}
+
+        void release(const backend::command_queue &q, const buffer &buf,
+                size_t size, bool in_order)
+        {
+            block b;
+            b.buf = buf;
+            if (!in_order)
+                b.ready.push_back(backend::enqueue_marker(q));
+
+            std::lock_guard<std::mutex> lock(mx);
+
+            stat.bytes_in_use -= size;
+
+            if (stat.bytes_cached + size > limit) {
+                ++stat.releases;
+                return;
+            }
+
+            store[q][size].push_back(b);
+            stat.bytes_cached += size;
+        }
+
+        void drop(free_list &l) {
+            for(auto b = l.begin(); b != l.end(); ++b) {
+                stat.releases     += b->second.size();
+                stat.bytes_cached -= b->first * b->second.size();
+            }
+        }
+};
+
+// While a command graph is captured, keepers of the allocated buffers are
+// stored here so that the scratch memory outlives the recorded launches.
+inline std::vector< std::shared_ptr<void> >*& capture_sink() {
+    static std::vector< std::shared_ptr<void> > *s = 0;
+    return s;
+}
+
+} // namespace detail
+/// \endcond
+
+/// Allocates uninitialized device buffer from the pool.
+/**
+ * The buffer goes back to the pool when the last copy of the returned
+ * device_vector is destroyed, and may only be reused by the same queue.
+ */
+template <typename T>
+backend::device_vector<T> allocate(const backend::command_queue &q, size_t n) {
+    if (!n) return backend::device_vector<T>();
+
+    std::shared_ptr<void> keeper;
+    auto bytes = detail::pool::instance()->acquire(q, n * sizeof(T), keeper);
+
+    if (detail::capture_sink()) detail::capture_sink()->push_back(keeper);
+
+    return backend::device_vector<T>(q, bytes, n, keeper);
+}
+
+/// Releases cached buffers.
+inline void trim() {
+    detail::pool::instance()->trim();
+}
+
+/// Releases buffers cached for the given queue.
+inline void trim(const backend::command_queue &q) {
+    detail::pool::instance()->trim(q);
+}
+
+/// Returns memory pool usage statistics.
+inline statistics stats() {
+    return detail::pool::instance()->stats();
+}
+
+/// Returns size limit (in bytes) for the cached buffers.
+inline size_t size_limit() {
+    return detail::pool::instance()->size_limit();
+}
+
+/// Sets size limit (in bytes) for the cached buffers.
+inline void set_size_limit(size_t bytes) {
+    detail::pool::instance()->set_size_limit(bytes);
+}
+
+} // namespace memory_pool
+} // namespace vex
+
+#endif
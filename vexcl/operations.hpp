@@ -36,15 +36,19 @@ THE SOFTWARE.
 #include <deque>
 #include <set>
 #include <memory>
+#include <algorithm>
 
 #include <boost/proto/proto.hpp>
 #include <boost/mpl/max.hpp>
 #include <boost/any.hpp>
+#include <boost/fusion/include/for_each.hpp>
 
 #include <vexcl/backend.hpp>
 #include <vexcl/types.hpp>
 #include <vexcl/util.hpp>
 #include <vexcl/cache.hpp>
+#include <vexcl/detail/access_tracker.hpp>
+#include <vexcl/autotune.hpp>
 
 // Workaround for gcc bug http://gcc.gnu.org/bugzilla/show_bug.cgi?id=35722
 #if defined(BOOST_NO_VARIADIC_TEMPLATES) || (defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 4 && __GNUC_MINOR__ == 6)
@@ -94,6 +98,68 @@ inline kernel_generator_state_ptr empty_state() {
     return std::make_shared<kernel_generator_state>();
 }
 
+// How a kernel accesses the buffers of the terminals in an expression.
+// Buffers that are only read are declared const, and, when no other kernel
+// parameter refers to the same memory, restrict. The access of top-level
+// terminals is recorded in the state, where the declarations of the nested
+// terminals find it as well.
+enum parameter_access {
+    inherited_access,   // Same as for the enclosing terminal.
+    read_write_access,
+    read_only_access,
+    no_alias_access     // Read only and not aliased.
+};
+
+inline void set_parameter_access(kernel_generator_state_ptr state,
+        parameter_access access, const std::string &prm_name)
+{
+    if (access == inherited_access) return;
+
+    (*state)["param_read_only"] = (access != read_write_access);
+
+    // Only the top-level terminal itself may be restrict. Nested terminals
+    // (e.g. vector inside a slice) could alias the output.
+    (*state)["param_no_alias"] = (access == no_alias_access ? prm_name : std::string());
+}
+
+// Is the parameter only read by the kernel?
+inline bool read_only_parameter(kernel_generator_state_ptr state) {
+    auto s = state->find("param_read_only");
+    return s != state->end() && boost::any_cast<bool>(s->second);
+}
+
+// Is the parameter read only and not aliased by other parameters?
+inline bool no_alias_parameter(kernel_generator_state_ptr state,
+        const std::string &prm_name)
+{
+    auto s = state->find("param_no_alias");
+    return s != state->end() && boost::any_cast<const std::string&>(s->second) == prm_name;
+}
+
+// Width of vector types the terminals are loaded as (see vector_width()).
+// Zero means scalar loads.
+inline unsigned loaded_vector_width(kernel_generator_state_ptr state) {
+    auto s = state->find("vector_width");
+    return s == state->end() ? 0 : boost::any_cast<unsigned>(s->second);
+}
+
+// Kernel variables that hold values of terminals (see vex::deferred).
+// Terminals are identified by their addresses.
+typedef std::map<const void*, std::string> terminal_variables;
+
+// Name of the variable holding the terminal, or NULL if there is none.
+inline const std::string* terminal_variable(kernel_generator_state_ptr state,
+        const void *term)
+{
+    auto s = state->find("terminal_variables");
+    if (s == state->end()) return 0;
+
+    const terminal_variables &vars = boost::any_cast<const terminal_variables&>(s->second);
+
+    auto v = vars.find(term);
+    return v == vars.end() ? 0 : &v->second;
+}
+
 } // namespace detail
 
 namespace traits {
@@ -258,6 +324,68 @@ void extract_expression_properties(
     >::get(term, queue_list, partition, size);
 }
 
+// Which tracker (if any) guards the device buffer used by a terminal:
+template <class T, class Enable = void>
+struct terminal_access_tracker {
+    static detail::access_tracker* get(const T&, unsigned/*device*/) {
+        return 0;
+    }
+};
+
+template <class T>
+detail::access_tracker* get_access_tracker(const T &term, unsigned device) {
+    return terminal_access_tracker<
+        typename std::decay<T>::type
+    >::get(term, device);
+}
+
+// Which device buffer (if any) a terminal refers to. Used to find out if
+// kernel parameters alias each other. Zero means the buffer is unknown:
+template <class T, class Enable = void>
+struct terminal_buffer_id {
+    static size_t get(const T&, unsigned/*device*/) {
+        return 0;
+    }
+};
+
+template <class T>
+size_t get_terminal_buffer_id(const T &term, unsigned device) {
+    return terminal_buffer_id<
+        typename std::decay<T>::type
+    >::get(term, device);
+}
+
+// Can the terminal be loaded as a vector type with elements of type T
+// (e.g. double4 for T = double)? Arithmetic scalars are broadcast; integral
+// scalars are allowed with floating point vectors:
+template <class Term, class T, class Enable = void>
+struct is_wide_terminal : std::false_type {};
+
+template <class S, class T>
+struct is_wide_terminal<S, T,
+    typename std::enable_if<std::is_arithmetic<S>::value>::type
+    > : std::integral_constant<bool,
+            std::is_same<S, T>::value ||
+            (std::is_integral<S>::value && std::is_floating_point<T>::value)
+        >
+{};
+
+// How many bytes of device memory a terminal touches per element of the
+// expression (used for kernel statistics):
+template <class T, class Enable = void>
+struct terminal_bytes_per_element {
+    static size_t get(const T&) {
+        return 0;
+    }
+};
+
+template <class T>
+size_t get_terminal_bytes_per_element(const T &term) {
+    return terminal_bytes_per_element<
+        typename std::decay<T>::type
+    >::get(term);
+}
+
 //---------------------------------------------------------------------------
 // Scalars and helper types/functions used in multivector expressions
 //---------------------------------------------------------------------------
@@ -1339,12 +1467,14 @@ struct vector_expr_context : public expression_context {
 };
 
 struct declare_expression_parameter : expression_context {
+    parameter_access access;
 
     declare_expression_parameter(backend::source_generator &src,
             const backend::command_queue &queue, const std::string &prefix,
-            kernel_generator_state_ptr state
+            kernel_generator_state_ptr state,
+            parameter_access access = inherited_access
             )
-        : expression_context(src, queue, prefix, state)
+        : expression_context(src, queue, prefix, state), access(access)
     {}
 
     template <typename Term>
@@ -1353,6 +1483,7 @@ struct declare_expression_parameter : expression_context {
         std::ostringstream prm_name;
         prm_name << prefix << "_" << ++prm_idx;
 
+        set_parameter_access(state, access, prm_name.str());
         traits::get_kernel_param_declaration(src, term, queue,
                 prm_name.str(), state);
     }
@@ -1363,6 +1494,7 @@ struct declare_expression_parameter : expression_context {
         std::ostringstream prm_name;
         prm_name << prefix << "_" << ++prm_idx;
 
+        set_parameter_access(state, access, prm_name.str());
         traits::get_kernel_param_declaration(src, boost::proto::value(term),
                 queue, prm_name.str(), state);
     }
@@ -1393,6 +1525,155 @@ struct set_expression_argument {
     }
 };
 
+// Collects access trackers of the terminals in an expression.
+struct collect_access_trackers {
+    std::vector<access_tracker*> &trackers;
+    unsigned part;
+
+    collect_access_trackers(std::vector<access_tracker*> &trackers, unsigned part)
+        : trackers(trackers), part(part)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        add(traits::get_access_tracker(term, part));
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        add(traits::get_access_tracker(boost::proto::value(term), part));
+    }
+
+    void add(access_tracker *t) const {
+        if (t) trackers.push_back(t);
+    }
+};
+
+// Vector partitions read and written by a single command (a kernel launch
+// or a transfer). acquire() makes the queue wait for the conflicting
+// accesses, and release() records the command as the latest access. Every
+// library command that touches a vector should be wrapped with these.
+struct access_list {
+    std::vector<access_tracker*> writes;
+    std::vector<access_tracker*> reads;
+
+    // Adds trackers of the vectors referenced by the expression.
+    template <class Expr>
+    access_list& read(const Expr &expr, unsigned part) {
+        extract_terminals()(boost::proto::as_child(expr),
+                collect_access_trackers(reads, part));
+        return *this;
+    }
+
+    template <class Expr>
+    access_list& write(const Expr &expr, unsigned part) {
+        extract_terminals()(boost::proto::as_child(expr),
+                collect_access_trackers(writes, part));
+        return *this;
+    }
+
+    // Same for each vector of a fusion sequence (e.g. a tuple of keys).
+    template <class Seq>
+    access_list& read_each(const Seq &seq, unsigned part) {
+        boost::fusion::for_each(seq, add_each(reads, part));
+        return *this;
+    }
+
+    template <class Seq>
+    access_list& write_each(const Seq &seq, unsigned part) {
+        boost::fusion::for_each(seq, add_each(writes, part));
+        return *this;
+    }
+
+    void acquire(const backend::command_queue &q) const {
+        for(auto t = writes.begin(); t != writes.end(); ++t) (*t)->acquire(q, true);
+        for(auto t = reads.begin();  t != reads.end();  ++t) (*t)->acquire(q, false);
+    }
+
+    void release(const backend::command_queue &q) const {
+        for(auto t = reads.begin();  t != reads.end();  ++t) (*t)->release(q, false);
+        for(auto t = writes.begin(); t != writes.end(); ++t) (*t)->release(q, true);
+    }
+
+    private:
+        struct add_each {
+            std::vector<access_tracker*> &trackers;
+            unsigned part;
+
+            add_each(std::vector<access_tracker*> &trackers, unsigned part)
+                : trackers(trackers), part(part) {}
+
+            template <class V>
+            void operator()(const V &v) const {
+                extract_terminals()(boost::proto::as_child(v),
+                        collect_access_trackers(trackers, part));
+            }
+        };
+};
+
+// Collects buffer ids of the terminals in an expression.
+struct collect_buffer_ids {
+    std::vector<size_t> &ids;
+    unsigned part;
+
+    collect_buffer_ids(std::vector<size_t> &ids, unsigned part)
+        : ids(ids), part(part)
+    {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        ids.push_back(traits::get_terminal_buffer_id(term, part));
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        ids.push_back(traits::get_terminal_buffer_id(boost::proto::value(term), part));
+    }
+};
+
+// Could any of the inputs refer to the memory written through the outputs?
+// Outputs with unknown buffers are assumed to alias everything.
+inline bool may_alias(const std::vector<size_t> &out, const std::vector<size_t> &in) {
+    for(auto o = out.begin(); o != out.end(); ++o)
+        if (*o == 0 || std::find(in.begin(), in.end(), *o) != in.end()) return true;
+    return false;
+}
+
+// Estimates memory traffic per element of an expression.
+struct count_terminal_bytes {
+    size_t &bytes;
+
+    count_terminal_bytes(size_t &bytes) : bytes(bytes) {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        bytes += traits::get_terminal_bytes_per_element(term);
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        bytes += traits::get_terminal_bytes_per_element(boost::proto::value(term));
+    }
+};
+
+// Bytes moved per element by an assignment. Compound assignments read the
+// left hand side as well.
+template <class OP, class LHS, class RHS>
+size_t assignment_bytes(const LHS &lhs, const RHS &rhs) {
+    size_t wr = 0, rd = 0;
+
+    extract_terminals()(lhs, count_terminal_bytes(wr));
+    extract_terminals()(rhs, count_terminal_bytes(rd));
+
+    return rd + (std::is_same<OP, assign::SET>::value ? wr : 2 * wr);
+}
+
 struct get_expression_properties {
     mutable std::vector<backend::command_queue> queue;
     mutable std::vector<size_t> part;
@@ -1800,6 +2081,170 @@ struct return_type {
 //---------------------------------------------------------------------------
 // Assign expression to lhs
 //---------------------------------------------------------------------------
+// Expressions that may be evaluated with vector types. Only arithmetic
+// operators are allowed, since those work the same way with vector types in
+// every backend.
+struct wide_expr_grammar
+    : boost::proto::or_<
+        boost::proto::terminal< boost::proto::_ >,
+        boost::proto::plus      < wide_expr_grammar, wide_expr_grammar >,
+        boost::proto::minus     < wide_expr_grammar, wide_expr_grammar >,
+        boost::proto::multiplies< wide_expr_grammar, wide_expr_grammar >,
+        boost::proto::divides   < wide_expr_grammar, wide_expr_grammar >,
+        boost::proto::negate    < wide_expr_grammar >
+      >
+{};
+
+template <class OP> struct is_wide_assign_op : std::false_type {};
+
+template <> struct is_wide_assign_op<assign::SET> : std::true_type {};
+template <> struct is_wide_assign_op<assign::ADD> : std::true_type {};
+template <> struct is_wide_assign_op<assign::SUB> : std::true_type {};
+template <> struct is_wide_assign_op<assign::MUL> : std::true_type {};
+template <> struct is_wide_assign_op<assign::DIV> : std::true_type {};
+
+// Checks that every terminal may be loaded as a vector type, and counts
+// the terminals that are not scalars.
+template <class T>
+struct check_wide_terminals {
+    bool   &ok;
+    size_t &vectors;
+
+    check_wide_terminals(bool &ok, size_t &vectors) : ok(ok), vectors(vectors) {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {
+        check<Term>();
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term&) const {
+        check<
+            typename std::decay<
+                typename boost::proto::result_of::value<Term>::type
+            >::type
+        >();
+    }
+
+    template <typename Term>
+    void check() const {
+        ok = ok && traits::is_wide_terminal<Term, T>::value;
+        if (!std::is_arithmetic<Term>::value) ++vectors;
+    }
+};
+
+// Width of vector types the assignment is evaluated with (vloadN/vstoreN),
+// or 1 for scalar evaluation. Vector types are used when lhs is a vector,
+// and rhs applies arithmetic operators to vectors of the same type and to
+// scalars. The width is the one preferred by the device.
+template <class OP, class LHS, class RHS>
+unsigned vector_width(const LHS&, const RHS &rhs, const backend::command_queue &queue) {
+    typedef typename return_type<LHS>::type T;
+
+    if (
+            !is_wide_assign_op<OP>::value ||
+            !std::is_arithmetic<T>::value || std::is_same<T, bool>::value ||
+            !traits::is_wide_terminal<typename std::decay<LHS>::type, T>::value ||
+            !boost::proto::matches<
+                typename boost::proto::result_of::as_expr<RHS>::type,
+                wide_expr_grammar
+            >::value
+       ) return 1;
+
+    bool   ok = true;
+    size_t vectors = 0;
+    extract_terminals()(boost::proto::as_child(rhs), check_wide_terminals<T>(ok, vectors));
+
+    if (!ok || !vectors) return 1;
+
+    unsigned w = backend::preferred_vector_width<T>(queue);
+    return (w == 2 || w == 4 || w == 8 || w == 16) ? w : 1;
+}
+
+// Generates source of the kernel that assigns expression to lhs.
+// The kernel parameters of the top-level vectors in rhs are declared restrict
+// when no_alias is set.
+template <class OP, class LHS, class RHS>
+std::string assign_expression_source(const LHS &lhs, const RHS &rhs,
+        const backend::command_queue &queue, bool no_alias = false
+        )
+{
+    backend::source_generator source(queue);
+
+    output_terminal_preamble termpream(source, queue, "prm", empty_state());
+
+    boost::proto::eval(boost::proto::as_child(lhs), termpream);
+    boost::proto::eval(boost::proto::as_child(rhs), termpream);
+
+    source.kernel("vexcl_vector_kernel")
+        .open("(")
+            .parameter<size_t>("n");
+
+    declare_expression_parameter declare(source, queue, "prm", empty_state(),
+            read_write_access);
+
+    extract_terminals()(boost::proto::as_child(lhs), declare);
+
+    declare.access = no_alias ? no_alias_access : read_only_access;
+    extract_terminals()(boost::proto::as_child(rhs), declare);
+
+    source.close(")").open("{");
+
+    const unsigned w = vector_width<OP>(lhs, rhs, queue);
+
+    if (w > 1) {
+        // Process w elements per iteration with vector types. Here lhs is a
+        // single vector, so its parameter is prm_1.
+        std::ostringstream bnd;
+        bnd << "(n / " << w << ")";
+
+        auto state = empty_state();
+        (*state)["vector_width"] = w;
+
+        vector_expr_context expr_ctx(source, queue, "prm", state);
+        expr_ctx.prm_idx = 1;
+
+        std::string op = OP::string();
+        op.erase(op.size() - 1);
+
+        source.grid_stride_loop("idx", bnd.str()).open("{");
+        source.new_line() << "vstore" << w << "(";
+        if (!op.empty())
+            source << "vload" << w << "(idx, prm_1) " << op << " ";
+        source << "(";
+        boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
+        source << "), idx, prm_1);";
+        source.close("}");
+
+        // The remaining n % w elements are processed by the first work item.
+        source.new_line() << "if (" << source.global_id(0) << " == 0)";
+        source.new_line() << "for(" << type_name<size_t>() << " idx = n / " << w
+            << " * " << w << "; idx < n; ++idx)";
+    } else {
+        source.grid_stride_loop();
+    }
+
+    source.open("{");
+
+    output_local_preamble loc_init(source, queue, "prm", empty_state());
+    boost::proto::eval(boost::proto::as_child(lhs), loc_init);
+    boost::proto::eval(boost::proto::as_child(rhs), loc_init);
+
+    vector_expr_context expr_ctx(source, queue, "prm", empty_state());
+
+    source.new_line();
+    boost::proto::eval(boost::proto::as_child(lhs), expr_ctx);
+    source << " " << OP::string() << " ";
+    boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
+
+    source << ";";
+    source.close("}").close("}");
+
+    return source.str();
+}
+
 template <class OP, class LHS, class RHS>
 void assign_expression(LHS &lhs, const RHS &rhs,
         const std::vector<backend::command_queue> &queue,
@@ -1823,62 +2268,42 @@ void assign_expression(LHS &lhs, const RHS &rhs,
                 );
     }
 #endif
-    static kernel_cache cache;
+    // Kernels with restrict inputs are only used when the inputs do not
+    // alias the outputs.
+    static object_cache<index_by_context, autotune::tunable_kernel> cache[2];
 
     for(unsigned d = 0; d < queue.size(); d++) {
-        auto kernel = cache.find(queue[d]);
-
-        backend::select_context(queue[d]);
-
-        if (kernel == cache.end()) {
-            backend::source_generator source(queue[d]);
-
-            output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
-
-            boost::proto::eval(boost::proto::as_child(lhs), termpream);
-            boost::proto::eval(boost::proto::as_child(rhs), termpream);
-
-            source.kernel("vexcl_vector_kernel")
-                .open("(")
-                    .parameter<size_t>("n");
+        std::vector<size_t> out, in;
+        extract_terminals()( boost::proto::as_child(lhs), collect_buffer_ids(out, d));
+        extract_terminals()( boost::proto::as_child(rhs), collect_buffer_ids(in,  d));
 
-            declare_expression_parameter declare(source, queue[d], "prm", empty_state());
+        bool no_alias = !may_alias(out, in);
 
-            extract_terminals()(boost::proto::as_child(lhs), declare);
-            extract_terminals()(boost::proto::as_child(rhs), declare);
+        auto kernel = cache[no_alias].find(queue[d]);
 
-            source.close(")")
-                .open("{")
-                    .grid_stride_loop()
-                    .open("{");
-
-            output_local_preamble loc_init(source, queue[d], "prm", empty_state());
-            boost::proto::eval(boost::proto::as_child(lhs), loc_init);
-            boost::proto::eval(boost::proto::as_child(rhs), loc_init);
-
-            vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
-
-            source.new_line();
-            boost::proto::eval(boost::proto::as_child(lhs), expr_ctx);
-            source << " " << OP::string() << " ";
-            boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
-
-            source << ";";
-            source.close("}").close("}");
+        backend::select_context(queue[d]);
 
-            kernel = cache.insert(queue[d], backend::kernel(
-                        queue[d], source.str(), "vexcl_vector_kernel"));
+        if (kernel == cache[no_alias].end()) {
+            kernel = cache[no_alias].insert(queue[d], autotune::tunable_kernel(queue[d],
+                        assign_expression_source<OP>(lhs, rhs, queue[d], no_alias),
+                        "vexcl_vector_kernel"));
         }
 
         if (size_t psize = part[d + 1] - part[d]) {
-            kernel->second.push_arg(psize);
+            access_list acc;
+            acc.write(lhs, d).read(rhs, d).acquire(queue[d]);
 
-            set_expression_argument setarg(kernel->second, d, part[d], empty_state());
+            kernel->second.kernel.push_arg(psize);
+
+            set_expression_argument setarg(kernel->second.kernel, d, part[d], empty_state());
 
             extract_terminals()( boost::proto::as_child(lhs), setarg);
             extract_terminals()( boost::proto::as_child(rhs), setarg);
 
-            kernel->second(queue[d]);
+            kernel->second(queue[d], psize, stats::enabled() ? psize *
+                    assignment_bytes<OP>(boost::proto::as_child(lhs), boost::proto::as_child(rhs)) : 0);
+
+            acc.release(queue[d]);
         }
     }
 }
@@ -1964,26 +2389,57 @@ struct preamble_constructor {
     }
 };
 
-template <class LHS, class RHS>
+// Declares parameters for either side of the multiexpression. All outputs
+// are declared before the inputs, so that a terminal shared between an
+// output and an input (e.g. a tagged one) is never declared read only.
+template <class Expr>
 struct parameter_declarator {
-    const LHS &lhs;
-    const RHS &rhs;
+    const Expr &expr;
 
-    kernel_generator_state_ptr state;
-    mutable detail::declare_expression_parameter lhs_ctx;
-    mutable detail::declare_expression_parameter rhs_ctx;
+    mutable detail::declare_expression_parameter ctx;
 
-    parameter_declarator(const LHS &lhs, const RHS &rhs,
-            backend::source_generator &source, const backend::command_queue &queue)
-        : lhs(lhs), rhs(rhs), state(empty_state()),
-          lhs_ctx(source, queue, "lhs", state),
-          rhs_ctx(source, queue, "rhs", state)
+    parameter_declarator(const Expr &expr,
+            backend::source_generator &source, const backend::command_queue &queue,
+            const std::string &prefix, kernel_generator_state_ptr state,
+            parameter_access access)
+        : expr(expr), ctx(source, queue, prefix, state, access)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(subexpression<I>::get(expr), ctx);
+    }
+};
+
+template <class Expr>
+struct buffer_id_collector {
+    const Expr &expr;
+
+    mutable detail::collect_buffer_ids ctx;
+
+    buffer_id_collector(const Expr &expr, std::vector<size_t> &ids, unsigned part)
+        : expr(expr), ctx(ids, part)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(subexpression<I>::get(expr), ctx);
+    }
+};
+
+template <class Expr>
+struct access_collector {
+    const Expr &expr;
+
+    mutable detail::collect_access_trackers ctx;
+
+    access_collector(const Expr &expr, std::vector<access_tracker*> &trackers, unsigned part)
+        : expr(expr), ctx(trackers, part)
     { }
 
     template <size_t I>
     void apply() const {
-        extract_terminals()(subexpression<I>::get(lhs), lhs_ctx);
-        extract_terminals()(subexpression<I>::get(rhs), rhs_ctx);
+        extract_terminals()(subexpression<I>::get(expr), ctx);
     }
 };
 
@@ -2046,22 +2502,37 @@ struct expression_finalize {
     }
 };
 
-template <class LHS, class RHS>
+template <class Expr>
 struct kernel_arg_setter {
-    const LHS &lhs;
-    const RHS &rhs;
+    const Expr &expr;
 
     mutable detail::set_expression_argument ctx;
 
-    kernel_arg_setter(const LHS &lhs, const RHS &rhs,
-            backend::kernel &krn, unsigned part, size_t offset)
-        : lhs(lhs), rhs(rhs), ctx(krn, part, offset, empty_state())
+    kernel_arg_setter(const Expr &expr,
+            backend::kernel &krn, unsigned part, size_t offset,
+            kernel_generator_state_ptr state)
+        : expr(expr), ctx(krn, part, offset, state)
     { }
 
     template <size_t I>
     void apply() const {
-        detail::extract_terminals()(subexpression<I>::get(lhs), ctx);
-        detail::extract_terminals()(subexpression<I>::get(rhs), ctx);
+        detail::extract_terminals()(subexpression<I>::get(expr), ctx);
+    }
+};
+
+template <class OP, class LHS, class RHS>
+struct multiexpression_bytes {
+    const LHS &lhs;
+    const RHS &rhs;
+    size_t &bytes;
+
+    multiexpression_bytes(const LHS &lhs, const RHS &rhs, size_t &bytes)
+        : lhs(lhs), rhs(rhs), bytes(bytes)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        bytes += assignment_bytes<OP>(subexpression<I>::get(lhs), subexpression<I>::get(rhs));
     }
 };
 
@@ -2092,7 +2563,9 @@ void assign_multiexpression( LHS &lhs, const RHS &rhs,
 
     typedef traits::get_dimension<LHS> N;
 
-    static kernel_cache cache;
+    // Kernels with restrict inputs are only used when the inputs do not
+    // alias the outputs.
+    static object_cache<index_by_context, autotune::tunable_kernel> cache[2];
 
     // 1. If any device in context is CPU, then do not fuse the kernel,
     //    but assign components individually (this works better with CPU
@@ -2106,7 +2579,7 @@ void assign_multiexpression( LHS &lhs, const RHS &rhs,
 #endif
             (N::value == 1) ||
             std::any_of(queue.begin(), queue.end(),
-                [](const backend::command_queue &q) { return backend::is_cpu(q); })
+                [](const backend::command_queue &q) { return get_queue_info(q).cpu; })
        )
     {
         static_for<0, N::value>::loop(
@@ -2116,11 +2589,17 @@ void assign_multiexpression( LHS &lhs, const RHS &rhs,
     }
 
     for(unsigned d = 0; d < queue.size(); d++) {
-        auto kernel = cache.find(queue[d]);
+        std::vector<size_t> out, in;
+        static_for<0, N::value>::loop(buffer_id_collector<LHS>(lhs, out, d));
+        static_for<0, N::value>::loop(buffer_id_collector<RHS>(rhs, in,  d));
+
+        bool no_alias = !may_alias(out, in);
+
+        auto kernel = cache[no_alias].find(queue[d]);
 
         backend::select_context(queue[d]);
 
-        if (kernel == cache.end()) {
+        if (kernel == cache[no_alias].end()) {
             backend::source_generator source(queue[d]);
 
             static_for<0, N::value>::loop(
@@ -2131,8 +2610,15 @@ void assign_multiexpression( LHS &lhs, const RHS &rhs,
                 .open("(")
                     .parameter<size_t>("n");
 
+            auto state = empty_state();
+
             static_for<0, N::value>::loop(
-                    parameter_declarator<LHS, RHS>(lhs, rhs, source, queue[d])
+                    parameter_declarator<LHS>(lhs, source, queue[d], "lhs",
+                        state, read_write_access)
+                    );
+            static_for<0, N::value>::loop(
+                    parameter_declarator<RHS>(rhs, source, queue[d], "rhs",
+                        state, no_alias ? no_alias_access : read_only_access)
                     );
 
             source.close(")").open("{")
@@ -2143,18 +2629,35 @@ void assign_multiexpression( LHS &lhs, const RHS &rhs,
 
             source.close("}").close("}");
 
-            kernel = cache.insert(queue[d], backend::kernel(
+            kernel = cache[no_alias].insert(queue[d], autotune::tunable_kernel(
                         queue[d], source.str(), "vexcl_multivector_kernel") );
         }
 
         if (size_t psize = part[d + 1] - part[d]) {
-            kernel->second.push_arg(psize);
+            kernel->second.kernel.push_arg(psize);
+
+            auto state = empty_state();
 
             static_for<0, N::value>::loop(
-                    kernel_arg_setter<LHS, RHS>(lhs, rhs, kernel->second, d, part[d])
+                    kernel_arg_setter<LHS>(lhs, kernel->second.kernel, d, part[d], state)
                     );
+            static_for<0, N::value>::loop(
+                    kernel_arg_setter<RHS>(rhs, kernel->second.kernel, d, part[d], state)
+                    );
+
+            size_t bytes = 0;
+            if (stats::enabled())
+                static_for<0, N::value>::loop(
+                        multiexpression_bytes<OP, LHS, RHS>(lhs, rhs, bytes)
+                        );
+
+            access_list acc;
+            static_for<0, N::value>::loop(access_collector<LHS>(lhs, acc.writes, d));
+            static_for<0, N::value>::loop(access_collector<RHS>(rhs, acc.reads,  d));
 
-            kernel->second(queue[d]);
+            acc.acquire(queue[d]);
+            kernel->second(queue[d], psize, psize * bytes);
+            acc.release(queue[d]);
         }
     }
 }
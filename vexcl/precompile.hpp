@@ -0,0 +1,87 @@
+#ifndef VEXCL_PRECOMPILE_HPP
+#define VEXCL_PRECOMPILE_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/precompile.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Ahead-of-time compilation of vector expressions.
+ */
+
+#include <vector>
+#include <string>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/backend/precompile.hpp>
+#include <vexcl/operations.hpp>
+
+namespace vex {
+namespace precompile {
+
+/// Submits kernel for the vector assignment for compilation in background.
+/**
+ * The kernel is compiled on worker threads for every queue lhs is located
+ * on. The assignment itself, when executed later, only waits for the
+ * compilation to finish.
+ * \code
+ * vex::precompile::assignment(x, sin(y) + z);
+ * vex::precompile::assignment<vex::assign::ADD>(x, 2 * y);
+ * ...
+ * x = sin(y) + z; // Does not compile anything.
+ * \endcode
+ */
+template <class OP = assign::SET, class LHS, class RHS>
+void assignment(const LHS &lhs, const RHS &rhs) {
+    vex::detail::get_expression_properties prop;
+    vex::detail::extract_terminals()(boost::proto::as_child(lhs), prop);
+
+    precondition(!prop.queue.empty(),
+            "Can not determine expression queue list"
+            );
+
+    for(unsigned d = 0; d < prop.queue.size(); ++d) {
+        std::vector<size_t> out, in;
+        vex::detail::extract_terminals()(boost::proto::as_child(lhs),
+                vex::detail::collect_buffer_ids(out, d));
+        vex::detail::extract_terminals()(boost::proto::as_child(rhs),
+                vex::detail::collect_buffer_ids(in,  d));
+
+        source(prop.queue[d], vex::detail::assign_expression_source<OP>(
+                    lhs, rhs, prop.queue[d], !vex::detail::may_alias(out, in)));
+    }
+}
+
+/// Submits programs recorded with vex::precompile::record() for compilation.
+template <class Context>
+size_t from_file(const Context &ctx, const std::string &file) {
+    return from_file(ctx.queue(), file);
+}
+
+} // namespace precompile
+} // namespace vex
+
+#endif
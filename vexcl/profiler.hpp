@@ -42,6 +42,9 @@ THE SOFTWARE.
 #include <memory>
 #include <stack>
 #include <vector>
+#include <deque>
+#include <utility>
+#include <algorithm>
 #include <cassert>
 
 #if defined(_MSC_VER) && (_MSC_VER < 1700)
@@ -117,6 +120,11 @@ class stopwatch {
             return delta;
         }
 
+        /// Adds externally measured interval (in seconds).
+        inline void add(double delta) {
+            acc(delta);
+        }
+
         /// Average time across tics.
         inline double average() const {
             namespace ba = boost::accumulators;
@@ -188,6 +196,12 @@ class profiler {
                     return watch.toc();
                 }
 
+                // Resolves pending device timings.
+                virtual void resolve() {
+                    for(auto c = children.begin(); c != children.end(); c++)
+                        (*c)->resolve();
+                }
+
                 double children_time() const {
                     double tm = 0;
 
@@ -268,16 +282,81 @@ class profiler {
                 const std::vector<backend::command_queue> &queue;
         };
 
+        // Brackets the interval with timestamp events instead of waiting
+        // for the queues. Device time of the interval is only known after
+        // the events complete, so it is resolved when the profile is printed.
+        class event_profile_unit : public profile_unit {
+            public:
+                event_profile_unit(const std::string &name, const std::vector<backend::command_queue> &queue)
+                    : profile_unit(name), queue(queue) {}
+
+                void tic() {
+                    start.clear();
+                    for(auto q = queue.begin(); q != queue.end(); ++q)
+                        start.push_back(backend::enqueue_timestamp(*q));
+
+                    host.tic();
+                }
+
+                // Returns host time of the interval, the device time is
+                // accounted for later.
+                double toc() {
+                    std::vector<backend::event> stop;
+                    for(auto q = queue.begin(); q != queue.end(); ++q)
+                        stop.push_back(backend::enqueue_timestamp(*q));
+
+                    pending.push_back(std::make_pair(start, stop));
+
+                    return host.toc();
+                }
+
+                void resolve() {
+                    for(auto p = pending.begin(); p != pending.end(); ++p) {
+                        double delta = 0;
+
+                        for(size_t i = 0; i < p->first.size(); ++i)
+                            delta = std::max(delta,
+                                    backend::elapsed(p->first[i], p->second[i]));
+
+                        this->watch.add(delta);
+                    }
+
+                    pending.clear();
+
+                    profile_unit::resolve();
+                }
+            private:
+                const std::vector<backend::command_queue> &queue;
+
+                stopwatch<Clock> host;
+
+                std::vector<backend::event> start;
+                std::vector<
+                    std::pair<
+                        std::vector<backend::event>,
+                        std::vector<backend::event>
+                        >
+                    > pending;
+        };
+
     public:
         /// Constructor.
         /**
-         * \param queue vector of command queues.
-         * \param name  Optional name to be used when profiling info is printed.
+         * \param queue       vector of command queues.
+         * \param name        Optional name to be used when profiling info is printed.
+         * \param nonblocking When set, tic_cl() and toc() do not wait for the
+         *                    queues. The intervals are bracketed with
+         *                    timestamp events, and device time is resolved
+         *                    lazily in print(). With the OpenCL backend this
+         *                    requires queues created with
+         *                    CL_QUEUE_PROFILING_ENABLE property; blocking
+         *                    timers are used otherwise.
          */
         profiler(
                 const std::vector<backend::command_queue> &queue = std::vector<backend::command_queue>(),
-                const std::string &name = "Profile"
-                ) : queue(queue)
+                const std::string &name = "Profile",
+                bool nonblocking = false
+                ) : queue(queue), nonblocking(nonblocking)
         {
             auto root = std::shared_ptr<profile_unit>(new profile_unit(name));
             root->tic();
@@ -311,12 +390,20 @@ class profiler {
          */
         void tic_cl(const std::string &name) {
             assert(!queue.empty());
-            tic(new cl_profile_unit(name, queue));
+
+            if (nonblocking && std::all_of(queue.begin(), queue.end(),
+                        [](const backend::command_queue &q) {
+                            return backend::profiling_enabled(q);
+                        }))
+                tic(new event_profile_unit(name, queue));
+            else
+                tic(new cl_profile_unit(name, queue));
         }
 
         /// Returns time since last tic.
         /**
          * Also removes interval from the top of the profiler hierarchy.
+         * For nonblocking device intervals this is the host time.
          */
         double toc(const std::string &) {
             assert(stack.size() > 1);
@@ -335,6 +422,7 @@ class profiler {
                 out << "Warning! Profile is incomplete." << std::endl;
 
             auto root = stack.front();
+            root->resolve();
             double length = root->toc();
             out << std::endl;
             root->print(out, 0, length, root->max_line_width(0));
@@ -342,6 +430,7 @@ class profiler {
 
     private:
         const std::vector<backend::command_queue> &queue;
+        bool nonblocking;
         std::deque<std::shared_ptr<profile_unit>> stack;
 };
 
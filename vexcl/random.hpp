@@ -247,7 +247,7 @@ struct RandomNormal : UserFunction<RandomNormal<T,Generator>, T(cl_ulong, cl_ulo
                 src.new_line() << type_name<Ts>()
                     << " l = sqrt(-2 * log(u[0])), cs, sn;";
 
-#if defined(VEXCL_BACKEND_OPENCL)
+#if defined(VEXCL_BACKEND_OPENCL) || defined(VEXCL_BACKEND_JIT)
                 src.new_line() << "sn = sincos("
                     << std::setprecision(16)
                     << boost::math::constants::two_pi<double>()
@@ -53,6 +53,7 @@ limitations under the License.
 #include <string>
 
 #include <vexcl/vector.hpp>
+#include <vexcl/memory_pool.hpp>
 #include <vexcl/scan.hpp>
 #include <vexcl/detail/fusion.hpp>
 #include <vexcl/function.hpp>
@@ -62,349 +63,275 @@ namespace detail {
 namespace rbk {
 
 //---------------------------------------------------------------------------
-template <typename T, class Comp>
-backend::kernel offset_calculation(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Comp::define(src, "comp");
-
-        src.kernel("offset_calculation")
-            .open("(")
-            .template parameter< size_t >("n");
-
-        boost::mpl::for_each<T>(pointer_param<global_ptr, true>(src, "keys"));
-
-        src.template parameter< global_ptr<int> >("offsets");
-        src.close(")").open("{");
-
-        src.new_line().grid_stride_loop().open("{");
-        src.new_line()
-            << "if (idx > 0)"
-            << " offsets[idx] = !comp(";
-        for(int p = 0; p < boost::mpl::size<T>::value; ++p)
-            src << (p ? ", " : "") << "keys" << p << "[idx - 1]";
-        for(int p = 0; p < boost::mpl::size<T>::value; ++p)
-            src << ", keys" << p << "[idx]";
-        src << ");";
-        src.new_line() << "else offsets[idx] = 0;";
-        src.close("}");
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "offset_calculation"));
-    }
-
-    return kernel->second;
+template <typename T>
+void offset_calculation(backend::source_generator &src) {
+    src.kernel("offset_calculation")
+        .open("(")
+        .template parameter< size_t >("n");
+
+    boost::mpl::for_each<T>(pointer_param<global_ptr, true>(src, "keys"));
+
+    src.template parameter< global_ptr<int> >("offsets");
+    src.close(")").open("{");
+
+    src.new_line().grid_stride_loop().open("{");
+    src.new_line()
+        << "if (idx > 0)"
+        << " offsets[idx] = !comp(";
+    for(int p = 0; p < boost::mpl::size<T>::value; ++p)
+        src << (p ? ", " : "") << "keys" << p << "[idx - 1]";
+    for(int p = 0; p < boost::mpl::size<T>::value; ++p)
+        src << ", keys" << p << "[idx]";
+    src << ");";
+    src.new_line() << "else offsets[idx] = 0;";
+    src.close("}");
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
-template <int NT, typename T, class Oper>
-backend::kernel block_scan_by_key(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Oper::define(src, "oper");
-
-        src.kernel("block_scan_by_key")
-            .open("(")
-                .template parameter< size_t                >("n")
-                .template parameter< global_ptr<const int> >("keys")
-                .template parameter< global_ptr<const T>   >("vals")
-                .template parameter< global_ptr<T>         >("output")
-                .template parameter< global_ptr<int>       >("key_buf")
-                .template parameter< global_ptr<T>         >("val_buf")
-            .close(")").open("{");
-
-        src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t block = " << src.group_id(0)   << ";";
-
-        src.new_line() << "struct Shared";
-        src.open("{");
-            src.new_line() << "int keys[" << NT << "];";
-            src.new_line() << type_name<T>() << " vals[" << NT << "];";
-        src.close("};");
-
-        src.smem_static_var("struct Shared", "shared");
-
-        src.new_line() << "int key;";
-        src.new_line() << type_name<T>() << " val;";
-
-        src.new_line() << "if (g_id < n)";
-        src.open("{");
-        src.new_line() << "key = keys[g_id];";
-        src.new_line() << "val = vals[g_id];";
-        src.new_line() << "shared.keys[l_id] = key;";
-        src.new_line() << "shared.vals[l_id] = val;";
-        src.close("}");
-
-        // Computes a scan within a workgroup updates vals in lds but not keys
-        src.new_line() << type_name<T>() << " sum = val;";
-        src.new_line() << "for(size_t offset = 1; offset < " << NT << "; offset *= 2)";
-        src.open("{");
-        src.new_line().barrier();
-        src.new_line() << "if (l_id >= offset && shared.keys[l_id - offset] == key)";
-        src.open("{");
-        src.new_line() << "sum = oper(sum, shared.vals[l_id - offset]);";
-        src.close("}");
-        src.new_line().barrier();
-        src.new_line() << "shared.vals[l_id] = sum;";
-        src.close("}");
-        src.new_line().barrier();
-
-        src.new_line() << "if (g_id >= n) return;";
-
-        // Each work item writes out its calculated scan result, relative to the
-        // beginning of each work group
-        src.new_line() << "int key2 = -1;";
-        src.new_line() << "if (g_id < n - 1) key2 = keys[g_id + 1];";
-        src.new_line() << "if (key != key2) output[g_id] = sum;";
-
-        src.new_line() << "if (l_id == 0)";
-        src.open("{");
-        src.new_line() << "key_buf[block] = shared.keys[" << NT - 1 << "];";
-        src.new_line() << "val_buf[block] = shared.vals[" << NT - 1 << "];";
-        src.close("}");
-
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_scan_by_key"));
-    }
-
-    return kernel->second;
+template <int NT, typename T>
+void block_scan_by_key(backend::source_generator &src) {
+    src.kernel("block_scan_by_key")
+        .open("(")
+            .template parameter< size_t                >("n")
+            .template parameter< global_ptr<const int> >("keys")
+            .template parameter< global_ptr<const T>   >("vals")
+            .template parameter< global_ptr<T>         >("output")
+            .template parameter< global_ptr<int>       >("key_buf")
+            .template parameter< global_ptr<T>         >("val_buf")
+        .close(")").open("{");
+
+    src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t block = " << src.group_id(0)   << ";";
+
+    src.new_line() << "struct Shared";
+    src.open("{");
+        src.new_line() << "int keys[" << NT << "];";
+        src.new_line() << type_name<T>() << " vals[" << NT << "];";
+    src.close("};");
+
+    src.smem_static_var("struct Shared", "shared");
+
+    src.new_line() << "int key;";
+    src.new_line() << type_name<T>() << " val;";
+
+    src.new_line() << "if (g_id < n)";
+    src.open("{");
+    src.new_line() << "key = keys[g_id];";
+    src.new_line() << "val = vals[g_id];";
+    src.new_line() << "shared.keys[l_id] = key;";
+    src.new_line() << "shared.vals[l_id] = val;";
+    src.close("}");
+
+    // Computes a scan within a workgroup updates vals in lds but not keys
+    src.new_line() << type_name<T>() << " sum = val;";
+    src.new_line() << "for(size_t offset = 1; offset < " << NT << "; offset *= 2)";
+    src.open("{");
+    src.new_line().barrier();
+    src.new_line() << "if (l_id >= offset && shared.keys[l_id - offset] == key)";
+    src.open("{");
+    src.new_line() << "sum = oper(sum, shared.vals[l_id - offset]);";
+    src.close("}");
+    src.new_line().barrier();
+    src.new_line() << "shared.vals[l_id] = sum;";
+    src.close("}");
+    src.new_line().barrier();
+
+    src.new_line() << "if (g_id >= n) return;";
+
+    // Each work item writes out its calculated scan result, relative to the
+    // beginning of each work group
+    src.new_line() << "int key2 = -1;";
+    src.new_line() << "if (g_id < n - 1) key2 = keys[g_id + 1];";
+    src.new_line() << "if (key != key2) output[g_id] = sum;";
+
+    src.new_line() << "if (l_id == 0)";
+    src.open("{");
+    src.new_line() << "key_buf[block] = shared.keys[" << NT - 1 << "];";
+    src.new_line() << "val_buf[block] = shared.vals[" << NT - 1 << "];";
+    src.close("}");
+
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
-template <int NT, typename T, class Oper>
-backend::kernel block_inclusive_scan_by_key(const backend::command_queue &queue)
-{
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Oper::define(src, "oper");
-
-        src.kernel("block_inclusive_scan_by_key")
-            .open("(")
-                .template parameter< size_t                >("n")
-                .template parameter< global_ptr<const int> >("key_sum")
-                .template parameter< global_ptr<const T>   >("pre_sum")
-                .template parameter< global_ptr<T>         >("post_sum")
-                .template parameter< cl_uint               >("work_per_thread")
-            .close(")").open("{");
-
-        src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t map_id = g_id * work_per_thread;";
-
-        src.new_line() << "struct Shared";
-        src.open("{");
-            src.new_line() << "int keys[" << NT << "];";
-            src.new_line() << type_name<T>() << " vals[" << NT << "];";
-        src.close("};");
-
-        src.smem_static_var("struct Shared", "shared");
-
-        src.new_line() << "uint offset;";
-        src.new_line() << "int  key;";
-        src.new_line() << type_name<T>() << " work_sum;";
-
-        src.new_line() << "if (map_id < n)";
-        src.open("{");
-        src.new_line() << "int prev_key;";
-
-        // accumulate zeroth value manually
-        src.new_line() << "offset   = 0;";
-        src.new_line() << "key      = key_sum[map_id];";
-        src.new_line() << "work_sum = pre_sum[map_id];";
-
-        src.new_line() << "post_sum[map_id] = work_sum;";
-
-        //  Serial accumulation
-        src.new_line() << "for( offset = offset + 1; offset < work_per_thread; ++offset )";
-        src.open("{");
-        src.new_line() << "prev_key = key;";
-        src.new_line() << "key      = key_sum[ map_id + offset ];";
-
-        src.new_line() << "if ( map_id + offset < n )";
-        src.open("{");
-        src.new_line() << type_name<T>() << " y = pre_sum[ map_id + offset ];";
-
-        src.new_line() << "if ( key == prev_key ) work_sum = oper( work_sum, y );";
-        src.new_line() << "else work_sum = y;";
-
-        src.new_line() << "post_sum[ map_id + offset ] = work_sum;";
-        src.close("}");
-        src.close("}");
-        src.close("}");
-        src.new_line().barrier();
-
-        // load LDS with register sums
-        src.new_line() << "shared.vals[ l_id ] = work_sum;";
-        src.new_line() << "shared.keys[ l_id ] = key;";
-
-        // scan in lds
-        src.new_line() << type_name<T>() << " scan_sum = work_sum;";
-
-        src.new_line() << "for( offset = 1; offset < " << NT << "; offset *= 2 )";
-        src.open("{");
-        src.new_line().barrier();
-
-        src.new_line() << "if (map_id < n)";
-        src.open("{");
-        src.new_line() << "if (l_id >= offset)";
-        src.open("{");
-        src.new_line() << "int key1 = shared.keys[ l_id ];";
-        src.new_line() << "int key2 = shared.keys[ l_id - offset ];";
-
-        src.new_line() << "if ( key1 == key2 ) scan_sum = oper( scan_sum, shared.vals[ l_id - offset ] );";
-        src.new_line() << "else scan_sum = shared.vals[ l_id ];";
-        src.close("}");
-
-        src.close("}");
-        src.new_line().barrier();
-
-        src.new_line() << "shared.vals[ l_id ] = scan_sum;";
-        src.close("}");
-
-        src.new_line().barrier();
-
-        // write final scan from pre-scan and lds scan
-        src.new_line() << "for( offset = 0; offset < work_per_thread; ++offset )";
-        src.open("{");
-        src.new_line().barrier(true);
-
-        src.new_line() << "if (map_id < n && l_id > 0)";
-        src.open("{");
-        src.new_line() << type_name<T>() << " y = post_sum[ map_id + offset ];";
-        src.new_line() << "int key1 = key_sum    [ map_id + offset ];";
-        src.new_line() << "int key2 = shared.keys[ l_id - 1 ];";
-
-        src.new_line() << "if ( key1 == key2 ) y = oper( y, shared.vals[l_id - 1] );";
-
-        src.new_line() << "post_sum[ map_id + offset ] = y;";
-        src.close("}");
-        src.close("}");
-
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_inclusive_scan_by_key"));
-    }
-
-    return kernel->second;
+template <int NT, typename T>
+void block_inclusive_scan_by_key(backend::source_generator &src) {
+    src.kernel("block_inclusive_scan_by_key")
+        .open("(")
+            .template parameter< size_t                >("n")
+            .template parameter< global_ptr<const int> >("key_sum")
+            .template parameter< global_ptr<const T>   >("pre_sum")
+            .template parameter< global_ptr<T>         >("post_sum")
+            .template parameter< cl_uint               >("work_per_thread")
+        .close(")").open("{");
+
+    src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t map_id = g_id * work_per_thread;";
+
+    src.new_line() << "struct Shared";
+    src.open("{");
+        src.new_line() << "int keys[" << NT << "];";
+        src.new_line() << type_name<T>() << " vals[" << NT << "];";
+    src.close("};");
+
+    src.smem_static_var("struct Shared", "shared");
+
+    src.new_line() << "uint offset;";
+    src.new_line() << "int  key;";
+    src.new_line() << type_name<T>() << " work_sum;";
+
+    src.new_line() << "if (map_id < n)";
+    src.open("{");
+    src.new_line() << "int prev_key;";
+
+    // accumulate zeroth value manually
+    src.new_line() << "offset   = 0;";
+    src.new_line() << "key      = key_sum[map_id];";
+    src.new_line() << "work_sum = pre_sum[map_id];";
+
+    src.new_line() << "post_sum[map_id] = work_sum;";
+
+    //  Serial accumulation
+    src.new_line() << "for( offset = offset + 1; offset < work_per_thread; ++offset )";
+    src.open("{");
+    src.new_line() << "prev_key = key;";
+    src.new_line() << "key      = key_sum[ map_id + offset ];";
+
+    src.new_line() << "if ( map_id + offset < n )";
+    src.open("{");
+    src.new_line() << type_name<T>() << " y = pre_sum[ map_id + offset ];";
+
+    src.new_line() << "if ( key == prev_key ) work_sum = oper( work_sum, y );";
+    src.new_line() << "else work_sum = y;";
+
+    src.new_line() << "post_sum[ map_id + offset ] = work_sum;";
+    src.close("}");
+    src.close("}");
+    src.close("}");
+    src.new_line().barrier();
+
+    // load LDS with register sums
+    src.new_line() << "shared.vals[ l_id ] = work_sum;";
+    src.new_line() << "shared.keys[ l_id ] = key;";
+
+    // scan in lds
+    src.new_line() << type_name<T>() << " scan_sum = work_sum;";
+
+    src.new_line() << "for( offset = 1; offset < " << NT << "; offset *= 2 )";
+    src.open("{");
+    src.new_line().barrier();
+
+    src.new_line() << "if (map_id < n)";
+    src.open("{");
+    src.new_line() << "if (l_id >= offset)";
+    src.open("{");
+    src.new_line() << "int key1 = shared.keys[ l_id ];";
+    src.new_line() << "int key2 = shared.keys[ l_id - offset ];";
+
+    src.new_line() << "if ( key1 == key2 ) scan_sum = oper( scan_sum, shared.vals[ l_id - offset ] );";
+    src.new_line() << "else scan_sum = shared.vals[ l_id ];";
+    src.close("}");
+
+    src.close("}");
+    src.new_line().barrier();
+
+    src.new_line() << "shared.vals[ l_id ] = scan_sum;";
+    src.close("}");
+
+    src.new_line().barrier();
+
+    // write final scan from pre-scan and lds scan
+    src.new_line() << "for( offset = 0; offset < work_per_thread; ++offset )";
+    src.open("{");
+    src.new_line().barrier(true);
+
+    src.new_line() << "if (map_id < n && l_id > 0)";
+    src.open("{");
+    src.new_line() << type_name<T>() << " y = post_sum[ map_id + offset ];";
+    src.new_line() << "int key1 = key_sum    [ map_id + offset ];";
+    src.new_line() << "int key2 = shared.keys[ l_id - 1 ];";
+
+    src.new_line() << "if ( key1 == key2 ) y = oper( y, shared.vals[l_id - 1] );";
+
+    src.new_line() << "post_sum[ map_id + offset ] = y;";
+    src.close("}");
+    src.close("}");
+
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
-template <typename T, class Oper>
-backend::kernel block_sum_by_key(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Oper::define(src, "oper");
-
-        src.kernel("block_sum_by_key")
-            .open("(")
-                .template parameter< size_t                >("n")
-                .template parameter< global_ptr<const int> >("key_sum")
-                .template parameter< global_ptr<const T>   >("post_sum")
-                .template parameter< global_ptr<const int> >("keys")
-                .template parameter< global_ptr<T>         >("output")
-            .close(")").open("{");
-
-        src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t block = " << src.group_id(0)   << ";";
-
-        src.new_line() << "if (g_id >= n) return;";
-
-        // accumulate prefix
-        src.new_line() << "int key2 = keys[ g_id ];";
-        src.new_line() << "int key1 = (block > 0    ) ? key_sum[ block - 1 ] : key2 - 1;";
-        src.new_line() << "int key3 = (g_id  < n - 1) ? keys   [ g_id  + 1 ] : key2 - 1;";
-
-        src.new_line() << "if (block > 0 && key1 == key2 && key2 != key3)";
-        src.open("{");
-        src.new_line() << type_name<T>() << " scan_result    = output  [ g_id      ];";
-        src.new_line() << type_name<T>() << " post_block_sum = post_sum[ block - 1 ];";
-        src.new_line() << "output[ g_id ] = oper( scan_result, post_block_sum );";
-        src.close("}");
-
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_sum_by_key"));
-    }
-
-    return kernel->second;
+template <typename T>
+void block_sum_by_key(backend::source_generator &src) {
+    src.kernel("block_sum_by_key")
+        .open("(")
+            .template parameter< size_t                >("n")
+            .template parameter< global_ptr<const int> >("key_sum")
+            .template parameter< global_ptr<const T>   >("post_sum")
+            .template parameter< global_ptr<const int> >("keys")
+            .template parameter< global_ptr<T>         >("output")
+        .close(")").open("{");
+
+    src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t block = " << src.group_id(0)   << ";";
+
+    src.new_line() << "if (g_id >= n) return;";
+
+    // accumulate prefix
+    src.new_line() << "int key2 = keys[ g_id ];";
+    src.new_line() << "int key1 = (block > 0    ) ? key_sum[ block - 1 ] : key2 - 1;";
+    src.new_line() << "int key3 = (g_id  < n - 1) ? keys   [ g_id  + 1 ] : key2 - 1;";
+
+    src.new_line() << "if (block > 0 && key1 == key2 && key2 != key3)";
+    src.open("{");
+    src.new_line() << type_name<T>() << " scan_result    = output  [ g_id      ];";
+    src.new_line() << type_name<T>() << " post_block_sum = post_sum[ block - 1 ];";
+    src.new_line() << "output[ g_id ] = oper( scan_result, post_block_sum );";
+    src.close("}");
+
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
 template <typename K, typename V>
-backend::kernel key_value_mapping(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        src.kernel("key_value_mapping")
-            .open("(")
-                .template parameter< size_t >("n");
-
-        boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
-        boost::mpl::for_each<K>(pointer_param<global_ptr      >(src, "okeys"));
-
-        src.template parameter< global_ptr<V>       >("ovals");
-        src.template parameter< global_ptr<int>     >("offset");
-        src.template parameter< global_ptr<const V> >("ivals");
-        src.close(")").open("{");
+void key_value_mapping(backend::source_generator &src) {
+    src.kernel("key_value_mapping")
+        .open("(")
+            .template parameter< size_t >("n");
 
-        src.new_line().grid_stride_loop().open("{");
+    boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
+    boost::mpl::for_each<K>(pointer_param<global_ptr      >(src, "okeys"));
 
-        src.new_line() << "int num_sections = offset[n - 1] + 1;";
+    src.template parameter< global_ptr<V>       >("ovals");
+    src.template parameter< global_ptr<int>     >("offset");
+    src.template parameter< global_ptr<const V> >("ivals");
+    src.close(")").open("{");
 
-        src.new_line() << "int off = offset[idx];";
-        src.new_line() << "if (idx < (n - 1) && off != offset[idx + 1])";
-        src.open("{");
-        for(int p = 0; p < boost::mpl::size<K>::value; ++p)
-            src.new_line() << "okeys" << p << "[off] = ikeys" << p << "[idx];";
-        src.new_line() << "ovals[off] = ivals[idx];";
-        src.close("}");
+    src.new_line().grid_stride_loop().open("{");
 
-        src.new_line() << "if (idx == (n - 1))";
-        src.open("{");
-        for(int p = 0; p < boost::mpl::size<K>::value; ++p)
-            src.new_line() << "okeys" << p << "[num_sections - 1] = ikeys" << p << "[idx];";
-        src.new_line() << "ovals[num_sections - 1] = ivals[idx];";
-        src.close("}");
+    src.new_line() << "int num_sections = offset[n - 1] + 1;";
 
-        src.close("}");
+    src.new_line() << "int off = offset[idx];";
+    src.new_line() << "if (idx < (n - 1) && off != offset[idx + 1])";
+    src.open("{");
+    for(int p = 0; p < boost::mpl::size<K>::value; ++p)
+        src.new_line() << "okeys" << p << "[off] = ikeys" << p << "[idx];";
+    src.new_line() << "ovals[off] = ivals[idx];";
+    src.close("}");
 
-        src.close("}");
+    src.new_line() << "if (idx == (n - 1))";
+    src.open("{");
+    for(int p = 0; p < boost::mpl::size<K>::value; ++p)
+        src.new_line() << "okeys" << p << "[num_sections - 1] = ikeys" << p << "[idx];";
+    src.new_line() << "ovals[num_sections - 1] = ivals[idx];";
+    src.close("}");
 
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "key_value_mapping"));
-    }
+    src.close("}");
 
-    return kernel->second;
+    src.close("}");
 }
 
 struct do_vex_resize {
@@ -420,6 +347,48 @@ struct do_vex_resize {
     }
 };
 
+//---------------------------------------------------------------------------
+// Kernels used by reduce_by_key. They are compiled as a single program.
+template <int NT, typename K, typename V, class Comp, class Oper>
+struct reduce_by_key_kernels {
+    backend::kernel offset_calculation;
+    backend::kernel block_scan;
+    backend::kernel block_inclusive_scan;
+    backend::kernel block_sum;
+    backend::kernel key_value_mapping;
+
+    reduce_by_key_kernels(const backend::command_queue &queue) {
+        backend::source_generator src(queue);
+
+        Comp::define(src, "comp");
+        Oper::define(src, "oper");
+
+        rbk::offset_calculation<K>(src);
+        rbk::block_scan_by_key<NT, V>(src);
+        rbk::block_inclusive_scan_by_key<NT, V>(src);
+        rbk::block_sum_by_key<V>(src);
+        rbk::key_value_mapping<K, V>(src);
+
+        auto program = backend::build_program(queue, src.str());
+
+        offset_calculation   = backend::kernel(queue, program, "offset_calculation");
+        block_scan           = backend::kernel(queue, program, "block_scan_by_key");
+        block_inclusive_scan = backend::kernel(queue, program, "block_inclusive_scan_by_key");
+        block_sum            = backend::kernel(queue, program, "block_sum_by_key");
+        key_value_mapping    = backend::kernel(queue, program, "key_value_mapping");
+    }
+
+    static const reduce_by_key_kernels& get(const backend::command_queue &queue) {
+        static detail::object_cache<detail::index_by_context, reduce_by_key_kernels> cache;
+
+        auto k = cache.find(queue);
+        if (k == cache.end())
+            k = cache.insert(queue, reduce_by_key_kernels(queue));
+
+        return k->second;
+    }
+};
+
 struct do_push_arg {
     backend::kernel &k;
 
@@ -457,6 +426,9 @@ int reduce_by_key_sink(
     const auto &queue = fusion::at_c<0>(ikeys).queue_list();
     backend::select_context(queue[0]);
 
+    access_list in;
+    in.read_each(ikeys, 0).read(ivals, 0).acquire(queue[0]);
+
     const int NT_cpu = 1;
     const int NT_gpu = 256;
     const int NT = is_cpu(queue[0]) ? NT_cpu : NT_gpu;
@@ -465,14 +437,16 @@ int reduce_by_key_sink(
     size_t num_blocks    = (count + NT - 1) / NT;
     size_t scan_buf_size = alignup(num_blocks, NT);
 
-    backend::device_vector<int> key_sum   (queue[0], scan_buf_size);
-    backend::device_vector<V>   pre_sum   (queue[0], scan_buf_size);
-    backend::device_vector<V>   post_sum  (queue[0], scan_buf_size);
-    backend::device_vector<V>   offset_val(queue[0], count);
-    backend::device_vector<int> offset    (queue[0], count);
+    auto key_sum    = memory_pool::allocate<int>(queue[0], scan_buf_size);
+    auto pre_sum    = memory_pool::allocate<V>  (queue[0], scan_buf_size);
+    auto post_sum   = memory_pool::allocate<V>  (queue[0], scan_buf_size);
+    auto offset_val = memory_pool::allocate<V>  (queue[0], count);
+    auto offset     = memory_pool::allocate<int>(queue[0], count);
 
     /***** Kernel 0 *****/
-    auto krn0 = offset_calculation<K, Comp>(queue[0]);
+    auto krn0 = is_cpu(queue[0]) ?
+        reduce_by_key_kernels<NT_cpu, K, V, Comp, Oper>::get(queue[0]).offset_calculation :
+        reduce_by_key_kernels<NT_gpu, K, V, Comp, Oper>::get(queue[0]).offset_calculation;
 
     krn0.push_arg(count);
     boost::fusion::for_each(ikeys, do_push_arg(krn0));
@@ -485,8 +459,8 @@ int reduce_by_key_sink(
 
     /***** Kernel 1 *****/
     auto krn1 = is_cpu(queue[0]) ?
-        block_scan_by_key<NT_cpu, V, Oper>(queue[0]) :
-        block_scan_by_key<NT_gpu, V, Oper>(queue[0]);
+        reduce_by_key_kernels<NT_cpu, K, V, Comp, Oper>::get(queue[0]).block_scan :
+        reduce_by_key_kernels<NT_gpu, K, V, Comp, Oper>::get(queue[0]).block_scan;
 
     krn1.push_arg(count);
     krn1.push_arg(offset);
@@ -502,8 +476,8 @@ int reduce_by_key_sink(
     uint work_per_thread = std::max<uint>(1U, static_cast<uint>(scan_buf_size / NT));
 
     auto krn2 = is_cpu(queue[0]) ?
-        block_inclusive_scan_by_key<NT_cpu, V, Oper>(queue[0]) :
-        block_inclusive_scan_by_key<NT_gpu, V, Oper>(queue[0]);
+        reduce_by_key_kernels<NT_cpu, K, V, Comp, Oper>::get(queue[0]).block_inclusive_scan :
+        reduce_by_key_kernels<NT_gpu, K, V, Comp, Oper>::get(queue[0]).block_inclusive_scan;
 
     krn2.push_arg(num_blocks);
     krn2.push_arg(key_sum);
@@ -515,7 +489,9 @@ int reduce_by_key_sink(
     krn2(queue[0]);
 
     /***** Kernel 3 *****/
-    auto krn3 = block_sum_by_key<V, Oper>(queue[0]);
+    auto krn3 = is_cpu(queue[0]) ?
+        reduce_by_key_kernels<NT_cpu, K, V, Comp, Oper>::get(queue[0]).block_sum :
+        reduce_by_key_kernels<NT_gpu, K, V, Comp, Oper>::get(queue[0]).block_sum;
 
     krn3.push_arg(count);
     krn3.push_arg(key_sum);
@@ -535,7 +511,12 @@ int reduce_by_key_sink(
     ovals.resize(ivals.queue_list(), out_elements);
 
     /***** Kernel 4 *****/
-    auto krn4 = key_value_mapping<K, V>(queue[0]);
+    access_list out;
+    out.write_each(okeys, 0).write(ovals, 0).acquire(queue[0]);
+
+    auto krn4 = is_cpu(queue[0]) ?
+        reduce_by_key_kernels<NT_cpu, K, V, Comp, Oper>::get(queue[0]).key_value_mapping :
+        reduce_by_key_kernels<NT_gpu, K, V, Comp, Oper>::get(queue[0]).key_value_mapping;
 
     krn4.push_arg(count);
     boost::fusion::for_each(ikeys, do_push_arg(krn4));
@@ -546,6 +527,9 @@ int reduce_by_key_sink(
 
     krn4(queue[0]);
 
+    out.release(queue[0]);
+    in.release(queue[0]);
+
     return out_elements;
 }
 
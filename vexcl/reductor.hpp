@@ -37,11 +37,17 @@ THE SOFTWARE.
 #include <sstream>
 #include <numeric>
 #include <limits>
+#include <cmath>
+#include <memory>
 
 #include <vexcl/operations.hpp>
+#include <vexcl/memory_pool.hpp>
+#include <vexcl/device_scalar.hpp>
 
 namespace vex {
 
+template <typename T> class vector;
+
 /// Summation. Should be used as a template parameter for Reductor class.
 struct SUM {
     // In order to define a reduction kind for vex::Reductor, one should define
@@ -116,6 +122,787 @@ struct MIN {
     };
 };
 
+/// Compensated summation. Should be used as a template parameter for Reductor class.
+/**
+ * The reductor kernel carries a compensation term for the rounding errors of
+ * each partial sum (Kahan-Babuska summation in Neumaier's form). This gives
+ * nearly the accuracy of a sum in twice the working precision. The kernels
+ * should not be compiled with options that allow reassociation of floating
+ * point operations (e.g. -cl-fast-relaxed-math).
+ */
+struct SUM_Kahan {
+    template <class T>
+    struct impl {
+        static_assert(std::is_floating_point<T>::value,
+                "SUM_Kahan is only defined for floating point types");
+
+        static T initial() {
+            return T();
+        }
+
+        struct device : UserFunction<device, T(T, T)> {
+            static std::string name() { return "SUM_Kahan_" + type_name<T>(); }
+            static std::string body() { return "return prm1 + prm2;"; }
+        };
+
+        // Rounding error of device(prm1, prm2). Reduction kinds that define
+        // it get compensated partial results in the reductor kernel.
+        struct error : UserFunction<error, T(T, T)> {
+            static std::string name() { return "SUM_Kahan_error_" + type_name<T>(); }
+            static std::string body() {
+                return "return fabs(prm1) >= fabs(prm2) ? "
+                    "(prm1 - (prm1 + prm2)) + prm2 : (prm2 - (prm1 + prm2)) + prm1;";
+            }
+        };
+
+        T operator()(T a, T b) const {
+            return a + b;
+        }
+    };
+};
+
+/// Maximum element and its position. Should be used as a template parameter for Reductor class.
+/**
+ * The result is std::pair<T, size_t> of the maximum value and the index of
+ * its first occurrence. Indices are global, i.e. the partitioning of the
+ * vectors between devices is taken into account. An empty expression gives
+ * static_cast<size_t>(-1) as the index.
+ */
+struct ARGMAX {
+    template <class T>
+    struct impl {
+        typedef std::pair<T, size_t> result_type;
+
+        // Initial value for the operation.
+        static T initial() {
+            return MAX::impl<T>::initial();
+        }
+
+        // Device-side comparison: is prm1 better than prm2? Reduction kinds
+        // that define it get the indices of the selected values.
+        struct select : UserFunction<select, bool(T, T)> {
+            static std::string name() { return "ARGMAX_" + type_name<T>(); }
+            static std::string body() { return "return prm1 > prm2;"; }
+        };
+
+        // Host-side reduction function. Equal values resolve to the lower
+        // index.
+        result_type operator()(const result_type &a, const result_type &b) const {
+            return (b.first > a.first || (!(a.first > b.first) && b.second < a.second)) ? b : a;
+        }
+    };
+};
+
+/// Minimum element and its position. Should be used as a template parameter for Reductor class.
+/**
+ * The result is std::pair<T, size_t> of the minimum value and the global
+ * index of its first occurrence (see vex::ARGMAX).
+ */
+struct ARGMIN {
+    template <class T>
+    struct impl {
+        typedef std::pair<T, size_t> result_type;
+
+        static T initial() {
+            return MIN::impl<T>::initial();
+        }
+
+        struct select : UserFunction<select, bool(T, T)> {
+            static std::string name() { return "ARGMIN_" + type_name<T>(); }
+            static std::string body() { return "return prm1 < prm2;"; }
+        };
+
+        result_type operator()(const result_type &a, const result_type &b) const {
+            return (b.first < a.first || (!(a.first < b.first) && b.second < a.second)) ? b : a;
+        }
+    };
+};
+
+/// Minimum and maximum elements. Should be used as a template parameter for Reductor class.
+/**
+ * Both values are found in a single pass. The result is std::pair<T, T> of
+ * the minimum and the maximum.
+ */
+struct MINMAX {
+    template <class T>
+    struct impl {
+        typedef std::pair<T, T> result_type;
+
+        // Reduction kinds that define the first and the second reductions
+        // get both of them done by the same kernel.
+        typedef MIN::impl<T> first;
+        typedef MAX::impl<T> second;
+    };
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+// Rounding error function of a reduction kind, if any. Each accumulator of
+// the reductor kernel then gets a compensation term, which is written out
+// next to the partial result, and the partial results are combined with
+// Neumaier's algorithm.
+template <class Impl, class Enable = void>
+struct reduction_error {
+    static const bool compensated = false;
+
+    static void define(backend::source_generator&) {}
+    static std::string name() { return ""; }
+
+    // Shared memory slots per work item for n accumulators.
+    static size_t slots(size_t n) { return n; }
+};
+
+template <class Impl>
+struct reduction_error<Impl,
+    typename std::enable_if<
+        std::is_same<typename Impl::error, typename Impl::error>::value
+    >::type>
+{
+    static const bool compensated = true;
+
+    static void define(backend::source_generator &src) {
+        Impl::error::define(src);
+    }
+
+    static std::string name() {
+        return Impl::error::name();
+    }
+
+    static size_t slots(size_t n) { return 2 * n; }
+};
+
+template <class Impl, class Enable = void>
+struct has_select_function : std::false_type {};
+
+template <class Impl>
+struct has_select_function<Impl,
+    typename std::enable_if<
+        std::is_same<typename Impl::select, typename Impl::select>::value
+    >::type
+    > : std::true_type
+{};
+
+template <class Impl, class Enable = void>
+struct has_paired_reductions : std::false_type {};
+
+template <class Impl>
+struct has_paired_reductions<Impl,
+    typename std::enable_if<
+        std::is_same<typename Impl::first,  typename Impl::first >::value &&
+        std::is_same<typename Impl::second, typename Impl::second>::value
+    >::type
+    > : std::true_type
+{};
+
+// Index of an accumulator that has not seen any values yet.
+const cl_ulong no_reduction_index = static_cast<cl_ulong>(-1);
+
+// How the reductor kernel accumulates the values of a reduction kind. Each
+// component of the reduced expression gets a number of channels, and each
+// channel has its own accumulator. Plain kinds have a single channel, which
+// may be compensated (see reduction_error).
+template <typename real, class Impl, class Enable = void>
+struct reduction_kind {
+    typedef real value_type;
+    typedef real result_type;
+
+    static const size_t channels = 1;
+    static const bool   indexed  = false;
+
+    static const bool compensated = reduction_error<Impl>::compensated;
+
+    static void define(backend::source_generator &src) {
+        Impl::device::define(src);
+        reduction_error<Impl>::define(src);
+    }
+
+    // Device-side reduction function of c-th channel.
+    static std::string fun(size_t) {
+        return Impl::device::name();
+    }
+
+    static std::string error() {
+        return reduction_error<Impl>::name();
+    }
+
+    static std::string select() {
+        return "";
+    }
+
+    static real initial(size_t) {
+        return Impl::initial();
+    }
+
+    static result_type initial_result() {
+        return Impl::initial();
+    }
+
+    // Shared memory per work item for n components.
+    static size_t smem(size_t n) {
+        return reduction_error<Impl>::slots(n) * sizeof(real);
+    }
+
+    // Adds a partial result of c-th channel to the result.
+    static void combine(result_type &r, size_t, real v, cl_ulong, size_t) {
+        r = Impl()(r, v);
+    }
+};
+
+// Two reductions of the same values (e.g. MINMAX).
+template <typename real, class Impl>
+struct reduction_kind<real, Impl,
+    typename std::enable_if<has_paired_reductions<Impl>::value>::type
+    >
+{
+    typedef typename Impl::first  first;
+    typedef typename Impl::second second;
+
+    typedef real value_type;
+    typedef std::pair<real, real> result_type;
+
+    static const size_t channels = 2;
+    static const bool   indexed  = false;
+
+    static const bool compensated = false;
+
+    static void define(backend::source_generator &src) {
+        first::device::define(src);
+        second::device::define(src);
+    }
+
+    static std::string fun(size_t c) {
+        return c ? second::device::name() : first::device::name();
+    }
+
+    static std::string error() {
+        return "";
+    }
+
+    static std::string select() {
+        return "";
+    }
+
+    static real initial(size_t c) {
+        return c ? second::initial() : first::initial();
+    }
+
+    static result_type initial_result() {
+        return result_type(first::initial(), second::initial());
+    }
+
+    static size_t smem(size_t n) {
+        return 2 * n * sizeof(real);
+    }
+
+    static void combine(result_type &r, size_t c, real v, cl_ulong, size_t) {
+        if (c)
+            r.second = second()(r.second, v);
+        else
+            r.first = first()(r.first, v);
+    }
+};
+
+// Selection of the best value together with its index (e.g. ARGMAX). The
+// indices are relative to the part of the expression on each device, and the
+// start of the part is added to them on the host.
+template <typename real, class Impl>
+struct reduction_kind<real, Impl,
+    typename std::enable_if<has_select_function<Impl>::value>::type
+    >
+{
+    typedef real value_type;
+    typedef std::pair<real, size_t> result_type;
+
+    static const size_t channels = 1;
+    static const bool   indexed  = true;
+
+    static const bool compensated = false;
+
+    static void define(backend::source_generator &src) {
+        Impl::select::define(src);
+    }
+
+    static std::string fun(size_t) {
+        return "";
+    }
+
+    static std::string error() {
+        return "";
+    }
+
+    static std::string select() {
+        return Impl::select::name();
+    }
+
+    static real initial(size_t) {
+        return Impl::initial();
+    }
+
+    static result_type initial_result() {
+        return result_type(Impl::initial(), static_cast<size_t>(-1));
+    }
+
+    static size_t smem(size_t n) {
+        return n * (sizeof(real) + sizeof(cl_ulong));
+    }
+
+    static void combine(result_type &r, size_t, real v, cl_ulong idx, size_t start) {
+        if (idx != no_reduction_index)
+            r = Impl()(r, result_type(v, static_cast<size_t>(idx) + start));
+    }
+};
+
+// Condition for the value v with index i to replace the value w with index j
+// in an indexed reduction. Equal values resolve to the lower index.
+inline std::string reduction_better(const std::string &select,
+        const std::string &v, const std::string &i,
+        const std::string &w, const std::string &j)
+{
+    return select + "(" + v + ", " + w + ") || (!" + select + "(" + w + ", " + v
+        + ") && " + i + " < " + j + ")";
+}
+
+// Name of a-th accumulator variable of the reductor kernel.
+inline std::string reduction_var(const std::string &prefix, size_t a) {
+    std::ostringstream s;
+    s << prefix << "_" << a + 1;
+    return s.str();
+}
+
+// Adds a partial result on the host. Compensated kinds get the partial
+// sums and their error terms as separate values, which are summed with
+// Neumaier's algorithm; the running error is kept in err.
+template <class Kind>
+void combine_partial(typename Kind::result_type &r, typename Kind::result_type&,
+        size_t c, typename Kind::value_type v, cl_ulong idx, size_t start,
+        std::false_type)
+{
+    Kind::combine(r, c, v, idx, start);
+}
+
+template <class Kind>
+void combine_partial(typename Kind::result_type &r, typename Kind::result_type &err,
+        size_t, typename Kind::value_type v, cl_ulong, size_t,
+        std::true_type)
+{
+    typename Kind::result_type s = r + v;
+    err += std::abs(r) >= std::abs(v) ? (r - s) + v : (v - s) + r;
+    r = s;
+}
+
+template <class Kind>
+void finish_partial(typename Kind::result_type&, const typename Kind::result_type&,
+        std::false_type)
+{}
+
+template <class Kind>
+void finish_partial(typename Kind::result_type &r, const typename Kind::result_type &err,
+        std::true_type)
+{
+    r += err;
+}
+
+// Plain reduction: nothing is assigned by the reductor kernel.
+struct reduce_only {
+    // The reduced expression is only read, and the output goes to a separate
+    // buffer.
+    static const parameter_access expr_access = no_alias_access;
+
+    void properties(get_expression_properties&) const {}
+
+    void preamble(backend::source_generator&, const backend::command_queue&,
+            kernel_generator_state_ptr) const {}
+
+    void declare(backend::source_generator&, const backend::command_queue&) const {}
+
+    void assign(backend::source_generator&, const backend::command_queue&,
+            kernel_generator_state_ptr) const {}
+
+    void set_args(backend::kernel&, unsigned, size_t) const {}
+
+    // Accesses of the reduced expression are tracked by the reductor.
+    void acquire(const backend::command_queue&, unsigned) const {}
+    void release(const backend::command_queue&, unsigned) const {}
+
+    size_t bytes() const { return 0; }
+
+    const void* variable() const { return 0; }
+};
+
+// Estimates memory traffic per element of the reduced expression. The given
+// terminal is held in a kernel variable and is not read from memory.
+struct count_unloaded_bytes {
+    const void *var;
+    size_t &bytes;
+
+    count_unloaded_bytes(const void *var, size_t &bytes) : var(var), bytes(bytes) {}
+
+    template <typename Term>
+    typename std::enable_if<traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        if (static_cast<const void*>(std::addressof(term)) != var)
+            bytes += traits::get_terminal_bytes_per_element(term);
+    }
+
+    template <typename Term>
+    typename std::enable_if<!traits::terminal_is_value<Term>::value, void>::type
+    operator()(const Term &term) const {
+        bytes += traits::get_terminal_bytes_per_element(boost::proto::value(term));
+    }
+};
+
+// Assignment lhs = rhs made by the reductor kernel. The reduced expression
+// gets the new values of lhs from a kernel variable, so lhs should be a
+// single vex::vector.
+template <class LHS, class RHS>
+struct reduce_assignment {
+    // Other terminals of the reduced expression could refer to lhs.
+    static const parameter_access expr_access = read_only_access;
+
+    LHS       &lhs;
+    const RHS &rhs;
+
+    reduce_assignment(LHS &lhs, const RHS &rhs) : lhs(lhs), rhs(rhs) {}
+
+    void properties(get_expression_properties &prop) const {
+        extract_terminals()(boost::proto::as_child(lhs), prop);
+        extract_terminals()(boost::proto::as_child(rhs), prop);
+    }
+
+    void preamble(backend::source_generator &src,
+            const backend::command_queue &q, kernel_generator_state_ptr state) const
+    {
+        output_terminal_preamble termpream(src, q, "asg", state);
+        boost::proto::eval(boost::proto::as_child(lhs), termpream);
+        boost::proto::eval(boost::proto::as_child(rhs), termpream);
+    }
+
+    void declare(backend::source_generator &src, const backend::command_queue &q) const {
+        declare_expression_parameter declare(src, q, "asg", empty_state(),
+                read_write_access);
+        extract_terminals()(boost::proto::as_child(lhs), declare);
+
+        declare.access = read_only_access;
+        extract_terminals()(boost::proto::as_child(rhs), declare);
+    }
+
+    void assign(backend::source_generator &src, const backend::command_queue &q,
+            kernel_generator_state_ptr state) const
+    {
+        output_local_preamble loc_init(src, q, "asg", empty_state());
+        boost::proto::eval(boost::proto::as_child(lhs), loc_init);
+        boost::proto::eval(boost::proto::as_child(rhs), loc_init);
+
+        // Here lhs is a single vector, so its parameter is asg_1.
+        vector_expr_context rhs_ctx(src, q, "asg", empty_state());
+        rhs_ctx.prm_idx = 1;
+
+        src.new_line() << type_name<typename LHS::value_type>() << " asg_val = ";
+        boost::proto::eval(boost::proto::as_child(rhs), rhs_ctx);
+        src << ";";
+
+        vector_expr_context lhs_ctx(src, q, "asg", empty_state());
+        src.new_line();
+        boost::proto::eval(boost::proto::as_child(lhs), lhs_ctx);
+        src << " = asg_val;";
+
+        terminal_variables vars;
+        vars[std::addressof(lhs)] = "asg_val";
+        (*state)["terminal_variables"] = vars;
+    }
+
+    void set_args(backend::kernel &krn, unsigned d, size_t start) const {
+        set_expression_argument setarg(krn, d, start, empty_state());
+        extract_terminals()(boost::proto::as_child(lhs), setarg);
+        extract_terminals()(boost::proto::as_child(rhs), setarg);
+    }
+
+    void acquire(const backend::command_queue &q, unsigned d) const {
+        trackers(d).acquire(q);
+    }
+
+    void release(const backend::command_queue &q, unsigned d) const {
+        trackers(d).release(q);
+    }
+
+    size_t bytes() const {
+        return assignment_bytes<assign::SET>(
+                boost::proto::as_child(lhs), boost::proto::as_child(rhs));
+    }
+
+    // The terminal of the reduced expression that is held in a variable.
+    const void* variable() const {
+        return std::addressof(lhs);
+    }
+
+    private:
+        access_list trackers(unsigned d) const {
+            access_list acc;
+            acc.write(lhs, d).read(rhs, d);
+            return acc;
+        }
+};
+
+// Component of the reduced expression. A vector expression is the single
+// component of itself.
+template <size_t I, class Expr>
+typename std::enable_if<
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<Expr>::type,
+        vector_expr_grammar
+    >::value,
+    const Expr&
+>::type
+reduced_component(const Expr &expr) {
+    return expr;
+}
+
+template <size_t I, class Expr>
+auto reduced_component(const Expr &expr) ->
+    typename std::enable_if<
+        !boost::proto::matches<
+            typename boost::proto::result_of::as_expr<Expr>::type,
+            vector_expr_grammar
+        >::value,
+        decltype(subexpression<I>::get(expr))
+    >::type
+{
+    return subexpression<I>::get(expr);
+}
+
+// Position of the partial result for i-th component in the shared memory
+// of the reductor kernel.
+inline std::string reduction_slot(size_t i, const std::string &pos) {
+    std::ostringstream s;
+    if (i) s << i << " * block_size + ";
+    s << pos;
+    return s.str();
+}
+
+template <class Expr>
+struct reduction_preamble {
+    const Expr &expr;
+
+    mutable output_terminal_preamble ctx;
+
+    reduction_preamble(const Expr &expr, backend::source_generator &source,
+            const backend::command_queue &queue, kernel_generator_state_ptr state)
+        : expr(expr), ctx(source, queue, "prm", state)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        boost::proto::eval(boost::proto::as_child(reduced_component<I>(expr)), ctx);
+    }
+};
+
+template <class Expr>
+struct reduction_declarator {
+    const Expr &expr;
+
+    mutable declare_expression_parameter ctx;
+
+    reduction_declarator(const Expr &expr, backend::source_generator &source,
+            const backend::command_queue &queue, parameter_access access)
+        : expr(expr), ctx(source, queue, "prm", empty_state(), access)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(reduced_component<I>(expr), ctx);
+    }
+};
+
+// Adds current element of each component to its accumulators. Compensated
+// kinds keep the rounding errors in myErr_A, and indexed kinds keep the
+// indices of the selected values in myIdx_A. Accumulator of c-th channel of
+// I-th component is A = I + c * n.
+template <class Kind, class Expr>
+struct reduction_accumulator {
+    const Expr &expr;
+    size_t n;
+
+    backend::source_generator &source;
+
+    mutable output_local_preamble loc_init;
+    mutable vector_expr_context   expr_ctx;
+
+    reduction_accumulator(const Expr &expr, size_t n,
+            backend::source_generator &source,
+            const backend::command_queue &queue, kernel_generator_state_ptr vars)
+        : expr(expr), n(n), source(source),
+          loc_init(source, queue, "prm", empty_state()),
+          expr_ctx(source, queue, "prm", vars)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        boost::proto::eval(reduced_component<I>(expr), loc_init);
+
+        if (Kind::channels == 1 && !Kind::indexed && Kind::error().empty()) {
+            source.new_line() << "mySum_" << I + 1 << " = " << Kind::fun(0)
+                << "(mySum_" << I + 1 << ", ";
+            boost::proto::eval(reduced_component<I>(expr), expr_ctx);
+            source << ");";
+            return;
+        }
+
+        source.open("{");
+        source.new_line() << type_name<typename Kind::value_type>() << " val = ";
+        boost::proto::eval(reduced_component<I>(expr), expr_ctx);
+        source << ";";
+
+        for(size_t c = 0; c < Kind::channels; ++c) {
+            std::string sum = reduction_var("mySum", I + c * n);
+            std::string err = reduction_var("myErr", I + c * n);
+            std::string pos = reduction_var("myIdx", I + c * n);
+
+            if (Kind::indexed) {
+                source.new_line() << "if (" << reduction_better(
+                        Kind::select(), "val", "idx", sum, pos) << ")";
+                source.open("{");
+                source.new_line() << sum << " = val;";
+                source.new_line() << pos << " = idx;";
+                source.close("}");
+            } else if (!Kind::error().empty()) {
+                source.new_line() << err << " = " << Kind::fun(c) << "("
+                    << err << ", " << Kind::error() << "(" << sum << ", val));";
+                source.new_line() << sum << " = " << Kind::fun(c) << "("
+                    << sum << ", val);";
+            } else {
+                source.new_line() << sum << " = " << Kind::fun(c) << "("
+                    << sum << ", val);";
+            }
+        }
+
+        source.close("}");
+    }
+};
+
+template <class Expr>
+struct reduction_arg_setter {
+    const Expr &expr;
+
+    mutable set_expression_argument ctx;
+
+    reduction_arg_setter(const Expr &expr, backend::kernel &krn,
+            unsigned part, size_t offset)
+        : expr(expr), ctx(krn, part, offset, empty_state())
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(reduced_component<I>(expr), ctx);
+    }
+};
+
+template <class Expr>
+struct reduction_access {
+    const Expr &expr;
+
+    mutable collect_access_trackers ctx;
+
+    reduction_access(const Expr &expr, std::vector<access_tracker*> &trackers, unsigned part)
+        : expr(expr), ctx(trackers, part)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(reduced_component<I>(expr), ctx);
+    }
+};
+
+template <class Expr>
+struct reduction_bytes {
+    const Expr &expr;
+
+    count_unloaded_bytes ctx;
+
+    reduction_bytes(const Expr &expr, const void *var, size_t &bytes)
+        : expr(expr), ctx(var, bytes)
+    { }
+
+    template <size_t I>
+    void apply() const {
+        extract_terminals()(reduced_component<I>(expr), ctx);
+    }
+};
+
+} // namespace detail
+/// \endcond
+
+template <typename real, class RDC> class Reductor;
+
+/// Result of an asynchronous reduction.
+/**
+ * Returned by Reductor::async(). The reduction is complete on each device
+ * once the commands submitted before the future was created are complete.
+ * Copies of the future share the same result.
+ */
+template <typename real, class RDC>
+class reduction_future {
+    public:
+        /// Waits for the reduction to complete.
+        void wait() const {
+            if (state->ready) return;
+
+            for(auto q = state->queue.begin(); q != state->queue.end(); ++q)
+                q->finish();
+
+            state->ready = true;
+        }
+
+        /// Waits for the reduction to complete and returns the result.
+        real get() const {
+            wait();
+
+            typedef
+                detail::reduction_kind<real, typename RDC::template impl<real> >
+                kind;
+
+            std::integral_constant<bool, kind::compensated> compensated;
+
+            real result = kind::initial_result(), error = real();
+
+            for(auto v = state->hbuf.begin(); v != state->hbuf.end(); ++v)
+                detail::combine_partial<kind>(result, error, 0, *v, 0, 0, compensated);
+
+            detail::finish_partial<kind>(result, error, compensated);
+
+            return result;
+        }
+    private:
+        // Reduced values of each device (followed by their error terms for
+        // compensated kinds) are read into hbuf without blocking.
+        // The device buffers and hbuf should outlive the transfers, so the
+        // queues are finished before the state is destroyed.
+        struct shared_state {
+            bool ready;
+
+            std::vector<backend::command_queue>            queue;
+            std::vector< backend::device_vector<real> > dbuf;
+            std::vector<real>                             hbuf;
+
+            shared_state() : ready(false) {}
+
+            ~shared_state() {
+                if (ready) return;
+
+                try {
+                    for(auto q = queue.begin(); q != queue.end(); ++q)
+                        q->finish();
+                } catch(...) { }
+            }
+        };
+
+        std::shared_ptr<shared_state> state;
+
+        reduction_future() : state(std::make_shared<shared_state>()) {}
+
+        friend class Reductor<real, RDC>;
+};
+
 /// Parallel reduction of arbitrary expression.
 /**
  * Reduction uses small temporary buffer on each device present in the queue
@@ -124,7 +911,18 @@ struct MIN {
  */
 template <typename real, class RDC>
 class Reductor {
+    private:
+        typedef
+            detail::reduction_kind<real, typename RDC::template impl<real> >
+            kind;
     public:
+        /// Type of the reduction result.
+        /**
+         * This is real for most reduction kinds, or a std::pair for kinds
+         * like vex::ARGMAX or vex::MINMAX.
+         */
+        typedef typename kind::result_type result_type;
+
         /// Constructor.
         Reductor(const std::vector<backend::command_queue> &queue
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
@@ -135,38 +933,138 @@ class Reductor {
         /// Compute reduction of a vector expression.
         template <class Expr>
 #ifdef DOXYGEN
-        real
+        result_type
 #else
         typename std::enable_if<
-            boost::proto::matches<Expr, vector_expr_grammar>::value,
-            real
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<Expr>::type,
+                vector_expr_grammar
+            >::value,
+            result_type
         >::type
 #endif
         operator()(const Expr &expr) const;
 
-        /// Compute reduction of a multivector expression.
+        /// Compute reduction of a multivector expression or a tuple of vector expressions.
+        /**
+         * All components are reduced by a single kernel, and the partial
+         * results are read back from each device at once.
+         */
         template <class Expr>
 #ifdef DOXYGEN
-        std::array<real, N>
+        std::array<result_type, N>
 #else
         typename std::enable_if<
-            boost::proto::matches<Expr, multivector_expr_grammar>::value &&
-            !boost::proto::matches<Expr, vector_expr_grammar>::value,
-            std::array<real, std::result_of<traits::multiex_dimension(Expr)>::type::value>
+            (
+                boost::proto::matches<
+                    typename boost::proto::result_of::as_expr<Expr>::type,
+                    multivector_expr_grammar
+                >::value &&
+                !boost::proto::matches<
+                    typename boost::proto::result_of::as_expr<Expr>::type,
+                    vector_expr_grammar
+                >::value
+            ) || is_tuple<Expr>::value,
+            std::array<result_type, traits::get_dimension<Expr>::value>
         >::type
 #endif
         operator()(const Expr &expr) const;
+
+        /// Assign vector expression to a vector and compute reduction of another expression.
+        /**
+         * Both operations are made by a single kernel. The reduced expression
+         * sees the new values of lhs without reading them back from memory:
+         * \code
+         * vex::Reductor<double, vex::SUM> sum(ctx);
+         * double norm2 = sum(y, f(x), y * y); // y = f(x); norm2 = sum(y * y);
+         * \endcode
+         * Other terminals of the reduced expression should not refer to the
+         * memory of lhs.
+         */
+        template <class T, class RHS, class Expr>
+#ifdef DOXYGEN
+        result_type
+#else
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<RHS>::type,
+                vector_expr_grammar
+            >::value &&
+            boost::proto::matches<Expr, vector_expr_grammar>::value,
+            result_type
+        >::type
+#endif
+        operator()(vector<T> &lhs, const RHS &rhs, const Expr &expr) const;
+
+        /// Start reduction of a vector expression without waiting for the result.
+        /**
+         * The partial results of each device are combined by a small device
+         * kernel, and the reduced value is read back asynchronously. The
+         * host may submit other work to the queues while the reduction is in
+         * progress:
+         * \code
+         * vex::Reductor<double, vex::SUM> sum(ctx);
+         * auto xy = sum.async(x * y);
+         * z = sin(z); // Does not depend on the reduction.
+         * double s = xy.get();
+         * \endcode
+         */
+        template <class Expr>
+#ifdef DOXYGEN
+        reduction_future<real, RDC>
+#else
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<Expr>::type,
+                vector_expr_grammar
+            >::value,
+            reduction_future<real, RDC>
+        >::type
+#endif
+        async(const Expr &expr) const;
+
+        /// Compute reduction of a vector expression and store the result in a device scalar.
+        /**
+         * With a single device, the partial results are combined by a small
+         * device kernel, and the host does not wait for the reduction to
+         * complete. With several devices, the values of each device are
+         * combined on the host, so the call blocks until the reduction
+         * completes and then writes the result to each device.
+         *
+         * The scalar should live on the same devices and contexts as the
+         * reductor queues.
+         */
+        template <class Expr>
+#ifdef DOXYGEN
+        void
+#else
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<Expr>::type,
+                vector_expr_grammar
+            >::value,
+            void
+        >::type
+#endif
+        operator()(device_scalar<real> &result, const Expr &expr) const;
     private:
         const std::vector<backend::command_queue> &queue;
 
+        // Partial results, and their indices for indexed reductions.
         struct reductor_data {
-            std::vector<real>            hbuf;
-            backend::device_vector<real> dbuf;
-
-            reductor_data(const backend::command_queue &q)
-                : hbuf(backend::kernel::num_workgroups(q)),
-                  dbuf(q, backend::kernel::num_workgroups(q))
-            { }
+            std::vector<real>                hbuf;
+            backend::device_vector<real>     dbuf;
+            std::vector<cl_ulong>            ihbuf;
+            backend::device_vector<cl_ulong> idbuf;
+
+            reductor_data(const backend::command_queue &q, size_t n)
+                : hbuf(n), dbuf(q, n)
+            {
+                if (kind::indexed) {
+                    ihbuf.resize(n);
+                    idbuf = backend::device_vector<cl_ulong>(q, n);
+                }
+            }
         };
 
         typedef
@@ -178,19 +1076,45 @@ class Reductor {
             return cache;
         }
 
-        template <size_t I, size_t N, class Expr>
-        typename std::enable_if<I == N, void>::type
-        assign_subexpressions(std::array<real, N> &, const Expr &) const
-        { }
+        // Buffers for the partial results of n accumulators.
+        static reductor_data& get_data(const backend::command_queue &q, size_t n) {
+            auto &cache = get_data_cache();
+            size_t size = n * backend::kernel::num_workgroups(q);
 
-        template <size_t I, size_t N, class Expr>
-        typename std::enable_if<I < N, void>::type
-        assign_subexpressions(std::array<real, N> &result, const Expr &expr) const
-        {
-            result[I] = (*this)(detail::extract_subexpression<I>()(expr));
+            auto data = cache.find(q);
 
-            assign_subexpressions<I + 1, N, Expr>(result, expr);
+            if (data != cache.end() && data->second.hbuf.size() < size) {
+                cache.erase(q);
+                data = cache.find(q);
+            }
+
+            if (data == cache.end())
+                data = cache.insert(q, reductor_data(q, size));
+
+            return data->second;
         }
+
+        // Submits the reductor kernel. Each device gets the partial results
+        // of N * kind::channels accumulators per workgroup in its data
+        // buffer.
+        template <size_t N, class Assign, class Expr>
+        detail::get_expression_properties
+        launch(const Assign &assign, const Expr &expr) const;
+
+        template <size_t N, class Assign, class Expr>
+        std::array<result_type, N> reduce(const Assign &assign, const Expr &expr) const;
+
+        // Combines the partial results of a launched single-component
+        // reduction on each device, and starts reading them back.
+        reduction_future<real, RDC>
+        collect(const detail::get_expression_properties &prop) const;
+
+        // Combines the partial results of a single-component reduction on
+        // the d-th device, and writes the reduced value to dst. When
+        // keep_error is set, compensated kinds write the sum and its error
+        // term separately, so that dst should hold two values.
+        void finalize(unsigned d, const backend::device_vector<real> &dst,
+                bool keep_error = false) const;
 };
 
 #ifndef DOXYGEN
@@ -201,23 +1125,52 @@ Reductor<real,RDC>::Reductor(const std::vector<backend::command_queue> &queue)
 
 template <typename real, class RDC> template <class Expr>
 typename std::enable_if<
-    boost::proto::matches<Expr, vector_expr_grammar>::value,
-    real
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<Expr>::type,
+        vector_expr_grammar
+    >::value,
+    typename Reductor<real,RDC>::result_type
 >::type
 Reductor<real,RDC>::operator()(const Expr &expr) const {
+    return reduce<1>(detail::reduce_only(), expr)[0];
+}
+
+template <typename real, class RDC> template <class T, class RHS, class Expr>
+typename std::enable_if<
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<RHS>::type,
+        vector_expr_grammar
+    >::value &&
+    boost::proto::matches<Expr, vector_expr_grammar>::value,
+    typename Reductor<real,RDC>::result_type
+>::type
+Reductor<real,RDC>::operator()(vector<T> &lhs, const RHS &rhs, const Expr &expr) const {
+    return reduce<1>(detail::reduce_assignment<vector<T>, RHS>(lhs, rhs), expr)[0];
+}
+
+template <typename real, class RDC> template <size_t N, class Assign, class Expr>
+detail::get_expression_properties
+Reductor<real,RDC>::launch(const Assign &assign, const Expr &expr) const {
     using namespace detail;
 
     static kernel_cache cache;
-
-    auto &data_cache = get_data_cache();
+    static object_cache<index_by_context, stats::detail::counter> stat_cache;
 
     get_expression_properties prop;
-    extract_terminals()(expr, prop);
+    extract_terminals()(reduced_component<0>(expr), prop);
+    assign.properties(prop);
 
-    real initial = RDC::template impl<real>::initial();
+    // Number of accumulators.
+    const size_t A = N * kind::channels;
+
+    const bool compensated = kind::compensated;
+
+    // Number of partial results per workgroup. Compensated kinds write
+    // the error terms after the sums.
+    const size_t S = compensated ? 2 * A : A;
 
     // If expression is of zero size, then there is nothing to do. Hurray!
-    if (prop.size == 0) return initial;
+    if (prop.size == 0) return prop;
 
     // Sometimes the expression only knows its size:
     if (prop.size && prop.part.empty())
@@ -231,147 +1184,500 @@ Reductor<real,RDC>::operator()(const Expr &expr) const {
         if (kernel == cache.end()) {
             backend::source_generator source(queue[d]);
 
-            typedef typename RDC::template impl<real>::device fun;
-            fun::define(source);
+            kind::define(source);
 
-            output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
-            boost::proto::eval(boost::proto::as_child(expr),  termpream);
+            auto pre_state = empty_state();
+            static_for<0, N>::loop(
+                    reduction_preamble<Expr>(expr, source, queue[d], pre_state));
+            assign.preamble(source, queue[d], pre_state);
 
             source.kernel("vexcl_reductor_kernel")
                 .open("(").parameter<size_t>("n");
 
-            extract_terminals()( expr, declare_expression_parameter(source, queue[d], "prm", empty_state()) );
+            static_for<0, N>::loop(
+                    reduction_declarator<Expr>(expr, source, queue[d], Assign::expr_access));
+            assign.declare(source, queue[d]);
 
+            source.template parameter< global_ptr<real> >("g_odata");
+            if (kind::indexed)
+                source.template parameter< global_ptr<cl_ulong> >("g_oidx");
             source
-                .template parameter< global_ptr<real> >("g_odata")
                 .template smem_parameter<real>()
                 .close(")");
 
 #define VEXCL_INCREMENT_MY_SUM                                                 \
   {                                                                            \
-    output_local_preamble loc_init(source, queue[d], "prm", empty_state());    \
-    boost::proto::eval(expr, loc_init);                                        \
-    vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());      \
-    source.new_line() << "mySum = " << fun::name() << "(mySum, ";              \
-    boost::proto::eval(expr, expr_ctx);                                        \
-    source << ");";                                                            \
+    auto vars = empty_state();                                                 \
+    assign.assign(source, queue[d], vars);                                     \
+    static_for<0, N>::loop(reduction_accumulator<kind, Expr>(                  \
+          expr, N, source, queue[d], vars));                                   \
   }
 
+            // Each workgroup writes A partial results to g_odata (and their
+            // indices to g_oidx), followed by A compensation terms for
+            // compensated kinds. The accumulators are kept in A consecutive
+            // blocks of the shared memory, followed by A blocks of the
+            // compensation terms. Indices go first, in front of the
+            // accumulators, so that the 8-byte values stay aligned whatever
+            // the size of real.
             source.open("{");
             source.smem_declaration<real>();
             source.new_line() << type_name< shared_ptr<real> >() << " sdata = smem;";
 
-            if ( backend::is_cpu(queue[d]) ) {
+            if ( get_queue_info(queue[d]).cpu ) {
                 source.new_line() << "size_t grid_size  = " << source.global_size(0) << ";";
                 source.new_line() << "size_t chunk_size = (n + grid_size - 1) / grid_size;";
                 source.new_line() << "size_t chunk_id   = " << source.global_id(0) << ";";
                 source.new_line() << "size_t start      = min(n, chunk_size * chunk_id);";
                 source.new_line() << "size_t stop       = min(n, chunk_size * (chunk_id + 1));";
-                source.new_line() << type_name<real>() << " mySum = (" << type_name<real>() << ")" << initial << ";";
+                for(size_t a = 0; a < A; ++a) {
+                    source.new_line() << type_name<real>() << " " << reduction_var("mySum", a)
+                        << " = (" << type_name<real>() << ")" << kind::initial(a / N) << ";";
+                    if (compensated)
+                        source.new_line() << type_name<real>() << " " << reduction_var("myErr", a)
+                            << " = (" << type_name<real>() << ")0;";
+                    if (kind::indexed)
+                        source.new_line() << type_name<cl_ulong>() << " " << reduction_var("myIdx", a)
+                            << " = (" << type_name<cl_ulong>() << ")-1;";
+                }
                 source.new_line() << "for (size_t idx = start; idx < stop; idx++)";
                 source.open("{");
                 VEXCL_INCREMENT_MY_SUM
                 source.close("}");
-                source.new_line() << "g_odata[" << source.group_id(0) << "] = mySum;";
+                for(size_t a = 0; a < A; ++a) {
+                    source.new_line() << "g_odata[" << S << " * " << source.group_id(0)
+                        << " + " << a << "] = " << reduction_var("mySum", a) << ";";
+                    if (compensated)
+                        source.new_line() << "g_odata[" << S << " * " << source.group_id(0)
+                            << " + " << A + a << "] = " << reduction_var("myErr", a) << ";";
+                    if (kind::indexed)
+                        source.new_line() << "g_oidx[" << A << " * " << source.group_id(0)
+                            << " + " << a << "] = " << reduction_var("myIdx", a) << ";";
+                }
                 source.close("}");
 
                 kernel = cache.insert(queue[d], backend::kernel(
                             queue[d], source.str(), "vexcl_reductor_kernel"));
+                stat_cache.insert(queue[d], stats::detail::counter(
+                            source.str(), "vexcl_reductor_kernel"));
             } else {
                 source.new_line() << "size_t tid = " << source.local_id(0) << ";";
                 source.new_line() << "size_t block_size = " << source.local_size(0) << ";";
-                source.new_line() << type_name<real>() << " mySum = " << initial << ";";
+                if (kind::indexed) {
+                    source.new_line() << type_name< shared_ptr<cl_ulong> >() << " idata = ("
+                        << type_name< shared_ptr<cl_ulong> >() << ")smem;";
+                    source.new_line() << "sdata = (" << type_name< shared_ptr<real> >()
+                        << ")(idata + " << A << " * block_size);";
+                }
+                for(size_t a = 0; a < A; ++a) {
+                    source.new_line() << type_name<real>() << " " << reduction_var("mySum", a)
+                        << " = " << kind::initial(a / N) << ";";
+                    if (compensated)
+                        source.new_line() << type_name<real>() << " " << reduction_var("myErr", a) << " = 0;";
+                    if (kind::indexed)
+                        source.new_line() << type_name<cl_ulong>() << " " << reduction_var("myIdx", a)
+                            << " = (" << type_name<cl_ulong>() << ")-1;";
+                }
 
                 source.grid_stride_loop().open("{");
                 VEXCL_INCREMENT_MY_SUM
                 source.close("}");
-                source.new_line() << "sdata[tid] = mySum;";
+
+                // Combines a-th accumulator with the one of the pair work
+                // item. For compensated kinds, the compensation term gets the
+                // other compensation term and the rounding error of the sum,
+                // which should go before the sum is updated. Indexed kinds
+                // take the value of the pair work item, if it is better.
+                auto combine = [&](const std::string &mem, const std::string &imem,
+                        size_t a, const std::string &pair)
+                {
+                    std::string sum = reduction_var("mySum", a);
+
+                    if (kind::indexed) {
+                        std::string pos = reduction_var("myIdx", a);
+
+                        source.new_line() << "if (" << reduction_better(kind::select(),
+                                mem + "[" + reduction_slot(a, pair) + "]",
+                                imem + "[" + reduction_slot(a, pair) + "]",
+                                sum, pos) << ")";
+                        source.open("{");
+                        source.new_line() << mem << "[" << reduction_slot(a, "tid") << "] = "
+                            << sum << " = " << mem << "[" << reduction_slot(a, pair) << "];";
+                        source.new_line() << imem << "[" << reduction_slot(a, "tid") << "] = "
+                            << pos << " = " << imem << "[" << reduction_slot(a, pair) << "];";
+                        source.close("}");
+                        return;
+                    }
+
+                    if (compensated)
+                        source.new_line() << mem << "[" << reduction_slot(A + a, "tid") << "] = "
+                            << reduction_var("myErr", a) << " = "
+                            << kind::fun(a / N) << "(" << kind::fun(a / N) << "("
+                            << reduction_var("myErr", a) << ", "
+                            << mem << "[" << reduction_slot(A + a, pair) << "]), "
+                            << kind::error() << "(" << sum << ", "
+                            << mem << "[" << reduction_slot(a, pair) << "]));";
+
+                    source.new_line() << mem << "[" << reduction_slot(a, "tid") << "] = "
+                        << sum << " = " << kind::fun(a / N) << "(" << sum << ", "
+                        << mem << "[" << reduction_slot(a, pair) << "]);";
+                };
+
+                for(size_t a = 0; a < A; ++a) {
+                    source.new_line() << "sdata[" << reduction_slot(a, "tid") << "] = "
+                        << reduction_var("mySum", a) << ";";
+                    if (compensated)
+                        source.new_line() << "sdata[" << reduction_slot(A + a, "tid") << "] = "
+                            << reduction_var("myErr", a) << ";";
+                    if (kind::indexed)
+                        source.new_line() << "idata[" << reduction_slot(a, "tid") << "] = "
+                            << reduction_var("myIdx", a) << ";";
+                }
                 source.new_line().barrier();
                 for(unsigned bs = 512; bs > 32; bs /= 2) {
+                    std::ostringstream pair;
+                    pair << "tid + " << bs;
+
                     source.new_line() << "if (block_size >= " << bs * 2 << ")";
-                    source.open("{").new_line() << "if (tid < " << bs << ") "
-                        "{ sdata[tid] = mySum = " << fun::name() << "(mySum, sdata[tid + " << bs << "]); }";
+                    source.open("{").new_line() << "if (tid < " << bs << ")";
+                    source.open("{");
+                    for(size_t a = 0; a < A; ++a)
+                        combine("sdata", "idata", a, pair.str());
+                    source.close("}");
                     source.new_line().barrier().close("}");
                 }
                 source.new_line() << "if (tid < 32)";
                 source.open("{");
                 source.new_line() << "volatile " << type_name< shared_ptr<real> >() << " smem = sdata;";
+                if (kind::indexed)
+                    source.new_line() << "volatile " << type_name< shared_ptr<cl_ulong> >() << " ismem = idata;";
                 for(unsigned bs = 32; bs > 0; bs /= 2) {
-                    source.new_line() << "if (block_size >= " << 2 * bs << ") "
-                        "{ smem[tid] = mySum = " << fun::name() << "(mySum, smem[tid + " << bs << "]); }";
+                    std::ostringstream pair;
+                    pair << "tid + " << bs;
+
+                    source.new_line() << "if (block_size >= " << 2 * bs << ")";
+                    source.open("{");
+                    for(size_t a = 0; a < A; ++a)
+                        combine("smem", "ismem", a, pair.str());
+                    source.close("}");
+                }
+                source.close("}");
+                source.new_line() << "if (tid == 0)";
+                source.open("{");
+                for(size_t a = 0; a < A; ++a) {
+                    source.new_line() << "g_odata[" << S << " * " << source.group_id(0)
+                        << " + " << a << "] = sdata[" << reduction_slot(a, "0") << "];";
+                    if (compensated)
+                        source.new_line() << "g_odata[" << S << " * " << source.group_id(0)
+                            << " + " << A + a << "] = sdata[" << reduction_slot(A + a, "0") << "];";
+                    if (kind::indexed)
+                        source.new_line() << "g_oidx[" << A << " * " << source.group_id(0)
+                            << " + " << a << "] = idata[" << reduction_slot(a, "0") << "];";
                 }
                 source.close("}");
-                source.new_line() << "if (tid == 0) g_odata[" << source.group_id(0) << "] = sdata[0];";
                 source.close("}");
 
                 kernel = cache.insert(queue[d], backend::kernel(
                             queue[d], source.str(), "vexcl_reductor_kernel",
-                            sizeof(real)));
+                            kind::smem(N)));
+                stat_cache.insert(queue[d], stats::detail::counter(
+                            source.str(), "vexcl_reductor_kernel"));
             }
         }
 
 #undef VEXCL_INCREMENT_MY_SUM
 
         if (size_t psize = prop.part_size(d)) {
-            auto data = data_cache.find(queue[d]);
-            if (data == data_cache.end())
-                data = data_cache.insert(queue[d], reductor_data(queue[d]));
+            auto &data = get_data(queue[d], S);
 
             kernel->second.push_arg(psize);
 
-            extract_terminals()(
-                    expr,
-                    set_expression_argument(kernel->second, d, prop.part_start(d), empty_state())
-                    );
+            static_for<0, N>::loop(reduction_arg_setter<Expr>(
+                        expr, kernel->second, d, prop.part_start(d)));
+
+            assign.set_args(kernel->second, d, prop.part_start(d));
+
+            kernel->second.push_arg(data.dbuf);
+            if (kind::indexed)
+                kernel->second.push_arg(data.idbuf);
+            kernel->second.set_smem([](size_t wgs){ return wgs * kind::smem(N); });
+
+            size_t bytes = 0;
+            if (stats::enabled()) {
+                bytes = assign.bytes();
+                static_for<0, N>::loop(
+                        reduction_bytes<Expr>(expr, assign.variable(), bytes));
+            }
+
+            stats::detail::counter::launch stat(
+                    stat_cache.find(queue[d])->second, queue[d], psize, psize * bytes);
 
-            kernel->second.push_arg(data->second.dbuf);
-            kernel->second.set_smem([](size_t wgs){ return wgs * sizeof(real); });
+            access_list acc;
+            static_for<0, N>::loop(reduction_access<Expr>(expr, acc.reads, d));
 
+            assign.acquire(queue[d], d);
+            acc.acquire(queue[d]);
             kernel->second(queue[d]);
+            acc.release(queue[d]);
+            assign.release(queue[d], d);
+
+            stat.done();
         }
     }
 
+    return prop;
+}
+
+template <typename real, class RDC> template <size_t N, class Assign, class Expr>
+std::array<typename Reductor<real,RDC>::result_type, N>
+Reductor<real,RDC>::reduce(const Assign &assign, const Expr &expr) const {
+    detail::get_expression_properties prop = launch<N>(assign, expr);
+
+    const size_t A = N * kind::channels;
+    const size_t S = kind::compensated ? 2 * A : A;
+
+    std::array<result_type, N> result, error;
+    result.fill(kind::initial_result());
+    error.fill(result_type());
+
+    if (prop.size == 0) return result;
+
     for(unsigned d = 0; d < queue.size(); d++) {
         if (prop.part_size(d)) {
-            auto data = data_cache.find(queue[d]);
-
-            data->second.dbuf.read(queue[d], 0, data->second.hbuf.size(), data->second.hbuf.data());
+            auto &data = get_data(queue[d], S);
+            size_t size = S * backend::kernel::num_workgroups(queue[d]);
+
+            trace::detail::command cmd(queue[d]);
+            data.dbuf.read(queue[d], 0, size, data.hbuf.data());
+            if (kind::indexed)
+                data.idbuf.read(queue[d], 0, size, data.ihbuf.data());
+            cmd.done("read_data", "transfer",
+                    size * (sizeof(real) + (kind::indexed ? sizeof(cl_ulong) : 0)));
         }
     }
 
-    real result = initial;
-    typename RDC::template impl<real> rdc;
     for(unsigned d = 0; d < queue.size(); d++) {
         if (prop.part_size(d)) {
-            auto data = data_cache.find(queue[d]);
+            auto &data = get_data(queue[d], S);
+            size_t size = S * backend::kernel::num_workgroups(queue[d]);
 
             queue[d].finish();
 
-            result = rdc(result, std::accumulate(
-                        data->second.hbuf.begin(), data->second.hbuf.end(),
-                        initial, rdc));
+            // j-th partial result belongs to (j % S % A)-th accumulator,
+            // which is the channel (j % S % A) / N of the component j % N.
+            // Compensation terms are added as any other partial sum.
+            for(size_t j = 0; j < size; ++j)
+                detail::combine_partial<kind>(result[j % N], error[j % N],
+                        (j % S % A) / N, data.hbuf[j],
+                        kind::indexed ? data.ihbuf[j] : 0, prop.part_start(d),
+                        std::integral_constant<bool, kind::compensated>());
         }
     }
 
+    for(size_t i = 0; i < N; ++i)
+        detail::finish_partial<kind>(result[i], error[i],
+                std::integral_constant<bool, kind::compensated>());
+
     return result;
 }
 
 template <typename real, class RDC> template <class Expr>
 typename std::enable_if<
-    boost::proto::matches<Expr, multivector_expr_grammar>::value &&
-    !boost::proto::matches<Expr, vector_expr_grammar>::value,
-    std::array<real, std::result_of<traits::multiex_dimension(Expr)>::type::value>
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<Expr>::type,
+        vector_expr_grammar
+    >::value,
+    reduction_future<real, RDC>
 >::type
-Reductor<real,RDC>::operator()(const Expr &expr) const {
-    const size_t dim = std::result_of<traits::multiex_dimension(Expr)>::type::value;
-    std::array<real, dim> result;
+Reductor<real,RDC>::async(const Expr &expr) const {
+    static_assert(std::is_same<result_type, real>::value,
+            "Only scalar reductions may be finished on the device");
 
-    assign_subexpressions<0, dim, Expr>(result, expr);
+    return collect(launch<1>(detail::reduce_only(), expr));
+}
 
-    return result;
+template <typename real, class RDC> template <class Expr>
+typename std::enable_if<
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<Expr>::type,
+        vector_expr_grammar
+    >::value,
+    void
+>::type
+Reductor<real,RDC>::operator()(device_scalar<real> &result, const Expr &expr) const {
+    static_assert(std::is_same<result_type, real>::value,
+            "Only scalar reductions may be finished on the device");
+
+    const std::vector<backend::command_queue> &rq = result.queue_list();
+
+    precondition(rq.size() == queue.size(), "Incompatible queue lists");
+
+    for(unsigned d = 0; d < queue.size(); ++d)
+        precondition(
+                backend::get_context_id(rq[d]) == backend::get_context_id(queue[d]) &&
+                get_queue_info(rq[d]).device == get_queue_info(queue[d]).device,
+                "Device scalar is located on another device or context"
+                );
+
+    detail::get_expression_properties prop = launch<1>(detail::reduce_only(), expr);
+
+    if (prop.size == 0) {
+        result = RDC::template impl<real>::initial();
+    } else if (queue.size() == 1) {
+        result.access(0).acquire(queue[0], true);
+        finalize(0, result(0));
+        result.access(0).release(queue[0], true);
+    } else {
+        // A host synchronization point: values of the devices are combined
+        // on the host.
+        result = collect(prop).get();
+    }
+}
+
+template <typename real, class RDC>
+reduction_future<real, RDC>
+Reductor<real,RDC>::collect(const detail::get_expression_properties &prop) const {
+    reduction_future<real, RDC> future;
+
+    if (prop.size == 0) {
+        future.state->ready = true;
+        return future;
+    }
+
+    auto &state = *future.state;
+
+    const size_t S = kind::compensated ? 2 : 1;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (prop.part_size(d)) {
+            state.queue.push_back(queue[d]);
+            state.dbuf.push_back(memory_pool::allocate<real>(queue[d], S));
+            finalize(d, state.dbuf.back(), true);
+        }
+    }
+
+    // Pointers to hbuf elements should not change after the reads are
+    // submitted.
+    state.hbuf.resize(S * state.queue.size());
+
+    for(size_t k = 0; k < state.queue.size(); ++k) {
+        trace::detail::command cmd(state.queue[k]);
+        state.dbuf[k].read(state.queue[k], 0, S, &state.hbuf[S * k]);
+        cmd.done("read_data", "transfer", S * sizeof(real));
+    }
+
+    return future;
+}
+
+template <typename real, class RDC>
+void Reductor<real,RDC>::finalize(unsigned d, const backend::device_vector<real> &dst,
+        bool keep_error) const
+{
+    using namespace detail;
+
+    static kernel_cache cache;
+
+    backend::select_context(queue[d]);
+
+    auto kernel = cache.find(queue[d]);
+
+    if (kernel == cache.end()) {
+        backend::source_generator source(queue[d]);
+
+        kind::define(source);
+
+        // A single work item combines the partial results of all
+        // workgroups. There are only a few of them. For compensated kinds
+        // these are the sums followed by their error terms, which are all
+        // added up with Neumaier's algorithm.
+        source.kernel("vexcl_reductor_final_kernel")
+            .open("(")
+            .template parameter<size_t>("n")
+            .template parameter< global_ptr<const real> >("g_idata")
+            .template parameter< global_ptr<real> >("g_odata");
+        if (kind::compensated)
+            source.template parameter<int>("keep_error");
+        source.close(")").open("{");
+
+        source.new_line() << type_name<real>() << " mySum = ("
+            << type_name<real>() << ")" << kind::initial(0) << ";";
+        if (kind::compensated)
+            source.new_line() << type_name<real>() << " myErr = ("
+                << type_name<real>() << ")0;";
+        source.new_line() << "for(size_t i = 0; i < n; ++i)";
+        source.open("{");
+        if (kind::compensated)
+            source.new_line() << "myErr += " << kind::error() << "(mySum, g_idata[i]);";
+        source.new_line() << "mySum = " << kind::fun(0) << "(mySum, g_idata[i]);";
+        source.close("}");
+        if (kind::compensated) {
+            source.new_line() << "if (keep_error)";
+            source.open("{");
+            source.new_line() << "g_odata[0] = mySum;";
+            source.new_line() << "g_odata[1] = myErr;";
+            source.close("}");
+            source.new_line() << "else";
+            source.open("{");
+            source.new_line() << "g_odata[0] = " << kind::fun(0) << "(mySum, myErr);";
+            source.close("}");
+        } else {
+            source.new_line() << "g_odata[0] = mySum;";
+        }
+        source.close("}");
+
+        kernel = cache.insert(queue[d], backend::kernel(
+                    queue[d], source.str(), "vexcl_reductor_final_kernel"));
+        kernel->second.config(1, 1);
+    }
+
+    const size_t S = kind::compensated ? 2 : 1;
+
+    auto &data = get_data(queue[d], S);
+
+    kernel->second.push_arg(S * backend::kernel::num_workgroups(queue[d]));
+    kernel->second.push_arg(data.dbuf);
+    kernel->second.push_arg(dst);
+    if (kind::compensated)
+        kernel->second.push_arg(static_cast<int>(keep_error));
+
+    kernel->second(queue[d]);
+}
+
+template <typename real, class RDC> template <class Expr>
+typename std::enable_if<
+    (
+        boost::proto::matches<
+            typename boost::proto::result_of::as_expr<Expr>::type,
+            multivector_expr_grammar
+        >::value &&
+        !boost::proto::matches<
+            typename boost::proto::result_of::as_expr<Expr>::type,
+            vector_expr_grammar
+        >::value
+    ) || is_tuple<Expr>::value,
+    std::array<typename Reductor<real,RDC>::result_type, traits::get_dimension<Expr>::value>
+>::type
+Reductor<real,RDC>::operator()(const Expr &expr) const {
+    return reduce<traits::get_dimension<Expr>::value>(detail::reduce_only(), expr);
 }
 #endif
 
+/// Assigns vector expression to a vector and returns reduction of another expression.
+/**
+ * Both operations are made in a single pass over the data (see
+ * Reductor::operator()(vector<T>&, const RHS&, const Expr&)). The result type is
+ * deduced from the reduced expression.
+ * \code
+ * double s = vex::assign_and_reduce<vex::SUM>(y, f(x), y * y);
+ * \endcode
+ */
+template <class RDC, class T, class RHS, class Expr>
+typename Reductor<typename detail::return_type<Expr>::type, RDC>::result_type
+assign_and_reduce(vector<T> &lhs, const RHS &rhs, const Expr &expr) {
+    typedef typename detail::return_type<Expr>::type real;
+    return Reductor<real, RDC>(lhs.queue_list())(lhs, rhs, expr);
+}
+
 /// Returns an instance of vex::Reductor<T,R>
 /**
  * \deprecated
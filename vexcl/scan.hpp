@@ -52,10 +52,12 @@ limitations under the License.
 
 #include <string>
 #include <functional>
+#include <numeric>
 
 #include <vexcl/backend.hpp>
 #include <vexcl/util.hpp>
 #include <vexcl/vector.hpp>
+#include <vexcl/memory_pool.hpp>
 #include <vexcl/function.hpp>
 
 namespace vex {
@@ -63,273 +65,259 @@ namespace vex {
 namespace detail {
 
 //---------------------------------------------------------------------------
-template <int NT, typename T, typename Oper>
-backend::kernel block_inclusive_scan(const backend::command_queue &queue)
-{
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Oper::define(src, "oper");
-
-        src.kernel("block_inclusive_scan")
-            .open("(")
-                .template parameter< size_t              >("n")
-                .template parameter< global_ptr<const T> >("input")
-                .template parameter< T                   >("identity")
-                .template parameter< global_ptr<T>       >("scan_buf1")
-                .template parameter< global_ptr<T>       >("scan_buf2")
-                .template parameter< int                 >("exclusive")
-            .close(")").open("{");
-
-        src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t block = " << src.group_id(0)   << ";";
-
-        src.new_line() << "size_t offset = 1;";
-
-        {
-            std::ostringstream shared;
-            shared << "shared[" << 2 * NT << "]";
-            src.smem_static_var(type_name<T>(), shared.str());
-        }
-
-        // load input into shared memory
-        src.new_line()
-            << "if(block * " << 2 * NT << " + l_id < n)"
-            << " shared[l_id] = input[block * " << 2 * NT << " + l_id];";
-
-        src.new_line()
-            << "if(block * " << 2 * NT << " + l_id + " << NT << " < n)"
-            << " shared[l_id + " << NT << "] ="
-            << " input[block * " << 2 * NT << " + l_id + " << NT << "];";
-
-        // Exclusive case
-        src.new_line()
-            << "if(exclusive && g_id == 0)"
-            << " shared[l_id] = oper(identity, input[0]);";
-
-        src.new_line() << "for (size_t start = " << NT << "; start > 0; start >>= 1, offset *= 2)";
-        src.open("{");
-        src.new_line().barrier();
-
-        src.new_line() << "if (l_id < start)";
-        src.open("{");
-        src.new_line() << "size_t temp1 = offset * (2 * l_id + 1) - 1;";
-        src.new_line() << "size_t temp2 = offset * (2 * l_id + 2) - 1;";
-        src.new_line() << type_name<T>() << " y2 = shared[temp2];";
-        src.new_line() << type_name<T>() << " y1 = shared[temp1];";
-        src.new_line() << "shared[temp2] = oper(y2, y1);";
-        src.close("}");
-
-        src.close("}");
-        src.new_line().barrier();
-
-        src.new_line() << "if (l_id == 0)";
-        src.open("{");
-        src.new_line() << "scan_buf1[ block ] = shared[" << NT * 2 - 1 << "];";
-        src.new_line() << "scan_buf2[ block ] = shared[" << NT - 1 << "];";
-        src.close("}");
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_inclusive_scan"));
+template <int NT, typename T>
+void block_inclusive_scan(backend::source_generator &src) {
+    src.kernel("block_inclusive_scan")
+        .open("(")
+            .template parameter< size_t              >("n")
+            .template parameter< global_ptr<const T> >("input")
+            .template parameter< T                   >("identity")
+            .template parameter< global_ptr<T>       >("scan_buf1")
+            .template parameter< global_ptr<T>       >("scan_buf2")
+            .template parameter< int                 >("exclusive")
+        .close(")").open("{");
+
+    src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t block = " << src.group_id(0)   << ";";
+
+    src.new_line() << "size_t offset = 1;";
+
+    {
+        std::ostringstream shared;
+        shared << "shared[" << 2 * NT << "]";
+        src.smem_static_var(type_name<T>(), shared.str());
     }
 
-    return kernel->second;
+    // load input into shared memory
+    src.new_line()
+        << "if(block * " << 2 * NT << " + l_id < n)"
+        << " shared[l_id] = input[block * " << 2 * NT << " + l_id];";
+
+    src.new_line()
+        << "if(block * " << 2 * NT << " + l_id + " << NT << " < n)"
+        << " shared[l_id + " << NT << "] ="
+        << " input[block * " << 2 * NT << " + l_id + " << NT << "];";
+
+    // Exclusive case
+    src.new_line()
+        << "if(exclusive && g_id == 0)"
+        << " shared[l_id] = oper(identity, input[0]);";
+
+    src.new_line() << "for (size_t start = " << NT << "; start > 0; start >>= 1, offset *= 2)";
+    src.open("{");
+    src.new_line().barrier();
+
+    src.new_line() << "if (l_id < start)";
+    src.open("{");
+    src.new_line() << "size_t temp1 = offset * (2 * l_id + 1) - 1;";
+    src.new_line() << "size_t temp2 = offset * (2 * l_id + 2) - 1;";
+    src.new_line() << type_name<T>() << " y2 = shared[temp2];";
+    src.new_line() << type_name<T>() << " y1 = shared[temp1];";
+    src.new_line() << "shared[temp2] = oper(y2, y1);";
+    src.close("}");
+
+    src.close("}");
+    src.new_line().barrier();
+
+    src.new_line() << "if (l_id == 0)";
+    src.open("{");
+    src.new_line() << "scan_buf1[ block ] = shared[" << NT * 2 - 1 << "];";
+    src.new_line() << "scan_buf2[ block ] = shared[" << NT - 1 << "];";
+    src.close("}");
+    src.close("}");
 }
 
-template <int NT, typename T, typename Oper>
-backend::kernel intra_block_inclusive_scan(const backend::command_queue &queue)
-{
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
-
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
-
-        Oper::define(src, "oper");
+template <int NT, typename T>
+void intra_block_inclusive_scan(backend::source_generator &src) {
+    src.kernel("intra_block_inclusive_scan")
+        .open("(")
+            .template parameter< size_t              >("n")
+            .template parameter< global_ptr<T>       >("post_sum")
+            .template parameter< global_ptr<const T> >("pre_sum")
+            .template parameter< T                   >("identity")
+            .template parameter< uint                >("work_per_thread")
+        .close(")").open("{");
+
+    src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t map_id = g_id * work_per_thread;";
+
+    {
+        std::ostringstream shared;
+        shared << "shared[" << NT << "]";
+        src.smem_static_var(type_name<T>(), shared.str());
+    }
 
-        src.kernel("intra_block_inclusive_scan")
-            .open("(")
-                .template parameter< size_t              >("n")
-                .template parameter< global_ptr<T>       >("post_sum")
-                .template parameter< global_ptr<const T> >("pre_sum")
-                .template parameter< T                   >("identity")
-                .template parameter< uint                >("work_per_thread")
-            .close(")").open("{");
-
-        src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t map_id = g_id * work_per_thread;";
-
-        {
-            std::ostringstream shared;
-            shared << "shared[" << NT << "]";
-            src.smem_static_var(type_name<T>(), shared.str());
-        }
+    src.new_line() << "size_t offset;";
+    src.new_line() << type_name<T>() << " work_sum;";
+
+    src.new_line() << "if (map_id < n)";
+    src.open("{");
+
+    // accumulate zeroth value manually
+    src.new_line() << "offset = 0;";
+    src.new_line() << "work_sum = pre_sum[map_id];";
+
+    //  Serial accumulation
+    src.new_line() << "for( offset = 1; offset < work_per_thread; ++offset )";
+    src.open("{");
+    src.new_line()
+        << "if (map_id + offset < n)"
+        << " work_sum = oper( work_sum, pre_sum[map_id + offset] );";
+    src.close("}");
+    src.close("}");
+    src.new_line().barrier();
+
+    src.new_line() << type_name<T>() << " scan_sum = work_sum;";
+    src.new_line() << "shared[ l_id ] = work_sum;";
+
+    // scan in shared
+    src.new_line() << "for( offset = 1; offset < " << NT << "; offset *= 2 )";
+    src.open("{");
+    src.new_line().barrier();
+
+    src.new_line()
+        << "if (map_id < n && l_id >= offset)"
+        << " scan_sum = oper( scan_sum, shared[ l_id - offset ] );";
+    src.new_line().barrier();
+    src.new_line() << "shared[ l_id ] = scan_sum;";
+    src.close("}");
+    src.new_line().barrier();
+
+    // write final scan from pre-scan and shared scan
+    src.new_line() << "work_sum = pre_sum[map_id];";
+    src.new_line() << "if (l_id > 0)";
+    src.open("{");
+    src.new_line() << "    work_sum = oper(work_sum, shared[l_id - 1]);";
+    src.new_line() << "    post_sum[map_id] = work_sum;";
+    src.close("}");
+    src.new_line() << "else post_sum[map_id] = work_sum;";
+
+    src.new_line() << "for( offset = 1; offset < work_per_thread; ++offset )";
+    src.open("{");
+    src.new_line().barrier();
+
+    src.new_line() << "if (map_id < n && l_id > 0)";
+    src.open("{");
+    src.new_line() << type_name<T>() << " y = oper(pre_sum[map_id + offset], work_sum);";
+    src.new_line() << "post_sum[ map_id + offset ] = y;";
+    src.new_line() << "work_sum = y;";
+    src.close("}");
+    src.new_line() << "else";
+    src.open("{");
+    src.new_line() << "post_sum[map_id + offset] = oper(pre_sum[map_id + offset], work_sum);";
+    src.new_line() << "work_sum = post_sum[map_id + offset];";
+    src.close("}");
+    src.close("}");
+    src.close("}");
+}
 
-        src.new_line() << "size_t offset;";
-        src.new_line() << type_name<T>() << " work_sum;";
-
-        src.new_line() << "if (map_id < n)";
-        src.open("{");
-
-        // accumulate zeroth value manually
-        src.new_line() << "offset = 0;";
-        src.new_line() << "work_sum = pre_sum[map_id];";
-
-        //  Serial accumulation
-        src.new_line() << "for( offset = 1; offset < work_per_thread; ++offset )";
-        src.open("{");
-        src.new_line()
-            << "if (map_id + offset < n)"
-            << " work_sum = oper( work_sum, pre_sum[map_id + offset] );";
-        src.close("}");
-        src.close("}");
-        src.new_line().barrier();
-
-        src.new_line() << type_name<T>() << " scan_sum = work_sum;";
-        src.new_line() << "shared[ l_id ] = work_sum;";
-
-        // scan in shared
-        src.new_line() << "for( offset = 1; offset < " << NT << "; offset *= 2 )";
-        src.open("{");
-        src.new_line().barrier();
-
-        src.new_line()
-            << "if (map_id < n && l_id >= offset)"
-            << " scan_sum = oper( scan_sum, shared[ l_id - offset ] );";
-        src.new_line().barrier();
-        src.new_line() << "shared[ l_id ] = scan_sum;";
-        src.close("}");
-        src.new_line().barrier();
-
-        // write final scan from pre-scan and shared scan
-        src.new_line() << "work_sum = pre_sum[map_id];";
-        src.new_line() << "if (l_id > 0)";
-        src.open("{");
-        src.new_line() << "    work_sum = oper(work_sum, shared[l_id - 1]);";
-        src.new_line() << "    post_sum[map_id] = work_sum;";
-        src.close("}");
-        src.new_line() << "else post_sum[map_id] = work_sum;";
-
-        src.new_line() << "for( offset = 1; offset < work_per_thread; ++offset )";
-        src.open("{");
-        src.new_line().barrier();
-
-        src.new_line() << "if (map_id < n && l_id > 0)";
-        src.open("{");
-        src.new_line() << type_name<T>() << " y = oper(pre_sum[map_id + offset], work_sum);";
-        src.new_line() << "post_sum[ map_id + offset ] = y;";
-        src.new_line() << "work_sum = y;";
-        src.close("}");
-        src.new_line() << "else";
-        src.open("{");
-        src.new_line() << "post_sum[map_id + offset] = oper(pre_sum[map_id + offset], work_sum);";
-        src.new_line() << "work_sum = post_sum[map_id + offset];";
-        src.close("}");
-        src.close("}");
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "intra_block_inclusive_scan"));
+//---------------------------------------------------------------------------
+template <int NT, typename T>
+void block_addition(backend::source_generator &src) {
+    src.kernel("block_addition")
+        .open("(")
+            .template parameter< size_t              >("n")
+            .template parameter< global_ptr<const T> >("input")
+            .template parameter< global_ptr<T>       >("output")
+            .template parameter< global_ptr<T>       >("post_sum")
+            .template parameter< global_ptr<T>       >("pre_sum")
+            .template parameter< T                   >("identity")
+            .template parameter< int                 >("exclusive")
+        .close(")").open("{");
+
+    src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t block = " << src.group_id(0)   << ";";
+
+    src.new_line() << type_name<T>() << " val;";
+
+    {
+        std::ostringstream shared;
+        shared << "shared[" << NT << "]";
+        src.smem_static_var(type_name<T>(), shared.str());
     }
 
-    return kernel->second;
+    src.new_line() << "if (g_id < n)";
+    src.open("{");
+    src.new_line() << "if (exclusive) val = g_id > 0 ? input[g_id - 1] : identity;";
+    src.new_line() << "else val = input[g_id];";
+    src.close("}");
+    src.new_line() << "shared[l_id] = val;";
+
+    src.new_line() << type_name<T>() << " scan_result = val;";
+    src.new_line() << type_name<T>() << " post_block_sum, new_result;";
+    src.new_line() << type_name<T>() << " y1, y2, sum;";
+
+    src.new_line() << "if(l_id == 0 && g_id < n)";
+    src.open("{");
+    src.new_line() << "if(block > 0)";
+    src.open("{");
+    src.new_line() << "if(block % 2 == 0)  post_block_sum = post_sum[ block/2 - 1 ];";
+    src.new_line() << "else if(block == 1) post_block_sum = pre_sum[0];";
+    src.new_line() << "else";
+    src.open("{");
+    src.new_line() << "y1 = post_sum[ block/2 - 1 ];";
+    src.new_line() << "y2 = pre_sum [ block/2];";
+    src.new_line() << "post_block_sum = oper(y1, y2);";
+    src.close("}");
+    src.new_line() << "new_result = exclusive ? post_block_sum : oper( scan_result, post_block_sum );";
+    src.close("}");
+    src.new_line() << "else new_result = scan_result;";
+
+    src.new_line() << "shared[ l_id ] = new_result;";
+    src.close("}");
+
+    //  Computes a scan within a workgroup
+    src.new_line() << "sum = shared[ l_id ];";
+    src.new_line() << "for( size_t offset = 1; offset < " << NT << "; offset *= 2 )";
+    src.open("{");
+    src.new_line().barrier();
+    src.new_line() << "if (l_id >= offset) sum = oper( sum, shared[ l_id - offset ] );";
+    src.new_line().barrier();
+    src.new_line() << "shared[ l_id ] = sum;";
+    src.close("}");
+    src.new_line().barrier();
+    src.new_line() << "if(g_id < n) output[ g_id ] = sum;";
+
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
+// Kernels used by scan. They are compiled as a single program.
 template <int NT, typename T, typename Oper>
-backend::kernel block_addition(
-        const backend::command_queue &queue)
-{
-    static detail::kernel_cache cache;
-
-    auto kernel = cache.find(queue);
+struct scan_kernels {
+    backend::kernel block_scan;
+    backend::kernel intra_block_scan;
+    backend::kernel block_add;
 
-    if (kernel == cache.end()) {
+    scan_kernels(const backend::command_queue &queue) {
         backend::source_generator src(queue);
 
         Oper::define(src, "oper");
 
-        src.kernel("block_addition")
-            .open("(")
-                .template parameter< size_t              >("n")
-                .template parameter< global_ptr<const T> >("input")
-                .template parameter< global_ptr<T>       >("output")
-                .template parameter< global_ptr<T>       >("post_sum")
-                .template parameter< global_ptr<T>       >("pre_sum")
-                .template parameter< T                   >("identity")
-                .template parameter< int                 >("exclusive")
-            .close(")").open("{");
-
-        src.new_line() << "size_t l_id  = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t g_id  = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t block = " << src.group_id(0)   << ";";
-
-        src.new_line() << type_name<T>() << " val;";
-
-        {
-            std::ostringstream shared;
-            shared << "shared[" << NT << "]";
-            src.smem_static_var(type_name<T>(), shared.str());
-        }
+        block_inclusive_scan<NT, T>(src);
+        intra_block_inclusive_scan<NT, T>(src);
+        block_addition<NT, T>(src);
+
+        auto program = backend::build_program(queue, src.str());
 
-        src.new_line() << "if (g_id < n)";
-        src.open("{");
-        src.new_line() << "if (exclusive) val = g_id > 0 ? input[g_id - 1] : identity;";
-        src.new_line() << "else val = input[g_id];";
-        src.close("}");
-        src.new_line() << "shared[l_id] = val;";
-
-        src.new_line() << type_name<T>() << " scan_result = val;";
-        src.new_line() << type_name<T>() << " post_block_sum, new_result;";
-        src.new_line() << type_name<T>() << " y1, y2, sum;";
-
-        src.new_line() << "if(l_id == 0 && g_id < n)";
-        src.open("{");
-        src.new_line() << "if(block > 0)";
-        src.open("{");
-        src.new_line() << "if(block % 2 == 0)  post_block_sum = post_sum[ block/2 - 1 ];";
-        src.new_line() << "else if(block == 1) post_block_sum = pre_sum[0];";
-        src.new_line() << "else";
-        src.open("{");
-        src.new_line() << "y1 = post_sum[ block/2 - 1 ];";
-        src.new_line() << "y2 = pre_sum [ block/2];";
-        src.new_line() << "post_block_sum = oper(y1, y2);";
-        src.close("}");
-        src.new_line() << "new_result = exclusive ? post_block_sum : oper( scan_result, post_block_sum );";
-        src.close("}");
-        src.new_line() << "else new_result = scan_result;";
-
-        src.new_line() << "shared[ l_id ] = new_result;";
-        src.close("}");
-
-        //  Computes a scan within a workgroup
-        src.new_line() << "sum = shared[ l_id ];";
-        src.new_line() << "for( size_t offset = 1; offset < " << NT << "; offset *= 2 )";
-        src.open("{");
-        src.new_line().barrier();
-        src.new_line() << "if (l_id >= offset) sum = oper( sum, shared[ l_id - offset ] );";
-        src.new_line().barrier();
-        src.new_line() << "shared[ l_id ] = sum;";
-        src.close("}");
-        src.new_line().barrier();
-        src.new_line() << "if(g_id < n) output[ g_id ] = sum;";
-
-        src.close("}");
-
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_addition"));
+        block_scan       = backend::kernel(queue, program, "block_inclusive_scan");
+        intra_block_scan = backend::kernel(queue, program, "intra_block_inclusive_scan");
+        block_add        = backend::kernel(queue, program, "block_addition");
     }
 
-    return kernel->second;
-}
+    static const scan_kernels& get(const backend::command_queue &queue) {
+        static detail::object_cache<detail::index_by_context, scan_kernels> cache;
+
+        auto k = cache.find(queue);
+        if (k == cache.end())
+            k = cache.insert(queue, scan_kernels(queue));
+
+        return k->second;
+    }
+};
 
 template <typename T, typename Oper>
 void scan(
@@ -359,14 +347,14 @@ void scan(
     const size_t num_blocks    = (count + NT2 - 1) / NT2;
     const size_t scan_buf_size = alignup(num_blocks, NT2);
 
-    backend::device_vector<T> pre_sum1(queue, scan_buf_size);
-    backend::device_vector<T> pre_sum2(queue, scan_buf_size);
-    backend::device_vector<T> post_sum(queue, scan_buf_size);
+    auto pre_sum1 = memory_pool::allocate<T>(queue, scan_buf_size);
+    auto pre_sum2 = memory_pool::allocate<T>(queue, scan_buf_size);
+    auto post_sum = memory_pool::allocate<T>(queue, scan_buf_size);
 
     // Kernel0
     auto krn0 = is_cpu(queue) ?
-        block_inclusive_scan<NT_cpu, T, Oper>(queue) :
-        block_inclusive_scan<NT_gpu, T, Oper>(queue);
+        scan_kernels<NT_cpu, T, Oper>::get(queue).block_scan :
+        scan_kernels<NT_gpu, T, Oper>::get(queue).block_scan;
 
     krn0.push_arg(count);
     krn0.push_arg(input);
@@ -381,8 +369,8 @@ void scan(
 
     // Kernel1
     auto krn1 = is_cpu(queue) ?
-        intra_block_inclusive_scan<NT_cpu, T, Oper>(queue) :
-        intra_block_inclusive_scan<NT_gpu, T, Oper>(queue);
+        scan_kernels<NT_cpu, T, Oper>::get(queue).intra_block_scan :
+        scan_kernels<NT_gpu, T, Oper>::get(queue).intra_block_scan;
 
     uint work_per_thread = std::max<uint>(1U, static_cast<uint>(scan_buf_size / NT));
     krn1.push_arg(num_blocks);
@@ -397,8 +385,8 @@ void scan(
 
     // Kernel2
     auto krn2 = is_cpu(queue) ?
-        block_addition<NT_cpu, T, Oper>(queue) :
-        block_addition<NT_gpu, T, Oper>(queue);
+        scan_kernels<NT_cpu, T, Oper>::get(queue).block_add :
+        scan_kernels<NT_gpu, T, Oper>::get(queue).block_add;
 
     krn2.push_arg(count);
     krn2.push_arg(input);
@@ -439,8 +427,12 @@ void inclusive_scan(
 
     auto &queue = input.queue_list();
 
-    for(unsigned d = 0; d < queue.size(); ++d)
+    for(unsigned d = 0; d < queue.size(); ++d) {
+        detail::access_list acc;
+        acc.write(output, d).read(input, d).acquire(queue[d]);
         detail::scan(queue[d], input(d), output(d), init, false, oper.device);
+        acc.release(queue[d]);
+    }
 
     std::vector<T> tail(queue.size() - 1);
 
@@ -452,8 +444,13 @@ void inclusive_scan(
 
     for(unsigned d = 1; d < queue.size(); ++d)
         if (output.part_start(d)) {
+            detail::access_list acc;
+            acc.write(output, d).acquire(queue[d]);
+
             vector<T> part(queue[d], output(d));
             part = oper.device(part, tail[d - 1]);
+
+            acc.release(queue[d]);
         }
 }
 
@@ -490,8 +487,12 @@ void exclusive_scan(
         if (size_t head = input.part_start(d))
             tail[d - 1] = input[head - 1];
 
-    for(unsigned d = 0; d < queue.size(); ++d)
+    for(unsigned d = 0; d < queue.size(); ++d) {
+        detail::access_list acc;
+        acc.write(output, d).read(input, d).acquire(queue[d]);
         detail::scan(queue[d], input(d), output(d), init, true, oper.device);
+        acc.release(queue[d]);
+    }
 
     for(unsigned d = 1; d < queue.size(); ++d)
         if (size_t head = output.part_start(d))
@@ -501,8 +502,13 @@ void exclusive_scan(
 
     for(unsigned d = 1; d < queue.size(); ++d)
         if (output.part_start(d)) {
+            detail::access_list acc;
+            acc.write(output, d).acquire(queue[d]);
+
             vector<T> part(queue[d], output(d));
             part = oper.device(part, tail[d - 1]);
+
+            acc.release(queue[d]);
         }
 }
 
@@ -53,6 +53,7 @@ limitations under the License.
 #include <string>
 
 #include <vexcl/vector.hpp>
+#include <vexcl/memory_pool.hpp>
 #include <vexcl/detail/fusion.hpp>
 #include <vexcl/function.hpp>
 
@@ -74,549 +75,537 @@ struct gcc46_workaround {
 };
 
 //---------------------------------------------------------------------------
-template <int NT, typename K, typename V, class Comp, class Oper, bool exclusive>
-backend::kernel block_scan_by_key(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
+template <int NT, typename K, typename V, bool exclusive>
+void block_scan_by_key(backend::source_generator &src) {
+    src.kernel( "block_scan_by_key")
+        .open("(")
+            .template parameter< size_t              >("n")
+            .template parameter< global_ptr<const V> >("ivals")
+            .template parameter< global_ptr<      V> >("ovals1")
+            .template parameter< global_ptr<      V> >("ovals2");
 
-    auto kernel = cache.find(queue);
+    boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
+    boost::mpl::for_each<K>(pointer_param<global_ptr      >(src, "okeys"));
 
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
+    if (exclusive) src.template parameter<V>("init");
 
-        Comp::define(src, "comp");
-        Oper::define(src, "oper");
+    src.close(")").open("{");
 
-        src.kernel( "block_scan_by_key")
-            .open("(")
-                .template parameter< size_t              >("n")
-                .template parameter< global_ptr<const V> >("ivals")
-                .template parameter< global_ptr<      V> >("ovals1")
-                .template parameter< global_ptr<      V> >("ovals2");
+    src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
+    src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
+    src.new_line() << "size_t block  = " << src.group_id(0)   << ";";
+    src.new_line() << "size_t offset = 1;";
 
-        boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
-        boost::mpl::for_each<K>(pointer_param<global_ptr      >(src, "okeys"));
+    const int    wgsz = NT * 2;
+    const size_t nK   = boost::mpl::size<K>::value;
 
-        if (exclusive) src.template parameter<V>("init");
+    src.new_line() << "size_t pos = block * " << wgsz << " + l_id;";
 
-        src.close(")").open("{");
+    src.new_line() << "struct Shared";
+    src.open("{");
+    src.new_line() << type_name<V>() << " vals[" << wgsz << "];";
 
-        src.new_line() << "size_t g_id   = " << src.global_id(0)  << ";";
-        src.new_line() << "size_t l_id   = " << src.local_id(0)   << ";";
-        src.new_line() << "size_t block  = " << src.group_id(0)   << ";";
-        src.new_line() << "size_t offset = 1;";
+    // gcc 4.6 crashes if the following type iteration is done with lambda.
+    // so here it goes:
+    boost::mpl::for_each<K>( gcc46_workaround(src, wgsz) );
+    src.close("};");
+    src.smem_static_var("struct Shared", "shared");
 
-        const int    wgsz = NT * 2;
-        const size_t nK   = boost::mpl::size<K>::value;
+    if (exclusive) {
+        src.new_line() << "if (g_id > 0 && pos < n)";
+        src.open("{");
 
-        src.new_line() << "size_t pos = block * " << wgsz << " + l_id;";
+        boost::mpl::for_each<K>(
+                type_iterator([&](size_t p, std::string tname) {
+                    src.new_line() << tname << " key1" << p << " = ikeys" << p << "[pos];";
+                    src.new_line() << tname << " key2" << p << " = ikeys" << p << "[pos - 1];";
+                    })
+                );
 
-        src.new_line() << "struct Shared";
+        src.new_line() << "if (comp(key10";
+        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+        src << "))";
         src.open("{");
-        src.new_line() << type_name<V>() << " vals[" << wgsz << "];";
-
-        // gcc 4.6 crashes if the following type iteration is done with lambda.
-        // so here it goes:
-        boost::mpl::for_each<K>( gcc46_workaround(src, wgsz) );
-        src.close("};");
-        src.smem_static_var("struct Shared", "shared");
-
-        if (exclusive) {
-            src.new_line() << "if (g_id > 0 && pos < n)";
-            src.open("{");
-
-            boost::mpl::for_each<K>(
-                    type_iterator([&](size_t p, std::string tname) {
-                        src.new_line() << tname << " key1" << p << " = ikeys" << p << "[pos];";
-                        src.new_line() << tname << " key2" << p << " = ikeys" << p << "[pos - 1];";
-                        })
-                    );
-
-            src.new_line() << "if (comp(key10";
-            for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-            for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-            src << "))";
-            src.open("{");
-            src.new_line() << "shared.vals[l_id] = ivals[pos];";
-            src.close("}");
-            src.new_line() << "else";
-            src.open("{");
-            src.new_line() << "shared.vals[l_id] = oper(init, ivals[pos]);";
-            src.close("}");
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[pos];";
-
-            src.close("}");
-            src.new_line() << "else";
-            src.open("{");
-
-            src.new_line() << "shared.vals[l_id] = oper(init, ivals[0]);";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[0];";
-
-            src.close("}");
-
-            src.new_line() << "if (pos + " << NT << " < n)";
-            src.open("{");
-
-            boost::mpl::for_each<K>(
-                    type_iterator([&](size_t p, std::string tname) {
-                        src.new_line()
-                            << tname << " key1" << p << " = ikeys" << p <<
-                            "[pos + " << NT << "];";
-                        src.new_line()
-                            << tname << " key2" << p << " = ikeys" << p <<
-                            "[pos + " << NT << " - 1];";
-                        })
-                    );
-
-            src.new_line() << "if (comp(key10";
-            for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-            for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-            src << "))";
-            src.open("{");
-            src.new_line()
-                << "shared.vals[l_id + " << NT << "] = ivals[pos + " << NT << "];";
-            src.close("}");
-            src.new_line() << "else";
-            src.open("{");
-            src.new_line()
-                << "shared.vals[l_id + " << NT << "] = oper(init, ivals[pos + " << NT << "]);";
-            src.close("}");
-
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line()
-                    << "shared.keys" << p << "[l_id + " << NT <<
-                    "] = ikeys" << p << "[pos + " << NT << "];";
-
-            src.close("}");
-
-        } else { // inclusive
-            src.new_line() << "if (pos < n)";
-            src.open("{");
-            src.new_line() << "shared.vals[l_id] = ivals[pos];";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[pos];";
-            src.close("}");
-
-            src.new_line() << "if (pos + " << NT << " < n)";
-            src.open("{");
-            src.new_line() << "shared.vals[l_id + " << NT << "] = ivals[pos + " << NT << "];";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id + " << NT << "] = ikeys" << p << "[pos + " << NT << "];";
-            src.close("}");
-        }
-
-        src.new_line() << "for(size_t start = " << NT << "; start > 0; start /= 2)";
+        src.new_line() << "shared.vals[l_id] = ivals[pos];";
+        src.close("}");
+        src.new_line() << "else";
         src.open("{");
-        src.new_line().barrier();
-        src.new_line() << "if (l_id < start)";
+        src.new_line() << "shared.vals[l_id] = oper(init, ivals[pos]);";
+        src.close("}");
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[pos];";
+
+        src.close("}");
+        src.new_line() << "else";
         src.open("{");
 
-        src.new_line() << "size_t temp1 = offset * (2 * l_id + 1) - 1;";
-        src.new_line() << "size_t temp2 = offset * (2 * l_id + 2) - 1;";
+        src.new_line() << "shared.vals[l_id] = oper(init, ivals[0]);";
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[0];";
+
+        src.close("}");
+
+        src.new_line() << "if (pos + " << NT << " < n)";
+        src.open("{");
 
         boost::mpl::for_each<K>(
                 type_iterator([&](size_t p, std::string tname) {
-                    src.new_line() << tname << " key1" << p << " = shared.keys" << p << "[temp1];";
-                    src.new_line() << tname << " key2" << p << " = shared.keys" << p << "[temp2];";
+                    src.new_line()
+                        << tname << " key1" << p << " = ikeys" << p <<
+                        "[pos + " << NT << "];";
+                    src.new_line()
+                        << tname << " key2" << p << " = ikeys" << p <<
+                        "[pos + " << NT << " - 1];";
                     })
                 );
 
-        src.new_line() << "if (comp(key20";
-        for(size_t p = 1; p < nK; ++p) src << ", key2" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", key1" << p;
+        src.new_line() << "if (comp(key10";
+        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
         src << "))";
         src.open("{");
-        src.new_line() << "shared.vals[temp2] = oper(shared.vals[temp2], shared.vals[temp1]);";
+        src.new_line()
+            << "shared.vals[l_id + " << NT << "] = ivals[pos + " << NT << "];";
         src.close("}");
+        src.new_line() << "else";
+        src.open("{");
+        src.new_line()
+            << "shared.vals[l_id + " << NT << "] = oper(init, ivals[pos + " << NT << "]);";
         src.close("}");
-        src.new_line() << "offset *= 2;";
+
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line()
+                << "shared.keys" << p << "[l_id + " << NT <<
+                "] = ikeys" << p << "[pos + " << NT << "];";
+
         src.close("}");
 
-        src.new_line().barrier();
-        src.new_line() << "if (l_id == 0)";
+    } else { // inclusive
+        src.new_line() << "if (pos < n)";
         src.open("{");
+        src.new_line() << "shared.vals[l_id] = ivals[pos];";
         for(size_t p = 0; p < nK; ++p)
-            src.new_line() << "okeys" << p << "[block] = shared.keys" << p << "[" << wgsz - 1 << "];";
-        src.new_line() << "ovals1[block] = shared.vals[" << wgsz - 1 << "];";
-        src.new_line() << "ovals2[block] = shared.vals[" << NT - 1 << "];";
-        src.close("}");
+            src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[pos];";
         src.close("}");
 
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_scan_by_key"));
+        src.new_line() << "if (pos + " << NT << " < n)";
+        src.open("{");
+        src.new_line() << "shared.vals[l_id + " << NT << "] = ivals[pos + " << NT << "];";
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id + " << NT << "] = ikeys" << p << "[pos + " << NT << "];";
+        src.close("}");
     }
 
-    return kernel->second;
-}
-
-//---------------------------------------------------------------------------
-template <int NT, typename K, typename V, class Comp, class Oper>
-backend::kernel block_inclusive_scan_by_key(const backend::command_queue &queue)
-{
-    static detail::kernel_cache cache;
+    src.new_line() << "for(size_t start = " << NT << "; start > 0; start /= 2)";
+    src.open("{");
+    src.new_line().barrier();
+    src.new_line() << "if (l_id < start)";
+    src.open("{");
 
-    auto kernel = cache.find(queue);
+    src.new_line() << "size_t temp1 = offset * (2 * l_id + 1) - 1;";
+    src.new_line() << "size_t temp2 = offset * (2 * l_id + 2) - 1;";
 
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line() << tname << " key1" << p << " = shared.keys" << p << "[temp1];";
+                src.new_line() << tname << " key2" << p << " = shared.keys" << p << "[temp2];";
+                })
+            );
 
-        Comp::define(src, "comp");
-        Oper::define(src, "oper");
+    src.new_line() << "if (comp(key20";
+    for(size_t p = 1; p < nK; ++p) src << ", key2" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", key1" << p;
+    src << "))";
+    src.open("{");
+    src.new_line() << "shared.vals[temp2] = oper(shared.vals[temp2], shared.vals[temp1]);";
+    src.close("}");
+    src.close("}");
+    src.new_line() << "offset *= 2;";
+    src.close("}");
+
+    src.new_line().barrier();
+    src.new_line() << "if (l_id == 0)";
+    src.open("{");
+    for(size_t p = 0; p < nK; ++p)
+        src.new_line() << "okeys" << p << "[block] = shared.keys" << p << "[" << wgsz - 1 << "];";
+    src.new_line() << "ovals1[block] = shared.vals[" << wgsz - 1 << "];";
+    src.new_line() << "ovals2[block] = shared.vals[" << NT - 1 << "];";
+    src.close("}");
+    src.close("}");
+}
 
-        const size_t nK = boost::mpl::size<K>::value;
+//---------------------------------------------------------------------------
+template <int NT, typename K, typename V>
+void block_inclusive_scan_by_key(backend::source_generator &src) {
+    const size_t nK = boost::mpl::size<K>::value;
 
-        src.kernel("block_inclusive_scan_by_key")
-            .open("(")
-                .template parameter< size_t        >("n")
-                .template parameter< global_ptr<V> >("pre_sum")
-                .template parameter< cl_uint       >("work_per_thread");
+    src.kernel("block_inclusive_scan_by_key")
+        .open("(")
+            .template parameter< size_t        >("n")
+            .template parameter< global_ptr<V> >("pre_sum")
+            .template parameter< cl_uint       >("work_per_thread");
 
-        boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "key_sum"));
+    boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "key_sum"));
 
-        src.close(")").open("{");
+    src.close(")").open("{");
 
-        src.new_line() << "size_t block  = " << src.group_id(0)  << ";";
-        src.new_line() << "size_t g_id   = " << src.global_id(0) << ";";
-        src.new_line() << "size_t l_id   = " << src.local_id(0)  << ";";
-        src.new_line() << "size_t map_id = g_id * work_per_thread;";
+    src.new_line() << "size_t block  = " << src.group_id(0)  << ";";
+    src.new_line() << "size_t g_id   = " << src.global_id(0) << ";";
+    src.new_line() << "size_t l_id   = " << src.local_id(0)  << ";";
+    src.new_line() << "size_t map_id = g_id * work_per_thread;";
 
-        src.new_line() << "struct Shared";
-        src.open("{");
-            src.new_line() << type_name<V>() << " vals[" << NT << "];";
-            boost::mpl::for_each<K>(
-                    type_iterator([&](size_t p, std::string tname) {
-                        src.new_line()
-                            << tname << " keys" << p << "[" << NT << "];";
-                        })
-                    );
-        src.close("};");
-        src.smem_static_var("struct Shared", "shared");
-
-        // do offset of zero manually
-        src.new_line() << "uint offset;";
+    src.new_line() << "struct Shared";
+    src.open("{");
+        src.new_line() << type_name<V>() << " vals[" << NT << "];";
         boost::mpl::for_each<K>(
                 type_iterator([&](size_t p, std::string tname) {
-                    src.new_line() << tname << " key" << p << ";";
-                    })
-                );
-        src.new_line() << type_name<V>() << " work_sum;";
-
-        src.new_line() << "if (map_id < n)";
-        src.open("{");
-
-        boost::mpl::for_each<K>(
-                type_iterator([&](size_t p, std::string tname) {
-                    src.new_line() << tname << " prev_key" << p << ";";
+                    src.new_line()
+                        << tname << " keys" << p << "[" << NT << "];";
                     })
                 );
+    src.close("};");
+    src.smem_static_var("struct Shared", "shared");
+
+    // do offset of zero manually
+    src.new_line() << "uint offset;";
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line() << tname << " key" << p << ";";
+                })
+            );
+    src.new_line() << type_name<V>() << " work_sum;";
 
-        // accumulate zeroth value manually
-        src.new_line() << "offset = 0;";
-        for(size_t p = 0; p < nK; ++p)
-            src.new_line() << "key" << p << " = key_sum" << p << "[map_id];";
-        src.new_line() << "work_sum = pre_sum[map_id];";
+    src.new_line() << "if (map_id < n)";
+    src.open("{");
 
-        // serial accumulation
-        src.new_line() << "for(offset = 1; offset < work_per_thread; ++offset)";
-        src.open("{");
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line() << tname << " prev_key" << p << ";";
+                })
+            );
 
-        for(size_t p = 0; p < nK; ++p) {
-            src.new_line() << "prev_key" << p << " = key" << p << ";";
-            src.new_line() << "key" << p << " = " << "key_sum" << p << "[map_id + offset];";
-        }
+    // accumulate zeroth value manually
+    src.new_line() << "offset = 0;";
+    for(size_t p = 0; p < nK; ++p)
+        src.new_line() << "key" << p << " = key_sum" << p << "[map_id];";
+    src.new_line() << "work_sum = pre_sum[map_id];";
 
-        src.new_line() << "if (map_id + offset < n)";
-        src.open("{");
+    // serial accumulation
+    src.new_line() << "for(offset = 1; offset < work_per_thread; ++offset)";
+    src.open("{");
 
-        src.new_line() << "if (comp(key0";
-        for(size_t p = 1; p < nK; ++p) src << ", key" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", prev_key" << p;
-        src << ")) work_sum = oper(work_sum, pre_sum[map_id + offset]);";
-        src.new_line() << "else work_sum =  pre_sum[map_id + offset];";
+    for(size_t p = 0; p < nK; ++p) {
+        src.new_line() << "prev_key" << p << " = key" << p << ";";
+        src.new_line() << "key" << p << " = " << "key_sum" << p << "[map_id + offset];";
+    }
 
-        src.new_line() << "pre_sum[map_id + offset] = work_sum;";
+    src.new_line() << "if (map_id + offset < n)";
+    src.open("{");
 
-        src.close("}");
-        src.close("}");
-        src.close("}");
+    src.new_line() << "if (comp(key0";
+    for(size_t p = 1; p < nK; ++p) src << ", key" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", prev_key" << p;
+    src << ")) work_sum = oper(work_sum, pre_sum[map_id + offset]);";
+    src.new_line() << "else work_sum =  pre_sum[map_id + offset];";
 
-        src.new_line().barrier();
+    src.new_line() << "pre_sum[map_id + offset] = work_sum;";
 
-        src.new_line() << type_name<V>() << " scan_sum = work_sum;";
-        src.new_line() << "shared.vals[l_id] = work_sum;";
-        for(size_t p = 0; p < nK; ++p)
-            src.new_line() << "shared.keys" << p << "[l_id] = key" << p << ";";
+    src.close("}");
+    src.close("}");
+    src.close("}");
 
-        src.new_line() << "for(offset = 1; offset < " << NT << "; offset *= 2)";
-        src.open("{");
+    src.new_line().barrier();
 
-        src.new_line().barrier();
-        src.new_line() << "if (map_id < n)";
-        src.open("{");
+    src.new_line() << type_name<V>() << " scan_sum = work_sum;";
+    src.new_line() << "shared.vals[l_id] = work_sum;";
+    for(size_t p = 0; p < nK; ++p)
+        src.new_line() << "shared.keys" << p << "[l_id] = key" << p << ";";
 
-        src.new_line() << "if (l_id >= offset)";
-        src.open("{");
+    src.new_line() << "for(offset = 1; offset < " << NT << "; offset *= 2)";
+    src.open("{");
 
-        boost::mpl::for_each<K>(
-                type_iterator([&](size_t p, std::string tname) {
-                    src.new_line()
-                        << tname << " key1" << p << " = shared.keys" << p
-                        << "[l_id];";
-                    src.new_line()
-                        << tname << " key2" << p << " = shared.keys" << p
-                        << "[l_id - offset];";
-                    })
-                );
+    src.new_line().barrier();
+    src.new_line() << "if (map_id < n)";
+    src.open("{");
 
-        src.new_line() << "if (comp(key10";
-        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-        src << ")) scan_sum = oper(scan_sum, shared.vals[l_id - offset]);";
-        src.new_line() << "else scan_sum = shared.vals[l_id];";
+    src.new_line() << "if (l_id >= offset)";
+    src.open("{");
 
-        src.close("}");
-        src.close("}");
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line()
+                    << tname << " key1" << p << " = shared.keys" << p
+                    << "[l_id];";
+                src.new_line()
+                    << tname << " key2" << p << " = shared.keys" << p
+                    << "[l_id - offset];";
+                })
+            );
 
-        src.new_line().barrier();
-        src.new_line() << "shared.vals[l_id] = scan_sum;";
+    src.new_line() << "if (comp(key10";
+    for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+    src << ")) scan_sum = oper(scan_sum, shared.vals[l_id - offset]);";
+    src.new_line() << "else scan_sum = shared.vals[l_id];";
 
-        src.close("}");
-        src.new_line().barrier();
+    src.close("}");
+    src.close("}");
 
-        // write final scan from pre-scan and shared scan
-        src.new_line() << "for(offset = 0; offset < work_per_thread; ++offset)";
-        src.open("{");
+    src.new_line().barrier();
+    src.new_line() << "shared.vals[l_id] = scan_sum;";
 
-        src.new_line().barrier(true);
+    src.close("}");
+    src.new_line().barrier();
 
-        src.new_line() << "if (map_id < n && l_id > 0)";
-        src.open("{");
+    // write final scan from pre-scan and shared scan
+    src.new_line() << "for(offset = 0; offset < work_per_thread; ++offset)";
+    src.open("{");
 
-        src.new_line() << type_name<V>() << " y = pre_sum[map_id + offset];";
+    src.new_line().barrier(true);
 
-        boost::mpl::for_each<K>(
-                type_iterator([&](size_t p, std::string tname) {
-                    src.new_line()
-                        << tname << " key1" << p << " = key_sum" << p
-                        << "[map_id + offset];";
-                    src.new_line()
-                        << tname << " key2" << p << " = shared.keys" << p
-                        << "[l_id - 1];";
-                    })
-                );
+    src.new_line() << "if (map_id < n && l_id > 0)";
+    src.open("{");
 
-        src.new_line() << "if (comp(key10";
-        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-        src << ")) y = oper(y, shared.vals[l_id - 1]);";
-        src.new_line() << "pre_sum[map_id + offset] = y;";
-        src.close("}");
-        src.close("}");
-        src.close("}");
+    src.new_line() << type_name<V>() << " y = pre_sum[map_id + offset];";
 
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_inclusive_scan_by_key"));
-    }
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line()
+                    << tname << " key1" << p << " = key_sum" << p
+                    << "[map_id + offset];";
+                src.new_line()
+                    << tname << " key2" << p << " = shared.keys" << p
+                    << "[l_id - 1];";
+                })
+            );
 
-    return kernel->second;
+    src.new_line() << "if (comp(key10";
+    for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+    src << ")) y = oper(y, shared.vals[l_id - 1]);";
+    src.new_line() << "pre_sum[map_id + offset] = y;";
+    src.close("}");
+    src.close("}");
+    src.close("}");
 }
 
 //---------------------------------------------------------------------------
-template <int NT, typename K, typename V, class Comp, class Oper, bool exclusive>
-backend::kernel block_add_by_key(const backend::command_queue &queue) {
-    static detail::kernel_cache cache;
+template <int NT, typename K, typename V, bool exclusive>
+void block_add_by_key(backend::source_generator &src) {
+    src.kernel("block_add_by_key")
+        .open("(")
+            .template parameter<size_t>("n")
+            .template parameter< global_ptr<const V> >("pre_sum")
+            .template parameter< global_ptr<const V> >("pre_sum1")
+            .template parameter< global_ptr<const V> >("ivals")
+            .template parameter< global_ptr<      V> >("ovals");
 
-    auto kernel = cache.find(queue);
-    if (kernel == cache.end()) {
-        backend::source_generator src(queue);
+    boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
 
-        Comp::define(src, "comp");
-        Oper::define(src, "oper");
+    if (exclusive) src.template parameter<V>("init");
 
-        src.kernel("block_add_by_key")
-            .open("(")
-                .template parameter<size_t>("n")
-                .template parameter< global_ptr<const V> >("pre_sum")
-                .template parameter< global_ptr<const V> >("pre_sum1")
-                .template parameter< global_ptr<const V> >("ivals")
-                .template parameter< global_ptr<      V> >("ovals");
+    src.close(")").open("{");
 
-        boost::mpl::for_each<K>(pointer_param<global_ptr, true>(src, "ikeys"));
+    src.new_line() << "size_t g_id   = " << src.global_id(0) << ";";
+    src.new_line() << "size_t l_id   = " << src.local_id(0)  << ";";
+    src.new_line() << "size_t block  = " << src.group_id(0)  << ";";
 
-        if (exclusive) src.template parameter<V>("init");
+    src.new_line() << "struct Shared";
+    src.open("{");
+        src.new_line() << type_name<V>() << " vals[" << NT << "];";
+        boost::mpl::for_each<K>(
+                type_iterator([&](size_t p, std::string tname) {
+                    src.new_line()
+                        << tname << " keys" << p << "[" << NT << "];";
+                    })
+                );
+    src.close("};");
+    src.smem_static_var("struct Shared", "shared");
 
-        src.close(")").open("{");
+    const size_t nK = boost::mpl::size<K>::value;
 
-        src.new_line() << "size_t g_id   = " << src.global_id(0) << ";";
-        src.new_line() << "size_t l_id   = " << src.local_id(0)  << ";";
-        src.new_line() << "size_t block  = " << src.group_id(0)  << ";";
+    // if exclusive, load gloId=0 w/ init, and all others shifted-1
+    src.new_line() << type_name<V>() << " val;";
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line() << tname << " key" << p << ";";
+                })
+            );
+
+    src.new_line() << "if (g_id < n)";
+    src.open("{");
 
-        src.new_line() << "struct Shared";
+    if (exclusive) {
+        src.new_line() << "if (g_id > 0)";
         src.open("{");
-            src.new_line() << type_name<V>() << " vals[" << NT << "];";
-            boost::mpl::for_each<K>(
-                    type_iterator([&](size_t p, std::string tname) {
-                        src.new_line()
-                            << tname << " keys" << p << "[" << NT << "];";
-                        })
-                    );
-        src.close("};");
-        src.smem_static_var("struct Shared", "shared");
-
-        const size_t nK = boost::mpl::size<K>::value;
-
-        // if exclusive, load gloId=0 w/ init, and all others shifted-1
-        src.new_line() << type_name<V>() << " val;";
         boost::mpl::for_each<K>(
                 type_iterator([&](size_t p, std::string tname) {
-                    src.new_line() << tname << " key" << p << ";";
+                    src.new_line() << tname << " key1" << p << " = key" << p << " = ikeys" << p << "[g_id];";
+                    src.new_line() << tname << " key2" << p << " = ikeys" << p << "[g_id-1];";
                     })
                 );
 
-        src.new_line() << "if (g_id < n)";
+        src.new_line() << "if (comp(key10";
+        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+        src << ")) val = ivals[g_id - 1];";
+        src.new_line() << "else val = init;";
+
+        src.new_line() << "shared.vals[l_id] = val;";
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id] = key" << p << ";";
+
+        src.close("}");
+        src.new_line() << "else";
         src.open("{");
 
-        if (exclusive) {
-            src.new_line() << "if (g_id > 0)";
-            src.open("{");
-            boost::mpl::for_each<K>(
-                    type_iterator([&](size_t p, std::string tname) {
-                        src.new_line() << tname << " key1" << p << " = key" << p << " = ikeys" << p << "[g_id];";
-                        src.new_line() << tname << " key2" << p << " = ikeys" << p << "[g_id-1];";
-                        })
-                    );
-
-            src.new_line() << "if (comp(key10";
-            for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-            for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-            src << ")) val = ivals[g_id - 1];";
-            src.new_line() << "else val = init;";
-
-            src.new_line() << "shared.vals[l_id] = val;";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = key" << p << ";";
-
-            src.close("}");
-            src.new_line() << "else";
-            src.open("{");
-
-            src.new_line() << "val = init;";
-            src.new_line() << "shared.vals[l_id] = val;";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[g_id];";
-
-            src.close("}");
-        } else {
-            src.new_line() << "shared.vals[l_id] =val = ivals[g_id];";
-            for(size_t p = 0; p < nK; ++p)
-                src.new_line() << "shared.keys" << p << "[l_id] = key" << p << " = ikeys" << p << "[g_id];";
-        }
+        src.new_line() << "val = init;";
+        src.new_line() << "shared.vals[l_id] = val;";
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id] = ikeys" << p << "[g_id];";
 
         src.close("}");
+    } else {
+        src.new_line() << "shared.vals[l_id] =val = ivals[g_id];";
+        for(size_t p = 0; p < nK; ++p)
+            src.new_line() << "shared.keys" << p << "[l_id] = key" << p << " = ikeys" << p << "[g_id];";
+    }
 
-        // Each work item writes out its calculated scan result, relative to
-        // the beginning of each work group
-        src.new_line() << type_name<V>() << " scan_result = shared.vals[l_id];";
-        src.new_line() << type_name<V>() << " post_sum, new_result, sum;";
+    src.close("}");
+
+    // Each work item writes out its calculated scan result, relative to
+    // the beginning of each work group
+    src.new_line() << type_name<V>() << " scan_result = shared.vals[l_id];";
+    src.new_line() << type_name<V>() << " post_sum, new_result, sum;";
+
+    boost::mpl::for_each<K>(
+            type_iterator([&](size_t p, std::string tname) {
+                src.new_line() << tname
+                    << " key1" << p << ", "
+                    << " key2" << p << ", "
+                    << " key3" << p << ", "
+                    << " key4" << p << ";";
+                })
+            );
 
-        boost::mpl::for_each<K>(
-                type_iterator([&](size_t p, std::string tname) {
-                    src.new_line() << tname
-                        << " key1" << p << ", "
-                        << " key2" << p << ", "
-                        << " key3" << p << ", "
-                        << " key4" << p << ";";
-                    })
-                );
+    src.new_line() << "if (l_id == 0 && g_id < n)";
+    src.open("{");
 
-        src.new_line() << "if (l_id == 0 && g_id < n)";
-        src.open("{");
+    src.new_line() << "if (block > 0)";
+    src.open("{");
 
-        src.new_line() << "if (block > 0)";
-        src.open("{");
+    for(size_t p = 0; p < nK; ++p) {
+        src.new_line() << "key1" << p << " = ikeys" << p << "[g_id];";
+        src.new_line() << "key2" << p << " = ikeys" << p << "[block * "<< NT << " - 1];";
+    }
 
-        for(size_t p = 0; p < nK; ++p) {
-            src.new_line() << "key1" << p << " = ikeys" << p << "[g_id];";
-            src.new_line() << "key2" << p << " = ikeys" << p << "[block * "<< NT << " - 1];";
-        }
+    src.new_line() << "if (block % 2 == 0) post_sum = pre_sum[block / 2 - 1];";
+    src.new_line() << "else if (block == 1) post_sum = pre_sum1[0];";
+    src.new_line() << "else";
+    src.open("{");
 
-        src.new_line() << "if (block % 2 == 0) post_sum = pre_sum[block / 2 - 1];";
-        src.new_line() << "else if (block == 1) post_sum = pre_sum1[0];";
-        src.new_line() << "else";
-        src.open("{");
+    for(size_t p = 0; p < nK; ++p) {
+        src.new_line() << "key3" << p << " = ikeys" << p << "[block * " << NT << " - 1];";
+        src.new_line() << "key4" << p << " = ikeys" << p << "[(block - 1) * " << NT << " - 1];";
+    }
 
-        for(size_t p = 0; p < nK; ++p) {
-            src.new_line() << "key3" << p << " = ikeys" << p << "[block * " << NT << " - 1];";
-            src.new_line() << "key4" << p << " = ikeys" << p << "[(block - 1) * " << NT << " - 1];";
-        }
+    src.new_line() << "if (comp(key30";
+    for(size_t p = 1; p < nK; ++p) src << ", key3" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", key4" << p;
+    src << ")) post_sum = oper(pre_sum[block / 2 - 1], pre_sum1[block / 2]);";
+    src.new_line() << "else post_sum = pre_sum1[block / 2];";
 
-        src.new_line() << "if (comp(key30";
-        for(size_t p = 1; p < nK; ++p) src << ", key3" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", key4" << p;
-        src << ")) post_sum = oper(pre_sum[block / 2 - 1], pre_sum1[block / 2]);";
-        src.new_line() << "else post_sum = pre_sum1[block / 2];";
+    src.close("}");
 
-        src.close("}");
+    if (exclusive) {
+        src.new_line() << "if (comp(key10";
+        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+        src << ")) new_result = post_sum;";
+        src.new_line() << "else new_result = init;";
+    } else {
+        src.new_line() << "if (comp(key10";
+        for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
+        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+        src << ")) new_result = oper(scan_result, post_sum);";
+        src.new_line() << "else new_result = scan_result;";
+    }
 
-        if (exclusive) {
-            src.new_line() << "if (comp(key10";
-            for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-            for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-            src << ")) new_result = post_sum;";
-            src.new_line() << "else new_result = init;";
-        } else {
-            src.new_line() << "if (comp(key10";
-            for(size_t p = 1; p < nK; ++p) src << ", key1" << p;
-            for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-            src << ")) new_result = oper(scan_result, post_sum);";
-            src.new_line() << "else new_result = scan_result;";
-        }
+    src.close("}");
 
-        src.close("}");
+    src.new_line() << "else new_result = scan_result;";
+    src.new_line() << "shared.vals[l_id] = new_result;";
 
-        src.new_line() << "else new_result = scan_result;";
-        src.new_line() << "shared.vals[l_id] = new_result;";
+    src.close("}");
 
-        src.close("}");
+    // Computes a scan within a workgroup,
+    // updates vals in shared but not keys
+    src.new_line() << "sum = shared.vals[l_id];";
+    src.new_line() << "for(size_t offset = 1; offset < " << NT << "; offset *= 2)";
+    src.open("{");
 
-        // Computes a scan within a workgroup,
-        // updates vals in shared but not keys
-        src.new_line() << "sum = shared.vals[l_id];";
-        src.new_line() << "for(size_t offset = 1; offset < " << NT << "; offset *= 2)";
-        src.open("{");
+    src.new_line().barrier();
 
-        src.new_line().barrier();
+    src.new_line() << "if (l_id >= offset)";
+    src.open("{");
 
-        src.new_line() << "if (l_id >= offset)";
-        src.open("{");
+    for(size_t p = 0; p < nK; ++p)
+        src.new_line() << "key2" << p << " = shared.keys" << p << "[l_id - offset];";
 
-        for(size_t p = 0; p < nK; ++p)
-            src.new_line() << "key2" << p << " = shared.keys" << p << "[l_id - offset];";
+    src.new_line() << "if (comp(key0";
+    for(size_t p = 1; p < nK; ++p) src << ", key" << p;
+    for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
+    src << ")) sum = oper(sum, shared.vals[l_id - offset]);";
 
-        src.new_line() << "if (comp(key0";
-        for(size_t p = 1; p < nK; ++p) src << ", key" << p;
-        for(size_t p = 0; p < nK; ++p) src << ", key2" << p;
-        src << ")) sum = oper(sum, shared.vals[l_id - offset]);";
+    src.close("}");
 
-        src.close("}");
+    src.new_line().barrier();
+    src.new_line() << "shared.vals[l_id] = sum;";
 
-        src.new_line().barrier();
-        src.new_line() << "shared.vals[l_id] = sum;";
+    src.close("}");
+    src.new_line().barrier();
 
-        src.close("}");
-        src.new_line().barrier();
+    src.new_line() << "if (g_id < n) ovals[g_id] = sum;";
 
-        src.new_line() << "if (g_id < n) ovals[g_id] = sum;";
+    src.close("}");
+}
 
-        src.close("}");
+//---------------------------------------------------------------------------
+// Kernels used by scan_by_key. They are compiled as a single program.
+template <int NT, typename K, typename V, class Comp, class Oper, bool exclusive>
+struct scan_by_key_kernels {
+    backend::kernel block_scan;
+    backend::kernel block_inclusive_scan;
+    backend::kernel block_add;
+
+    scan_by_key_kernels(const backend::command_queue &queue) {
+        backend::source_generator src(queue);
+
+        Comp::define(src, "comp");
+        Oper::define(src, "oper");
+
+        block_scan_by_key<NT, K, V, exclusive>(src);
+        block_inclusive_scan_by_key<NT, K, V>(src);
+        block_add_by_key<NT, K, V, exclusive>(src);
 
-        kernel = cache.insert(queue, backend::kernel(
-                    queue, src.str(), "block_add_by_key"));
+        auto program = backend::build_program(queue, src.str());
+
+        block_scan           = backend::kernel(queue, program, "block_scan_by_key");
+        block_inclusive_scan = backend::kernel(queue, program, "block_inclusive_scan_by_key");
+        block_add            = backend::kernel(queue, program, "block_add_by_key");
     }
 
-    return kernel->second;
-}
+    static const scan_by_key_kernels& get(const backend::command_queue &queue) {
+        static detail::object_cache<detail::index_by_context, scan_by_key_kernels> cache;
+
+        auto k = cache.find(queue);
+        if (k == cache.end())
+            k = cache.insert(queue, scan_by_key_kernels(queue));
+
+        return k->second;
+    }
+};
 
 template <bool exclusive, class KTuple, class V, class Comp, class Oper>
 void scan_by_key(
@@ -639,6 +628,9 @@ void scan_by_key(
     const auto &queue = fusion::at_c<0>(keys).queue_list()[0];
     backend::select_context(queue);
 
+    access_list acc;
+    acc.write(ovals, 0).read(ivals, 0).read_each(keys, 0).acquire(queue);
+
     const int NT_cpu = 1;
     const int NT_gpu = 256;
     const int NT = is_cpu(queue) ? NT_cpu : NT_gpu;
@@ -650,13 +642,13 @@ void scan_by_key(
     auto ikeys = fusion::transform(keys, extract_device_vector(0));
 
     temp_storage<K>           key_sum (queue, scan_buf_size);
-    backend::device_vector<V> pre_sum (queue, scan_buf_size);
-    backend::device_vector<V> pre_sum1(queue, scan_buf_size);
+    auto pre_sum  = memory_pool::allocate<V>(queue, scan_buf_size);
+    auto pre_sum1 = memory_pool::allocate<V>(queue, scan_buf_size);
 
     /***** Kernel 0 *****/
     auto krn0 = is_cpu(queue) ?
-        block_scan_by_key<NT_cpu, K, V, Comp, Oper, exclusive>(queue) :
-        block_scan_by_key<NT_gpu, K, V, Comp, Oper, exclusive>(queue);
+        scan_by_key_kernels<NT_cpu, K, V, Comp, Oper, exclusive>::get(queue).block_scan :
+        scan_by_key_kernels<NT_gpu, K, V, Comp, Oper, exclusive>::get(queue).block_scan;
 
     krn0.push_arg(count);
     krn0.push_arg(ivals(0));
@@ -673,8 +665,8 @@ void scan_by_key(
 
     /***** Kernel 1 *****/
     auto krn1 = is_cpu(queue) ?
-        block_inclusive_scan_by_key<NT_cpu, K, V, Comp, Oper>(queue) :
-        block_inclusive_scan_by_key<NT_gpu, K, V, Comp, Oper>(queue);
+        scan_by_key_kernels<NT_cpu, K, V, Comp, Oper, exclusive>::get(queue).block_inclusive_scan :
+        scan_by_key_kernels<NT_gpu, K, V, Comp, Oper, exclusive>::get(queue).block_inclusive_scan;
 
     uint work_per_thread = std::max<uint>(1U, static_cast<uint>(scan_buf_size / NT));
 
@@ -689,8 +681,8 @@ void scan_by_key(
 
     /***** Kernel 2 *****/
     auto krn2 = is_cpu(queue) ?
-        block_add_by_key<NT_cpu, K, V, Comp, Oper, exclusive>(queue) :
-        block_add_by_key<NT_gpu, K, V, Comp, Oper, exclusive>(queue);
+        scan_by_key_kernels<NT_cpu, K, V, Comp, Oper, exclusive>::get(queue).block_add :
+        scan_by_key_kernels<NT_gpu, K, V, Comp, Oper, exclusive>::get(queue).block_add;
 
     krn2.push_arg(count);
     krn2.push_arg(pre_sum);
@@ -704,6 +696,8 @@ void scan_by_key(
 
     krn2.config(num_blocks * 2, NT);
     krn2(queue);
+
+    acc.release(queue);
 }
 
 } // namespace sbk
@@ -67,6 +67,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vexcl/backend.hpp>
 #include <vexcl/util.hpp>
 #include <vexcl/vector.hpp>
+#include <vexcl/memory_pool.hpp>
 #include <vexcl/detail/fusion.hpp>
 #include <vexcl/function.hpp>
 
@@ -1063,7 +1064,7 @@ backend::device_vector<int> merge_path_partitions(
     int num_partitions       = (count + nv - 1) / nv;
     int num_partition_blocks = (num_partitions + NT) / NT;
 
-    backend::device_vector<int> partitions(queue, num_partitions + 1);
+    auto partitions = memory_pool::allocate<int>(queue, num_partitions + 1);
 
     auto merge_partition = merge_partition_kernel<NT, K, Comp>(queue);
 
@@ -2053,8 +2054,13 @@ void sort_sink(K &&keys, Comp comp) {
 
     for(unsigned d = 0; d < queue.size(); ++d)
         if (fusion::at_c<0>(keys).part_size(d)) {
+            access_list acc;
+            acc.write_each(keys, d).acquire(queue[d]);
+
             auto part = fusion::transform(keys, extract_device_vector(d));
             sort(queue[d], part, comp.device);
+
+            acc.release(queue[d]);
         }
 
     if (queue.size() <= 1) return;
@@ -2079,9 +2085,14 @@ void sort_by_key_sink(K &&keys, V &&vals, Comp comp) {
 
     for(unsigned d = 0; d < queue.size(); ++d)
         if (fusion::at_c<0>(keys).part_size(d)) {
+            access_list acc;
+            acc.write_each(keys, d).write_each(vals, d).acquire(queue[d]);
+
             auto kpart = fusion::transform(keys, extract_device_vector(d));
             auto vpart = fusion::transform(vals, extract_device_vector(d));
             sort_by_key(queue[d], kpart, vpart, comp.device);
+
+            acc.release(queue[d]);
         }
 
     if (queue.size() <= 1) return;
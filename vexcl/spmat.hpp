@@ -130,6 +130,11 @@ class SpMat {
 
             static kernel_cache cache;
 
+            // Everything below reads x(d) and writes y(d) on queue[d].
+            std::vector<access_list> acc(queue.size());
+            for(unsigned d = 0; d < queue.size(); d++)
+                acc[d].write(y, d).read(x, d).acquire(queue[d]);
+
             if (rx.size()) {
                 // Gather values to send to neighbors.
                 for(unsigned d = 0; d < queue.size(); d++) {
@@ -142,8 +147,12 @@ class SpMat {
                     }
                 }
 
+                // The transfer queues wait for the gather on the device, so
+                // that the host is free to keep submitting work.
                 for(unsigned d = 0; d < queue.size(); d++)
-                    if (cidx[d + 1] > cidx[d]) queue[d].finish();
+                    if (cidx[d + 1] > cidx[d])
+                        backend::enqueue_barrier(squeue[d],
+                                std::vector<backend::event>(1, backend::enqueue_marker(queue[d])));
             }
 
             // Start computing contribution from local part of the matrix.
@@ -180,7 +189,9 @@ class SpMat {
                 }
 
                 for(unsigned d = 0; d < queue.size(); d++)
-                    if (exc[d].cols_to_recv.size()) squeue[d].finish();
+                    if (exc[d].cols_to_recv.size())
+                        backend::enqueue_barrier(queue[d],
+                                std::vector<backend::event>(1, backend::enqueue_marker(squeue[d])));
 
                 // Compute contribution from remote part of the matrix.
                 for(unsigned d = 0; d < queue.size(); d++) {
@@ -190,6 +201,9 @@ class SpMat {
                     }
                 }
             }
+
+            for(unsigned d = 0; d < queue.size(); d++)
+                acc[d].release(queue[d]);
         }
 
         /// Number of rows.
@@ -199,7 +213,7 @@ class SpMat {
         /// Number of non-zero entries.
         size_t nonzeros() const { return nnz;   }
 
-#if defined(VEXCL_BACKEND_OPENCL) || !defined(VEXCL_USE_CUSPARSE)
+#if !defined(VEXCL_BACKEND_CUDA) || !defined(VEXCL_USE_CUSPARSE)
         static void inline_preamble(backend::source_generator &src,
                 const backend::command_queue &queue, const std::string &prm_name,
                 detail::kernel_generator_state_ptr)
@@ -256,7 +270,7 @@ class SpMat {
                     scalar_type alpha
                     ) const = 0;
 
-#if defined(VEXCL_BACKEND_OPENCL) || !defined(VEXCL_USE_CUSPARSE)
+#if !defined(VEXCL_BACKEND_CUDA) || !defined(VEXCL_USE_CUSPARSE)
             virtual void setArgs(backend::kernel &kernel, unsigned part, const vector<val_t> &x) const = 0;
 #endif
 
@@ -264,7 +278,7 @@ class SpMat {
         };
 
 
-#if defined(VEXCL_BACKEND_OPENCL) || !defined(VEXCL_USE_CUSPARSE)
+#if !defined(VEXCL_BACKEND_CUDA) || !defined(VEXCL_USE_CUSPARSE)
 #  include <vexcl/spmat/hybrid_ell.inl>
 #  include <vexcl/spmat/csr.inl>
 #else
@@ -266,6 +266,15 @@ struct expression_properties< ccsr_product<val_t, col_t, idx_t, T> > {
     }
 };
 
+template <typename val_t, typename col_t, typename idx_t, typename T>
+struct terminal_access_tracker< ccsr_product<val_t, col_t, idx_t, T> > {
+    static detail::access_tracker* get(
+            const ccsr_product<val_t, col_t, idx_t, T> &term, unsigned device)
+    {
+        return &term.x.access(device);
+    }
+};
+
 } // namespace traits
 
 #ifdef VEXCL_MULTIVECTOR_HPP
@@ -195,6 +195,13 @@ struct expression_properties< inline_spmv<M, V> > {
     }
 };
 
+template <class M, class V>
+struct terminal_access_tracker< inline_spmv<M, V> > {
+    static detail::access_tracker* get(const inline_spmv<M, V> &term, unsigned device) {
+        return get_access_tracker(term.x, device);
+    }
+};
+
 } // namespace traits
 
 #ifdef VEXCL_MULTIVECTOR_HPP
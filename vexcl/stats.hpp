@@ -0,0 +1,263 @@
+#ifndef VEXCL_STATS_HPP
+#define VEXCL_STATS_HPP
+
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+/**
+ * \file   vexcl/stats.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Per-kernel launch statistics.
+ *
+ * When enabled, the library counts launches, processed elements, and
+ * estimated memory traffic of the generated kernels. The counters are keyed
+ * by the hash of the kernel source. The memory traffic is estimated from the
+ * vector terminals of the expressions. Launches are also bracketed with
+ * timestamp events where the queues support those, so that the achieved
+ * bandwidth may be reported.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/io/ios_state.hpp>
+
+#include <vexcl/backend.hpp>
+
+namespace vex {
+
+/// Per-kernel launch statistics.
+namespace stats {
+
+/// Statistics of a single kernel.
+struct record {
+    std::string kernel;   ///< Kernel name.
+    size_t      launches; ///< Number of launches.
+    size_t      elements; ///< Total number of processed elements.
+    size_t      bytes;    ///< Estimated device memory traffic in bytes.
+    size_t      timed;    ///< Number of launches with known device time.
+    double      time;     ///< Device time (in seconds) of the timed launches.
+
+    record(const std::string &kernel = "")
+        : kernel(kernel), launches(0), elements(0), bytes(0), timed(0), time(0)
+    {}
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+inline bool& enabled_flag() {
+    static bool on = false;
+    return on;
+}
+
+struct entry {
+    record stat;
+
+    // Traffic of the timed launches; the launches that were not timed do
+    // not count towards the achieved bandwidth.
+    size_t timed_bytes;
+
+    // Timestamps of the launches waiting to be resolved.
+    std::vector< std::pair<backend::event, backend::event> > pending;
+    std::vector<size_t> pending_bytes;
+
+    entry(const std::string &kernel) : stat(kernel), timed_bytes(0) {}
+
+    void resolve() {
+        for(size_t i = 0; i < pending.size(); ++i) {
+            stat.time += backend::elapsed(pending[i].first, pending[i].second);
+            stat.timed++;
+            timed_bytes += pending_bytes[i];
+        }
+
+        pending.clear();
+        pending_bytes.clear();
+    }
+};
+
+inline std::mutex& store_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+inline std::map< std::string, std::shared_ptr<entry> >& store() {
+    static std::map< std::string, std::shared_ptr<entry> > s;
+    return s;
+}
+
+// Statistics counter of a kernel identified by its source.
+class counter {
+    public:
+        counter() {}
+
+        counter(const std::string &src, const std::string &name) {
+            std::string key = sha1(name + "\n" + src);
+
+            std::lock_guard<std::mutex> lock(store_mutex());
+
+            auto s = store().find(key);
+            if (s == store().end())
+                s = store().insert(std::make_pair(key, std::make_shared<entry>(name))).first;
+
+            e = s->second;
+        }
+
+        // Registers a single kernel launch. Should be followed by done()
+        // once the launch is enqueued.
+        class launch {
+            public:
+                launch(const counter &c, const backend::command_queue &q,
+                        size_t elements, size_t bytes)
+                    : e(enabled_flag() ? c.e.get() : 0), q(q),
+                      elements(elements), bytes(bytes), timed(false)
+                {
+                    if (e && backend::profiling_enabled(q)) {
+                        start = backend::enqueue_timestamp(q);
+                        timed = true;
+                    }
+                }
+
+                void done() {
+                    if (!e) return;
+
+                    backend::event stop;
+                    if (timed) stop = backend::enqueue_timestamp(q);
+
+                    std::lock_guard<std::mutex> lock(store_mutex());
+
+                    e->stat.launches++;
+                    e->stat.elements += elements;
+                    e->stat.bytes    += bytes;
+
+                    if (timed) {
+                        e->pending.push_back(std::make_pair(start, stop));
+                        e->pending_bytes.push_back(bytes);
+                    }
+                }
+            private:
+                entry *e;
+                const backend::command_queue &q;
+                size_t elements, bytes;
+                bool timed;
+                backend::event start;
+        };
+    private:
+        std::shared_ptr<entry> e;
+};
+
+} // namespace detail
+/// \endcond
+
+/// Enables or disables collection of the kernel statistics.
+/**
+ * With the OpenCL backend, device time is only measured for the queues
+ * created with CL_QUEUE_PROFILING_ENABLE property.
+ */
+inline void enable(bool on = true) {
+    detail::enabled_flag() = on;
+}
+
+/// Returns true if collection of the kernel statistics is enabled.
+inline bool enabled() {
+    return detail::enabled_flag();
+}
+
+/// Returns statistics of the launched kernels indexed by kernel source hash.
+/**
+ * Waits for completion of the timed launches.
+ */
+inline std::map<std::string, record> results() {
+    std::lock_guard<std::mutex> lock(detail::store_mutex());
+
+    std::map<std::string, record> res;
+    for(auto s = detail::store().begin(); s != detail::store().end(); ++s) {
+        s->second->resolve();
+        if (s->second->stat.launches) res.insert(std::make_pair(s->first, s->second->stat));
+    }
+
+    return res;
+}
+
+/// Resets all counters.
+inline void reset() {
+    std::lock_guard<std::mutex> lock(detail::store_mutex());
+
+    for(auto s = detail::store().begin(); s != detail::store().end(); ++s) {
+        s->second->resolve();
+        *(s->second) = detail::entry(s->second->stat.kernel);
+    }
+}
+
+/// Prints the kernel statistics along with the achieved bandwidth.
+inline void report(std::ostream &os = std::cout) {
+    // Achieved bandwidth is computed from the timed launches only:
+    std::map<std::string, double> bw;
+    std::map<std::string, record> res;
+    {
+        std::lock_guard<std::mutex> lock(detail::store_mutex());
+
+        for(auto s = detail::store().begin(); s != detail::store().end(); ++s) {
+            s->second->resolve();
+
+            const detail::entry &e = *(s->second);
+            if (!e.stat.launches) continue;
+
+            res.insert(std::make_pair(s->first, e.stat));
+            bw[s->first] = e.stat.time > 0 ? 1e-9 * e.timed_bytes / e.stat.time : 0.0;
+        }
+    }
+
+    boost::io::ios_all_saver stream_state(os);
+
+    os << std::left << std::setw(10) << "key"
+       << std::setw(26) << "kernel"
+       << std::right << std::setw(10) << "launches"
+       << std::setw(14) << "elements"
+       << std::setw(12) << "MB"
+       << std::setw(12) << "time (s)"
+       << std::setw(10) << "GB/s" << std::endl;
+
+    for(auto r = res.begin(); r != res.end(); ++r) {
+        os << std::left  << std::setw(10) << r->first.substr(0, 8)
+           << std::setw(26) << r->second.kernel
+           << std::right << std::setw(10) << r->second.launches
+           << std::setw(14) << r->second.elements
+           << std::fixed
+           << std::setw(12) << std::setprecision(2) << r->second.bytes / 1048576.0
+           << std::setw(12) << std::setprecision(6) << r->second.time
+           << std::setw(10) << std::setprecision(2) << bw[r->first]
+           << std::endl;
+    }
+}
+
+} // namespace stats
+} // namespace vex
+
+#endif
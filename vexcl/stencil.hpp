@@ -113,8 +113,9 @@ void stencil_base<T>::exchange_halos(const vex::vector<T> &x) const {
         }
     }
 
-    // Wait for the end of transfer.
-    for(unsigned d = 0; d < queue.size(); d++) queue[d].finish();
+    // Wait for the end of transfer. Only the halo reads are waited for,
+    // work submitted to the queues after them keeps running.
+    for(unsigned d = 0; d < queue.size(); d++) x.access(d).wait();
 
     // Write halos to a local buffer.
     for(unsigned d = 0; d < queue.size(); d++) {
@@ -562,7 +563,7 @@ void StencilOperator<T, width, center, Impl>::apply(
     for(unsigned d = 0; d < queue.size(); d++) {
         backend::select_context(queue[d]);
 
-        auto key    = backend::get_context_id(queue[d]);
+        auto key    = get_queue_info(queue[d]).context;
         auto kernel = cache.find(queue[d]);
 
         if (kernel == cache.end()) {
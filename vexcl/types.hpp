@@ -46,8 +46,10 @@ THE SOFTWARE.
 #  include <CL/cl.hpp>
 #elif defined(VEXCL_BACKEND_CUDA)
 #  include <CL/cl_platform.h>
+#elif defined(VEXCL_BACKEND_JIT)
+#  include <vexcl/backend/jit/types.hpp>
 #else
-#  error Neither OpenCL nor CUDA backend is selected
+#  error Neither OpenCL, CUDA, nor JIT backend is selected
 #endif
 
 /// \cond INTERNAL
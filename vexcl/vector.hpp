@@ -49,6 +49,10 @@ THE SOFTWARE.
 #include <vexcl/operations.hpp>
 #include <vexcl/profiler.hpp>
 #include <vexcl/devlist.hpp>
+#include <vexcl/memory_pool.hpp>
+#include <vexcl/detail/throughput.hpp>
+#include <vexcl/device_profile.hpp>
+#include <vexcl/deferred.hpp>
 
 #ifdef BOOST_NO_NOEXCEPT
 #  define noexcept throw()
@@ -66,7 +70,9 @@ namespace vex {
  a = b + c;
  \endcode
  * where a, b and c are device vectors. Each device gets portion of the vector
- * proportional to the performance of this operation.
+ * proportional to the performance of this operation. The measured weights are
+ * stored on disk (see vex::device_profile), so that the test is only run once
+ * for each device, driver, and host.
  */
 inline double device_vector_perf(const backend::command_queue&);
 
@@ -100,6 +106,10 @@ struct partitioning_scheme {
 
     static std::vector<size_t> get(size_t n, const std::vector<backend::command_queue> &queue);
 
+    static void set_weight(backend::device_id dev, double w) {
+        device_weight[dev] = w;
+    }
+
     private:
         static bool is_set;
         static weight_function weight;
@@ -131,7 +141,7 @@ std::vector<size_t> partitioning_scheme<dummy>::get(size_t n,
         cumsum.push_back(0);
 
         for(auto q = queue.begin(); q != queue.end(); q++) {
-            auto dev_id = backend::get_device_id(*q);
+            auto dev_id = get_queue_info(*q).device;
             auto dw = device_weight.find(dev_id);
 
             double w = (dw == device_weight.end()) ?
@@ -178,6 +188,48 @@ inline std::vector<size_t> partition(size_t n,
     return partitioning_scheme<>::get(n, queue);
 }
 
+/// Starts (or stops) measuring throughput of element-wise kernels on each device.
+/**
+ * The measurements are used by adapt_partitioning(). With the OpenCL
+ * backend, only queues created with CL_QUEUE_PROFILING_ENABLE property are
+ * measured.
+ */
+inline void measure_device_throughput(bool on = true) {
+    detail::throughput_meter::instance().enabled = on;
+}
+
+/// Replaces device weights with the measured throughput of element-wise kernels.
+/**
+ * The weights are only updated when each device of the given queue list has
+ * been measured; the return value tells if this was the case. The
+ * measurements are reset afterwards. Vectors created after the call are
+ * partitioned with the new weights; the existing ones may be moved to the new
+ * partitioning with vector::repartition(). Sparse matrices should be
+ * reconstructed.
+ * \code
+ * vex::measure_device_throughput();
+ * for(int i = 0; i < 10; ++i) step(x, y);
+ * if (vex::adapt_partitioning(ctx)) {
+ *     x.repartition();
+ *     y.repartition();
+ * }
+ * \endcode
+ */
+inline bool adapt_partitioning(const std::vector<backend::command_queue> &queue) {
+    auto rates = detail::throughput_meter::instance().rates();
+
+    for(auto q = queue.begin(); q != queue.end(); ++q)
+        if (!rates.count(get_queue_info(*q).device)) return false;
+
+    for(auto q = queue.begin(); q != queue.end(); ++q) {
+        auto dev = get_queue_info(*q).device;
+        partitioning_scheme<>::set_weight(dev, rates[dev]);
+    }
+
+    detail::throughput_meter::instance().clear();
+    return true;
+}
+
 /// \cond INTERNAL
 
 //--- Vector Type -----------------------------------------------------------
@@ -230,13 +282,16 @@ class vector : public vector_terminal_expression {
                 /// Read associated element of a vector.
                 operator T() const {
                     T val;
+                    acc.acquire(queue, false);
                     buf.read(queue, index, 1, &val, true);
                     return val;
                 }
 
                 /// Write associated element of a vector.
                 T operator=(T val) {
+                    acc.acquire(queue, true);
                     buf.write(queue, index, 1, &val, true);
+                    acc.release(queue, true);
                     return val;
                 }
 
@@ -253,12 +308,14 @@ class vector : public vector_terminal_expression {
             private:
                 element(const backend::command_queue &q,
                         const backend::device_vector<T> &b,
+                        detail::access_tracker &a,
                         size_t i
-                        ) : queue(q), buf(b), index(i)
+                        ) : queue(q), buf(b), acc(a), index(i)
                 {}
 
                 const backend::command_queue    &queue;
                 const backend::device_vector<T> &buf;
+                detail::access_tracker          &acc;
 
                 size_t index;
 
@@ -312,7 +369,7 @@ class vector : public vector_terminal_expression {
 
                 reference dereference() const {
                     return element_type(
-                            vec->queue[part], vec->buf[part],
+                            vec->queue[part], vec->buf[part], vec->acc[part],
                             pos - vec->part[part]
                             );
                 }
@@ -370,13 +427,19 @@ class vector : public vector_terminal_expression {
         vector(const backend::command_queue &q,
                const backend::device_vector<T> &buffer,
                size_t size = 0
-               ) : queue(1, q), part(2), buf(1, buffer)
+               ) : queue(1, q), part(2), buf(1, buffer), acc(1)
         {
             part[0] = 0;
             part[1] = size ? size : buffer.size();
         }
 
         /// Copy host data to the new buffer.
+        /**
+         * With backend::MEM_USE_HOST_PTR flag the vector wraps the host
+         * memory instead (zero-copy on devices sharing memory with the host),
+         * and copying to or from the wrapped memory only synchronizes it.
+         * Backends that do not support this fall back to copying.
+         */
         vector(const std::vector<backend::command_queue> &queue,
                 size_t size, const T *host = 0,
                 backend::mem_flags flags = backend::MEM_READ_WRITE
@@ -414,9 +477,41 @@ class vector : public vector_terminal_expression {
         }
 #endif
 
+        /// Allocate uninitialized buffers from the memory pool.
+        /**
+         * The memory goes back to vex::memory_pool when the vector is
+         * destroyed, which makes this suitable for short-lived temporaries.
+         */
+        vector(const std::vector<backend::command_queue> &queue,
+                size_t size, memory_pool::pooled_t
+              ) : queue(queue), part(vex::partition(size, queue))
+        {
+            if (size) allocate_pooled_buffers();
+        }
+
+#ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
+        /// Allocate uninitialized buffers from the memory pool, use static context.
+        vector(size_t size, memory_pool::pooled_t
+              ) : queue(current_context().queue()), part(vex::partition(size, queue))
+        {
+            if (size) allocate_pooled_buffers();
+        }
+#endif
+
         /// Move constructor
+        /**
+         * Does not flush deferred statements (see vex::deferred) that use
+         * v, so that it can stay noexcept.
+         */
         vector(vector &&v) noexcept {
-            swap(v);
+            swap_members(this, &v);
+            if (!detail::deferred_move(&v, this, &swap_members))
+                swap_members(this, &v);
+        }
+
+        /// Destructor. Executes deferred statements that use the vector.
+        ~vector() {
+            detail::deferred_sync_nothrow(this);
         }
 
         /// Construct new vector from vector expression.
@@ -468,9 +563,8 @@ class vector : public vector_terminal_expression {
 
         /// Swap function.
         void swap(vector &v) {
-            std::swap(queue,   v.queue);
-            std::swap(part,    v.part);
-            std::swap(buf,     v.buf);
+            detail::deferred_sync(this, &v);
+            swap_members(this, &v);
         }
 
         /// Resize vector.
@@ -524,37 +618,43 @@ class vector : public vector_terminal_expression {
 
         /// Const iterator to beginning.
         const_iterator begin() const {
+            detail::deferred_sync(this);
             return const_iterator(*this, 0);
         }
 
         /// Const iterator to end.
         const_iterator end() const {
+            detail::deferred_sync(this);
             return const_iterator(*this, size());
         }
 
         /// Iterator to beginning.
         iterator begin() {
+            detail::deferred_sync(this);
             return iterator(*this, 0);
         }
 
         /// Iterator to end.
         iterator end() {
+            detail::deferred_sync(this);
             return iterator(*this, size());
         }
 
         /// Access element.
         const element operator[](size_t index) const {
+            detail::deferred_sync(this);
             size_t d = std::upper_bound(
                     part.begin(), part.end(), index) - part.begin() - 1;
-            return element(queue[d], buf[d], index - part[d]);
+            return element(queue[d], buf[d], acc[d], index - part[d]);
         }
 
         /// Access element.
         element operator[](size_t index) {
+            detail::deferred_sync(this);
             unsigned d = static_cast<unsigned>(
                 std::upper_bound(part.begin(), part.end(), index) - part.begin() - 1
                 );
-            return element(queue[d], buf[d], index - part[d]);
+            return element(queue[d], buf[d], acc[d], index - part[d]);
         }
 
         /// Return size .
@@ -587,8 +687,36 @@ class vector : public vector_terminal_expression {
             return part;
         }
 
+        /// Moves the data to the current partitioning of the vector queues.
+        /**
+         * Should be called after device weights are changed with
+         * vex::adapt_partitioning(). All vectors used together in an
+         * expression should be repartitioned. The data is moved through the
+         * host memory, and the vector gets freshly allocated buffers. Returns
+         * true if the partitioning has changed.
+         */
+        bool repartition() {
+            std::vector<size_t> new_part = vex::partition(size(), queue);
+            if (new_part == part) return false;
+
+            std::vector<T> host(size());
+            read_data(0, size(), host.data(), true);
+
+            part.swap(new_part);
+            allocate_buffers(backend::MEM_READ_WRITE, host.data());
+
+            return true;
+        }
+
+        /// \cond INTERNAL
+        /// Tracks pending accesses to the buffer located on a given device.
+        detail::access_tracker& access(unsigned d = 0) const {
+            return acc[d];
+        }
+        /// \endcond
+
         const vector& operator=(const vector &x) {
-            if (&x != this)
+            if (&x != this && !detail::defer_assignment<assign::SET>(*this, x, queue, part))
                 detail::assign_expression<assign::SET>(*this, x, queue, part);
             return *this;
         }
@@ -596,6 +724,7 @@ class vector : public vector_terminal_expression {
         /// Maps device buffer to host array.
         typename backend::device_vector<T>::mapped_array
         map(unsigned d = 0) {
+            detail::deferred_sync(this);
             return buf[d].map(queue[d]);
         }
 
@@ -616,7 +745,8 @@ class vector : public vector_terminal_expression {
           typename boost::proto::result_of::as_expr<Expr>::type,               \
           vector_expr_grammar>::value,                                         \
       const vector &>::type operator cop(const Expr & expr) {                  \
-    detail::assign_expression<op>(*this, expr, queue, part);                   \
+    if (!detail::defer_assignment<op>(*this, expr, queue, part))              \
+      detail::assign_expression<op>(*this, expr, queue, part);                 \
     return *this;                                                              \
   }
 #endif
@@ -747,22 +877,22 @@ class vector : public vector_terminal_expression {
         {
             if (!size) return;
 
+            detail::deferred_sync(this);
+
             for(unsigned d = 0; d < queue.size(); d++) {
                 size_t start = std::max(offset,        part[d]);
                 size_t stop  = std::min(offset + size, part[d + 1]);
 
                 if (stop <= start) continue;
 
+                acc[d].acquire(queue[d], true);
+                trace::detail::command cmd(queue[d]);
                 buf[d].write(queue[d], start - part[d], stop - start, hostptr + start - offset);
+                cmd.done("write_data", "transfer", (stop - start) * sizeof(T));
+                acc[d].release(queue[d], true);
             }
 
-            if (blocking)
-                for(size_t d = 0; d < queue.size(); d++) {
-                    size_t start = std::max(offset,        part[d]);
-                    size_t stop  = std::min(offset + size, part[d + 1]);
-
-                    if (start < stop) queue[d].finish();
-                }
+            if (blocking) wait_for(offset, size);
         }
 
         /// Copy data from device(s) to host buffer .
@@ -770,33 +900,59 @@ class vector : public vector_terminal_expression {
         {
             if (!size) return;
 
+            detail::deferred_sync(this);
+
             for(unsigned d = 0; d < queue.size(); d++) {
                 size_t start = std::max(offset,        part[d]);
                 size_t stop  = std::min(offset + size, part[d + 1]);
 
                 if (stop <= start) continue;
 
+                acc[d].acquire(queue[d], false);
+                trace::detail::command cmd(queue[d]);
                 buf[d].read(queue[d], start - part[d], stop - start, hostptr + start - offset);
+                cmd.done("read_data", "transfer", (stop - start) * sizeof(T));
+                acc[d].release(queue[d], false);
             }
 
-            if (blocking)
-                for(unsigned d = 0; d < queue.size(); d++) {
-                    size_t start = std::max(offset,        part[d]);
-                    size_t stop  = std::min(offset + size, part[d + 1]);
-
-                    if (start < stop) queue[d].finish();
-                }
+            if (blocking) wait_for(offset, size);
         }
 
     private:
         std::vector<backend::command_queue>      queue;
         std::vector<size_t>                      part;
         std::vector< backend::device_vector<T> > buf;
+        mutable std::vector<detail::access_tracker> acc;
+
+        static void swap_members(void *a, void *b) {
+            vector &x = *static_cast<vector*>(a);
+            vector &y = *static_cast<vector*>(b);
+
+            std::swap(x.queue, y.queue);
+            std::swap(x.part,  y.part);
+            std::swap(x.buf,   y.buf);
+            std::swap(x.acc,   y.acc);
+        }
+
+        // Waits for the transfers involving the given range to complete.
+        // Only the partitions touched by the range are waited for, so that
+        // unrelated work on the other queues keeps running.
+        void wait_for(size_t offset, size_t size) const {
+            for(unsigned d = 0; d < queue.size(); d++) {
+                size_t start = std::max(offset,        part[d]);
+                size_t stop  = std::min(offset + size, part[d + 1]);
+
+                if (start < stop) acc[d].wait();
+            }
+        }
 
         void allocate_buffers(backend::mem_flags flags, const T *hostptr) {
             buf.clear();
             buf.reserve(queue.size());
 
+            acc.clear();
+            acc.resize(queue.size());
+
             for(unsigned d = 0; d < queue.size(); d++)
                 buf.push_back(
                         backend::device_vector<T>(
@@ -805,6 +961,19 @@ class vector : public vector_terminal_expression {
                         );
         }
 
+        void allocate_pooled_buffers() {
+            buf.clear();
+            buf.reserve(queue.size());
+
+            acc.clear();
+            acc.resize(queue.size());
+
+            for(unsigned d = 0; d < queue.size(); d++)
+                buf.push_back(
+                        memory_pool::allocate<T>(queue[d], part[d + 1] - part[d])
+                        );
+        }
+
         template <typename S, size_t N>
         friend class multivector;
 };
@@ -820,28 +989,44 @@ struct is_vector_expr_terminal< vector_terminal > : std::true_type {};
 template <>
 struct proto_terminal_is_value< vector_terminal > : std::true_type {};
 
+template <>
+struct is_deferrable_terminal< vector_terminal > : std::true_type {};
+
 template <typename T>
 struct kernel_param_declaration< vector<T> > {
     static void get(backend::source_generator &src,
             const vector<T>&,
             const backend::command_queue&, const std::string &prm_name,
-            detail::kernel_generator_state_ptr)
+            detail::kernel_generator_state_ptr state)
     {
-        src.parameter< global_ptr<T> >(prm_name);
+        if (detail::no_alias_parameter(state, prm_name))
+            src.parameter< restrict_ptr<const T> >(prm_name);
+        else if (detail::read_only_parameter(state))
+            src.parameter< global_ptr<const T> >(prm_name);
+        else
+            src.parameter< global_ptr<T> >(prm_name);
     }
 };
 
 template <typename T>
 struct partial_vector_expr< vector<T> > {
     static void get(backend::source_generator &src,
-            const vector<T>&,
+            const vector<T> &term,
             const backend::command_queue&, const std::string &prm_name,
-            detail::kernel_generator_state_ptr)
+            detail::kernel_generator_state_ptr state)
     {
-        src << prm_name << "[idx]";
+        if (const std::string *var = detail::terminal_variable(state, std::addressof(term)))
+            src << *var;
+        else if (unsigned w = detail::loaded_vector_width(state))
+            src << "vload" << w << "(idx, " << prm_name << ")";
+        else
+            src << prm_name << "[idx]";
     }
 };
 
+template <typename T>
+struct is_wide_terminal< vector<T>, T > : std::true_type {};
+
 template <typename T>
 struct kernel_arg_setter< vector<T> > {
     static void set(const vector<T> &term,
@@ -866,6 +1051,27 @@ struct expression_properties< vector<T> > {
     }
 };
 
+template <class T>
+struct terminal_access_tracker< vector<T> > {
+    static detail::access_tracker* get(const vector<T> &term, unsigned device) {
+        return &term.access(device);
+    }
+};
+
+template <class T>
+struct terminal_buffer_id< vector<T> > {
+    static size_t get(const vector<T> &term, unsigned device) {
+        return term.size() ? (size_t)term(device).raw() : 0;
+    }
+};
+
+template <class T>
+struct terminal_bytes_per_element< vector<T> > {
+    static size_t get(const vector<T>&) {
+        return sizeof(T);
+    }
+};
+
 } // namespace traits
 
 //---------------------------------------------------------------------------
@@ -957,23 +1163,7 @@ void swap(vector<T> &x, vector<T> &y) {
 
 /// Returns device weight after simple bandwidth test
 inline double device_vector_perf(const backend::command_queue &q) {
-    static const size_t test_size = 1024U * 1024U;
-    std::vector<backend::command_queue> queue(1, q);
-
-    // Allocate test vectors on current device and measure execution
-    // time of a simple kernel.
-    vex::vector<float> a(queue, test_size);
-    vex::vector<float> b(queue, test_size);
-    vex::vector<float> c(queue, test_size);
-
-    // Skip the first run.
-    a = b + c;
-
-    // Measure the second run.
-    profiler<> prof(queue);
-    prof.tic_cl("");
-    a = b + c;
-    return 1.0 / prof.toc("");
+    return device_profile::get(q).weight;
 }
 
 
@@ -110,6 +110,13 @@ struct expression_properties< vector_pointer<T> >
     }
 };
 
+template <typename T>
+struct terminal_access_tracker< vector_pointer<T> > {
+    static detail::access_tracker* get(const vector_pointer<T> &term, unsigned device) {
+        return &term.v.access(device);
+    }
+};
+
 } // namespace traits
 }
 
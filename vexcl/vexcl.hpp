@@ -39,6 +39,7 @@ THE SOFTWARE.
 #include <vexcl/vector.hpp>
 #include <vexcl/vector_view.hpp>
 #include <vexcl/vector_pointer.hpp>
+#include <vexcl/device_scalar.hpp>
 #include <vexcl/tagged_terminal.hpp>
 #include <vexcl/temporary.hpp>
 #include <vexcl/cast.hpp>
@@ -58,5 +59,10 @@ THE SOFTWARE.
 #include <vexcl/reduce_by_key.hpp>
 #include <vexcl/profiler.hpp>
 #include <vexcl/function.hpp>
+#include <vexcl/precompile.hpp>
+#include <vexcl/graph.hpp>
+#include <vexcl/stats.hpp>
+#include <vexcl/device_profile.hpp>
+#include <vexcl/deferred.hpp>
 
 #endif